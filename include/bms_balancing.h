@@ -24,6 +24,11 @@ private:
     const float BAL_DELTA_STOP  = 0.03f;
     const float BAL_MIN_CELL_V  = 3.50f;
     
+    // Cân bằng theo điện lượng (khi SOC từng cell đủ tin cậy)
+    const float BAL_EXCESS_START = 30.0f;     // mAh
+    const float BAL_EXCESS_STOP  = 10.0f;
+    const float BAL_CHARGE_MIN_CELL_V = 3.20f;
+    
     const unsigned long BAL_ON_TIME  = 5000;
     const unsigned long BAL_OFF_TIME = 5000;
     
@@ -33,11 +38,21 @@ private:
     bool bal_on_phase;
     uint8_t bal_cell;
     
+    // Thời gian xả tích luỹ cho từng cell (ms)
+    unsigned long bal_last_update;
+    uint32_t bal_on_ms[4];
+    
+    // Mục tiêu theo điện lượng
+    float bal_excess[4];
+    bool bal_charge_mode;
+    bool bal_by_charge;           // lượt cân bằng đang chạy theo điện lượng (false = chênh áp)
+    
     // ========================= HÀM NỘI BỘ =========================
     void balanceAllOff();
     void balanceEnable(uint8_t cell);
     uint8_t getMaxCellIndex(float cell1, float cell2, float cell3, float cell4);
     float getMinCellVoltage(float cell1, float cell2, float cell3, float cell4);
+    uint8_t getMaxExcessIndex() const;
 
 public:
     // ========================= CONSTRUCTOR =========================
@@ -48,11 +63,16 @@ public:
     
     // ========================= CẬP NHẬT CÂN BẰNG =========================
     void update(float cell1, float cell2, float cell3, float cell4, float current);
+    // Gọi trước update(): excess_mAh = lượng cần xả của từng cell; valid = false → theo điện áp.
+    // valid nhưng không cell nào thừa ≥ BAL_EXCESS_START → vẫn cân bằng theo chênh áp
+    void setChargeTargets(const float excess_mAh[4], bool valid);
     
     // ========================= GETTERS =========================
     bool isActive() const;
     bool isBalancing(uint8_t cell) const;
     uint8_t getBalancingCell() const;
+    float getBalancingSeconds(uint8_t cell) const;
+    bool isChargeTargeted() const;
     
     // ========================= STOP THỦ CÔNG =========================
     void stop();
@@ -0,0 +1,98 @@
+#ifndef BMS_BLACKBOX_H
+#define BMS_BLACKBOX_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <Preferences.h>
+#include "bms_protection.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS BLACK-BOX MODULE
+ *  Ring buffer mẫu thô (tap, dòng, nhiệt độ) chạy liên tục ở
+ *  chu kỳ đo. Khi bảo vệ trip: đóng băng phần pre-trigger,
+ *  ghi tiếp phần post-trigger vào bản ghi trong RTC memory
+ *  (giữ qua reset mềm/watchdog), xong thì chép sang NVS
+ *  (giữ qua mất nguồn). Lưu 4 sự kiện gần nhất.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const uint16_t BLACKBOX_SAMPLE_MS = 100;     // theo chu kỳ updateAllBMSData()
+const uint16_t BLACKBOX_PRE_MS = 5000;
+const uint16_t BLACKBOX_POST_MS = 2000;
+const uint8_t BLACKBOX_PRE_SAMPLES = BLACKBOX_PRE_MS / BLACKBOX_SAMPLE_MS;
+const uint8_t BLACKBOX_POST_SAMPLES = BLACKBOX_POST_MS / BLACKBOX_SAMPLE_MS;
+const uint8_t BLACKBOX_SAMPLES = BLACKBOX_PRE_SAMPLES + BLACKBOX_POST_SAMPLES;
+const uint8_t BLACKBOX_SLOTS = 4;
+
+struct BlackBoxSample {
+    uint32_t time_ms;
+    uint16_t tap_mV[4];
+    int16_t  current_mA;
+    int16_t  temp_dC;
+};
+
+enum BlackBoxState : uint8_t {
+    BB_CAPTURING,      // đang ghi post-trigger
+    BB_COMPLETE,       // đủ mẫu, chưa chép sang NVS
+    BB_SAVED           // đã nằm trong NVS
+};
+
+struct BlackBoxRecord {
+    uint32_t magic;
+    uint32_t id;              // số thứ tự sự kiện, tăng dần
+    uint32_t triggerTime;     // millis() lúc trip
+    float    triggerValue;    // V, A hoặc °C tuỳ nguyên nhân
+    uint16_t boot;
+    uint8_t  cause;           // ProtectionType
+    uint8_t  tripMask;        // mọi trip trong cửa sổ ghi (bit = ProtectionType)
+    uint8_t  preCount;
+    uint8_t  count;
+    uint8_t  state;           // BlackBoxState
+    uint8_t  reserved;
+    BlackBoxSample samples[BLACKBOX_SAMPLES];
+    uint32_t crc;
+};
+
+class BMSBlackBox {
+private:
+    // ========================= PRE-TRIGGER RING =========================
+    BlackBoxSample ring[BLACKBOX_PRE_SAMPLES];
+    uint8_t ringHead;
+    uint8_t ringCount;
+
+    // ========================= LƯU TRỮ =========================
+    Preferences prefs;
+    uint32_t nextId;
+    uint16_t bootCount;
+
+    // ========================= HÀM NỘI BỘ =========================
+    static void seal(BlackBoxRecord& record);
+    static bool isValid(const BlackBoxRecord& record);
+    void persist();
+
+public:
+    BMSBlackBox();
+    // Gọi sau logger.begin() để có boot count
+    void begin(uint16_t boot);
+
+    // Gọi ở mỗi chu kỳ đo, trước trigger()
+    void addSample(const float taps[4], float current, float temp);
+    void trigger(ProtectionType cause, float value);
+
+    bool isCapturing() const;
+    uint8_t getStoredCount() const;
+    // index 0 = sự kiện mới nhất
+    bool getRecord(uint8_t index, BlackBoxRecord& record);
+    void clear();
+
+    // HTTP: danh sách sự kiện, hoặc toàn bộ mẫu của một sự kiện
+    void streamList(WebServer& server);
+    void streamRecord(WebServer& server, const BlackBoxRecord& record);
+
+    // Serial
+    void printList();
+    void printRecord(const BlackBoxRecord& record);
+};
+
+#endif // BMS_BLACKBOX_H
@@ -0,0 +1,319 @@
+#ifndef BMS_CODEC_H
+#define BMS_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "bms_frame.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS CODEC - nén chuỗi thời gian theo block
+ *  Header-only, không phụ thuộc Arduino: dùng cho bộ đệm lịch
+ *  sử trong RAM, log flash và chương trình host (benchmark).
+ * ═══════════════════════════════════════════════════════════
+ *
+ *  Mỗi block độc lập (mẫu đầu lưu nguyên) → truy cập ngẫu nhiên
+ *  theo block: tìm block theo firstTime/lastTime rồi chỉ giải
+ *  mã block đó. Kích thước block do người gọi chọn (512 B RAM,
+ *  4 KB sector flash, ...).
+ *
+ *  Header (little-endian):
+ *  0   4   timestamp mẫu đầu (ms)
+ *  4   4   timestamp mẫu cuối (ms)
+ *  8   2   số mẫu
+ *  10  1   số kênh (1..BMS_CODEC_MAX_CHANNELS)
+ *  11  1   xorMask: bit c = 1 → kênh c mã hoá XOR, 0 → zigzag-delta
+ *  12  2*N giá trị mẫu đầu (int16)
+ *  ... bitstream các mẫu sau (MSB trước)
+ *
+ *  Timestamp - delta-of-delta (dod, ms), zz = zigzag(dod):
+ *    '0'                  dod = 0
+ *    '10'   + 7 bit       zz < 2^7
+ *    '110'  + 12 bit      zz < 2^12
+ *    '1110' + 20 bit      zz < 2^20
+ *    '1111' + 32 bit      delta tuyệt đối
+ *
+ *  Giá trị zigzag-delta, zz = zigzag((int16)(v - prev)):
+ *    '0'                  không đổi
+ *    '10'   + 4 bit       zz < 2^4
+ *    '110'  + 8 bit       zz < 2^8
+ *    '111'  + 16 bit      còn lại
+ *
+ *  Giá trị XOR, x = v ^ prev:
+ *    '0'                  x = 0
+ *    '1' + 4 bit leading zero + 4 bit trailing zero + phần giữa
+ */
+
+#define BMS_CODEC_HEADER_SIZE    12
+#define BMS_CODEC_MAX_CHANNELS   8
+
+struct BMSCodecBlockInfo {
+    uint32_t firstTime;
+    uint32_t lastTime;
+    uint16_t count;
+    uint8_t  channels;
+    uint8_t  xorMask;
+};
+
+// ==================== HÀM PHỤ ====================
+inline uint32_t bmsZigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline int32_t bmsUnzigzag(uint32_t z) {
+    return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+// x != 0
+inline uint8_t bmsLeadingZeros16(uint16_t x) {
+    return (uint8_t)(__builtin_clz((uint32_t)x) - 16);
+}
+
+inline uint8_t bmsTrailingZeros16(uint16_t x) {
+    return (uint8_t)__builtin_ctz((uint32_t)x);
+}
+
+inline bool bmsCodecReadInfo(const uint8_t* block, size_t size, BMSCodecBlockInfo& info) {
+    if (size < BMS_CODEC_HEADER_SIZE) return false;
+    info.firstTime = bmsGetU32(block);
+    info.lastTime = bmsGetU32(block + 4);
+    info.count = bmsGetU16(block + 8);
+    info.channels = block[10];
+    info.xorMask = block[11];
+    return info.channels >= 1 && info.channels <= BMS_CODEC_MAX_CHANNELS &&
+           BMS_CODEC_HEADER_SIZE + 2u * info.channels <= size;
+}
+
+// ==================== ENCODER ====================
+class BMSCodecWriter {
+private:
+    uint8_t* buf;
+    size_t size;
+    size_t bitPos;
+    uint8_t channels;
+    uint8_t xorMask;
+    uint16_t count;
+    uint32_t lastTime;
+    int32_t lastDelta;
+    int16_t prev[BMS_CODEC_MAX_CHANNELS];
+
+    void put(uint32_t value, uint8_t bits) {
+        while (bits > 0) {
+            uint8_t room = 8 - (bitPos & 7);
+            uint8_t n = bits < room ? bits : room;
+            uint8_t chunk = (uint8_t)((value >> (bits - n)) & ((1u << n) - 1));
+            buf[bitPos >> 3] |= (uint8_t)(chunk << (room - n));
+            bitPos += n;
+            bits -= n;
+        }
+    }
+
+    static uint8_t timeBits(int32_t dod) {
+        uint32_t zz = bmsZigzag(dod);
+        if (zz == 0) return 1;
+        if (zz < (1u << 7)) return 2 + 7;
+        if (zz < (1u << 12)) return 3 + 12;
+        if (zz < (1u << 20)) return 4 + 20;
+        return 4 + 32;
+    }
+
+    static uint8_t deltaBits(int16_t v, int16_t p) {
+        uint32_t zz = bmsZigzag((int16_t)(v - p));
+        if (zz == 0) return 1;
+        if (zz < (1u << 4)) return 2 + 4;
+        if (zz < (1u << 8)) return 3 + 8;
+        return 3 + 16;
+    }
+
+    static uint8_t xorBits(int16_t v, int16_t p) {
+        uint16_t x = (uint16_t)v ^ (uint16_t)p;
+        if (x == 0) return 1;
+        return 1 + 8 + (16 - bmsLeadingZeros16(x) - bmsTrailingZeros16(x));
+    }
+
+public:
+    BMSCodecWriter() : buf(nullptr), size(0), bitPos(0), channels(0), xorMask(0),
+                       count(0), lastTime(0), lastDelta(0) {}
+
+    // Bắt đầu block mới trên buffer của người gọi (buffer bị xoá về 0)
+    void begin(uint8_t* block, size_t blockSize, uint8_t channelCount, uint8_t xorChannels = 0) {
+        buf = block;
+        size = blockSize;
+        channels = channelCount;
+        xorMask = xorChannels;
+        count = 0;
+        lastTime = 0;
+        lastDelta = 0;
+        memset(buf, 0, size);
+        bitPos = (BMS_CODEC_HEADER_SIZE + 2u * channels) * 8;
+        buf[10] = channels;
+        buf[11] = xorMask;
+    }
+
+    // false = block không đủ chỗ cho mẫu này (block giữ nguyên)
+    bool append(uint32_t time_ms, const int16_t* values) {
+        if (count == 0) {
+            if (BMS_CODEC_HEADER_SIZE + 2u * channels > size) return false;
+            bmsPutU32(buf, time_ms);
+            for (uint8_t c = 0; c < channels; c++) {
+                bmsPutU16(buf + BMS_CODEC_HEADER_SIZE + 2 * c, (uint16_t)values[c]);
+                prev[c] = values[c];
+            }
+        } else {
+            int32_t delta = (int32_t)(time_ms - lastTime);
+            int32_t dod = delta - lastDelta;
+
+            // Tính trước số bit để không ghi dở một mẫu
+            size_t bits = timeBits(dod);
+            for (uint8_t c = 0; c < channels; c++) {
+                bits += (xorMask & (1u << c)) ? xorBits(values[c], prev[c])
+                                              : deltaBits(values[c], prev[c]);
+            }
+            if (bitPos + bits > size * 8) return false;
+
+            uint32_t zz = bmsZigzag(dod);
+            if (zz == 0)                 put(0x0, 1);
+            else if (zz < (1u << 7))   { put(0x2, 2); put(zz, 7); }
+            else if (zz < (1u << 12))  { put(0x6, 3); put(zz, 12); }
+            else if (zz < (1u << 20))  { put(0xE, 4); put(zz, 20); }
+            else                       { put(0xF, 4); put((uint32_t)delta, 32); }
+
+            for (uint8_t c = 0; c < channels; c++) {
+                if (xorMask & (1u << c)) {
+                    uint16_t x = (uint16_t)values[c] ^ (uint16_t)prev[c];
+                    if (x == 0) {
+                        put(0, 1);
+                    } else {
+                        uint8_t lz = bmsLeadingZeros16(x);
+                        uint8_t tz = bmsTrailingZeros16(x);
+                        put(1, 1);
+                        put(lz, 4);
+                        put(tz, 4);
+                        put(x >> tz, 16 - lz - tz);
+                    }
+                } else {
+                    uint32_t vz = bmsZigzag((int16_t)(values[c] - prev[c]));
+                    if (vz == 0)               put(0x0, 1);
+                    else if (vz < (1u << 4)) { put(0x2, 2); put(vz, 4); }
+                    else if (vz < (1u << 8)) { put(0x6, 3); put(vz, 8); }
+                    else                     { put(0x7, 3); put(vz, 16); }
+                }
+                prev[c] = values[c];
+            }
+            lastDelta = delta;
+        }
+
+        lastTime = time_ms;
+        count++;
+        bmsPutU32(buf + 4, lastTime);
+        bmsPutU16(buf + 8, count);
+        return true;
+    }
+
+    uint16_t getCount() const { return count; }
+    size_t bytesUsed() const { return (bitPos + 7) / 8; }
+};
+
+// ==================== DECODER ====================
+class BMSCodecReader {
+private:
+    const uint8_t* buf;
+    size_t size;
+    size_t bitPos;
+    BMSCodecBlockInfo info;
+    uint16_t index;
+    uint32_t lastTime;
+    int32_t lastDelta;
+    int16_t prev[BMS_CODEC_MAX_CHANNELS];
+
+    uint32_t get(uint8_t bits) {
+        uint32_t value = 0;
+        while (bits > 0) {
+            uint8_t room = 8 - (bitPos & 7);
+            uint8_t n = bits < room ? bits : room;
+            uint8_t byte = (bitPos >> 3) < size ? buf[bitPos >> 3] : 0;
+            value = (value << n) | ((byte >> (room - n)) & ((1u << n) - 1));
+            bitPos += n;
+            bits -= n;
+        }
+        return value;
+    }
+
+    // Đếm số bit '1' đứng đầu (tối đa maxOnes)
+    uint8_t prefix(uint8_t maxOnes) {
+        uint8_t n = 0;
+        while (n < maxOnes && get(1)) n++;
+        return n;
+    }
+
+public:
+    BMSCodecReader() : buf(nullptr), size(0), bitPos(0), index(0), lastTime(0), lastDelta(0) {
+        memset(&info, 0, sizeof(info));
+    }
+
+    bool begin(const uint8_t* block, size_t blockSize) {
+        buf = block;
+        size = blockSize;
+        index = 0;
+        lastTime = 0;
+        lastDelta = 0;
+        bitPos = 0;
+        if (!bmsCodecReadInfo(block, blockSize, info)) {
+            info.count = 0;
+            return false;
+        }
+        bitPos = (BMS_CODEC_HEADER_SIZE + 2u * info.channels) * 8;
+        return true;
+    }
+
+    const BMSCodecBlockInfo& getInfo() const { return info; }
+
+    // Mẫu kế tiếp; false khi hết block
+    bool next(uint32_t& time_ms, int16_t* values) {
+        if (index >= info.count) return false;
+
+        if (index == 0) {
+            lastTime = info.firstTime;
+            for (uint8_t c = 0; c < info.channels; c++) {
+                prev[c] = (int16_t)bmsGetU16(buf + BMS_CODEC_HEADER_SIZE + 2 * c);
+            }
+        } else {
+            int32_t delta;
+            switch (prefix(4)) {
+                case 0:  delta = lastDelta; break;
+                case 1:  delta = lastDelta + bmsUnzigzag(get(7)); break;
+                case 2:  delta = lastDelta + bmsUnzigzag(get(12)); break;
+                case 3:  delta = lastDelta + bmsUnzigzag(get(20)); break;
+                default: delta = (int32_t)get(32); break;
+            }
+            lastTime += (uint32_t)delta;
+            lastDelta = delta;
+
+            for (uint8_t c = 0; c < info.channels; c++) {
+                if (info.xorMask & (1u << c)) {
+                    if (get(1)) {
+                        uint8_t lz = (uint8_t)get(4);
+                        uint8_t tz = (uint8_t)get(4);
+                        uint16_t x = (uint16_t)(get(16 - lz - tz) << tz);
+                        prev[c] = (int16_t)((uint16_t)prev[c] ^ x);
+                    }
+                } else {
+                    switch (prefix(3)) {
+                        case 0:  break;
+                        case 1:  prev[c] += (int16_t)bmsUnzigzag(get(4)); break;
+                        case 2:  prev[c] += (int16_t)bmsUnzigzag(get(8)); break;
+                        default: prev[c] += (int16_t)bmsUnzigzag(get(16)); break;
+                    }
+                }
+            }
+        }
+
+        time_ms = lastTime;
+        for (uint8_t c = 0; c < info.channels; c++) values[c] = prev[c];
+        index++;
+        return true;
+    }
+};
+
+#endif // BMS_CODEC_H
@@ -8,8 +8,19 @@
 #include "bms_protection.h"
 #include "bms_balancing.h"
 #include "bms_dwin.h"
+#include "bms_frame.h"
+#include "bms_history.h"
+#include "bms_logger.h"
+#include "bms_blackbox.h"
+#include "bms_reports.h"
+#include "bms_energy.h"
+#include "bms_usage.h"
+#include "bms_resistance.h"
+#include "bms_power.h"
 
 const int NUM_CELLS = 4;
+static_assert(NUM_CELLS == SOC_CELLS, "SOCCells sized for a different cell count");
+static_assert(NUM_CELLS == IR_CELLS, "BMSResistance sized for a different cell count");
 
 // ==================== NGƯỠNG BẢO VỆ (DISPLAY) ====================
 #define CELL_UV_WARNING 3.0
@@ -61,6 +72,7 @@ struct BMSData {
 
     // Balancing
     bool balancingActive;
+    bool balancingByCharge;     // mục tiêu theo SOC từng cell thay vì điện áp
     bool balancingCells[NUM_CELLS];
     uint8_t balancingCell;
 
@@ -80,15 +92,72 @@ struct BMSData {
     float remainingCycles;
 };
 
+// ==================== FIELD VERSIONS ====================
+// Thứ tự = thứ tự xuất hiện trong JSON của /bms
+enum BMSField : uint8_t {
+    FIELD_CELLS,
+    FIELD_PACK_VOLTAGE,
+    FIELD_AVG_CELL,
+    FIELD_CURRENT,
+    FIELD_TEMP,
+    FIELD_SOC,
+    FIELD_SOH,
+    FIELD_REMAINING_CAPACITY,
+    FIELD_TOTAL_CYCLES,
+    FIELD_CHARGING,
+    FIELD_BALANCING,
+    FIELD_PROTECTION,
+    FIELD_ALERTS,
+    FIELD_ENERGY,
+    FIELD_CELL_SOC,
+    FIELD_CAPACITY,
+    FIELD_RESISTANCE,
+    FIELD_POWER,
+    FIELD_COUNT
+};
+
+#define FIELD_BIT(f) (1UL << (f))
+
+const uint32_t FIELD_MASK_ALL        = FIELD_BIT(FIELD_COUNT) - 1;
+const uint32_t FIELD_MASK_CELLS      = FIELD_BIT(FIELD_CELLS);
+const uint32_t FIELD_MASK_STATE      = FIELD_BIT(FIELD_SOC) | FIELD_BIT(FIELD_SOH) |
+                                       FIELD_BIT(FIELD_REMAINING_CAPACITY) |
+                                       FIELD_BIT(FIELD_TOTAL_CYCLES) | FIELD_BIT(FIELD_CHARGING) |
+                                       FIELD_BIT(FIELD_CELL_SOC) | FIELD_BIT(FIELD_CAPACITY) |
+                                       FIELD_BIT(FIELD_RESISTANCE) | FIELD_BIT(FIELD_POWER);
+const uint32_t FIELD_MASK_PROTECTION = FIELD_BIT(FIELD_PROTECTION) | FIELD_BIT(FIELD_ALERTS);
+
+// Gửi lại toàn bộ (keyframe) mỗi khi seq vượt qua bội số này
+const uint32_t KEYFRAME_INTERVAL = 600;
+
+// Bộ nhớ JsonDocument của /bms, cấp phát trên heap mỗi lần gọi. Đủ trường ~2.4 KB;
+// alerts tối đa 5 mục (OV/UV mỗi loại chỉ alarm hoặc warning, 2 ngắt dòng, cân bằng)
+// → ~2.6 KB. ?fields= và since chỉ bớt trường nên không vượt mức này
+const size_t BMS_JSON_CAPACITY = 4096;
+
 // ==================== GLOBAL DATA ====================
 extern BMSData bmsData;
+extern uint32_t bmsSeq;
+extern uint32_t bmsEpoch;           // ngẫu nhiên mỗi lần boot
+extern uint32_t bmsFieldVersion[FIELD_COUNT];
 
 // ==================== EXTERNAL OBJECTS ====================
 extern BMSSensors sensors;
 extern BMSProtection protection;
 extern BMSBalancing balancing;
 extern BMSDwin dwin;
+extern BMSHistory history;
+extern BMSLogger logger;
+extern BMSBlackBox blackbox;
+extern BMSReports reports;
+extern BMSEnergy energy;
+extern BMSUsage usage;
+extern BMSResistance resistance;
+extern BMSPower power;
+extern BMSJournal journal;
 extern SOCEstimator soc;
+extern SOCCells cellSoc;
+extern CapacityEstimator capacityEst;
 extern SOHEstimator soh;
 extern bool socInitialized;
 extern bool sohInitialized;
@@ -104,7 +173,16 @@ void updateSOC();
 void updateSOH();
 void updateDWINDisplay();
 
-String getBMSJson();
+void commitBMSChanges();
+
+// 0 = danh sách rỗng hoặc có tên lạ (tên đầu tiên không khớp ghi vào *unknown)
+uint32_t parseFieldMask(const char* list, String* unknown = nullptr);
+// Chuỗi rỗng khi không cấp phát được hoặc tràn BMS_JSON_CAPACITY (đã log kèm mask)
+String getBMSJson(uint32_t mask = FIELD_MASK_ALL);
+String getBMSJsonSince(uint32_t since, uint32_t epoch, uint32_t mask = FIELD_MASK_ALL);
+size_t getBMSFrame(uint8_t* buf);
+uint16_t getAlarmBits();
+uint8_t getStatusFlags();
 void initBMSData();
 
 #endif
@@ -24,6 +24,17 @@ private:
     const uint16_t VP_WARN_DSG_OC   = 0x1550;
     const uint16_t VP_WARN_DSG_TEMP = 0x1560;
     
+    // Năng lượng trọn đời
+    const uint16_t VP_ENERGY_IN     = 0x1600;   // kWh x100
+    const uint16_t VP_ENERGY_OUT    = 0x1610;   // kWh x100
+    const uint16_t VP_EFFICIENCY    = 0x1620;   // % x10
+    
+    // Công suất cho phép (10 s) và thời gian còn lại
+    const uint16_t VP_SOP_CHARGE    = 0x1700;   // W x10
+    const uint16_t VP_SOP_DISCHARGE = 0x1710;   // W x10
+    const uint16_t VP_TIME_EMPTY    = 0x1720;   // phút, -1 = không xả
+    const uint16_t VP_TIME_FULL     = 0x1730;   // phút, -1 = không sạc
+    
     // Icon IDs
     const uint16_t ICON_CHARGING    = 0;
     const uint16_t ICON_DISCHARGING = 1;
@@ -38,6 +49,9 @@ private:
     const uint16_t WARN_ID_DSG_TEMP = 10;
     const uint16_t WARN_ID_NORMAL   = 11;
     
+    // Thống kê
+    uint32_t frameCount;
+    
     // Hàm nội bộ
     void writeWord(uint16_t vp, int16_t value);
     void writeFloat(uint16_t vp, float value, uint8_t decimal_places);
@@ -51,6 +65,8 @@ public:
     void sendCurrent(float current);
     void sendCurrentIcon(float current);
     void sendTemperature(float temp);
+    void sendEnergy(float inKWh, float outKWh, float efficiency);
+    void sendPower(float chargeW, float dischargeW, float emptyMinutes, float fullMinutes);
     void updateBasicData(float cell1, float cell2, float cell3, float cell4,
                         float pack, float current, float temp);
     
@@ -68,6 +84,9 @@ public:
                           bool dsg_oc_warn, bool dsg_oc_alarm,
                           bool dsg_temp_warn, bool dsg_temp_alarm);
     
+    // Thống kê
+    uint32_t getFrameCount() const;
+    
     // Control
     void resetDisplay();
     void printDebug();
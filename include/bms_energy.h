@@ -0,0 +1,74 @@
+#ifndef BMS_ENERGY_H
+#define BMS_ENERGY_H
+
+#include <Arduino.h>
+#include "bms_journal.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS ENERGY MODULE
+ *  Đo năng lượng sạc/xả ở mỗi chu kỳ đo (100 ms):
+ *    - Tích phân hình thang V×I và I giữa 2 mẫu liên tiếp;
+ *      dòng đổi dấu giữa 2 mẫu → tách tại điểm 0
+ *    - Bộ tích luỹ 64-bit số nguyên (mW·ms, mA·ms) → không
+ *      mất độ chính xác khi tổng lớn như float
+ *    - Hiệu suất trọn đời = Wh xả / Wh sạc; hiệu suất chu kỳ
+ *      tính giữa 2 lần đầy liên tiếp (cùng mốc SOC)
+ *  Tổng trọn đời lưu trong journal (lệch 0.5 Wh hoặc 60 s).
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const uint32_t ENERGY_MAX_GAP_MS = 2000;   // mất mẫu lâu hơn → không nội suy qua khoảng trống
+const float ENERGY_FULL_SOC = 99.0f;       // mốc "đầy" cho hiệu suất chu kỳ
+const float ENERGY_REARM_SOC = 90.0f;      // phải xuống dưới mức này mới tính lần đầy kế tiếp
+const float ENERGY_MIN_CYCLE_WH = 10.0f;   // chu kỳ nông hơn → không tính hiệu suất
+
+class BMSEnergy {
+private:
+    // ========================= TÍCH LUỸ =========================
+    // Năng lượng: mW·ms (= µJ), điện lượng: mA·ms (= µC)
+    uint64_t chargeEnergy;
+    uint64_t dischargeEnergy;
+    uint64_t chargeCharge;
+    uint64_t dischargeCharge;
+
+    int32_t lastPower_mW;
+    int32_t lastCurrent_mA;
+    unsigned long lastSample;
+    bool primed;
+
+    // ========================= HIỆU SUẤT CHU KỲ =========================
+    uint64_t markChargeEnergy;      // tổng tại lần đầy trước
+    uint64_t markDischargeEnergy;
+    bool marked;
+    bool fullArmed;
+    float cycleEfficiency;          // NAN = chưa có
+
+    BMSJournal* journal;
+
+    // ========================= HÀM NỘI BỘ =========================
+    static void integrate(int32_t a, int32_t b, uint32_t dt, uint64_t& pos, uint64_t& neg);
+    void checkFull(float soc);
+    void saveState();
+
+public:
+    BMSEnergy();
+    // Gọi sau journal.begin() để nạp tổng trọn đời
+    void begin(BMSJournal& store);
+
+    // Gọi ở mỗi chu kỳ đo
+    void update(float packVoltage, float current_A, float soc);
+
+    double getChargedWh() const;
+    double getDischargedWh() const;
+    double getChargedAh() const;
+    double getDischargedAh() const;
+    // %; NAN khi chưa có dữ liệu
+    float getEfficiency() const;
+    float getCycleEfficiency() const;
+
+    // Debug
+    void printStatus();
+};
+
+#endif // BMS_ENERGY_H
@@ -0,0 +1,182 @@
+#ifndef BMS_FRAME_H
+#define BMS_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS BINARY FRAME - /bms.bin
+ *  Khung nhị phân cố định, little-endian, có version.
+ *  Header-only, không phụ thuộc Arduino: dùng chung cho
+ *  firmware (encode) và chương trình host (decode).
+ * ═══════════════════════════════════════════════════════════
+ *
+ *  Offset  Size  Field
+ *  0       2     magic 'B''M'
+ *  2       1     version (BMS_FRAME_VERSION)
+ *  3       1     cellCount
+ *  4       4     timestamp (ms, millis() lúc cập nhật)
+ *  8       2*4   cell voltages (mV)
+ *  16      2     pack voltage (mV)
+ *  18      2     current (mA, int16, + = sạc)
+ *  20      2     pack temperature (0.1 °C, int16)
+ *  22      2     SOC (0.1 %)
+ *  24      2     SOH (0.1 %)
+ *  26      2     remaining capacity (mAh)
+ *  28      2     total cycles (0.1 cycle)
+ *  30      2     remaining cycles
+ *  32      2     alarm bits   (BMS_BIT_*)
+ *  34      2     warning bits (BMS_BIT_*)
+ *  36      1     status flags (BMS_FLAG_*)
+ *  37      1     balancing cell mask (bit i = cell i+1)
+ *  38      1     balancing cell (1..4, 0 = none)
+ *  39      1     reserved
+ */
+
+#define BMS_FRAME_MAGIC0   'B'
+#define BMS_FRAME_MAGIC1   'M'
+#define BMS_FRAME_VERSION  1
+#define BMS_FRAME_CELLS    4
+#define BMS_FRAME_SIZE     40
+
+// Bit alarm / warning
+#define BMS_BIT_OV    (1u << 0)
+#define BMS_BIT_UV    (1u << 1)
+#define BMS_BIT_OCC   (1u << 2)
+#define BMS_BIT_OCD   (1u << 3)
+#define BMS_BIT_OTC   (1u << 4)
+#define BMS_BIT_OTD   (1u << 5)
+#define BMS_BIT_UTC   (1u << 6)
+#define BMS_BIT_UTD   (1u << 7)
+
+// Cờ trạng thái
+#define BMS_FLAG_CHARGING     (1u << 0)
+#define BMS_FLAG_DISCHARGING  (1u << 1)
+#define BMS_FLAG_BALANCING    (1u << 2)
+#define BMS_FLAG_CHG_MOSFET   (1u << 3)
+#define BMS_FLAG_DSG_MOSFET   (1u << 4)
+#define BMS_FLAG_ACTIVE       (1u << 5)
+
+// Giá trị đã lượng tử hoá (đơn vị nguyên như bảng trên)
+struct BMSFrame {
+    uint32_t timestamp;
+    uint16_t cell_mV[BMS_FRAME_CELLS];
+    uint16_t pack_mV;
+    int16_t  current_mA;
+    int16_t  temp_dC;
+    uint16_t soc_pm;
+    uint16_t soh_pm;
+    uint16_t remaining_mAh;
+    uint16_t cycles_d;
+    uint16_t remainingCycles;
+    uint16_t alarms;
+    uint16_t warnings;
+    uint8_t  flags;
+    uint8_t  balancingMask;
+    uint8_t  balancingCell;
+};
+
+// ==================== LƯỢNG TỬ HOÁ ====================
+inline uint16_t bmsFrameU16(float value, float scale) {
+    float v = value * scale + 0.5f;
+    if (v < 0.0f) return 0;
+    if (v > 65535.0f) return 65535;
+    return (uint16_t)v;
+}
+
+inline int16_t bmsFrameI16(float value, float scale) {
+    float v = value * scale;
+    v += (v >= 0.0f) ? 0.5f : -0.5f;
+    if (v < -32768.0f) return -32768;
+    if (v > 32767.0f) return 32767;
+    return (int16_t)v;
+}
+
+// ==================== LITTLE-ENDIAN ====================
+inline void bmsPutU16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+inline void bmsPutU32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+inline uint16_t bmsGetU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t bmsGetU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ==================== ENCODE ====================
+// Ghi frame vào buf (>= BMS_FRAME_SIZE byte), trả về số byte đã ghi
+inline size_t bmsFrameEncode(const BMSFrame& f, uint8_t* buf) {
+    buf[0] = BMS_FRAME_MAGIC0;
+    buf[1] = BMS_FRAME_MAGIC1;
+    buf[2] = BMS_FRAME_VERSION;
+    buf[3] = BMS_FRAME_CELLS;
+    bmsPutU32(buf + 4, f.timestamp);
+    for (int i = 0; i < BMS_FRAME_CELLS; i++) {
+        bmsPutU16(buf + 8 + i * 2, f.cell_mV[i]);
+    }
+    bmsPutU16(buf + 16, f.pack_mV);
+    bmsPutU16(buf + 18, (uint16_t)f.current_mA);
+    bmsPutU16(buf + 20, (uint16_t)f.temp_dC);
+    bmsPutU16(buf + 22, f.soc_pm);
+    bmsPutU16(buf + 24, f.soh_pm);
+    bmsPutU16(buf + 26, f.remaining_mAh);
+    bmsPutU16(buf + 28, f.cycles_d);
+    bmsPutU16(buf + 30, f.remainingCycles);
+    bmsPutU16(buf + 32, f.alarms);
+    bmsPutU16(buf + 34, f.warnings);
+    buf[36] = f.flags;
+    buf[37] = f.balancingMask;
+    buf[38] = f.balancingCell;
+    buf[39] = 0;
+    return BMS_FRAME_SIZE;
+}
+
+// ==================== DECODE ====================
+// Trả về false nếu sai magic, sai version hoặc thiếu byte
+inline bool bmsFrameDecode(const uint8_t* buf, size_t len, BMSFrame& f) {
+    if (len < BMS_FRAME_SIZE) return false;
+    if (buf[0] != BMS_FRAME_MAGIC0 || buf[1] != BMS_FRAME_MAGIC1) return false;
+    if (buf[2] != BMS_FRAME_VERSION || buf[3] != BMS_FRAME_CELLS) return false;
+
+    f.timestamp = bmsGetU32(buf + 4);
+    for (int i = 0; i < BMS_FRAME_CELLS; i++) {
+        f.cell_mV[i] = bmsGetU16(buf + 8 + i * 2);
+    }
+    f.pack_mV = bmsGetU16(buf + 16);
+    f.current_mA = (int16_t)bmsGetU16(buf + 18);
+    f.temp_dC = (int16_t)bmsGetU16(buf + 20);
+    f.soc_pm = bmsGetU16(buf + 22);
+    f.soh_pm = bmsGetU16(buf + 24);
+    f.remaining_mAh = bmsGetU16(buf + 26);
+    f.cycles_d = bmsGetU16(buf + 28);
+    f.remainingCycles = bmsGetU16(buf + 30);
+    f.alarms = bmsGetU16(buf + 32);
+    f.warnings = bmsGetU16(buf + 34);
+    f.flags = buf[36];
+    f.balancingMask = buf[37];
+    f.balancingCell = buf[38];
+    return true;
+}
+
+// ==================== GIÁ TRỊ THỰC ====================
+inline float bmsFrameCellVoltage(const BMSFrame& f, int i) { return f.cell_mV[i] / 1000.0f; }
+inline float bmsFramePackVoltage(const BMSFrame& f) { return f.pack_mV / 1000.0f; }
+inline float bmsFrameCurrent(const BMSFrame& f)     { return f.current_mA / 1000.0f; }
+inline float bmsFrameTemperature(const BMSFrame& f) { return f.temp_dC / 10.0f; }
+inline float bmsFrameSOC(const BMSFrame& f)         { return f.soc_pm / 10.0f; }
+inline float bmsFrameSOH(const BMSFrame& f)         { return f.soh_pm / 10.0f; }
+inline float bmsFrameCycles(const BMSFrame& f)      { return f.cycles_d / 10.0f; }
+
+#endif // BMS_FRAME_H
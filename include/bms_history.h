@@ -0,0 +1,118 @@
+#ifndef BMS_HISTORY_H
+#define BMS_HISTORY_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <esp_heap_caps.h>
+#include "bms_codec.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS HISTORY MODULE
+ *  Lưu lịch sử trong RAM ở 3 độ phân giải:
+ *    Tier 0:  1 s  x 600   (10 phút)   25.2 KB
+ *    Tier 1: 10 s  x 720   (2 giờ)     30.2 KB
+ *    Tier 2:  1 min x 1440 (24 giờ)    60.5 KB
+ *  Mỗi bucket giữ min/max/avg int16 cho từng kênh, bố trí
+ *  structure-of-arrays. Tier cao được gộp dần từ tier thấp.
+ *  Archive: giá trị avg 1 s của mọi kênh, nén bằng bms_codec
+ *  trong vòng 32 block x 512 B (~4 B/mẫu → vài giờ ở 1 Hz).
+ *  Bộ nhớ cấp phát heap trong begin() (không chiếm .bss), luôn
+ *  chừa HISTORY_HEAP_RESERVE cho WiFi/lwIP/WebServer; thiếu heap
+ *  → bỏ bớt tier/archive (theo thứ tự ưu tiên), phần còn lại
+ *  vẫn chạy.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+// Kênh: cell 1..4 (mV), dòng (mA), nhiệt độ (0.1 °C), SOC (0.1 %)
+enum HistoryChannel : uint8_t {
+    HIST_CELL1,
+    HIST_CELL2,
+    HIST_CELL3,
+    HIST_CELL4,
+    HIST_CURRENT,
+    HIST_TEMP,
+    HIST_SOC,
+    HIST_CHANNELS
+};
+
+enum HistoryStat : uint8_t {
+    HIST_MIN,
+    HIST_MAX,
+    HIST_AVG,
+    HIST_STATS
+};
+
+const uint8_t HISTORY_TIERS = 3;
+const uint16_t HISTORY_ARCHIVE_BLOCKS = 32;
+const uint16_t HISTORY_ARCHIVE_BLOCK_SIZE = 512;
+const size_t HISTORY_HEAP_RESERVE = 64 * 1024;   // heap tối thiểu để lại sau khi cấp phát
+
+class BMSHistory {
+private:
+    // ========================= BỘ TÍCH LUỸ =========================
+    struct Accumulator {
+        int32_t sum[HIST_CHANNELS];
+        int16_t min[HIST_CHANNELS];
+        int16_t max[HIST_CHANNELS];
+        uint16_t count;
+    };
+
+    // ========================= MỘT TIER =========================
+    struct Tier {
+        int16_t* data;            // [stat][channel][capacity], nullptr = tắt
+        uint16_t capacity;
+        uint16_t head;            // vị trí ghi tiếp theo
+        uint16_t count;
+        uint32_t resolution_ms;
+        uint8_t  factor;          // số bucket tier dưới gộp thành 1 bucket
+        unsigned long lastEnd;    // millis() kết thúc bucket mới nhất
+        Accumulator acc;
+    };
+
+    Tier tiers[HISTORY_TIERS];
+    unsigned long bucketStart;
+
+    // ========================= ARCHIVE NÉN =========================
+    uint8_t* archiveData;         // nullptr = tắt
+    BMSCodecWriter archiveWriter;
+    uint16_t archiveHead;         // block đang ghi
+    uint16_t archiveCount;        // số block có dữ liệu (gồm block đang ghi)
+
+    size_t allocated;             // byte heap đã cấp phát
+
+    // ========================= HÀM NỘI BỘ =========================
+    void* allocate(size_t bytes, const char* name);
+    uint8_t* archiveBlock(uint16_t index) const;
+    static void resetAccumulator(Accumulator& acc);
+    static void accumulate(Accumulator& acc, const int16_t mn[], const int16_t mx[],
+                           const int16_t avg[]);
+    void closeBucket(uint8_t tier, unsigned long endTime);
+    int16_t* slot(uint8_t tier, HistoryStat stat, uint8_t channel);
+    void archiveSample(unsigned long time, const int16_t values[]);
+
+public:
+    BMSHistory();
+    void begin();
+
+    // Gọi ở mỗi chu kỳ đo (100 ms)
+    void addSample(const float cells[4], float current, float temp, float soc);
+
+    // Truy vấn
+    uint16_t getCount(uint8_t tier) const;
+    uint32_t getResolution(uint8_t tier) const;
+    int16_t getValue(uint8_t tier, HistoryStat stat, uint8_t channel, uint16_t ageIndex) const;
+    // -1 = không có tier độ phân giải này hoặc tier bị tắt do thiếu heap
+    int8_t findTier(uint32_t resolution_ms) const;
+
+    // Xuất JSON theo chunk (không dựng một String lớn)
+    void streamJson(WebServer& server, uint8_t tier, uint16_t points);
+    // Archive 1 s nén: range = số giây gần nhất (0 = tất cả)
+    void streamArchive(WebServer& server, uint32_t range_s);
+    uint16_t getArchiveBlocks() const;                   // 0 = archive tắt
+
+    // Debug
+    void printStatus();
+};
+
+#endif // BMS_HISTORY_H
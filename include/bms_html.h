@@ -181,6 +181,14 @@ String getHTMLPage() {
                     <div class="loading">Đang tải dữ liệu...</div>
                 </div>
             </div>
+
+            <!-- LIVE CHART -->
+            <div class="section">
+                <h2>Biểu Đồ Điện Áp &amp; Dòng</h2>
+                <div class="chart-container">
+                    <canvas id="liveChart"></canvas>
+                </div>
+            </div>
         </div>
     </div>
 
@@ -13,7 +13,129 @@ String getHTMLScripts() {
     return F(R"rawliteral(
 const CONFIG = {
     API_ENDPOINT: '/bms',
-    UPDATE_INTERVAL: 1000
+    BINARY_ENDPOINT: '/bms.bin',
+    TRANSPORT: 'delta',         // 'delta' | 'json' | 'bin'
+    UPDATE_INTERVAL: 1000       // ms, có thể giảm tới 100 (10 Hz)
+};
+
+// Khung nhị phân /bms.bin (xem include/bms_frame.h)
+const FRAME = { SIZE: 40, VERSION: 1 };
+const FRAME_BITS = [
+    'overVoltage', 'underVoltage', 'overCurrentCharge', 'overCurrentDischarge',
+    'overTempCharge', 'overTempDischarge', 'underTempCharge', 'underTempDischarge'
+];
+const FRAME_ALERTS = {
+    overVoltage: 'Ngắt sạc: Điện áp quá cao!',
+    underVoltage: 'Ngắt xả: Điện áp quá thấp!',
+    overCurrentCharge: 'Ngắt sạc: Quá dòng sạc!',
+    overCurrentDischarge: 'Ngắt xả: Quá dòng xả!'
+};
+
+// Giải mã frame thành cùng cấu trúc với JSON của /bms
+function decodeBMSFrame(buffer) {
+    const dv = new DataView(buffer);
+    if (dv.byteLength < FRAME.SIZE ||
+        dv.getUint8(0) !== 0x42 || dv.getUint8(1) !== 0x4D ||
+        dv.getUint8(2) !== FRAME.VERSION) {
+        throw new Error('Invalid BMS frame');
+    }
+    
+    const cellCount = dv.getUint8(3);
+    const cellVoltages = [];
+    for (let i = 0; i < cellCount; i++) {
+        cellVoltages.push({ cell: i + 1, voltage: dv.getUint16(8 + i * 2, true) / 1000 });
+    }
+    
+    const alarms = dv.getUint16(32, true);
+    const warnings = dv.getUint16(34, true);
+    const flags = dv.getUint8(36);
+    const mask = dv.getUint8(37);
+    
+    const protection = {};
+    const alerts = [];
+    FRAME_BITS.forEach((name, i) => {
+        if (alarms & (1 << i)) {
+            protection[name] = 'alarm';
+            if (FRAME_ALERTS[name]) alerts.push({ severity: 'critical', message: FRAME_ALERTS[name] });
+        } else {
+            protection[name] = (warnings & (1 << i)) ? 'warning' : 'normal';
+        }
+    });
+    
+    const balancingCells = [];
+    for (let i = 0; i < cellCount; i++) {
+        if (mask & (1 << i)) balancingCells.push(i + 1);
+    }
+    
+    return {
+        measurement: {
+            cellVoltages: cellVoltages,
+            packVoltage: dv.getUint16(16, true) / 1000,
+            current: dv.getInt16(18, true) / 1000,
+            packTemperature: dv.getInt16(20, true) / 10
+        },
+        calculation: {
+            soc: dv.getUint16(22, true) / 10,
+            soh: dv.getUint16(24, true) / 10,
+            remainingCapacity: dv.getUint16(26, true) / 1000,
+            totalCycles: dv.getUint16(28, true) / 10
+        },
+        status: {
+            charging: (flags & 1) ? 'charging' : ((flags & 2) ? 'discharging' : 'idle'),
+            balancing: { active: (flags & 4) !== 0, cells: balancingCells }
+        },
+        protection: protection,
+        alerts: alerts
+    };
+}
+
+// Trạng thái cục bộ cho chế độ delta (/bms?since=<seq>&epoch=<epoch>)
+const deltaState = { seq: 0, epoch: 0, data: {} };
+
+function mergeDelta(target, delta) {
+    for (const [key, value] of Object.entries(delta)) {
+        if (value && typeof value === 'object' && !Array.isArray(value) &&
+            target[key] && typeof target[key] === 'object') {
+            mergeDelta(target[key], value);
+        } else {
+            target[key] = value;
+        }
+    }
+    return target;
+}
+
+async function loadBMSData() {
+    if (CONFIG.TRANSPORT === 'delta') {
+        const response = await fetch(`${CONFIG.API_ENDPOINT}?since=${deltaState.seq}&epoch=${deltaState.epoch}`);
+        if (!response.ok) throw new Error(`HTTP ${response.status}`);
+        const delta = await response.json();
+        const { seq, epoch, keyframe, ...fields } = delta;
+        deltaState.data = keyframe ? fields : mergeDelta(deltaState.data, fields);
+        deltaState.seq = seq;
+        deltaState.epoch = epoch;
+        return deltaState.data;
+    }
+    
+    if (CONFIG.TRANSPORT === 'bin') {
+        const response = await fetch(CONFIG.BINARY_ENDPOINT);
+        if (!response.ok) throw new Error(`HTTP ${response.status}`);
+        return decodeBMSFrame(await response.arrayBuffer());
+    }
+    
+    const response = await fetch(CONFIG.API_ENDPOINT);
+    if (!response.ok) throw new Error(`HTTP ${response.status}`);
+    return response.json();
+}
+
+// ==================== RENDER STATE ====================
+// Node DOM được tạo một lần; mỗi lần có dữ liệu mới chỉ ghi lại
+// phần text/class thay đổi, gộp trong một requestAnimationFrame.
+const view = {
+    pending: null,
+    frameRequested: false,
+    cells: [],
+    alertsKey: '',
+    online: true
 };
 
 function getSOCColor(percent) {
@@ -22,261 +144,317 @@ function getSOCColor(percent) {
     return '#4caf50';                      // Xanh lá
 }
 
-function createSimpleBatteryCell(cellNum, voltage, isBalancing = false) {
-    const balancingClass = isBalancing ? 'balancing' : '';
-    return `
-        <div class="battery-cell ${balancingClass}">
-            <div class="cell-label">Cell ${cellNum}</div>
-            <div class="voltage-value">${voltage.toFixed(3)}<span class="voltage-unit">V</span></div>
-        </div>
-    `;
+function setText(node, value) {
+    if (node && node.textContent !== value) node.textContent = value;
+}
+
+function setTextById(id, value) {
+    setText(document.getElementById(id), value);
+}
+
+// Chỉ đổi class khi trạng thái thực sự thay đổi
+function setState(element, state, states) {
+    if (!element || element.dataset.state === state) return false;
+    element.classList.remove(...states);
+    if (state) element.classList.add(state);
+    element.dataset.state = state;
+    return true;
 }
 
-function updateElement(id, value, suffix = '') {
-    const element = document.getElementById(id);
-    if (!element) return;
+// ==================== CELLS ====================
+function buildCells(count) {
+    const display = document.getElementById('batteryDisplay');
+    display.textContent = '';
+    view.cells = [];
     
-    const newValue = value + suffix;
-    if (element.textContent !== newValue) {
-        element.style.opacity = '0.5';
-        setTimeout(() => {
-            element.textContent = newValue;
-            element.style.opacity = '1';
-        }, 150);
+    for (let i = 0; i < count; i++) {
+        const root = document.createElement('div');
+        root.className = 'battery-cell';
+        
+        const label = document.createElement('div');
+        label.className = 'cell-label';
+        label.textContent = `Cell ${i + 1}`;
+        
+        const value = document.createElement('div');
+        value.className = 'voltage-value';
+        const number = document.createTextNode('--');
+        const unit = document.createElement('span');
+        unit.className = 'voltage-unit';
+        unit.textContent = 'V';
+        value.append(number, unit);
+        
+        root.append(label, value);
+        display.appendChild(root);
+        view.cells.push({ root: root, number: number, balancing: false });
     }
 }
 
-function updateSOCCircular(soc) {
+function renderCells(cellVoltages, balancingCells) {
+    if (view.cells.length !== cellVoltages.length) buildCells(cellVoltages.length);
+    
+    cellVoltages.forEach((cell, i) => {
+        const node = view.cells[i];
+        const text = parseFloat(cell.voltage).toFixed(3);
+        if (node.number.nodeValue !== text) node.number.nodeValue = text;
+        
+        const balancing = balancingCells.includes(cell.cell);
+        if (node.balancing !== balancing) {
+            node.root.classList.toggle('balancing', balancing);
+            node.balancing = balancing;
+        }
+    });
+}
+
+// ==================== STATS ====================
+function renderSOC(soc) {
     const socPercent = parseFloat(soc);
+    const text = socPercent.toFixed(0) + '%';
     const percentageEl = document.getElementById('socPercentage');
-    const circleEl = document.getElementById('socCircle');
-    
-    if (!percentageEl || !circleEl) return;
-    
-    const color = getSOCColor(socPercent);
-    const degrees = socPercent * 3.6;
-    
-    percentageEl.style.opacity = '0.5';
-    setTimeout(() => {
-        percentageEl.textContent = socPercent.toFixed(0) + '%';
-        percentageEl.style.opacity = '1';
-    }, 150);
+    if (!percentageEl || percentageEl.textContent === text) return;
     
-    circleEl.style.background = `conic-gradient(${color} ${degrees}deg, #e0e0e0 0deg)`;
+    percentageEl.textContent = text;
+    document.getElementById('socCircle').style.background =
+        `conic-gradient(${getSOCColor(socPercent)} ${socPercent * 3.6}deg, #e0e0e0 0deg)`;
 }
 
-function updateChargingStatus(status) {
+function renderChargingStatus(status) {
     const badge = document.getElementById('chargingStatus');
+    if (!setState(badge, status, ['charging', 'discharging', 'idle'])) return;
+    
     const icon = badge.querySelector('.status-icon');
     const text = badge.querySelector('.status-text');
-    
-    badge.classList.remove('charging', 'discharging', 'idle');
-    
     if (status === 'charging') {
-        badge.classList.add('charging');
         icon.textContent = '🔌';
         text.textContent = 'Charging';
     } else if (status === 'discharging') {
-        badge.classList.add('discharging');
+        icon.textContent = '';
         text.textContent = 'Discharging';
     } else {
-        badge.classList.add('idle');
+        icon.textContent = '';
         text.textContent = 'Idle';
     }
 }
 
-function updateProtectionStatus(protectionData) {
-    const protections = {
-        'protectOV': { 
-            data: protectionData.overVoltage, 
-            label: 'Over Voltage (Sạc)' 
-        },
-        'protectUV': { 
-            data: protectionData.underVoltage, 
-            label: 'Under Voltage (Xả)' 
-        },
-        'protectOCCharge': { 
-            data: protectionData.overCurrentCharge, 
-            label: 'Over Current (Sạc)' 
-        },
-        'protectOCDischarge': { 
-            data: protectionData.overCurrentDischarge, 
-            label: 'Over Current (Xả)' 
-        }
-    };
+// ==================== PROTECTION ====================
+const PROTECTION_ITEMS = {
+    protectOV: ['overVoltage'],
+    protectUV: ['underVoltage'],
+    protectOCCharge: ['overCurrentCharge'],
+    protectOCDischarge: ['overCurrentDischarge'],
+    protectOT: ['overTempCharge', 'overTempDischarge'],
+    protectUT: ['underTempCharge', 'underTempDischarge']
+};
 
-    // Xử lý Over Temperature (kết hợp cả Sạc và Xả)
-    const otElement = document.getElementById('protectOT');
-    if (otElement) {
-        const otStatusEl = otElement.querySelector('.protection-status');
-        otElement.classList.remove('alert', 'alarm');
-        
-        // Kiểm tra cả overTempCharge và overTempDischarge
-        const otChargeStatus = protectionData.overTempCharge || 'normal';
-        const otDischargeStatus = protectionData.overTempDischarge || 'normal';
-        
+const PROTECTION_TEXT = { alarm: 'ALARM!', alert: 'Warning', '': 'Normal' };
+
+function renderProtection(protectionData) {
+    for (const [id, keys] of Object.entries(PROTECTION_ITEMS)) {
         // Ưu tiên alarm trước, sau đó warning
-        if (otChargeStatus === 'alarm' || otDischargeStatus === 'alarm') {
-            otElement.classList.add('alarm');
-            otStatusEl.textContent = 'ALARM!';
-        } else if (otChargeStatus === 'warning' || otDischargeStatus === 'warning') {
-            otElement.classList.add('alert');
-            otStatusEl.textContent = 'Warning';
-        } else {
-            otStatusEl.textContent = 'Normal';
+        const values = keys.map(key => protectionData[key] || 'normal');
+        const state = values.includes('alarm') ? 'alarm' :
+                      values.includes('warning') ? 'alert' : '';
+        
+        const element = document.getElementById(id);
+        if (setState(element, state, ['alert', 'alarm'])) {
+            element.querySelector('.protection-status').textContent = PROTECTION_TEXT[state];
         }
     }
+}
 
-    // Xử lý Under Temperature (kết hợp cả Sạc và Xả)
-    const utElement = document.getElementById('protectUT');
-    if (utElement) {
-        const utStatusEl = utElement.querySelector('.protection-status');
-        utElement.classList.remove('alert', 'alarm');
-        
-        // Kiểm tra cả underTempCharge và underTempDischarge
-        const utChargeStatus = protectionData.underTempCharge || 'normal';
-        const utDischargeStatus = protectionData.underTempDischarge || 'normal';
-        
-        // Ưu tiên alarm trước, sau đó warning
-        if (utChargeStatus === 'alarm' || utDischargeStatus === 'alarm') {
-            utElement.classList.add('alarm');
-            utStatusEl.textContent = 'ALARM!';
-        } else if (utChargeStatus === 'warning' || utDischargeStatus === 'warning') {
-            utElement.classList.add('alert');
-            utStatusEl.textContent = 'Warning';
-        } else {
-            utStatusEl.textContent = 'Normal';
-        }
+// ==================== ALERTS ====================
+function renderAlerts(alerts) {
+    const key = JSON.stringify(alerts || []);
+    if (key === view.alertsKey) return;
+    view.alertsKey = key;
+    
+    const container = document.getElementById('alertsContainer');
+    container.textContent = '';
+    container.classList.toggle('hidden', !alerts || alerts.length === 0);
+    
+    (alerts || []).forEach(alert => {
+        const item = document.createElement('div');
+        item.className = `alert ${alert.severity}`;
+        const text = document.createElement('div');
+        text.className = 'alert-text';
+        text.textContent = alert.message;
+        item.appendChild(text);
+        container.appendChild(item);
+    });
+}
+
+function renderOnline(online) {
+    if (view.online === online) return;
+    view.online = online;
+    const indicator = document.querySelector('.live-indicator');
+    indicator.classList.toggle('offline', !online);
+    setText(indicator.querySelector('span:last-child'), online ? 'Live' : 'Offline');
+}
+
+// ==================== LIVE CHART ====================
+// Ring buffer cố định; vẽ lại tối đa một lần mỗi frame
+const chart = {
+    size: 300,
+    voltage: new Float32Array(300),
+    current: new Float32Array(300),
+    head: 0,
+    count: 0,
+    dirty: false,
+    canvas: null,
+    ctx: null
+};
+
+function chartResize() {
+    const canvas = chart.canvas;
+    const dpr = window.devicePixelRatio || 1;
+    canvas.width = Math.round(canvas.clientWidth * dpr);
+    canvas.height = Math.round(canvas.clientHeight * dpr);
+    chart.ctx.setTransform(dpr, 0, 0, dpr, 0, 0);
+    chart.dirty = true;
+}
+
+function chartPush(voltage, current) {
+    chart.voltage[chart.head] = voltage;
+    chart.current[chart.head] = current;
+    chart.head = (chart.head + 1) % chart.size;
+    if (chart.count < chart.size) chart.count++;
+    chart.dirty = true;
+}
+
+function chartRange(series) {
+    let min = Infinity, max = -Infinity;
+    for (let i = 0; i < chart.count; i++) {
+        const v = series[(chart.head - chart.count + i + chart.size) % chart.size];
+        if (v < min) min = v;
+        if (v > max) max = v;
     }
+    const pad = Math.max((max - min) * 0.1, 0.05);
+    return [min - pad, max + pad];
+}
 
-    // Xử lý các protection còn lại
-    for (const [id, info] of Object.entries(protections)) {
-        const element = document.getElementById(id);
-        if (!element) continue;
-        
-        const statusEl = element.querySelector('.protection-status');
-        
-        element.classList.remove('alert', 'alarm');
-        
-        if (info.data === 'alarm') {
-            element.classList.add('alarm');
-            statusEl.textContent = 'ALARM!';
-        } else if (info.data === 'warning') {
-            element.classList.add('alert');
-            statusEl.textContent = 'Warning';
-        } else {
-            statusEl.textContent = 'Normal';
-        }
+function chartLine(series, color, w, h) {
+    const ctx = chart.ctx;
+    const [min, max] = chartRange(series);
+    const step = w / (chart.size - 1);
+    const x0 = w - (chart.count - 1) * step;
+    
+    ctx.beginPath();
+    for (let i = 0; i < chart.count; i++) {
+        const v = series[(chart.head - chart.count + i + chart.size) % chart.size];
+        const y = h - (v - min) / (max - min) * h;
+        if (i === 0) ctx.moveTo(x0, y);
+        else ctx.lineTo(x0 + i * step, y);
     }
+    ctx.strokeStyle = color;
+    ctx.lineWidth = 2;
+    ctx.stroke();
+    return [min, max];
 }
 
-function updateAlerts(alerts) {
-    const container = document.getElementById('alertsContainer');
+function drawChart() {
+    if (!chart.ctx || !chart.dirty || chart.count === 0) return;
+    chart.dirty = false;
+    
+    const ctx = chart.ctx;
+    const w = chart.canvas.clientWidth;
+    const h = chart.canvas.clientHeight;
+    ctx.clearRect(0, 0, w, h);
     
-    if (!alerts || alerts.length === 0) {
-        container.classList.add('hidden');
-        return;
+    ctx.strokeStyle = '#eeeeee';
+    ctx.lineWidth = 1;
+    ctx.beginPath();
+    for (let i = 1; i < 4; i++) {
+        ctx.moveTo(0, h * i / 4);
+        ctx.lineTo(w, h * i / 4);
     }
+    ctx.stroke();
+    
+    const last = (chart.head - 1 + chart.size) % chart.size;
+    const [vMin, vMax] = chartLine(chart.voltage, '#3f51b5', w, h);
+    const [iMin, iMax] = chartLine(chart.current, '#ff9800', w, h);
+    
+    ctx.font = '12px sans-serif';
+    ctx.fillStyle = '#3f51b5';
+    ctx.fillText(`${chart.voltage[last].toFixed(2)} V  [${vMin.toFixed(2)} – ${vMax.toFixed(2)}]`, 8, 16);
+    ctx.fillStyle = '#ff9800';
+    ctx.fillText(`${chart.current[last].toFixed(2)} A  [${iMin.toFixed(2)} – ${iMax.toFixed(2)}]`, 8, 32);
+}
+
+// ==================== FRAME BATCHING ====================
+function render(data) {
+    const m = data.measurement || {};
+    const c = data.calculation || {};
+    const st = data.status || {};
     
-    container.classList.remove('hidden');
-    container.innerHTML = alerts.map(alert => `
-        <div class="alert ${alert.severity}">
-            <div class="alert-text">${alert.message}</div>
-        </div>
-    `).join('');
+    if (m.packVoltage !== undefined) setTextById('packVolt', parseFloat(m.packVoltage).toFixed(2) + ' V');
+    if (m.current !== undefined) setTextById('current', parseFloat(m.current).toFixed(2) + ' A');
+    if (m.packTemperature !== undefined) setTextById('packTemp', parseFloat(m.packTemperature).toFixed(1) + ' °C');
+    if (c.soc !== undefined) renderSOC(c.soc);
+    if (c.soh !== undefined) setTextById('soh', parseFloat(c.soh).toFixed(1) + ' %');
+    if (st.charging) renderChargingStatus(st.charging);
+    if (st.balancing) setTextById('balancingStatus', st.balancing.active ? 'Active' : 'Inactive');
+    if (data.protection) renderProtection(data.protection);
+    if (data.alerts) renderAlerts(data.alerts);
+    if (m.cellVoltages) renderCells(m.cellVoltages, (st.balancing && st.balancing.cells) || []);
 }
 
+function flushRender() {
+    view.frameRequested = false;
+    if (view.pending) {
+        render(view.pending);
+        view.pending = null;
+    }
+    drawChart();
+}
+
+function scheduleRender(data) {
+    view.pending = data;
+    if (!view.frameRequested) {
+        view.frameRequested = true;
+        requestAnimationFrame(flushRender);
+    }
+}
+
+// ==================== POLLING ====================
 async function fetchBMSData() {
     try {
-        const response = await fetch(CONFIG.API_ENDPOINT);
-        if (!response.ok) throw new Error(`HTTP ${response.status}`);
-        const data = await response.json();
-        
-        if (data.measurement?.packVoltage) {
-            const packVolt = parseFloat(data.measurement.packVoltage).toFixed(2);
-            updateElement('packVolt', packVolt, ' V');
-        }
-        
-        if (data.calculation?.soc) {
-            const soc = parseFloat(data.calculation.soc).toFixed(1);
-            updateSOCCircular(soc);
-        }
-        
-        if (data.calculation?.soh) {
-            const soh = parseFloat(data.calculation.soh).toFixed(1);
-            updateElement('soh', soh, ' %');
-        }
-        
-        if (data.measurement?.current !== undefined) {
-            const current = parseFloat(data.measurement.current).toFixed(2);
-            updateElement('current', current, ' A');
-        }
-        
-        if (data.measurement?.packTemperature) {
-            const temp = parseFloat(data.measurement.packTemperature).toFixed(1);
-            updateElement('packTemp', temp, ' °C');
-        }
+        const data = await loadBMSData();
         
-        if (data.status?.charging) {
-            updateChargingStatus(data.status.charging);
+        if (data.measurement) {
+            chartPush(parseFloat(data.measurement.packVoltage), parseFloat(data.measurement.current));
         }
-        
-        if (data.status?.balancing) {
-            const balStatus = data.status.balancing.active ? 'Active' : 'Inactive';
-            updateElement('balancingStatus', balStatus);
-        }
-        
-        if (data.protection) {
-            updateProtectionStatus(data.protection);
-        }
-        
-        if (data.alerts) {
-            updateAlerts(data.alerts);
-        }
-        
-        if (data.measurement?.cellVoltages && data.status?.balancing) {
-            const balancingCells = data.status.balancing.cells || [];
-            const batteryHTML = data.measurement.cellVoltages
-                .map(cell => {
-                    const isBalancing = balancingCells.includes(cell.cell);
-                    return createSimpleBatteryCell(cell.cell, parseFloat(cell.voltage), isBalancing);
-                })
-                .join('');
-            
-            const display = document.getElementById('batteryDisplay');
-            if (display.innerHTML !== batteryHTML) {
-                display.style.opacity = '0.5';
-                setTimeout(() => {
-                    display.innerHTML = batteryHTML;
-                    display.style.opacity = '1';
-                }, 200);
-            }
-        }
-        
-        console.log('Data updated:', new Date().toLocaleTimeString());
+        renderOnline(true);
+        scheduleRender(data);
         
     } catch (error) {
         console.error('Fetch error:', error);
-        document.getElementById('batteryDisplay').innerHTML = 
-            '<div class="loading">Connection Error</div>';
+        deltaState.seq = 0;
+        renderOnline(false);
     }
 }
 
+// Không chồng request: lần poll kế tiếp chỉ bắt đầu sau khi lần trước xong
+async function poll() {
+    const started = performance.now();
+    await fetchBMSData();
+    const elapsed = performance.now() - started;
+    setTimeout(poll, Math.max(0, CONFIG.UPDATE_INTERVAL - elapsed));
+}
+
 (function init() {
     console.log('BMS Dashboard initialized');
     console.log('Update interval:', CONFIG.UPDATE_INTERVAL + 'ms');
     
-    ['packVolt', 'soh', 'current', 'packTemp', 'batteryDisplay', 'socPercentage', 'socCircle'].forEach(id => {
-        const element = document.getElementById(id);
-        if (element) {
-            element.style.transition = 'opacity 0.3s ease';
-        }
-    });
-    
-    fetchBMSData();
-    setInterval(fetchBMSData, CONFIG.UPDATE_INTERVAL);
+    chart.canvas = document.getElementById('liveChart');
+    if (chart.canvas) {
+        chart.ctx = chart.canvas.getContext('2d');
+        chartResize();
+        window.addEventListener('resize', () => {
+            chartResize();
+            scheduleRender(null);
+        });
+    }
     
-    console.log('Auto-refresh enabled');
+    poll();
 })();
 )rawliteral");
 }
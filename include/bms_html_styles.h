@@ -162,6 +162,16 @@ h1 {
     animation: pulse 2s infinite;
 }
 
+.live-indicator.offline {
+    background: #ffebee;
+    color: #c62828;
+}
+
+.live-indicator.offline .dot {
+    background: #f44336;
+    animation: none;
+}
+
 @keyframes pulse {
     0%, 100% { box-shadow: 0 0 0 0 rgba(0, 230, 118, 0.7); }
     50% { box-shadow: 0 0 0 8px rgba(0, 230, 118, 0); }
@@ -471,6 +481,19 @@ h2 {
     font-weight: 600;
 }
 
+.chart-container {
+    background: #ffffff;
+    border-radius: 16px;
+    padding: 15px;
+    box-shadow: 0 4px 15px rgba(0,0,0,0.08);
+}
+
+.chart-container canvas {
+    display: block;
+    width: 100%;
+    height: 220px;
+}
+
 @media (max-width: 1024px) {
     .stats-grid {
         grid-template-columns: repeat(2, 1fr);
@@ -0,0 +1,123 @@
+#ifndef BMS_JOURNAL_H
+#define BMS_JOURNAL_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS JOURNAL MODULE
+ *  Lưu trạng thái bền vững (SOH, chu kỳ, ...) dạng journal
+ *  append-only trong partition "journal" (xem partitions.csv):
+ *    - Mỗi record 12 byte: key, CRC16, giá trị double
+ *    - Sector 4 KB = header 16 byte + 340 record
+ *    - Sector đầy → xoá sector kế tiếp (vòng), ghi snapshot
+ *      toàn bộ khoá rồi ghi tiếp → mòn đều trên mọi sector
+ *    - Khởi động: replay các sector theo seq, record sau thắng
+ *  Module khác chỉ gọi set() (ghi RAM); task nền (core 0) ghi
+ *  khi giá trị lệch quá ngưỡng hoặc quá maxAge.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+// Khoá lưu trên flash: chỉ thêm vào cuối, không đổi thứ tự
+enum JournalKey : uint16_t {
+    JK_SOH,
+    JK_SOH_TOTAL_CYCLES,
+    JK_SOH_EQ_CYCLES,
+    JK_SOH_CAPACITY,
+    JK_SOH_CYCLE_ACCUM,
+    JK_SOC_COULOMB,
+    JK_SOC_VALUE,
+    JK_SOC_FLAGS,
+    JK_ENERGY_CHG_WH,
+    JK_ENERGY_DSG_WH,
+    JK_ENERGY_CHG_AH,
+    JK_ENERGY_DSG_AH,
+    JK_ENERGY_MARK_CHG_WH,
+    JK_ENERGY_MARK_DSG_WH,
+    JK_ENERGY_CYCLE_EFF,
+    JK_SOC_MODE,
+    JK_SOC_EKF,
+    JK_CELL_CAP_1,
+    JK_CELL_CAP_2,
+    JK_CELL_CAP_3,
+    JK_CELL_CAP_4,
+    JK_CAPACITY_AH,
+    JK_CAPACITY_VAR,
+    JK_CAPACITY_UPDATES,
+    JK_SOH_DAMAGE,
+    JK_SOH_CALENDAR_LOSS,
+    JK_SOH_CALENDAR_K2,
+    JK_SOH_CYCLE_RATE,
+    JOURNAL_KEYS
+};
+
+const uint32_t JOURNAL_COMMIT_PERIOD = 1000;    // ms giữa 2 lần task kiểm tra
+
+class BMSJournal {
+private:
+    // ========================= BẢNG KHOÁ (RAM) =========================
+    struct Entry {
+        double value;            // giá trị mới nhất (loop ghi)
+        double committed;        // giá trị đã nằm trên flash (NAN = chưa có)
+        double threshold;        // lệch >= threshold → ghi ngay
+        uint32_t maxAge_ms;      // lệch nhỏ hơn ngưỡng → ghi sau maxAge
+        unsigned long lastCommit;
+        bool defined;
+    };
+
+    Entry entries[JOURNAL_KEYS];
+    portMUX_TYPE lock;
+
+    // ========================= FLASH =========================
+    const esp_partition_t* partition;
+    uint16_t sectorCount;
+    uint16_t activeSector;
+    uint32_t activeSeq;
+    uint16_t writeSlot;
+
+    TaskHandle_t task;
+    volatile bool syncRequested;
+
+    // ========================= THỐNG KÊ =========================
+    uint32_t replayedRecords;
+    volatile uint32_t recordsWritten;
+    volatile uint32_t sectorsErased;
+    volatile uint32_t writeErrors;
+    volatile uint32_t maxWriteUs;
+    volatile uint32_t maxEraseUs;
+
+    // ========================= HÀM NỘI BỘ =========================
+    bool readSectorSeq(uint16_t sector, uint32_t& seq);
+    uint16_t replaySector(uint16_t sector);
+    bool startSector(uint16_t sector, uint32_t seq);
+    bool appendRecord(uint16_t key, double value);
+    void commitPending(bool force);
+    static void commitTask(void* arg);
+
+public:
+    BMSJournal();
+    bool begin();
+    bool isReady() const;
+
+    // Khai báo khoá, trả về giá trị đã lưu (hoặc defaultValue)
+    double define(JournalKey key, double defaultValue, double threshold, uint32_t maxAge_ms);
+    // true nếu khoá đã có trên flash lúc khởi động
+    bool has(JournalKey key) const;
+    double get(JournalKey key) const;
+    // Chỉ ghi RAM - không chạm flash, gọi được ở mọi chu kỳ
+    void set(JournalKey key, double value);
+    // Ghi mọi giá trị đã đổi ở lần chạy kế tiếp của task
+    void sync();
+
+    uint32_t getRecordsWritten() const;
+    uint32_t getMaxWriteUs() const;
+    uint32_t getMaxEraseUs() const;
+
+    // Debug
+    void printStatus();
+};
+
+#endif // BMS_JOURNAL_H
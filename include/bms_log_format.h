@@ -0,0 +1,130 @@
+#ifndef BMS_LOG_FORMAT_H
+#define BMS_LOG_FORMAT_H
+
+#include "bms_frame.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS LOG FORMAT - định dạng log nhị phân trên flash
+ *  Header-only, không phụ thuộc Arduino: firmware dùng để
+ *  ghi, chương trình host dùng để giải mã dữ liệu tải về.
+ * ═══════════════════════════════════════════════════════════
+ *
+ *  Block 4096 byte = header 16 byte + 170 record x 24 byte
+ *
+ *  Header:
+ *  0   4   magic 'BMLG'
+ *  4   4   block sequence (tăng dần, không quay vòng)
+ *  8   2   số record hợp lệ
+ *  10  1   record size (24)
+ *  11  1   version
+ *  12  4   CRC32 của byte 0..11 và toàn bộ vùng record
+ *
+ *  Record (little-endian):
+ *  0   4   uptime (ms)
+ *  4   2   boot count
+ *  6   2*4 cell voltages (mV)
+ *  14  2   current (mA, int16)
+ *  16  2   temperature (0.1 °C, int16)
+ *  18  2   SOC (0.1 %)
+ *  20  2   alarm bits (BMS_BIT_*)
+ *  22  1   status flags (BMS_FLAG_*)
+ *  23  1   reserved
+ */
+
+#define BMS_LOG_MAGIC              0x474C4D42UL   // "BMLG"
+#define BMS_LOG_VERSION            1
+#define BMS_LOG_BLOCK_SIZE         4096
+#define BMS_LOG_HEADER_SIZE        16
+#define BMS_LOG_RECORD_SIZE        24
+#define BMS_LOG_RECORDS_PER_BLOCK  ((BMS_LOG_BLOCK_SIZE - BMS_LOG_HEADER_SIZE) / BMS_LOG_RECORD_SIZE)
+
+struct BMSLogRecord {
+    uint32_t uptime_ms;
+    uint16_t boot;
+    uint16_t cell_mV[BMS_FRAME_CELLS];
+    int16_t  current_mA;
+    int16_t  temp_dC;
+    uint16_t soc_pm;
+    uint16_t alarms;
+    uint8_t  flags;
+};
+
+struct BMSLogBlockHeader {
+    uint32_t seq;
+    uint16_t count;
+};
+
+// ==================== CRC32 (IEEE, reflected) ====================
+inline uint32_t bmsCrc32(const uint8_t* data, size_t len, uint32_t crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0U - (crc & 1U)));
+        }
+    }
+    return ~crc;
+}
+
+// ==================== RECORD ====================
+inline void bmsLogEncodeRecord(const BMSLogRecord& r, uint8_t* p) {
+    bmsPutU32(p, r.uptime_ms);
+    bmsPutU16(p + 4, r.boot);
+    for (int i = 0; i < BMS_FRAME_CELLS; i++) {
+        bmsPutU16(p + 6 + i * 2, r.cell_mV[i]);
+    }
+    bmsPutU16(p + 14, (uint16_t)r.current_mA);
+    bmsPutU16(p + 16, (uint16_t)r.temp_dC);
+    bmsPutU16(p + 18, r.soc_pm);
+    bmsPutU16(p + 20, r.alarms);
+    p[22] = r.flags;
+    p[23] = 0;
+}
+
+inline void bmsLogDecodeRecord(const uint8_t* p, BMSLogRecord& r) {
+    r.uptime_ms = bmsGetU32(p);
+    r.boot = bmsGetU16(p + 4);
+    for (int i = 0; i < BMS_FRAME_CELLS; i++) {
+        r.cell_mV[i] = bmsGetU16(p + 6 + i * 2);
+    }
+    r.current_mA = (int16_t)bmsGetU16(p + 14);
+    r.temp_dC = (int16_t)bmsGetU16(p + 16);
+    r.soc_pm = bmsGetU16(p + 18);
+    r.alarms = bmsGetU16(p + 20);
+    r.flags = p[22];
+}
+
+// ==================== BLOCK ====================
+inline uint32_t bmsLogBlockCrc(const uint8_t* block) {
+    uint32_t crc = bmsCrc32(block, 12);
+    return bmsCrc32(block + BMS_LOG_HEADER_SIZE,
+                    BMS_LOG_BLOCK_SIZE - BMS_LOG_HEADER_SIZE, crc);
+}
+
+// Ghi header + CRC cho block đã chứa record
+inline void bmsLogSealBlock(uint8_t* block, uint32_t seq, uint16_t count) {
+    bmsPutU32(block, BMS_LOG_MAGIC);
+    bmsPutU32(block + 4, seq);
+    bmsPutU16(block + 8, count);
+    block[10] = BMS_LOG_RECORD_SIZE;
+    block[11] = BMS_LOG_VERSION;
+    bmsPutU32(block + 12, bmsLogBlockCrc(block));
+}
+
+// Chỉ đọc header (dùng khi quét tìm block mới nhất)
+inline bool bmsLogReadHeader(const uint8_t* header, BMSLogBlockHeader& h) {
+    if (bmsGetU32(header) != BMS_LOG_MAGIC) return false;
+    if (header[10] != BMS_LOG_RECORD_SIZE || header[11] != BMS_LOG_VERSION) return false;
+    h.seq = bmsGetU32(header + 4);
+    h.count = bmsGetU16(header + 8);
+    return h.count <= BMS_LOG_RECORDS_PER_BLOCK;
+}
+
+// Kiểm tra header và CRC của cả block
+inline bool bmsLogCheckBlock(const uint8_t* block, BMSLogBlockHeader& h) {
+    if (!bmsLogReadHeader(block, h)) return false;
+    return bmsGetU32(block + 12) == bmsLogBlockCrc(block);
+}
+
+#endif // BMS_LOG_FORMAT_H
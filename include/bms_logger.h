@@ -0,0 +1,116 @@
+#ifndef BMS_LOGGER_H
+#define BMS_LOGGER_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <Preferences.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "bms_log_format.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS LOGGER MODULE
+ *  Ghi log nhị phân append-only vào partition "bmslog"
+ *  (xem partitions.csv), dạng ring buffer theo sector:
+ *    - 1 block = 1 sector flash 4 KB = 170 record
+ *    - Partition chia thành segment 64 KB cố định để tải về
+ *    - Block seq tăng dần, vị trí = seq % tổng số block
+ *    - Mỗi sector bị xoá đúng 1 lần mỗi vòng ring → mòn đều
+ *  Record gom trong 2 buffer RAM; task nền (core 0) tính
+ *  CRC, xoá sector và ghi cả block - loop() không chạm flash.
+ *  Tải về: đọc thẳng từ flash qua buffer 1 KB trên stack, hỗ
+ *  trợ HTTP Range; giữa các chunk gọi service() để vòng điều
+ *  khiển (đo, bảo vệ) vẫn chạy đúng chu kỳ khi tải vài MB.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const uint8_t LOG_SEGMENT_BLOCKS = 16;                     // 64 KB / segment
+const uint16_t LOG_DEFAULT_DECIMATION = 10;                // 100 ms x 10 = 1 Hz
+const unsigned long LOG_FLUSH_INTERVAL = 600000;           // ghi block dở sau 10 phút
+const size_t LOG_STREAM_CHUNK = 1024;                      // byte mỗi lần đọc flash → socket
+
+// Callback chạy giữa các chunk khi tải log (tác vụ điều khiển theo chu kỳ)
+typedef void (*LogStreamService)();
+
+class BMSLogger {
+private:
+    // ========================= FLASH =========================
+    const esp_partition_t* partition;
+    uint16_t totalBlocks;
+    uint16_t segmentCount;
+
+    // ========================= DOUBLE BUFFER =========================
+    struct WriteJob {
+        uint8_t buffer;
+        uint16_t count;
+        uint32_t seq;
+    };
+
+    uint8_t buffers[2][BMS_LOG_BLOCK_SIZE];
+    volatile bool pending[2];            // true = task nền đang giữ buffer
+    uint8_t active;
+    uint16_t activeCount;
+    unsigned long activeStart;
+    uint32_t nextSeq;                    // seq của block đang gom
+    uint32_t firstSeq;                   // block cũ nhất còn trên flash
+    volatile uint32_t writtenSeq;        // mọi block < writtenSeq đã nằm trên flash
+
+    QueueHandle_t queue;
+    TaskHandle_t task;
+
+    // ========================= CẤU HÌNH =========================
+    Preferences prefs;
+    uint16_t decimation;
+    uint16_t decimationCounter;
+    uint16_t bootCount;
+    LogStreamService service;
+
+    // ========================= THỐNG KÊ =========================
+    uint32_t droppedRecords;
+    volatile uint32_t blocksWritten;
+    volatile uint32_t writeErrors;
+    volatile uint32_t lastWriteMs;
+    volatile uint32_t maxWriteMs;
+
+    // ========================= HÀM NỘI BỘ =========================
+    void scan();
+    void submit();
+    void writeBlock(const WriteJob& job);
+    static void writerTask(void* arg);
+    bool readStreamChunk(bool bySeq, uint32_t base, size_t offset, uint8_t* buf, size_t len);
+    void streamBlocks(WebServer& server, bool bySeq, uint32_t base, uint32_t blocks,
+                      const char* filename);
+
+public:
+    BMSLogger();
+    bool begin();
+
+    // Gọi ở mỗi chu kỳ đo; uptime và boot count do logger điền
+    void addSample(BMSLogRecord& record);
+    // Đẩy block đang gom (chưa đầy) xuống flash
+    void flush();
+
+    bool isReady() const;
+    uint16_t getBootCount() const;
+    uint16_t getDecimation() const;
+    void setDecimation(uint16_t value);
+    uint16_t getSegmentCount() const;
+
+    uint32_t getFirstSeq() const;
+    uint32_t getWrittenSeq() const;
+    void setStreamService(LogStreamService fn);
+
+    // Tải raw một segment (hỗ trợ Range)
+    void streamSegment(WebServer& server, uint16_t segment);
+    // Xuất block [fromSeq, toSeq) theo thứ tự: nhị phân (hỗ trợ Range) hoặc CSV
+    void streamExport(WebServer& server, uint32_t fromSeq, uint32_t toSeq, bool csv);
+    void sendInfo(WebServer& server);
+
+    // Debug
+    void printStatus();
+};
+
+#endif // BMS_LOGGER_H
@@ -0,0 +1,49 @@
+#ifndef BMS_METRICS_H
+#define BMS_METRICS_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS METRICS MODULE
+ *  Endpoint /metrics theo định dạng text của Prometheus.
+ *  Gauge lấy từ bmsData, counter từ các module, histogram
+ *  đo tại chỗ. Sinh nội dung bằng buffer trên stack,
+ *  gửi theo chunk - không cấp phát heap.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+// Biên bucket (µs): 1ms, 5ms, 10ms, 25ms, 50ms, 100ms, 250ms, 500ms, 1s
+const uint8_t METRIC_BUCKETS = 9;
+
+struct MetricHistogram {
+    uint32_t counts[METRIC_BUCKETS + 1];   // bucket cuối = +Inf
+    uint64_t sum_us;
+    uint32_t count;
+
+    void observe(uint32_t value_us);
+};
+
+class BMSMetrics {
+private:
+    MetricHistogram loopPeriod;
+    MetricHistogram httpDuration;
+    uint32_t httpRequests;
+    unsigned long lastLoopStart;
+    uint32_t loopMax_us;             // stall dài nhất kể từ khi khởi động
+
+public:
+    BMSMetrics();
+
+    // Gọi ở đầu mỗi vòng loop()
+    void markLoop();
+    // Gọi sau mỗi HTTP handler
+    void recordHttp(uint32_t duration_us);
+
+    uint32_t getHttpRequests() const;
+
+    void stream(WebServer& server);
+};
+
+#endif // BMS_METRICS_H
@@ -0,0 +1,186 @@
+#ifndef BMS_OCV_H
+#define BMS_OCV_H
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS OCV - mặt OCV theo SOC × nhiệt độ (LiFePO4, mỗi cell)
+ *  Header-only, không phụ thuộc Arduino. Các bảng được sinh lúc
+ *  biên dịch (constexpr, cần C++17) từ điểm datasheet:
+ *    - OCV 25 °C tại SOC 0, 10, ..., 100 % → nội suy PCHIP
+ *      (Fritsch–Carlson, giữ đơn điệu) lên lưới đều 2.5 %
+ *    - Hệ số nhiệt dOCV/dT (mV/°C) tại cùng các điểm SOC
+ *    - Lưới nhiệt độ -20 … 60 °C, bước 5 °C
+ *  Tra cứu: chỉ số trực tiếp + nội suy song tuyến → O(1).
+ *  Chiều ngược (OCV → SOC) là bảng thứ hai trên lưới điện áp
+ *  đều 10 mV, sinh bằng chia đôi trên hàm PCHIP lúc biên dịch.
+ *  Bảng hệ số dung lượng theo nhiệt độ dùng cùng lưới nhiệt độ.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+// ========================= LƯỚI =========================
+const int   BMS_OCV_SOC_POINTS = 41;         // 0 … 100 %, bước 2.5 %
+const float BMS_OCV_SOC_STEP = 2.5f;
+const int   BMS_OCV_TEMP_POINTS = 17;        // -20 … 60 °C, bước 5 °C
+const float BMS_OCV_TEMP_MIN = -20.0f;
+const float BMS_OCV_TEMP_STEP = 5.0f;
+const int   BMS_OCV_VOLT_POINTS = 96;        // 2.50 … 3.45 V, bước 10 mV
+const float BMS_OCV_VOLT_MIN = 2.50f;
+const float BMS_OCV_VOLT_STEP = 0.01f;
+
+// ========================= ĐIỂM DATASHEET =========================
+// OCV cell ở 25 °C tại SOC 0, 10, ..., 100 %
+constexpr float BMS_OCV_POINTS_25C[11] = {
+    2.500f, 3.000f, 3.125f, 3.200f, 3.225f, 3.250f, 3.275f, 3.300f, 3.325f, 3.350f, 3.400f
+};
+// Hệ số nhiệt (entropy) mV/°C tại cùng các điểm SOC
+constexpr float BMS_OCV_TEMP_COEFF_MV[11] = {
+    0.30f, 0.20f, 0.10f, 0.05f, 0.00f, -0.05f, -0.05f, -0.05f, -0.10f, -0.10f, -0.15f
+};
+// Hệ số dung lượng khả dụng theo nhiệt độ
+constexpr float BMS_CAPACITY_TEMP_POINTS[5][2] = {
+    {-20.0f, 0.40f},
+    {-10.0f, 0.60f},
+    {  0.0f, 0.85f},
+    { 25.0f, 1.00f},
+    { 60.0f, 0.98f}
+};
+
+// ========================= SINH BẢNG (COMPILE TIME) =========================
+struct BMSOcvTables {
+    float ocv[BMS_OCV_TEMP_POINTS][BMS_OCV_SOC_POINTS];     // V
+    float soc[BMS_OCV_TEMP_POINTS][BMS_OCV_VOLT_POINTS];    // %
+    float capacity[BMS_OCV_TEMP_POINTS];                    // hệ số 0..1
+};
+
+// PCHIP trên 11 điểm cách đều 10 %
+constexpr float bmsOcvPchip(const float (&y)[11], float soc) {
+    if (soc <= 0.0f) return y[0];
+    if (soc >= 100.0f) return y[10];
+
+    float d[10] = {};
+    for (int i = 0; i < 10; i++) d[i] = (y[i + 1] - y[i]) / 10.0f;
+
+    int i = (int)(soc / 10.0f);
+    if (i > 9) i = 9;
+
+    // Độ dốc tại nút: trung bình điều hoà, 0 nếu đổi chiều (giữ đơn điệu)
+    float m0 = 0.0f, m1 = 0.0f;
+    if (i == 0) m0 = d[0];
+    else if (d[i - 1] * d[i] > 0.0f) m0 = 2.0f * d[i - 1] * d[i] / (d[i - 1] + d[i]);
+    if (i == 9) m1 = d[9];
+    else if (d[i] * d[i + 1] > 0.0f) m1 = 2.0f * d[i] * d[i + 1] / (d[i] + d[i + 1]);
+
+    float t = (soc - i * 10.0f) / 10.0f;
+    float t2 = t * t, t3 = t2 * t;
+    return (2.0f * t3 - 3.0f * t2 + 1.0f) * y[i] + (t3 - 2.0f * t2 + t) * 10.0f * m0 +
+           (-2.0f * t3 + 3.0f * t2) * y[i + 1] + (t3 - t2) * 10.0f * m1;
+}
+
+constexpr float bmsOcvModel(float soc, float temp) {
+    float pos = soc / 10.0f;
+    if (pos < 0.0f) pos = 0.0f;
+    if (pos > 10.0f) pos = 10.0f;
+    int i = (int)pos;
+    if (i > 9) i = 9;
+    float coeff = BMS_OCV_TEMP_COEFF_MV[i] + (pos - i) * (BMS_OCV_TEMP_COEFF_MV[i + 1] - BMS_OCV_TEMP_COEFF_MV[i]);
+    return bmsOcvPchip(BMS_OCV_POINTS_25C, soc) + coeff * (temp - 25.0f) / 1000.0f;
+}
+
+constexpr float bmsCapacityModel(float temp) {
+    if (temp <= BMS_CAPACITY_TEMP_POINTS[0][0]) return BMS_CAPACITY_TEMP_POINTS[0][1];
+    if (temp >= BMS_CAPACITY_TEMP_POINTS[4][0]) return BMS_CAPACITY_TEMP_POINTS[4][1];
+    int i = 0;
+    while (i < 3 && temp > BMS_CAPACITY_TEMP_POINTS[i + 1][0]) i++;
+    float t1 = BMS_CAPACITY_TEMP_POINTS[i][0], t2 = BMS_CAPACITY_TEMP_POINTS[i + 1][0];
+    float a1 = BMS_CAPACITY_TEMP_POINTS[i][1], a2 = BMS_CAPACITY_TEMP_POINTS[i + 1][1];
+    return a1 + (temp - t1) * (a2 - a1) / (t2 - t1);
+}
+
+constexpr BMSOcvTables bmsBuildOcvTables() {
+    BMSOcvTables t = {};
+    for (int j = 0; j < BMS_OCV_TEMP_POINTS; j++) {
+        float temp = BMS_OCV_TEMP_MIN + j * BMS_OCV_TEMP_STEP;
+
+        for (int k = 0; k < BMS_OCV_SOC_POINTS; k++) {
+            t.ocv[j][k] = bmsOcvModel(k * BMS_OCV_SOC_STEP, temp);
+        }
+
+        for (int k = 0; k < BMS_OCV_VOLT_POINTS; k++) {
+            float v = BMS_OCV_VOLT_MIN + k * BMS_OCV_VOLT_STEP;
+            float lo = 0.0f, hi = 100.0f;
+            for (int n = 0; n < 24; n++) {
+                float mid = 0.5f * (lo + hi);
+                if (bmsOcvModel(mid, temp) < v) lo = mid;
+                else hi = mid;
+            }
+            t.soc[j][k] = 0.5f * (lo + hi);
+        }
+
+        t.capacity[j] = bmsCapacityModel(temp);
+    }
+    return t;
+}
+
+constexpr bool bmsOcvMonotonic(const BMSOcvTables& t) {
+    for (int j = 0; j < BMS_OCV_TEMP_POINTS; j++) {
+        for (int k = 1; k < BMS_OCV_SOC_POINTS; k++) {
+            if (!(t.ocv[j][k] > t.ocv[j][k - 1])) return false;
+        }
+    }
+    return true;
+}
+
+inline constexpr BMSOcvTables BMS_OCV_TABLES = bmsBuildOcvTables();
+static_assert(bmsOcvMonotonic(BMS_OCV_TABLES), "OCV surface must be strictly increasing in SOC");
+
+// ========================= TRA CỨU O(1) =========================
+// Vị trí trên lưới đều: chỉ số ô + phần lẻ
+struct BMSOcvCell {
+    int index;
+    float frac;
+};
+
+inline BMSOcvCell bmsOcvLocate(float value, float min, float step, int points) {
+    float pos = (value - min) / step;
+    if (!(pos > 0.0f)) return { 0, 0.0f };                  // cả NAN
+    if (pos >= points - 1) return { points - 2, 1.0f };
+    int i = (int)pos;
+    return { i, pos - i };
+}
+
+// OCV cell (V) theo SOC (%) và nhiệt độ; slope = dOCV/dSOC (V / %)
+inline float bmsOcvCell(float soc, float temp, float* slope = nullptr) {
+    BMSOcvCell s = bmsOcvLocate(soc, 0.0f, BMS_OCV_SOC_STEP, BMS_OCV_SOC_POINTS);
+    BMSOcvCell t = bmsOcvLocate(temp, BMS_OCV_TEMP_MIN, BMS_OCV_TEMP_STEP, BMS_OCV_TEMP_POINTS);
+    const float* r0 = BMS_OCV_TABLES.ocv[t.index];
+    const float* r1 = BMS_OCV_TABLES.ocv[t.index + 1];
+
+    float d0 = r0[s.index + 1] - r0[s.index];
+    float d1 = r1[s.index + 1] - r1[s.index];
+    float v0 = r0[s.index] + s.frac * d0;
+    float v1 = r1[s.index] + s.frac * d1;
+
+    if (slope) *slope = (d0 + t.frac * (d1 - d0)) / BMS_OCV_SOC_STEP;
+    return v0 + t.frac * (v1 - v0);
+}
+
+// SOC (%) theo OCV cell và nhiệt độ
+inline float bmsOcvCellToSOC(float voltage, float temp) {
+    BMSOcvCell v = bmsOcvLocate(voltage, BMS_OCV_VOLT_MIN, BMS_OCV_VOLT_STEP, BMS_OCV_VOLT_POINTS);
+    BMSOcvCell t = bmsOcvLocate(temp, BMS_OCV_TEMP_MIN, BMS_OCV_TEMP_STEP, BMS_OCV_TEMP_POINTS);
+    const float* r0 = BMS_OCV_TABLES.soc[t.index];
+    const float* r1 = BMS_OCV_TABLES.soc[t.index + 1];
+
+    float s0 = r0[v.index] + v.frac * (r0[v.index + 1] - r0[v.index]);
+    float s1 = r1[v.index] + v.frac * (r1[v.index + 1] - r1[v.index]);
+    return s0 + t.frac * (s1 - s0);
+}
+
+// Hệ số dung lượng khả dụng theo nhiệt độ (1.0 ở 25 °C)
+inline float bmsCapacityTempCoeff(float temp) {
+    BMSOcvCell t = bmsOcvLocate(temp, BMS_OCV_TEMP_MIN, BMS_OCV_TEMP_STEP, BMS_OCV_TEMP_POINTS);
+    return BMS_OCV_TABLES.capacity[t.index] +
+           t.frac * (BMS_OCV_TABLES.capacity[t.index + 1] - BMS_OCV_TABLES.capacity[t.index]);
+}
+
+#endif // BMS_OCV_H
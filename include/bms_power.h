@@ -0,0 +1,87 @@
+#ifndef BMS_POWER_H
+#define BMS_POWER_H
+
+#include <Arduino.h>
+#include "soc_cells.h"
+#include "bms_resistance.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS POWER MODULE
+ *  State-of-power: dòng sạc/xả tối đa giữ được trong 2 s / 10 s /
+ *  30 s mà không cell nào vượt giới hạn điện áp. Mỗi cell, dòng I
+ *  không đổi trong Δt (mô hình 1RC, I > 0 = sạc):
+ *    V(Δt) = OCV + V1·a + I·(R0 + R1·(1 - a) + dOCV/dSOC·Δt/(36·C))
+ *    a = exp(-Δt/τ); OCV, độ dốc theo SOC từng cell (bms_ocv.h);
+ *    R0 từng cell theo nhiệt độ (BMSResistance), R1 cùng hệ số
+ *  → I_max = khoảng cách tới V_min/V_max / R hiệu dụng, lấy cell
+ *  xấu nhất, kẹp theo giới hạn dòng và giảm tuyến tính gần ngưỡng
+ *  nhiệt độ bảo vệ. Công suất = I_max × điện áp pack dự đoán.
+ *  Thời gian còn lại: trung bình mũ dòng (τ 60 s)
+ *    TTE = Ah còn lại / |Ī|, TTF = Ah còn thiếu / Ī (bỏ qua pha CV)
+ *  Cập nhật mỗi chu kỳ đo 100 ms.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const uint8_t SOP_HORIZONS = 3;
+const float SOP_HORIZON_S[SOP_HORIZONS] = { 2.0f, 10.0f, 30.0f };
+
+const float SOP_CELL_V_MIN = 2.80f;          // dưới ngưỡng cảnh báo UV, trên ngưỡng trip 2.5 V
+const float SOP_CELL_V_MAX = 3.60f;          // dưới ngưỡng trip OV 3.65 V
+const float SOP_CHARGE_LIMIT_A = 1.0f;       // = ngưỡng cảnh báo OC sạc (bms_protection.h)
+const float SOP_DISCHARGE_LIMIT_A = 4.0f;    // = ngưỡng cảnh báo OC xả
+const float SOP_R1_OHM = 0.010f;             // nhánh RC mỗi cell (pack 40 mΩ, soc_ekf)
+const float SOP_TAU_S = 60.0f;
+
+// Nhiệt độ: dòng = 0 ngoài [min, max], giảm tuyến tính trong SOP_TEMP_RAMP
+const float SOP_CHARGE_T_MIN = 0.0f;
+const float SOP_CHARGE_T_MAX = 45.0f;
+const float SOP_DISCHARGE_T_MIN = -10.0f;
+const float SOP_DISCHARGE_T_MAX = 60.0f;
+const float SOP_TEMP_RAMP = 5.0f;
+
+const float SOP_AVG_TAU_S = 60.0f;           // trung bình mũ dòng cho TTE/TTF
+const float SOP_MIN_CURRENT = 0.05f;         // |Ī| nhỏ hơn → không tính TTE/TTF
+
+struct SOPLimit {
+    float charge_A;
+    float discharge_A;          // độ lớn (dương)
+    float charge_W;
+    float discharge_W;
+};
+
+class BMSPower {
+private:
+    const SOCCells* cells;
+    const BMSResistance* resistance;
+
+    SOPLimit limits[SOP_HORIZONS];
+    float decay[SOP_HORIZONS];   // exp(-Δt/τ), tính 1 lần
+
+    float avgCurrent;
+    float tteMinutes;            // NAN = không xả
+    float ttfMinutes;            // NAN = không sạc
+    unsigned long lastUpdate;
+
+    // ========================= HÀM NỘI BỘ =========================
+    static float tempDerate(float temp, float tMin, float tMax);
+
+public:
+    BMSPower();
+    // Nguồn SOC/dung lượng từng cell và điện trở trong
+    void attach(const SOCCells& cellSoc, const BMSResistance& ir);
+
+    // rcVoltage = V1 của pack (EKF); packSOC/packCapacity_Ah cho TTE/TTF
+    void update(float current_A, float temperature, float rcVoltage, float packSOC,
+                float packCapacity_Ah, bool chargeAllowed, bool dischargeAllowed);
+
+    const SOPLimit& getLimit(uint8_t horizon) const;     // 0..SOP_HORIZONS-1
+    float getAvgCurrent() const;
+    float getTimeToEmpty() const;                        // phút, NAN = không xả
+    float getTimeToFull() const;                         // phút, NAN = không sạc
+
+    // Debug
+    void printStatus();
+};
+
+#endif // BMS_POWER_H
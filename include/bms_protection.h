@@ -3,6 +3,17 @@
 
 #include <Arduino.h>
 
+// Loại bảo vệ (dùng cho bộ đếm trip)
+enum ProtectionType : uint8_t {
+    PROT_CHG_OV,
+    PROT_CHG_OC,
+    PROT_CHG_TEMP,
+    PROT_DSG_UV,
+    PROT_DSG_OC,
+    PROT_DSG_TEMP,
+    PROT_COUNT
+};
+
 class BMSProtection {
 private:
     // Cấu hình chân MOSFET
@@ -62,7 +73,17 @@ private:
     unsigned long dsg_oc_recover_timer;
     unsigned long dsg_temp_recover_timer;
     
+    // Bộ đếm số lần trip
+    uint32_t tripCount[PROT_COUNT];
+    
+    // Hàng đợi trip chưa được lấy bởi takeTrip, theo thứ tự phát sinh
+    // (nhiều bảo vệ có thể trip trong cùng một lần update)
+    ProtectionType tripQueue[PROT_COUNT];
+    float tripQueueValue[PROT_COUNT];
+    uint8_t tripQueueLen;
+    
     // Hàm nội bộ
+    void recordTrip(ProtectionType type, float value);
     bool checkChargeOV(float cell1, float cell2, float cell3, float cell4);
     bool checkChargeOC(float current);
     bool checkChargeTemp(float temp);
@@ -82,6 +103,10 @@ public:
     bool isAnyFault() const;
     bool getChargeMosfetState() const;
     bool getDischargeMosfetState() const;
+    uint32_t getTripCount(ProtectionType type) const;
+    static const char* getTypeName(ProtectionType type);
+    // Lấy lần lượt các trip mới phát sinh, cũ nhất trước (value: V, A hoặc °C)
+    bool takeTrip(ProtectionType& type, float& value);
     
     // Control
     void clearProtection();
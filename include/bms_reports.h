@@ -0,0 +1,95 @@
+#ifndef BMS_REPORTS_H
+#define BMS_REPORTS_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <Preferences.h>
+#include "bms_protection.h"
+#include "bms_energy.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS REPORTS MODULE
+ *  Tổng hợp theo ngày, cộng dồn ở mỗi chu kỳ đo (không quét lại
+ *  dữ liệu thô): Wh/Ah sạc-xả, dòng đỉnh, min/max cell, thời
+ *  gian sạc/xả/nghỉ/cân bằng, số lần trip bảo vệ.
+ *  Wh/Ah là phần tăng của tổng BMSEnergy mỗi chu kỳ (một bộ
+ *  tích phân duy nhất → tổng các ngày khớp /energy).
+ *  Không có đồng hồ thực → 1 "ngày" = 24 giờ vận hành; nếu
+ *  hệ thống có giờ thực thì ghi kèm epoch lúc bắt đầu ngày.
+ *  Ngày đã đóng lưu trong NVS dạng ring 32 bản ghi; ngày đang
+ *  chạy được lưu định kỳ để tiếp tục sau khi khởi động lại.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const uint8_t REPORT_DAYS = 32;
+const uint32_t REPORT_DAY_MS = 86400000UL;
+const unsigned long REPORT_SAVE_INTERVAL = 600000;   // lưu ngày đang chạy mỗi 10 phút
+const uint32_t REPORT_MAX_STEP_MS = 1000;            // loop bị trễ: không tính quá 1 s/lần
+
+struct DailyReport {
+    double   whCharged;
+    double   whDischarged;
+    double   ahCharged;
+    double   ahDischarged;
+    uint32_t epochStart;       // giờ thực lúc bắt đầu (0 = không có)
+    uint32_t elapsed_ms;       // thời gian vận hành đã ghi nhận trong ngày
+    uint32_t charging_ms;
+    uint32_t discharging_ms;
+    uint32_t idle_ms;
+    uint32_t balancing_ms;
+    float    peakChargeA;
+    float    peakDischargeA;   // độ lớn
+    uint16_t magic;
+    uint16_t day;              // số thứ tự ngày vận hành
+    uint16_t bootFirst;
+    uint16_t bootLast;
+    uint16_t minCell_mV;
+    uint16_t maxCell_mV;
+    uint16_t trips[PROT_COUNT];
+};
+
+class BMSReports {
+private:
+    DailyReport current;
+    uint32_t lastTrips[PROT_COUNT];
+    bool tripsPrimed;
+    // Tổng BMSEnergy ở chu kỳ trước (Wh, Ah)
+    double lastChargedWh;
+    double lastDischargedWh;
+    double lastChargedAh;
+    double lastDischargedAh;
+    bool energyPrimed;
+    unsigned long lastUpdate;
+    unsigned long lastSave;
+    uint16_t bootCount;
+    Preferences prefs;
+
+    // ========================= HÀM NỘI BỘ =========================
+    void startDay(uint16_t day);
+    void closeDay();
+    void saveCurrent();
+
+public:
+    BMSReports();
+    // Gọi sau logger.begin() để có boot count
+    void begin(uint16_t boot);
+
+    // Gọi ở mỗi chu kỳ đo (100 ms), sau energy.update(); flags = BMS_FLAG_*,
+    // trips = tổng số trip từ khi khởi động
+    void update(const BMSEnergy& energy, float current_A, const float cells[4], uint8_t flags,
+                const uint32_t trips[PROT_COUNT]);
+
+    uint8_t getStoredCount() const;
+    // index 0 = ngày đã đóng gần nhất
+    bool getDay(uint8_t index, DailyReport& report);
+    const DailyReport& getCurrent() const;
+
+    // HTTP: bảng các ngày (cũ → mới), ngày đang chạy ở cuối
+    void streamJson(WebServer& server);
+
+    // Debug
+    void printReports(uint8_t days);
+};
+
+#endif // BMS_REPORTS_H
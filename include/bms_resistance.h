@@ -0,0 +1,103 @@
+#ifndef BMS_RESISTANCE_H
+#define BMS_RESISTANCE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS RESISTANCE MODULE
+ *  Điện trở trong DC từng cell từ các bước nhảy dòng trong luồng
+ *  đo 100 ms (R = ΔV/ΔI giữa 2 mẫu liên tiếp):
+ *    - Bước tải: |ΔI pack| ≥ 0.5 A, mẫu trước đó dòng ổn định,
+ *      trạng thái xả cân bằng của cell không đổi giữa 2 mẫu
+ *  Không đo từ bật/tắt xả cân bằng: bước ~70 mA cho ΔV ~1 mV, dưới
+ *  nhiễu đo, bộ lọc 1 mΩ chỉ giữ đuôi dương → R lệch lên; dòng xả
+ *  còn đi qua dây đo nên ΔV không phải IR của cell.
+ *  Lọc Kalman vô hướng mỗi cell trên R quy về 25 °C:
+ *    R(T) = R25 · exp(k·(25 - T)),  k = 0.02 /°C
+ *    σ đo = √2·σV / |ΔI| → bước lớn tin hơn, ngoại lai > 4σ bị bỏ
+ *  Theo dõi theo nhiệt độ: mỗi cell có bảng trung bình mũ R đo
+ *  được (chưa quy đổi) theo bin 10 °C.
+ *  Dùng cho: SOH công suất (R25 so với mốc đầu đời, EOL = 2×) và
+ *  bù sụt áp R·I cho điện áp cell.
+ *  Lưu NVS dạng blob mỗi 10 phút khi có thay đổi.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const uint8_t IR_CELLS = 4;
+const float IR_DEFAULT_OHM = 0.015f;         // datasheet, 25 °C
+const float IR_TEMP_COEFF = 0.02f;           // /°C
+const float IR_MIN_STEP_A = 0.5f;            // bước tải tối thiểu
+const float IR_STABLE_A = 0.05f;             // dòng coi là ổn định giữa 2 mẫu
+const float IR_VOLT_NOISE = 0.002f;          // σ đo điện áp cell (V)
+const float IR_DRIFT = 0.0002f;              // σ thay đổi R25 mỗi phép đo (Ω)
+const float IR_MIN_OHM = 0.001f;
+const float IR_MAX_OHM = 0.200f;
+const float IR_EOL_FACTOR = 2.0f;            // R25 = 2× mốc đầu → SOH công suất 0 %
+const uint16_t IR_BASELINE_EVENTS = 50;      // chốt mốc đầu đời sau 50 lần đo tải
+const float IR_TEMP_MIN = -10.0f;
+const float IR_TEMP_STEP = 10.0f;
+const uint8_t IR_TEMP_BINS = 6;              // -10 … 50 °C
+const float IR_BIN_ALPHA = 0.05f;            // trung bình mũ trong bin
+const unsigned long IR_SAVE_INTERVAL = 600000;
+
+struct ResistanceState {
+    uint32_t magic;
+    float r25[IR_CELLS];                     // Ω, quy về 25 °C
+    float var[IR_CELLS];                     // Ω²
+    float baseline[IR_CELLS];                // Ω, mốc đầu đời; 0 = chưa chốt
+    uint32_t loadEvents[IR_CELLS];
+    float binR[IR_CELLS][IR_TEMP_BINS];      // Ω đo được theo nhiệt độ
+    uint16_t binCount[IR_CELLS][IR_TEMP_BINS];
+};
+
+class BMSResistance {
+private:
+    ResistanceState state;
+
+    // Mẫu trước
+    float prevCells[IR_CELLS];
+    bool prevBleed[IR_CELLS];
+    float prevCurrent;
+    float prevDelta;             // ΔI của bước trước (kiểm tra dòng ổn định)
+    bool hasPrev;
+
+    uint32_t rejected;
+    unsigned long lastSave;
+    bool dirty;
+    Preferences prefs;
+
+    // ========================= HÀM NỘI BỘ =========================
+    void defaults();
+    static float tempFactor(float temp_C);
+    void addMeasurement(uint8_t cell, float dV, float dI, float temp_C);
+    void save();
+
+public:
+    BMSResistance();
+    void begin();
+
+    // Gọi ở mỗi chu kỳ đo; bleeding[i] = điện trở xả của cell i bật trong lần đo này
+    void update(const float cells[IR_CELLS], float current_A, float temp_C, const bool bleeding[IR_CELLS]);
+
+    float getR25(uint8_t cell) const;                    // Ω
+    float getResistance(uint8_t cell, float temp_C) const;
+    float getSigma(uint8_t cell) const;                  // Ω, quy về 25 °C
+    uint32_t getEvents(uint8_t cell) const;              // số bước tải đã nhận
+    float getBaseline(uint8_t cell) const;               // Ω, NAN = chưa chốt
+    // Cell xấu nhất: 100 % = như mốc đầu, 0 % = R25 gấp IR_EOL_FACTOR lần
+    float getPowerSOH() const;
+    float getMaxR25() const;
+    // Điện áp cell đã trừ sụt áp R·I (ước lượng OCV khi có dòng)
+    float compensate(uint8_t cell, float voltage, float current_A, float temp_C) const;
+
+    // Bảng R theo nhiệt độ (Ω, NAN = chưa có mẫu)
+    float getTempBin(uint8_t cell, uint8_t bin) const;
+    void reset();
+
+    // Debug
+    void printStatus();
+};
+
+#endif // BMS_RESISTANCE_H
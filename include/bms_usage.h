@@ -0,0 +1,81 @@
+#ifndef BMS_USAGE_H
+#define BMS_USAGE_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <Preferences.h>
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS USAGE MODULE
+ *  Histogram thời gian lưu trú (giây) theo điều kiện vận hành,
+ *  dữ liệu nền cho phân tích lão hoá:
+ *    - Nhiệt độ pack: bin 5 °C từ -20 đến 70 °C
+ *    - C-rate có dấu (+ sạc / - xả), biên cố định
+ *    - SOC: bin 10 %
+ *    - Điện áp từng cell: bin 50 mV từ 2.50 đến 3.70 V
+ *  Giá trị ngoài dải dồn vào bin đầu/cuối. Mỗi chu kỳ đo chỉ
+ *  cộng dồn ms; đủ 1 s → +1 vào bin hiện tại của mỗi histogram
+ *  (chỉ số bin tính trực tiếp, không tìm kiếm).
+ *  Lưu NVS dạng blob mỗi 10 phút.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const float USAGE_TEMP_MIN = -20.0f;
+const float USAGE_TEMP_STEP = 5.0f;
+const uint8_t USAGE_TEMP_BINS = 18;
+
+const uint8_t USAGE_CRATE_BINS = 11;        // biên: xem USAGE_CRATE_EDGES trong .cpp
+
+const float USAGE_SOC_STEP = 10.0f;
+const uint8_t USAGE_SOC_BINS = 10;
+
+const float USAGE_CELL_MIN = 2.50f;
+const float USAGE_CELL_STEP = 0.05f;
+const uint8_t USAGE_CELL_BINS = 24;
+
+const unsigned long USAGE_SAVE_INTERVAL = 600000;   // lưu NVS mỗi 10 phút
+const uint32_t USAGE_MAX_STEP_MS = 1000;            // loop bị trễ: không tính quá 1 s/lần
+
+struct UsageHistograms {
+    uint32_t magic;
+    uint32_t total_s;
+    uint32_t temp[USAGE_TEMP_BINS];
+    uint32_t cRate[USAGE_CRATE_BINS];
+    uint32_t soc[USAGE_SOC_BINS];
+    uint32_t cell[4][USAGE_CELL_BINS];
+};
+
+class BMSUsage {
+private:
+    UsageHistograms hist;
+    float capacity_Ah;
+    uint32_t pendingMs;          // phần lẻ chưa đủ 1 s
+    unsigned long lastUpdate;
+    unsigned long lastSave;
+    bool dirty;
+    Preferences prefs;
+
+    // ========================= HÀM NỘI BỘ =========================
+    static uint8_t linearBin(float value, float min, float step, uint8_t bins);
+    static uint8_t cRateBin(float cRate);
+    void save();
+
+public:
+    explicit BMSUsage(float nominalCapacity_Ah);
+    void begin();
+
+    // Gọi ở mỗi chu kỳ đo (100 ms)
+    void update(const float cells[4], float current_A, float temp_C, float soc);
+
+    const UsageHistograms& getHistograms() const;
+    void reset();
+
+    // HTTP: biên bin + số giây mỗi bin
+    void streamJson(WebServer& server);
+
+    // Debug
+    void printStatus();
+};
+
+#endif // BMS_USAGE_H
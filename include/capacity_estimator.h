@@ -0,0 +1,85 @@
+#ifndef CAPACITY_ESTIMATOR_H
+#define CAPACITY_ESTIMATOR_H
+
+#include <Arduino.h>
+#include "bms_journal.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  CAPACITY ESTIMATOR - dung lượng pack từ ΔAh giữa 2 mốc SOC
+ *  Mốc tin cậy do SOCEstimator báo: đầy (taper / nghỉ ở áp cao),
+ *  đầu gối cạn, OCV khi nghỉ (đo sau 2 giờ hoặc dự đoán từ đường
+ *  hồi áp), mỗi mốc kèm 1σ SOC.
+ *
+ *  Mô hình: ΔAh = C · ΔSOC/100 → RLS vô hướng có trọng số:
+ *    x = ΔSOC/100, y = ΔAh (đếm từ mốc trước)
+ *    σe² = σy² + C²·σx²
+ *      σy: offset cảm biến dòng × thời gian + sai số hệ số × Ah qua
+ *      σx: √(σ1² + σ2²) của 2 mốc
+ *    P ← P/λ (quên dần, λ = 0.98 mỗi lần cập nhật)
+ *    K = P·x / (x²·P + σe²),  C += K·(y - x·C),  P = (1 - K·x)·P
+ *  Loại dữ liệu kém theo hiệp phương sai:
+ *    - Cặp mốc tự nó cho σC = σe/|x| > CAP_MAX_PAIR_SIGMA → bỏ
+ *      (ΔSOC quá nhỏ so với độ bất định của mốc)
+ *    - Sai lệch (y - x·C)² > 9·(x²·P + σe²) → bỏ (ngoại lai)
+ *  Hai mốc gần nhau (|ΔAh| nhỏ) coi là cùng 1 điểm: giữ mốc có σ
+ *  nhỏ hơn làm gốc cho cặp sau.
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const float CAP_FORGET = 0.98f;
+const float CAP_PRIOR_SIGMA = 0.20f;        // σ ban đầu = 20 % danh định
+const float CAP_OFFSET_A = 0.03f;           // offset cảm biến dòng
+const float CAP_GAIN_ERROR = 0.01f;         // sai số hệ số 1 %
+const float CAP_MAX_PAIR_SIGMA = 0.10f;     // 10 % danh định
+const float CAP_SAME_POINT = 0.05f;         // |ΔAh| < 5 % danh định → cùng điểm
+const float CAP_CONVERGED_SIGMA = 0.03f;    // σ < 3 % danh định → dùng cho SOC/SOH
+
+class CapacityEstimator {
+private:
+    float nominal_Ah;
+    float capacity_Ah;
+    float variance;             // Ah²
+    uint16_t updates;
+    uint16_t rejected;
+
+    // Mốc trước
+    bool hasAnchor;
+    float anchorSOC;
+    float anchorSigma;
+    double anchorNetAh;
+    double anchorThroughputAh;
+    unsigned long anchorTime;
+
+    // Lần xử lý gần nhất (debug)
+    float lastPairAh;
+    float lastPairSigma;
+    const char* lastResult;
+
+    BMSJournal* journal;
+
+public:
+    explicit CapacityEstimator(float nominal_capacity_Ah);
+
+    // Nạp ước lượng đã lưu; gọi sau journal.begin()
+    void begin(BMSJournal& store);
+
+    // Mốc SOC tin cậy: soc_pct ± sigma_pct tại bộ đếm netAh (sạc - xả, Ah)
+    // và throughputAh (sạc + xả, Ah) tính từ lúc khởi động.
+    // Trả về true nếu dung lượng được cập nhật.
+    bool addAnchor(float soc_pct, float sigma_pct, double netAh, double throughputAh);
+    // Mất liên tục bộ đếm (reset SOC thủ công...) → bỏ mốc trước
+    void clearAnchor();
+    void reset();
+
+    float getCapacityAh() const;
+    float getSigmaAh() const;
+    uint16_t getUpdates() const;
+    uint16_t getRejected() const;
+    // Đủ tin cậy để thay dung lượng danh định
+    bool isConverged() const;
+
+    void printStatus();
+};
+
+#endif // CAPACITY_ESTIMATOR_H
@@ -0,0 +1,100 @@
+#ifndef OCV_RELAX_H
+#define OCV_RELAX_H
+
+#include <stdint.h>
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  OCV RELAX - dự đoán OCV cuối từ đường hồi áp khi nghỉ
+ *  Không phụ thuộc Arduino (chạy cả trên host).
+ * ═══════════════════════════════════════════════════════════
+ *
+ *  Sau khi dòng về 0, điện áp hồi dần về OCV:
+ *    V(t) = V∞ + A·exp(-t / τ)        (A < 0 sau xả, > 0 sau sạc)
+ *
+ *  Với τ cố định mô hình tuyến tính theo [1, exp(-t/τ)] → bình
+ *  phương tối thiểu chỉ cần các tổng chạy. Giữ tổng cho một dãy
+ *  τ cách đều theo log (60 s … ~1900 s), mỗi mẫu O(OCV_RELAX_TAUS),
+ *  không lưu mẫu. Khi fit: chọn τ có tổng bình phương sai số nhỏ
+ *  nhất, V∞ = hệ số chặn.
+ *
+ *  Độ tin cậy (sigmaV):
+ *    - Sai số chuẩn của V∞ theo phần dư của τ tốt nhất
+ *    - Cộng độ phân tán V∞ giữa các τ fit gần tốt như nhau (pin
+ *      thật có nhiều hằng số thời gian → 1 hàm mũ không đủ)
+ *    - Cộng độ dốc đo được ở cuối × OCV_RELAX_HIDDEN_TAU_S: thành
+ *      phần chậm hơn thời gian đã nghỉ không tách được khỏi V∞, chỉ
+ *      lộ ra qua độ dốc còn lại (trung bình khối 3 phút, 4 khối:
+ *      khối ngắn thì nhiễu ADC làm độ dốc ≈ 0 dù đường còn hồi).
+ *      Đuôi τ 3000–8000 s: 2 × τ lớn nhất thì 2σ chỉ phủ ~85 %,
+ *      3 × τ lớn nhất phủ ~96 %
+ *    - τ tốt nhất chạm biên dãy hoặc chưa quan sát đủ 2τ → không
+ *      hợp lệ, trừ khi cả phần còn phải hồi theo fit lẫn phần ẩn
+ *      theo độ dốc đo được đều nhỏ
+ *  Mẫu đầu (OCV_RELAX_SKIP_S) bỏ qua: phân cực nhanh vài giây.
+ *  Kiểm tra trên host: tools/ocv_relax_sim.cpp
+ */
+
+const uint8_t OCV_RELAX_TAUS = 11;          // τ = 60·√2^k, k = 0..10
+const float OCV_RELAX_TAU_MIN = 60.0f;
+const float OCV_RELAX_SKIP_S = 30.0f;       // bỏ phần hồi nhanh
+const float OCV_RELAX_SAMPLE_S = 5.0f;      // 1 mẫu / 5 s
+const uint16_t OCV_RELAX_MIN_SAMPLES = 24;  // ≥ 2 phút dữ liệu
+const float OCV_RELAX_SSE_BAND = 1.5f;      // τ có SSE ≤ 1.5 × tốt nhất coi là "gần tốt như nhau"
+const float OCV_RELAX_NOISE_V = 0.001f;     // sàn nhiễu mỗi mẫu (V), tránh SSE ≈ 0
+const float OCV_RELAX_EDGE_V = 0.002f;      // τ chạm biên vẫn chấp nhận nếu còn phải hồi + phần ẩn < 2 mV
+const float OCV_RELAX_MIN_TAUS = 2.0f;      // cần quan sát ≥ 2τ của τ tốt nhất
+const float OCV_RELAX_HIDDEN_TAU_S = 5760.0f; // τ giả định của thành phần chậm chưa thấy (3 × τ lớn nhất)
+const uint8_t OCV_RELAX_BLOCK_SAMPLES = 36; // 1 khối = 3 phút
+const uint8_t OCV_RELAX_BLOCKS = 4;         // độ dốc cuối: khối mới nhất - cũ nhất
+
+struct OCVRelaxFit {
+    bool valid;
+    float ocv_V;          // V∞ dự đoán
+    float sigma_V;        // 1σ của V∞
+    float tau_s;          // τ tốt nhất
+    float remaining_V;    // còn phải hồi từ mẫu cuối đến V∞
+    float rms_V;          // RMS phần dư
+    float slope_mVps;     // độ dốc đo được ở cuối (mV/s)
+    uint16_t samples;
+};
+
+class OCVRelaxation {
+private:
+    // Tổng chung
+    double n, sumV, sumVV;
+    // Tổng theo từng τ: e = exp(-t/τ)
+    double sumE[OCV_RELAX_TAUS];
+    double sumEE[OCV_RELAX_TAUS];
+    double sumEV[OCV_RELAX_TAUS];
+
+    // Trung bình khối cho độ dốc cuối (vòng)
+    float blockMean[OCV_RELAX_BLOCKS];
+    float blockTime[OCV_RELAX_BLOCKS];
+    uint8_t blockHead;
+    uint8_t blockCount;
+    double blockSum;
+    double blockTimeSum;
+    uint8_t blockSamples;
+
+    float nextSample_s;
+    float lastSample_s;
+    float lastVoltage;
+
+    static float tauAt(uint8_t k);
+    bool endSlope(float& slope) const;
+
+public:
+    OCVRelaxation();
+
+    // Bắt đầu đợt nghỉ mới (xoá các tổng)
+    void start();
+    // t_s = thời gian từ lúc bắt đầu nghỉ; gọi tuỳ ý, tự lấy mẫu mỗi OCV_RELAX_SAMPLE_S
+    void addSample(float t_s, float voltage);
+    // Fit với dữ liệu hiện có; false nếu chưa đủ mẫu hoặc không đáng tin
+    bool fit(OCVRelaxFit& out) const;
+
+    uint16_t getSamples() const;
+};
+
+#endif // OCV_RELAX_H
@@ -0,0 +1,67 @@
+#ifndef RAINFLOW_H
+#define RAINFLOW_H
+
+#include <stdint.h>
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  RAINFLOW - đếm chu kỳ rainflow dạng streaming trên tín hiệu SOC
+ *  1. Phát hiện điểm đảo chiều có trễ: đỉnh/đáy chỉ được xác nhận
+ *     khi tín hiệu quay lại ≥ hysteresis (lọc nhiễu SOC)
+ *  2. Thuật toán 4 điểm trên ngăn xếp điểm đảo chiều (residue):
+ *       a, b, c, d = 4 điểm cuối, X = |c - b|
+ *       |b - a| ≥ X và |d - c| ≥ X → 1 chu kỳ biên độ X, bỏ b và c
+ *     lặp đến khi không còn chu kỳ đóng
+ *  3. Residue giới hạn RAINFLOW_STACK điểm, kể cả đỉnh/đáy đang
+ *     chờ xác nhận (lưu qua reset không mất điểm nào): tràn → điểm
+ *     cũ nhất thành nửa chu kỳ (count = 0.5)
+ *  Mỗi điểm mang nhiệt độ trung bình của đoạn dẫn tới nó; nhiệt độ
+ *  chu kỳ = trung bình 2 đoạn b→c và c→d.
+ *  Không phụ thuộc Arduino; kiểm tra trên host: tools/rainflow_check.cpp
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const uint8_t RAINFLOW_STACK = 24;
+const uint8_t RAINFLOW_MAX_OUT = RAINFLOW_STACK / 2 + 1;   // chu kỳ tối đa mỗi mẫu
+
+struct RainflowPoint {
+    float value;
+    float temp;                 // nhiệt độ trung bình đoạn dẫn tới điểm này
+};
+
+struct RainflowCycle {
+    float range;                // biên độ đỉnh-đáy (cùng đơn vị tín hiệu)
+    float mean;
+    float temp;
+    float count;                // 1 = chu kỳ đầy, 0.5 = nửa chu kỳ
+};
+
+class RainflowCounter {
+private:
+    RainflowPoint stack[RAINFLOW_STACK];
+    uint8_t depth;
+
+    float hysteresis;
+    int8_t direction;           // +1 đang tăng, -1 đang giảm, 0 chưa rõ
+    float candidate;            // đỉnh/đáy đang chờ xác nhận
+    float tempSum;              // tích luỹ nhiệt độ từ điểm đảo chiều trước
+    uint16_t tempCount;
+
+    // ========================= HÀM NỘI BỘ =========================
+    uint8_t push(float value, RainflowCycle out[RAINFLOW_MAX_OUT]);
+
+public:
+    explicit RainflowCounter(float hysteresis);
+
+    // Thêm 1 mẫu; trả về số chu kỳ vừa đóng (ghi vào out)
+    uint8_t addSample(float value, float temp, RainflowCycle out[RAINFLOW_MAX_OUT]);
+
+    // Residue (các điểm đảo chiều chưa thành chu kỳ), để lưu qua reset
+    uint8_t getResidueCount() const;
+    RainflowPoint getResidue(uint8_t index) const;
+    // Nạp residue đã lưu; điểm cuối thành đỉnh/đáy đang chờ xác nhận
+    void restore(const RainflowPoint* points, uint8_t count);
+    void clear();
+};
+
+#endif // RAINFLOW_H
@@ -0,0 +1,84 @@
+#ifndef SOC_CELLS_H
+#define SOC_CELLS_H
+
+#include <Arduino.h>
+#include "bms_journal.h"
+#include "soc_cells_kf.h"
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  SOC CELLS - ước lượng SOC và dung lượng từng cell
+ *  Trạng thái dạng structure-of-arrays (mỗi đại lượng 1 mảng
+ *  SOC_CELLS phần tử), cập nhật trong 1 vòng lặp ở mỗi chu kỳ
+ *  đo 100 ms:
+ *    - Coulomb counting theo dòng của từng cell: dòng pack trừ
+ *      dòng điện trở xả cân bằng khi cell đó đang được xả
+ *    - Lọc Kalman vô hướng: điện áp cell so với OCV(SOC, T) + R·I
+ *      (R từng cell theo BMSResistance, mặc định CELL_R0_OHM),
+ *      nhiễu đo tăng theo dòng (phân cực không mô hình hoá);
+ *      phần tính toán ở soc_cells_kf.h (kiểm tra trên host)
+ *    - Dung lượng: ΔAh giữa 2 mốc OCV khi nghỉ ≥ 30 phút, SOC
+ *      lệch ≥ 40 % → lọc mũ, lưu journal
+ *  SOC pack = Ah xả được (cell yếu nhất) / (Ah xả được + Ah còn
+ *  sạc được (cell đầy nhất)).
+ * ═══════════════════════════════════════════════════════════
+ */
+
+const float CELL_REST_CURRENT = 0.05f;
+const unsigned long CELL_REST_MS = 1800000;     // nghỉ 30 phút → mốc OCV
+const float CELL_CAP_MIN_SWING = 40.0f;         // % giữa 2 mốc để tính dung lượng
+const float CELL_CAP_GAIN = 0.2f;
+
+class SOCCells {
+private:
+    // ========================= TRẠNG THÁI (SoA) =========================
+    float soc[SOC_CELLS];               // %
+    float var[SOC_CELLS];               // %²
+    float capacity_mAh[SOC_CELLS];
+    float throughput_mAh[SOC_CELLS];    // điện lượng qua cell từ mốc trước (có dấu)
+    float anchorSoc[SOC_CELLS];         // SOC theo OCV ở mốc trước, NAN = chưa có
+    float r0[SOC_CELLS];                // Ω, ở nhiệt độ hiện tại
+
+    float nominal_mAh;
+    unsigned long lastUpdate;
+    unsigned long restStart;
+    bool resting;
+    bool anchoredThisRest;
+    bool initialized;
+    uint8_t capacityUpdates;
+
+    BMSJournal* journal;
+
+    // ========================= HÀM NỘI BỘ =========================
+    void anchor(const float cells[SOC_CELLS], float temperature);
+
+public:
+    explicit SOCCells(float capacity_Ah);
+    // Nạp dung lượng từng cell; gọi sau journal.begin()
+    void begin(BMSJournal& store);
+    // Bắt đầu mọi cell từ SOC pack (độ bất định 10 %), lọc tự kéo về theo điện áp
+    void initialize(float packSOC);
+
+    // Gọi ở mỗi chu kỳ đo; bleeding[i] = điện trở xả của cell i bật trong chu kỳ vừa qua
+    void update(const float cells[SOC_CELLS], float current_A, float temperature,
+                const bool bleeding[SOC_CELLS]);
+
+    // Điện trở trong đo được của cell (Ω, đã theo nhiệt độ)
+    void setResistance(uint8_t cell, float ohm);
+
+    bool isInitialized() const;
+    float getSOC(uint8_t cell) const;           // cell 0..SOC_CELLS-1
+    float getSigma(uint8_t cell) const;
+    float getCapacityAh(uint8_t cell) const;
+    float getPackSOC() const;
+    // true khi mọi cell có σ < CELL_CONFIDENT_SIGMA (lọc đã hội tụ)
+    bool isConfident() const;
+    // Điện lượng cần xả của từng cell (mAh) để mọi cell đầy cùng lúc, chỉ phần
+    // vượt 2σ độ bất định (chênh lệch nằm trong nhiễu ước lượng → 0)
+    void getBalanceExcess(float excess_mAh[SOC_CELLS]) const;
+
+    // Debug
+    void printStatus();
+};
+
+#endif // SOC_CELLS_H
@@ -0,0 +1,48 @@
+#ifndef SOC_CELLS_KF_H
+#define SOC_CELLS_KF_H
+
+#include <stdint.h>
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  SOC CELLS KF - phần tính toán của SOCCells
+ *  Không phụ thuộc Arduino: chạy trên firmware (SOCCells, mỗi
+ *  chu kỳ đo 100 ms) và trên máy host (tools/soc_cells_sim.cpp).
+ * ═══════════════════════════════════════════════════════════
+ *
+ *  Mỗi cell một bộ lọc Kalman vô hướng trên SOC (%), mảng SoA:
+ *    dòng cell = dòng pack - V/R_bleed khi cell đang được xả
+ *    predict:  SOC += I·dt / C,   P += q·dt
+ *    update:   V = OCV(SOC, T) + R0·I,   H = dOCV/dSOC
+ *  Nhiễu đo tăng theo |I| (phân cực không mô hình hoá) và nhân
+ *  theo số mẫu trong khoảng tương quan của sai số OCV.
+ *
+ *  Điện lượng thừa cho cân bằng chỉ tính phần vượt 2σ của hiệu
+ *  2 cell: excess - 2·√(σi²·Ci² + σj²·Cj²)/100, âm → 0.
+ */
+
+const uint8_t SOC_CELLS = 4;
+
+const float CELL_BLEED_OHM = 47.0f;             // điện trở xả cân bằng
+const float CELL_R0_OHM = 0.015f;               // điện trở trong mặc định mỗi cell
+const float CELL_SOC_DRIFT = 4.0f;              // σ trôi SOC (%/√h)
+const float CELL_VOLT_NOISE = 0.03f;            // σ sai số OCV + đo (V)
+const float CELL_LOAD_NOISE = 0.01f;            // σ thêm theo dòng (V/A)
+const float CELL_VOLT_CORR_S = 600.0f;          // sai số OCV tương quan trong khoảng này
+const float CELL_EXCESS_SIGMAS = 2.0f;          // excess phải vượt bao nhiêu σ mới tính
+const float CELL_CONFIDENT_SIGMA = 5.0f;        // % - mọi cell dưới mức này → cân bằng theo điện lượng;
+                                                // độ tin của từng hiệu do CELL_EXCESS_SIGMAS lo
+
+// 1 bước predict + update cho mọi cell. bleeding[i] = điện trở xả của cell i
+// bật trong bước vừa qua. charge_mAh[i] = điện lượng qua cell (có dấu).
+void socCellsStep(float soc[SOC_CELLS], float var[SOC_CELLS],
+                  const float capacity_mAh[SOC_CELLS], const float r0[SOC_CELLS],
+                  const float cells[SOC_CELLS], float current_A, float temperature,
+                  const bool bleeding[SOC_CELLS], float dt_s, float charge_mAh[SOC_CELLS]);
+
+// Điện lượng cần xả của từng cell (mAh) để mọi cell đầy cùng lúc, đã trừ
+// CELL_EXCESS_SIGMAS lần độ bất định của hiệu SOC so với cell còn trống nhất
+void socCellsBalanceExcess(const float soc[SOC_CELLS], const float var[SOC_CELLS],
+                           const float capacity_mAh[SOC_CELLS], float excess_mAh[SOC_CELLS]);
+
+#endif // SOC_CELLS_KF_H
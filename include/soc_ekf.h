@@ -0,0 +1,71 @@
+#ifndef SOC_EKF_H
+#define SOC_EKF_H
+
+#include <stdint.h>
+
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  SOC EKF - bộ lọc Kalman mở rộng trên mô hình Thevenin 1RC
+ *  Không phụ thuộc Arduino: chạy trên firmware (mỗi chu kỳ đo
+ *  100 ms) và trên máy host (tools/soc_ekf_sim.cpp).
+ * ═══════════════════════════════════════════════════════════
+ *
+ *  Mô hình (pack 4S, I > 0 = sạc):
+ *    V = OCV(SOC, T) + V1 + R0·I      (OCV: mặt SOC × nhiệt độ, bms_ocv.h)
+ *    SOC[k+1] = SOC[k] + I·dt / (3600·C)
+ *    V1[k+1]  = a·V1[k] + R1·(1 - a)·I,   a = exp(-dt / τ)
+ *
+ *  Trạng thái x = [SOC (0..1), V1 (V)], hiệp phương sai P 2×2
+ *  đối xứng lưu 3 phần tử (p00, p01, p11). F = diag(1, a),
+ *  H = [dOCV/dSOC, 1] → predict/update viết tay, không cấp phát.
+ *
+ *  Đoạn OCV phẳng của LiFePO4 (30–90 %) có độ dốc nhỏ → điện áp
+ *  ít thông tin, P00 tăng dần theo nhiễu dòng; ở hai đầu đường
+ *  cong độ dốc lớn → bộ lọc kéo SOC về nhanh.
+ */
+
+struct SOCEkfParams {
+    float capacity_Ah;
+    float r0_ohm;            // điện trở tức thời của pack (25 °C)
+    float r1_ohm;            // nhánh RC
+    float tau_s;             // R1·C1
+    float socDrift_pct;      // σ trôi SOC do offset dòng / sai dung lượng (%/√h)
+    float rcNoise_V;         // σ nhiễu quá trình V1 (V/√s)
+    float voltageNoise_V;    // σ sai số mô hình OCV + đo điện áp (V)
+    float voltageCorr_s;     // sai số OCV tương quan trong khoảng này → không coi
+                             // mỗi mẫu 100 ms là 1 phép đo độc lập
+};
+
+class SOCEkf {
+private:
+    SOCEkfParams params;
+
+    // ========================= TRẠNG THÁI =========================
+    float x0;                // SOC 0..1
+    float x1;                // điện áp nhánh RC (V)
+    float p00, p01, p11;     // hiệp phương sai
+
+    float lastInnovation;    // V đo - V dự đoán (V)
+
+public:
+    explicit SOCEkf(float capacity_Ah);
+
+    void setParams(const SOCEkfParams& p);
+    const SOCEkfParams& getParams() const;
+
+    // Đặt lại SOC (%) với độ bất định 1σ (%); V1 = 0
+    void reset(float soc_pct, float sigma_pct);
+
+    // 1 bước predict + update; dt_s = thời gian từ lần gọi trước
+    void step(float packVoltage, float current_A, float temperature, float dt_s);
+
+    float getSOC() const;             // %
+    float getUncertainty() const;     // 1σ, %
+    float getRCVoltage() const;       // V1 (V)
+    float getInnovation() const;      // V
+
+    // OCV pack (V) theo SOC 0..1 và nhiệt độ; slope = dOCV/dSOC (V / đơn vị SOC)
+    static float ocv(float soc, float temperature, float* slope);
+};
+
+#endif // SOC_EKF_H
@@ -2,12 +2,26 @@
 #define SOC_ESTIMATOR_H
 
 #include <Arduino.h>
+#include "bms_journal.h"
+#include "soc_ekf.h"
+#include "soc_cells.h"
+#include "bms_ocv.h"
+#include "ocv_relax.h"
+#include "capacity_estimator.h"
+
+// Nguồn SOC xuất ra: coulomb counting + OCV (mặc định), EKF mô hình 1RC
+// hoặc từ SOC từng cell (cell yếu nhất / đầy nhất)
+enum SOCMode : uint8_t {
+    SOC_MODE_COULOMB = 0,
+    SOC_MODE_EKF = 1,
+    SOC_MODE_CELLS = 2
+};
 
 class SOCEstimator {
 private:
     // Thông số pin
-    const float CAPACITY_AH;
-    const float CAPACITY_MAH;
+    const float CAPACITY_AH;                    // danh định
+    float capacity_mAh;                         // dùng cho coulomb counting, theo CapacityEstimator
     
     // Ngưỡng hiệu chỉnh
     const float V_FULL = 14.5f;
@@ -19,54 +33,125 @@ private:
     const float I_IDLE_THRESHOLD = 0.05f;
     const float ALPHA = 0.85f;
     
-    // Bảng OCV cho LiFePO4 4S
-    const float OCV_TABLE[11][2] = {
-        {0,   10.0},
-        {10,  12.0},
-        {20,  12.5},
-        {30,  12.8},
-        {40,  12.9},
-        {50,  13.0},
-        {60,  13.1},
-        {70,  13.2},
-        {80,  13.3},
-        {90,  13.4},
-        {100, 13.6}
-    };
-    
-    // Bảng bù nhiệt độ
-    const float TEMP_COMP_TABLE[5][2] = {
-        {-20, 0.40},
-        {-10, 0.60},
-        {0,   0.85},
-        {25,  1.00},
-        {60,  0.98}
-    };
+    // Mốc đầy: pha CV, điện áp đứng yên và dòng sạc giảm dưới ngưỡng đuôi
+    const float V_CV_MIN = 14.2f;                       // pack đã vào pha áp không đổi
+    const float V_PLATEAU_BAND = 0.03f;                 // dao động cho phép của điện áp pha CV
+    const unsigned long PLATEAU_MIN_MS = 60000;
+    const float TAIL_C_RATE = 0.05f;                    // dòng đuôi C/20
+    const unsigned long TAPER_DEBOUNCE_MS = 30000;
+    // Mốc cạn: cell thấp nhất (bù R·I) xuống tới đầu gối đường OCV
+    const float KNEE_CELL_V = 3.00f;                    // ~10 % ở 25 °C, trên ngưỡng UV cảnh báo/ngắt
+    const unsigned long KNEE_DEBOUNCE_MS = 10000;
+    
+    // Dự đoán OCV khi nghỉ (đồng bộ sớm thay vì chờ 2 giờ)
+    const unsigned long RELAX_MIN_REST_MS = 600000;     // fit sớm nhất sau 10 phút nghỉ
+    const unsigned long RELAX_FIT_INTERVAL_MS = 60000;
+    const float RELAX_MAX_SIGMA = 3.0f;                 // % - σ SOC dự đoán lớn hơn → không dùng
     
     // Biến trạng thái
     float soc;
     float coulombCounter_mAh;
     unsigned long lastUpdateTime;
     bool initialized;
+    float temperature;                          // °C gần nhất, cho tra bảng OCV
     
     unsigned long idleStartTime;
     bool isIdle;
     bool chargedFullThisCycle;
     
+    // Tổng điện lượng vào/ra (không bị reset khi hiệu chỉnh)
+    double chargeIn_mAh;
+    double chargeOut_mAh;
+    
+    // Warm restart
+    const float WARM_TOL_LOAD = 30.0f;          // % - đang có tải, OCV không tin được
+    const float WARM_TOL_UNRELAXED = 25.0f;     // % - reset ngắn, pin chưa hồi áp
+    const float WARM_TOL_REST = 15.0f;          // % - pin đã nghỉ
+    const uint32_t WARM_RELAX_S = 1800;
+    const uint32_t WARM_STALE_S = 30UL * 86400UL;
+    const float SELF_DISCHARGE_PER_DAY = 0.1f;  // %/ngày (~3%/tháng)
+    
+    BMSJournal* journal;
+    const char* startSource;                    // "rtc", "journal" hoặc "ocv"
+    
+    // EKF chạy song song ở mỗi chu kỳ đo, mode chọn giá trị xuất ra
+    SOCEkf ekf;
+    SOCMode mode;
+    unsigned long lastModelTime;
+    float restoredEkfSOC;                       // NAN = không có, khởi tạo EKF theo soc
+    const SOCCells* cells;
+    CapacityEstimator* capacityEst;
+    
+    // 1σ (%) của các mốc báo cho CapacityEstimator
+    const float ANCHOR_SIGMA_FULL = 1.0f;
+    const float ANCHOR_SIGMA_KNEE = 2.0f;
+    const float OCV_REST_SIGMA_V = 0.010f;      // sai số OCV pack sau 2 giờ nghỉ
+    
+    OCVRelaxation relax;
+    OCVRelaxFit relaxFit;
+    float relaxSOC;                             // SOC theo V∞ dự đoán, NAN = chưa có
+    float relaxSigma;                           // 1σ (%) của relaxSOC
+    unsigned long lastRelaxFit;
+    float relaxWeight;                          // mức kéo đã dùng trong đợt nghỉ này (0..1)
+    
+    // Trạng thái mốc đầy/cạn; mỗi lần sạc/xả chỉ neo 1 lần
+    float plateauRef;
+    unsigned long plateauStart;
+    unsigned long taperStart;                   // 0 = chưa thoả điều kiện
+    unsigned long kneeStart;
+    bool fullAnchored;
+    bool emptyAnchored;
+    uint16_t fullAnchors;
+    uint16_t emptyAnchors;
+    
     // Hàm nội bộ
-    float ocvToSOC(float voltage);
-    float getTempCoeff(float temp);
-    void autoRecalibrate(float voltage, float current);
+    float ocvToSOC(float voltage) const;
+    void autoRecalibrate(float voltage, float current, float minCellOcv);
+    void anchorFull(float voltage, float current);
+    void anchorEmpty(float minCellOcv, float current);
+    void relaxationSync(unsigned long idleDuration);
+    // Báo mốc SOC tin cậy; áp dụng dung lượng mới nếu đã hội tụ
+    void reportAnchor(float anchorSOC, float sigma);
+    void applyCapacity(float capacity_Ah);
+    bool restoreState(float packVoltage, float current_A);
+    void saveState(bool immediate);
 
 public:
     SOCEstimator(float capacity_ah);
     
-    void initializeFromVoltage(float packVoltage);
+    // Khai báo khoá journal; gọi sau journal.begin()
+    void begin(BMSJournal& store);
+    // Khôi phục trạng thái đã lưu nếu hợp lệ, nếu không thì theo OCV
+    void initializeFromVoltage(float packVoltage, float current_A = 0.0f);
     void update(float current_A, float temperature);
-    void recalibrate(float packVoltage, float current_A);
+    // EKF: gọi ở mỗi chu kỳ đo (100 ms)
+    void updateModel(float packVoltage, float current_A, float temperature);
+    // minCellOcv = điện áp cell thấp nhất đã bù sụt áp R·I (mốc cạn); NAN = bỏ qua mốc cạn
+    void recalibrate(float packVoltage, float current_A, float minCellOcv = NAN);
     void reset(float newSOC);
     
     float getSOC() const;
+    float getCoulombSOC() const;
+    float getEkfSOC() const;
+    // Điện áp nhánh RC của pack theo EKF (V), cho dự báo công suất
+    float getRCVoltage() const;
+    // 1σ (%) của EKF
+    float getUncertainty() const;
+    // SOC theo OCV dự đoán khi nghỉ (NAN nếu chưa fit được) và 1σ (%)
+    float getRelaxSOC() const;
+    float getRelaxSigma() const;
+    
+    // Nguồn cho SOC_MODE_CELLS
+    void attachCells(const SOCCells& cellEstimator);
+    // Nhận mốc SOC và trả dung lượng ước lượng cho coulomb counting/EKF
+    void attachCapacity(CapacityEstimator& estimator);
+    float getCapacityAh() const;
+    void setMode(SOCMode newMode);
+    SOCMode getMode() const;
+    const char* getModeName() const;
+    const char* getStartSource() const;
+    double getChargeInAh() const;
+    double getChargeOutAh() const;
     
     void printDebug(float packVoltage, float current_A, float temperature);
 };
@@ -3,6 +3,22 @@
 
 #include <Arduino.h>
 #include <Preferences.h>
+#include "bms_journal.h"
+#include "rainflow.h"
+
+// Biểu đồ độ sâu chu kỳ rainflow (% SOC): [0,5) [5,10) [10,20) ... [80,100]
+const uint8_t SOH_DEPTH_BINS = 7;
+const float SOH_DEPTH_EDGES[SOH_DEPTH_BINS] = { 0.0f, 5.0f, 10.0f, 20.0f, 40.0f, 60.0f, 80.0f };
+
+// Lưu NVS dạng blob: số nửa chu kỳ theo độ sâu + residue rainflow
+// (SOC 0.5 %/đơn vị, nhiệt độ °C) → chu kỳ dài qua reset vẫn được đếm
+struct RainflowStore {
+    uint32_t magic;
+    uint32_t halfCycles[SOH_DEPTH_BINS];
+    uint8_t residueCount;
+    uint8_t residueSOC[RAINFLOW_STACK];
+    int8_t residueTemp[RAINFLOW_STACK];
+};
 
 class SOHEstimator {
 private:
@@ -13,12 +29,37 @@ private:
     
     // Hệ số tính toán
     const float CYCLE_AGING_LINEAR = 0.01f;
+    const float CYCLE_MODEL_SIGMA = 5.0f;       // % SOH - độ tin của mô hình theo chu kỳ
+    // Tổn thương 1 chu kỳ (đơn vị: chu kỳ 100 % ở 25 °C):
+    //   (DoD/100)^k · exp(Ea/R · (1/298 - 1/T)), chỉ tăng tốc khi T > 25 °C
+    const float CYCLE_DOD_EXPONENT = 1.3f;      // LFP: 1.1 - 1.5
+    const float CYCLE_EA_OVER_R = 3800.0f;      // K (Ea ≈ 31.5 kJ/mol)
+    const float RAINFLOW_HYSTERESIS = 1.0f;     // % SOC
+    // Lão hoá lịch (calendar): mất dung lượng L = k·√t (t: ngày),
+    //   k = k25 · exp(Ea/R · (1/298 - 1/T)) · (0.5 + SOC/100)
+    // Cập nhật tăng dần: L² += k²·dt (đúng với √t khi k đổi theo thời gian)
+    const float CALENDAR_K25 = 0.105f;          // %/√ngày ở 25 °C, SOC 50 % (~2 %/√năm)
+    const float CALENDAR_EA_OVER_R = 6000.0f;   // K (Ea ≈ 50 kJ/mol)
+    // Dự báo tuổi thọ: trung bình mũ điều kiện gần đây, hằng số thời gian 30 ngày
+    const float LIFE_AVG_DAYS = 30.0f;
+    const float CYCLE_RATE_PRIOR = 1.0f;        // chu kỳ 100 %/ngày trước khi có số liệu
+    const unsigned long RAINFLOW_SAVE_INTERVAL = 600000;
     
     // Biến trạng thái
     float soh;
-    float totalCycles;
+    float totalCycles;                          // theo Ah qua (|ΔSOC| cộng dồn / 100)
+    float damageCycles;                         // rainflow, đã nhân trọng số độ sâu + nhiệt độ
     float equivalentFullCycles;
     float currentCapacity_Ah;
+    float sohCycle;                             // theo mô hình chu kỳ + lịch
+    float measuredCapacity_Ah;                  // từ CapacityEstimator, NAN = chưa có
+    float measuredSigma_Ah;
+    float sohPower;                             // theo điện trở trong (BMSResistance)
+    double calendarLoss;                        // % dung lượng mất do lão hoá lịch
+    float calendarK2;                           // k² (%²/ngày), trung bình mũ
+    float cycleRate;                            // % mất do chu kỳ mỗi ngày, trung bình mũ
+    float remainingDays;
+    unsigned long lastAgingUpdate;
     
     // Theo dõi chu kỳ
     float lastSOC;
@@ -26,7 +67,15 @@ private:
     bool chargingCycle;
     bool dischargingCycle;
     
-    // Persistent storage
+    // Rainflow
+    RainflowCounter rainflow;
+    uint32_t depthHalfCycles[SOH_DEPTH_BINS];
+    bool rainflowDirty;
+    unsigned long lastRainflowSave;
+    
+    // Persistent storage: journal (ghi nền); NVS chỉ dùng để chuyển
+    // dữ liệu cũ sang journal hoặc khi không có partition journal
+    BMSJournal* journal;
     Preferences prefs;
     const char* NAMESPACE = "soh_data";
     unsigned long lastSaveTime;
@@ -34,27 +83,48 @@ private:
     
     // Hàm nội bộ
     float calculateSOHFromCycles(float cycles);
-    void detectCycle(float currentSOC);
+    void detectCycle(float currentSOC, float temperature);
+    float cycleDamage(float depth, float temperature) const;
+    void updateAging(float currentSOC, float temperature, float cycleLossDelta);
+    float projectRemainingDays() const;
+    void countCycle(const RainflowCycle& cycle);
+    void saveRainflow();
+    void loadRainflow();
+    void clearRainflow();
+    void saveState(bool immediate);
     void saveToFlash();
     void loadFromFlash();
 
 public:
     SOHEstimator(float nominal_capacity_ah);
     
-    void begin();
+    void begin(BMSJournal& store);
     void update(float currentSOC, float temperature);
     
     // Hiệu chỉnh thủ công
     void resetCycles();
     void resetSOH();
     void calibrateFromCapacity(float measured_capacity_Ah);
+    // Dung lượng đo online (±1σ): SOH = trung bình theo nghịch đảo phương sai
+    // giữa mô hình chu kỳ và dung lượng đo
+    void setMeasuredCapacity(float capacity_Ah, float sigma_Ah);
+    // SOH công suất (suy giảm do điện trở trong tăng), tách khỏi SOH dung lượng
+    void setPowerFade(float soh_power);
     
     // Getters
     float getSOH() const;
+    float getPowerSOH() const;
     float getTotalCycles() const;
+    float getDamageCycles() const;
+    // Số chu kỳ đầy (nửa chu kỳ = 0.5) trong bin độ sâu SOH_DEPTH_EDGES[bin]
+    float getDepthCycles(uint8_t bin) const;
     float getEquivalentCycles() const;
     float getCurrentCapacity() const;
     float getRemainingCycles() const;
+    // Số ngày đến EOL theo điều kiện trung bình gần đây (lịch + chu kỳ)
+    float getRemainingDays() const;
+    float getCalendarLoss() const;              // %
+    float getCycleLoss() const;                 // %
     
     // Debug
     void printDebug();
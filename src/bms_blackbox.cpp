@@ -0,0 +1,320 @@
+#include "bms_blackbox.h"
+#include "bms_log_format.h"
+#include <ArduinoJson.h>
+
+#define BLACKBOX_MAGIC  0x58424242UL   // "BBBX"
+
+// Bản ghi đang dùng nằm trong RTC slow memory: không bị xoá khi
+// reset mềm, panic hay watchdog (mất nguồn thì kiểm tra CRC sẽ loại)
+RTC_NOINIT_ATTR static BlackBoxRecord rtcRecord;
+
+static int16_t toInt16(float value, float scale) {
+    float v = value * scale;
+    if (v > 32767.0f) return 32767;
+    if (v < -32768.0f) return -32768;
+    return (int16_t)lroundf(v);
+}
+
+static uint16_t toUInt16(float value, float scale) {
+    float v = value * scale;
+    if (v > 65535.0f) return 65535;
+    if (v < 0.0f) return 0;
+    return (uint16_t)lroundf(v);
+}
+
+// ========================= CONSTRUCTOR =========================
+BMSBlackBox::BMSBlackBox() {
+    ringHead = 0;
+    ringCount = 0;
+    nextId = 0;
+    bootCount = 0;
+}
+
+void BMSBlackBox::begin(uint16_t boot) {
+    bootCount = boot;
+
+    prefs.begin("bms_bbox", true);
+    nextId = prefs.getUInt("next", 0);
+    prefs.end();
+
+    // Sự kiện bị reset cắt ngang (hoặc chưa kịp chép sang NVS)
+    if (isValid(rtcRecord) && rtcRecord.state != BB_SAVED && rtcRecord.id >= nextId) {
+        Serial.printf("Black-box: recovered event #%lu (%s) from RTC memory, %u samples\n",
+                      (unsigned long)rtcRecord.id,
+                      BMSProtection::getTypeName((ProtectionType)rtcRecord.cause),
+                      rtcRecord.count);
+        persist();
+    } else if (!isValid(rtcRecord)) {
+        rtcRecord.magic = 0;
+    }
+
+    Serial.printf("Black-box initialized: %u/%u events stored, %ums pre + %ums post\n",
+                  getStoredCount(), BLACKBOX_SLOTS, BLACKBOX_PRE_MS, BLACKBOX_POST_MS);
+}
+
+// ========================= HÀM NỘI BỘ =========================
+void BMSBlackBox::seal(BlackBoxRecord& record) {
+    record.crc = bmsCrc32((const uint8_t*)&record, offsetof(BlackBoxRecord, crc));
+}
+
+bool BMSBlackBox::isValid(const BlackBoxRecord& record) {
+    if (record.magic != BLACKBOX_MAGIC) return false;
+    if (record.count > BLACKBOX_SAMPLES || record.preCount > record.count) return false;
+    if (record.cause >= PROT_COUNT) return false;
+    return record.crc == bmsCrc32((const uint8_t*)&record, offsetof(BlackBoxRecord, crc));
+}
+
+// Chép bản ghi RTC sang NVS (slot = id % BLACKBOX_SLOTS). Chỉ chạy
+// khi có trip - MOSFET đã ngắt, stall ghi flash không ảnh hưởng.
+void BMSBlackBox::persist() {
+    char key[8];
+    snprintf(key, sizeof(key), "ev%u", (unsigned)(rtcRecord.id % BLACKBOX_SLOTS));
+
+    rtcRecord.state = BB_SAVED;
+    seal(rtcRecord);
+
+    prefs.begin("bms_bbox", false);
+    prefs.putBytes(key, &rtcRecord, sizeof(rtcRecord));
+    prefs.putUInt("next", rtcRecord.id + 1);
+    prefs.end();
+
+    nextId = rtcRecord.id + 1;
+}
+
+// ========================= GHI MẪU =========================
+void BMSBlackBox::addSample(const float taps[4], float current, float temp) {
+    BlackBoxSample s;
+    s.time_ms = millis();
+    for (uint8_t i = 0; i < 4; i++) {
+        s.tap_mV[i] = toUInt16(taps[i], 1000.0f);
+    }
+    s.current_mA = toInt16(current, 1000.0f);
+    s.temp_dC = toInt16(temp, 10.0f);
+
+    ring[ringHead] = s;
+    ringHead = (ringHead + 1) % BLACKBOX_PRE_SAMPLES;
+    if (ringCount < BLACKBOX_PRE_SAMPLES) ringCount++;
+
+    if (!isCapturing()) return;
+
+    rtcRecord.samples[rtcRecord.count++] = s;
+    if (rtcRecord.count >= rtcRecord.preCount + BLACKBOX_POST_SAMPLES) {
+        rtcRecord.state = BB_COMPLETE;
+        persist();
+        Serial.printf("Black-box: event #%lu saved\n", (unsigned long)rtcRecord.id);
+    } else {
+        seal(rtcRecord);
+    }
+}
+
+void BMSBlackBox::trigger(ProtectionType cause, float value) {
+    if (cause >= PROT_COUNT) return;
+
+    // Trip kế tiếp trong cửa sổ post-trigger: chỉ đánh dấu
+    if (isCapturing()) {
+        rtcRecord.tripMask |= (1 << cause);
+        seal(rtcRecord);
+        return;
+    }
+
+    rtcRecord.magic = BLACKBOX_MAGIC;
+    rtcRecord.id = nextId;
+    rtcRecord.triggerTime = millis();
+    rtcRecord.triggerValue = value;
+    rtcRecord.boot = bootCount;
+    rtcRecord.cause = cause;
+    rtcRecord.tripMask = (1 << cause);
+    rtcRecord.state = BB_CAPTURING;
+    rtcRecord.reserved = 0;
+
+    // Pre-trigger: cũ nhất → mới nhất (mẫu cuối là chu kỳ gây trip)
+    uint8_t start = (ringHead + BLACKBOX_PRE_SAMPLES - ringCount) % BLACKBOX_PRE_SAMPLES;
+    for (uint8_t i = 0; i < ringCount; i++) {
+        rtcRecord.samples[i] = ring[(start + i) % BLACKBOX_PRE_SAMPLES];
+    }
+    rtcRecord.preCount = ringCount;
+    rtcRecord.count = ringCount;
+    seal(rtcRecord);
+
+    Serial.printf("Black-box: %s trip captured (event #%lu, %u pre-trigger samples)\n",
+                  BMSProtection::getTypeName(cause), (unsigned long)rtcRecord.id, ringCount);
+}
+
+// ========================= TRUY VẤN =========================
+bool BMSBlackBox::isCapturing() const {
+    return rtcRecord.magic == BLACKBOX_MAGIC && rtcRecord.state == BB_CAPTURING;
+}
+
+uint8_t BMSBlackBox::getStoredCount() const {
+    return (nextId < BLACKBOX_SLOTS) ? nextId : BLACKBOX_SLOTS;
+}
+
+bool BMSBlackBox::getRecord(uint8_t index, BlackBoxRecord& record) {
+    if (index >= getStoredCount()) return false;
+
+    uint32_t id = nextId - 1 - index;
+    char key[8];
+    snprintf(key, sizeof(key), "ev%u", (unsigned)(id % BLACKBOX_SLOTS));
+
+    prefs.begin("bms_bbox", true);
+    size_t len = prefs.getBytes(key, &record, sizeof(record));
+    prefs.end();
+
+    return len == sizeof(record) && isValid(record) && record.id == id;
+}
+
+void BMSBlackBox::clear() {
+    prefs.begin("bms_bbox", false);
+    prefs.clear();
+    prefs.end();
+
+    nextId = 0;
+    rtcRecord.magic = 0;
+}
+
+// ========================= XUẤT JSON =========================
+static void addTripNames(JsonArray arr, uint8_t mask) {
+    for (uint8_t t = 0; t < PROT_COUNT; t++) {
+        if (mask & (1 << t)) arr.add(BMSProtection::getTypeName((ProtectionType)t));
+    }
+}
+
+void BMSBlackBox::streamList(WebServer& server) {
+    StaticJsonDocument<1536> doc;
+    doc["capturing"] = isCapturing();
+    doc["preMs"] = BLACKBOX_PRE_MS;
+    doc["postMs"] = BLACKBOX_POST_MS;
+    doc["sampleMs"] = BLACKBOX_SAMPLE_MS;
+
+    JsonArray events = doc.createNestedArray("events");
+    BlackBoxRecord record;
+    for (uint8_t i = 0; i < getStoredCount(); i++) {
+        if (!getRecord(i, record)) continue;
+        JsonObject e = events.createNestedObject();
+        e["index"] = i;
+        e["id"] = record.id;
+        e["boot"] = record.boot;
+        e["cause"] = BMSProtection::getTypeName((ProtectionType)record.cause);
+        e["value"] = String(record.triggerValue, 3);
+        e["triggerTime"] = record.triggerTime;
+        e["samples"] = record.count;
+        addTripNames(e.createNestedArray("trips"), record.tripMask);
+    }
+
+    String output;
+    serializeJson(doc, output);
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.send(200, "application/json", output);
+}
+
+void BMSBlackBox::streamRecord(WebServer& server, const BlackBoxRecord& record) {
+    char buf[512];
+    size_t len = 0;
+
+    auto flush = [&]() {
+        if (len > 0) {
+            server.sendContent(buf, len);
+            len = 0;
+        }
+    };
+    auto text = [&](const char* str) {
+        size_t n = strlen(str);
+        if (len + n > sizeof(buf)) flush();
+        memcpy(buf + len, str, n);
+        len += n;
+    };
+    auto number = [&](long value) {
+        if (len + 12 > sizeof(buf)) flush();
+        len += snprintf(buf + len, sizeof(buf) - len, "%ld", value);
+    };
+    auto column = [&](const char* name, long (*get)(const BlackBoxRecord&, uint8_t)) {
+        text(",\"");
+        text(name);
+        text("\":[");
+        for (uint8_t i = 0; i < record.count; i++) {
+            if (i) text(",");
+            number(get(record, i));
+        }
+        text("]");
+    };
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.send(200, "application/json", "");
+
+    char value[16];
+    snprintf(value, sizeof(value), "%.3f", record.triggerValue);
+
+    text("{\"id\":");
+    number(record.id);
+    text(",\"boot\":");
+    number(record.boot);
+    text(",\"cause\":\"");
+    text(BMSProtection::getTypeName((ProtectionType)record.cause));
+    text("\",\"value\":\"");
+    text(value);
+    text("\",\"triggerTime\":");
+    number(record.triggerTime);
+    text(",\"preCount\":");
+    number(record.preCount);
+    text(",\"units\":{\"t\":\"ms\",\"tap\":\"mV\",\"current\":\"mA\",\"temp\":\"0.1C\"}");
+    text(",\"samples\":{\"count\":");
+    number(record.count);
+
+    // t tính từ lúc trip (âm = trước trip)
+    column("t", [](const BlackBoxRecord& r, uint8_t i) -> long {
+        return (int32_t)(r.samples[i].time_ms - r.triggerTime);
+    });
+    column("tap1", [](const BlackBoxRecord& r, uint8_t i) -> long { return r.samples[i].tap_mV[0]; });
+    column("tap2", [](const BlackBoxRecord& r, uint8_t i) -> long { return r.samples[i].tap_mV[1]; });
+    column("tap3", [](const BlackBoxRecord& r, uint8_t i) -> long { return r.samples[i].tap_mV[2]; });
+    column("tap4", [](const BlackBoxRecord& r, uint8_t i) -> long { return r.samples[i].tap_mV[3]; });
+    column("current", [](const BlackBoxRecord& r, uint8_t i) -> long { return r.samples[i].current_mA; });
+    column("temp", [](const BlackBoxRecord& r, uint8_t i) -> long { return r.samples[i].temp_dC; });
+    text("}}");
+
+    flush();
+    server.sendContent("");
+}
+
+// ========================= DEBUG =========================
+void BMSBlackBox::printList() {
+    Serial.println("\n╔═══ BLACK-BOX EVENTS ═══╗");
+    if (isCapturing()) {
+        Serial.printf("Capturing event #%lu (%u/%u samples)\n",
+                      (unsigned long)rtcRecord.id, rtcRecord.count,
+                      rtcRecord.preCount + BLACKBOX_POST_SAMPLES);
+    }
+
+    BlackBoxRecord record;
+    uint8_t stored = getStoredCount();
+    if (stored == 0) Serial.println("No events");
+    for (uint8_t i = 0; i < stored; i++) {
+        if (!getRecord(i, record)) {
+            Serial.printf("[%u] invalid record\n", i);
+            continue;
+        }
+        Serial.printf("[%u] #%lu boot %u @%lums: %s = %.3f (%u samples)\n",
+                      i, (unsigned long)record.id, record.boot,
+                      (unsigned long)record.triggerTime,
+                      BMSProtection::getTypeName((ProtectionType)record.cause),
+                      record.triggerValue, record.count);
+    }
+    Serial.println("Use 'blackbox N' to dump event N as CSV");
+    Serial.println("╚════════════════════════╝\n");
+}
+
+void BMSBlackBox::printRecord(const BlackBoxRecord& record) {
+    Serial.printf("# event %lu, boot %u, cause %s, value %.3f, trigger %lums\n",
+                  (unsigned long)record.id, record.boot,
+                  BMSProtection::getTypeName((ProtectionType)record.cause),
+                  record.triggerValue, (unsigned long)record.triggerTime);
+    Serial.println("t_ms,tap1_mV,tap2_mV,tap3_mV,tap4_mV,current_mA,temp_dC");
+    for (uint8_t i = 0; i < record.count; i++) {
+        const BlackBoxSample& s = record.samples[i];
+        Serial.printf("%ld,%u,%u,%u,%u,%d,%d\n",
+                      (long)(int32_t)(s.time_ms - record.triggerTime),
+                      s.tap_mV[0], s.tap_mV[1], s.tap_mV[2], s.tap_mV[3],
+                      s.current_mA, s.temp_dC);
+    }
+}
@@ -6,6 +6,13 @@ BMSBalancing::BMSBalancing() {
     bal_timer = 0;
     bal_on_phase = false;
     bal_cell = 0;
+    bal_last_update = 0;
+    for (int i = 0; i < 4; i++) {
+        bal_on_ms[i] = 0;
+        bal_excess[i] = 0.0f;
+    }
+    bal_charge_mode = false;
+    bal_by_charge = false;
 }
 
 // ========================= KHỞI TẠO =========================
@@ -59,10 +66,31 @@ float BMSBalancing::getMinCellVoltage(float cell1, float cell2, float cell3, flo
     return vmin;
 }
 
+uint8_t BMSBalancing::getMaxExcessIndex() const {
+    uint8_t idx = 1;
+    for (uint8_t i = 1; i < 4; i++) {
+        if (bal_excess[i] > bal_excess[idx - 1]) idx = i + 1;
+    }
+    return idx;
+}
+
 // ========================= CẬP NHẬT CÂN BẰNG =========================
+void BMSBalancing::setChargeTargets(const float excess_mAh[4], bool valid) {
+    bal_charge_mode = valid;
+    for (int i = 0; i < 4; i++) {
+        bal_excess[i] = valid ? excess_mAh[i] : 0.0f;
+    }
+}
+
 void BMSBalancing::update(float cell1, float cell2, float cell3, float cell4, float current) {
     unsigned long now = millis();
     
+    // Cộng dồn thời gian điện trở xả đang bật
+    if (bal_active && bal_on_phase && bal_cell >= 1 && bal_cell <= 4) {
+        bal_on_ms[bal_cell - 1] += now - bal_last_update;
+    }
+    bal_last_update = now;
+    
     bool idle = (fabs(current) < BAL_IDLE_CURRENT);
     float vmin = getMinCellVoltage(cell1, cell2, cell3, cell4);
     uint8_t vmax_idx = getMaxCellIndex(cell1, cell2, cell3, cell4);
@@ -80,16 +108,34 @@ void BMSBalancing::update(float cell1, float cell2, float cell3, float cell4, fl
     bool start_cond = idle && (vmax >= BAL_MIN_CELL_V) && (delta >= BAL_DELTA_START);
     bool stop_cond = (!idle) || (delta <= BAL_DELTA_STOP);
     
+    // Đoạn OCV phẳng: chênh áp không phản ánh chênh điện lượng → dùng SOC từng cell
+    // khi có cell thừa đáng kể. Excess đã trừ 2σ nên thường = 0: khi đó vẫn giữ
+    // quy tắc chênh áp (cuối sạc) thay vì tắt hẳn cân bằng
+    uint8_t excess_idx = getMaxExcessIndex();
+    float excess = bal_excess[excess_idx - 1];
+    bool by_charge = bal_active ? bal_by_charge : (bal_charge_mode && excess >= BAL_EXCESS_START);
+    if (by_charge) {
+        start_cond = idle && (vmin >= BAL_CHARGE_MIN_CELL_V) && (excess >= BAL_EXCESS_START);
+        stop_cond = (!idle) || (vmin < BAL_CHARGE_MIN_CELL_V) || (excess <= BAL_EXCESS_STOP);
+        vmax_idx = excess_idx;
+    }
+    
     if (!bal_active) {
         if (start_cond) {
             bal_active = true;
             bal_on_phase = true;
+            bal_by_charge = by_charge;
             bal_cell = vmax_idx;
             bal_timer = now;
             balanceEnable(bal_cell);
             
-            Serial.printf("Balancing started: Cell %d (%.3fV vs %.3fV = %.3fV)\n", 
-                         bal_cell, vmax, vmin, delta);
+            if (bal_by_charge) {
+                Serial.printf("Balancing started: Cell %d (%.0fmAh excess)\n",
+                             bal_cell, bal_excess[bal_cell - 1]);
+            } else {
+                Serial.printf("Balancing started: Cell %d (%.3fV vs %.3fV = %.3fV)\n", 
+                             bal_cell, vmax, vmin, delta);
+            }
         }
     } 
     else {
@@ -113,7 +159,8 @@ void BMSBalancing::update(float cell1, float cell2, float cell3, float cell4, fl
                 if (now - bal_timer >= BAL_OFF_TIME) {
                     bal_on_phase = true;
                     bal_timer = now;
-                    bal_cell = getMaxCellIndex(cell1, cell2, cell3, cell4);
+                    bal_cell = bal_by_charge ? getMaxExcessIndex()
+                                             : getMaxCellIndex(cell1, cell2, cell3, cell4);
                     balanceEnable(bal_cell);
                 }
             }
@@ -122,6 +169,11 @@ void BMSBalancing::update(float cell1, float cell2, float cell3, float cell4, fl
 }
 
 // ========================= GETTERS =========================
+// Lượt đang chạy: theo quy tắc của lượt đó; chưa chạy: quy tắc sẽ thử trước
+bool BMSBalancing::isChargeTargeted() const {
+    return bal_active ? bal_by_charge : bal_charge_mode;
+}
+
 bool BMSBalancing::isActive() const {
     return bal_active;
 }
@@ -135,6 +187,11 @@ uint8_t BMSBalancing::getBalancingCell() const {
     return bal_active ? bal_cell : 0;
 }
 
+float BMSBalancing::getBalancingSeconds(uint8_t cell) const {
+    if (cell < 1 || cell > 4) return 0.0f;
+    return bal_on_ms[cell - 1] / 1000.0f;
+}
+
 // ========================= STOP THỦ CÔNG =========================
 void BMSBalancing::stop() {
     bal_active = false;
@@ -148,6 +205,11 @@ void BMSBalancing::stop() {
 void BMSBalancing::printStatus() {
     Serial.println("\n╔═══ BALANCING STATUS ═══╗");
     Serial.printf("Active: %s\n", bal_active ? "YES" : "NO");
+    Serial.printf("Target: %s\n", isChargeTargeted() ? "charge (cell SOC)" : "voltage");
+    if (bal_charge_mode) {
+        Serial.printf("Excess: %.0f / %.0f / %.0f / %.0f mAh\n",
+                      bal_excess[0], bal_excess[1], bal_excess[2], bal_excess[3]);
+    }
     
     if (bal_active) {
         Serial.printf("Cell: %d\n", bal_cell);
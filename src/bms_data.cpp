@@ -3,6 +3,20 @@
 // ==================== GLOBAL INSTANCE ====================
 BMSData bmsData;
 
+// ==================== INIT ====================
+void initBMSData() {
+    memset(&bmsData, 0, sizeof(bmsData));
+    bmsData.packTemp = 25.0f;
+    bmsData.soc = 50.0f;
+    bmsData.soh = 100.0f;
+    bmsData.remainingCapacity = BATTERY_CAPACITY;
+    bmsData.chargeMosfetEnabled = true;
+    bmsData.dischargeMosfetEnabled = true;
+
+    // Epoch delta ngẫu nhiên mỗi lần boot, khác 0 (0 = client chưa có)
+    bmsEpoch = esp_random() | 1;
+}
+
 // ==================== HELPER ====================
 const char* statusToString(bool alarm) {
     return alarm ? "alarm" : "normal";
@@ -76,6 +90,20 @@ void checkProtectionStatus() {
     }
 }
 
+// ==================== DATA LOGGER ====================
+static void logSample() {
+    BMSLogRecord r;
+    for (int i = 0; i < NUM_CELLS; i++) {
+        r.cell_mV[i] = bmsFrameU16(bmsData.cellVoltages[i], 1000.0f);
+    }
+    r.current_mA = bmsFrameI16(bmsData.current, 1000.0f);
+    r.temp_dC = bmsFrameI16(bmsData.packTemp, 10.0f);
+    r.soc_pm = bmsFrameU16(bmsData.soc, 10.0f);
+    r.alarms = getAlarmBits();
+    r.flags = getStatusFlags();
+    logger.addSample(r);
+}
+
 // ==================== MAIN UPDATE ====================
 void updateAllBMSData() {
     sensors.readAllSensors();
@@ -90,7 +118,8 @@ void updateAllBMSData() {
     bmsData.packTemp = sensors.getTemperature();
 
     if (!socInitialized) {
-        soc.initializeFromVoltage(bmsData.packVoltage);
+        soc.initializeFromVoltage(bmsData.packVoltage, bmsData.current);
+        cellSoc.initialize(soc.getCoulombSOC());
         socInitialized = true;
     }
 
@@ -103,9 +132,31 @@ void updateAllBMSData() {
         bmsData.packTemp
     );
 
+    // Black-box: mẫu của chu kỳ gây trip là mẫu pre-trigger cuối cùng
+    float taps[4] = { sensors.getTap(1), sensors.getTap(2), sensors.getTap(3), sensors.getTap(4) };
+    blackbox.addSample(taps, bmsData.current, bmsData.packTemp);
+    // Trip đầu tiên là nguyên nhân, các trip cùng lúc vào tripMask
+    ProtectionType tripType;
+    float tripValue;
+    while (protection.takeTrip(tripType, tripValue)) {
+        blackbox.trigger(tripType, tripValue);
+    }
+
     bmsData.chargeMosfetEnabled = protection.getChargeMosfetState();
     bmsData.dischargeMosfetEnabled = protection.getDischargeMosfetState();
 
+    // Điện trở trong từ bước nhảy dòng (cùng trạng thái xả cân bằng với SOC từng cell)
+    resistance.update(bmsData.cellVoltages, bmsData.current, bmsData.packTemp, bmsData.balancingCells);
+    for (int i = 0; i < NUM_CELLS; i++) {
+        cellSoc.setResistance(i, resistance.getResistance(i, bmsData.packTemp));
+    }
+
+    // SOC từng cell: dòng xả cân bằng của chu kỳ trước, rồi đặt mục tiêu cân bằng theo điện lượng
+    cellSoc.update(bmsData.cellVoltages, bmsData.current, bmsData.packTemp, bmsData.balancingCells);
+    float excess[NUM_CELLS];
+    cellSoc.getBalanceExcess(excess);
+    balancing.setChargeTargets(excess, cellSoc.isConfident());
+
     balancing.update(
         bmsData.cellVoltages[0],
         bmsData.cellVoltages[1],
@@ -115,10 +166,15 @@ void updateAllBMSData() {
     );
 
     bmsData.balancingActive = balancing.isActive();
+    bmsData.balancingByCharge = balancing.isChargeTargeted();
     bmsData.balancingCell = balancing.getBalancingCell();
     balancing.getBalancingStatus(bmsData.balancingCells);
 
+    soc.updateModel(bmsData.packVoltage, bmsData.current, bmsData.packTemp);
     bmsData.soc = socInitialized ? soc.getSOC() : 50.0;
+    power.update(bmsData.current, bmsData.packTemp, soc.getRCVoltage(), bmsData.soc, soc.getCapacityAh(),
+                 bmsData.chargeMosfetEnabled, bmsData.dischargeMosfetEnabled);
+    energy.update(bmsData.packVoltage, bmsData.current, bmsData.soc);
 
     if (sohInitialized) {
         bmsData.soh = soh.getSOH();
@@ -130,56 +186,337 @@ void updateAllBMSData() {
     updateChargingStatus();
     checkProtectionStatus();
 
+    uint32_t trips[PROT_COUNT];
+    for (uint8_t t = 0; t < PROT_COUNT; t++) {
+        trips[t] = protection.getTripCount((ProtectionType)t);
+    }
+    reports.update(energy, bmsData.current, bmsData.cellVoltages, getStatusFlags(), trips);
+    usage.update(bmsData.cellVoltages, bmsData.current, bmsData.packTemp, bmsData.soc);
+
+    history.addSample(bmsData.cellVoltages, bmsData.current, bmsData.packTemp, bmsData.soc);
+
     bmsData.systemActive = true;
     bmsData.lastUpdateTime = millis();
+
+    logSample();
+    commitBMSChanges();
 }
 
 // ==================== SOC / SOH ====================
 void updateSOC() {
     if (!socInitialized) return;
     soc.update(bmsData.current, bmsData.packTemp);
-    soc.recalibrate(bmsData.packVoltage, bmsData.current);
+    // Mốc cạn theo cell thấp nhất sau khi bù sụt áp R·I
+    float minCellOcv = INFINITY;
+    for (int i = 0; i < NUM_CELLS; i++) {
+        minCellOcv = fminf(minCellOcv, resistance.compensate(i, bmsData.cellVoltages[i],
+                                                             bmsData.current, bmsData.packTemp));
+    }
+    soc.recalibrate(bmsData.packVoltage, bmsData.current, minCellOcv);
     bmsData.soc = soc.getSOC();
+    commitBMSChanges();
 }
 
 void updateSOH() {
     if (!sohInitialized || !socInitialized) return;
+    if (capacityEst.getUpdates() > 0) {
+        soh.setMeasuredCapacity(capacityEst.getCapacityAh(), capacityEst.getSigmaAh());
+    }
+    soh.setPowerFade(resistance.getPowerSOH());
     soh.update(bmsData.soc, bmsData.packTemp);
     bmsData.soh = soh.getSOH();
     bmsData.totalCycles = soh.getTotalCycles();
     bmsData.remainingCapacity = soh.getCurrentCapacity();
     bmsData.remainingCycles = soh.getRemainingCycles();
+    commitBMSChanges();
+}
+
+// ==================== DWIN ====================
+void updateDWINDisplay() {
+    dwin.updateBasicData(
+        bmsData.cellVoltages[0],
+        bmsData.cellVoltages[1],
+        bmsData.cellVoltages[2],
+        bmsData.cellVoltages[3],
+        bmsData.packVoltage,
+        bmsData.current,
+        bmsData.packTemp
+    );
+
+    dwin.updateAllWarnings(
+        bmsData.overVoltageWarning, bmsData.overVoltageAlarm,
+        bmsData.overCurrentChargeWarning, bmsData.overCurrentChargeAlarm,
+        bmsData.overTempChargeWarning || bmsData.underTempChargeWarning,
+        bmsData.overTempChargeAlarm || bmsData.underTempChargeAlarm,
+        bmsData.underVoltageWarning, bmsData.underVoltageAlarm,
+        bmsData.overCurrentDischargeWarning, bmsData.overCurrentDischargeAlarm,
+        bmsData.overTempDischargeWarning || bmsData.underTempDischargeWarning,
+        bmsData.overTempDischargeAlarm || bmsData.underTempDischargeAlarm
+    );
+
+    float eff = energy.getCycleEfficiency();
+    if (isnan(eff)) eff = energy.getEfficiency();
+    dwin.sendEnergy(energy.getChargedWh() / 1000.0f, energy.getDischargedWh() / 1000.0f,
+                    isnan(eff) ? 0.0f : eff);
+
+    const SOPLimit& sop = power.getLimit(1);    // 10 s
+    dwin.sendPower(sop.charge_W, sop.discharge_W, power.getTimeToEmpty(), power.getTimeToFull());
+}
+
+// ==================== ALARM BITS ====================
+static uint16_t packBits(bool ov, bool uv, bool occ, bool ocd,
+                         bool otc, bool otd, bool utc, bool utd) {
+    uint16_t bits = 0;
+    if (ov)  bits |= BMS_BIT_OV;
+    if (uv)  bits |= BMS_BIT_UV;
+    if (occ) bits |= BMS_BIT_OCC;
+    if (ocd) bits |= BMS_BIT_OCD;
+    if (otc) bits |= BMS_BIT_OTC;
+    if (otd) bits |= BMS_BIT_OTD;
+    if (utc) bits |= BMS_BIT_UTC;
+    if (utd) bits |= BMS_BIT_UTD;
+    return bits;
+}
+
+uint16_t getAlarmBits() {
+    return packBits(bmsData.overVoltageAlarm, bmsData.underVoltageAlarm,
+                    bmsData.overCurrentChargeAlarm, bmsData.overCurrentDischargeAlarm,
+                    bmsData.overTempChargeAlarm, bmsData.overTempDischargeAlarm,
+                    bmsData.underTempChargeAlarm, bmsData.underTempDischargeAlarm);
+}
+
+uint8_t getStatusFlags() {
+    uint8_t flags = 0;
+    if (bmsData.isCharging)             flags |= BMS_FLAG_CHARGING;
+    if (bmsData.isDischarging)          flags |= BMS_FLAG_DISCHARGING;
+    if (bmsData.balancingActive)        flags |= BMS_FLAG_BALANCING;
+    if (bmsData.chargeMosfetEnabled)    flags |= BMS_FLAG_CHG_MOSFET;
+    if (bmsData.dischargeMosfetEnabled) flags |= BMS_FLAG_DSG_MOSFET;
+    if (bmsData.systemActive)           flags |= BMS_FLAG_ACTIVE;
+    return flags;
 }
 
 // ==================== JSON API ====================
-String getBMSJson() {
-    StaticJsonDocument<2048> doc;
-   
-    // ============ MEASUREMENT ============
-    JsonObject measurement = doc.createNestedObject("measurement");
-   
-    JsonArray cells = measurement.createNestedArray("cellVoltages");
+// Mỗi trường JSON có một hàm ghi và một chữ ký (giá trị đã lượng tử
+// hoá theo đúng độ chính xác hiển thị). Chữ ký đổi → version của
+// trường được nâng lên seq hiện tại, dùng cho chế độ ?since=<seq>.
+static JsonObject getSection(JsonObject root, const char* name) {
+    JsonObject obj = root[name].as<JsonObject>();
+    if (obj.isNull()) obj = root.createNestedObject(name);
+    return obj;
+}
+
+static uint32_t quantize(float value, float scale) {
+    return (uint32_t)(int32_t)lroundf(value * scale);
+}
+
+static uint32_t hashMix(uint32_t h, uint32_t v) {
+    return (h ^ v) * 16777619u;
+}
+
+// Số thực làm tròn để ghi thẳng vào JSON dạng số (không cấp phát String).
+// Tính bằng double: ArduinoJson in double ngắn nhất (3.312, không phải 3.3120000362)
+static double rounded(double value, uint8_t decimals) {
+    static const double SCALE[] = { 1.0, 10.0, 100.0, 1000.0 };
+    return round(value * SCALE[decimals]) / SCALE[decimals];
+}
+
+static float getCellDelta() {
+    float maxV = bmsData.cellVoltages[0];
+    float minV = bmsData.cellVoltages[0];
+    for (int i = 1; i < NUM_CELLS; i++) {
+        if (bmsData.cellVoltages[i] > maxV) maxV = bmsData.cellVoltages[i];
+        if (bmsData.cellVoltages[i] < minV) minV = bmsData.cellVoltages[i];
+    }
+    return maxV - minV;
+}
+
+// ---------- Measurement ----------
+static void writeCells(JsonObject root) {
+    JsonArray cells = getSection(root, "measurement").createNestedArray("cellVoltages");
     for (int i = 0; i < NUM_CELLS; i++) {
         JsonObject cell = cells.createNestedObject();
         cell["cell"] = i + 1;
-        cell["voltage"] = String(bmsData.cellVoltages[i], 3);
+        cell["voltage"] = rounded(bmsData.cellVoltages[i], 3);
     }
-   
-    measurement["packVoltage"] = String(bmsData.packVoltage, 2);
-    measurement["avgCellVoltage"] = String(bmsData.avgCellVoltage, 3);
-    measurement["current"] = String(bmsData.current, 2);
-    measurement["packTemperature"] = String(bmsData.packTemp, 1);
-   
-    // ============ CALCULATION ============
-    JsonObject calculation = doc.createNestedObject("calculation");
-    calculation["soc"] = String(bmsData.soc, 1);
-    calculation["soh"] = String(bmsData.soh, 1);
-    calculation["remainingCapacity"] = String(bmsData.remainingCapacity, 3);
-    calculation["totalCycles"] = String(bmsData.totalCycles, 1);
-   
-    // ============ STATUS ============
-    JsonObject status = doc.createNestedObject("status");
-   
+}
+
+static uint32_t signCells() {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < NUM_CELLS; i++) {
+        h = hashMix(h, quantize(bmsData.cellVoltages[i], 1000.0f));
+    }
+    return h;
+}
+
+static void writePackVoltage(JsonObject root) {
+    getSection(root, "measurement")["packVoltage"] = rounded(bmsData.packVoltage, 2);
+}
+static uint32_t signPackVoltage() { return quantize(bmsData.packVoltage, 100.0f); }
+
+static void writeAvgCell(JsonObject root) {
+    getSection(root, "measurement")["avgCellVoltage"] = rounded(bmsData.avgCellVoltage, 3);
+}
+static uint32_t signAvgCell() { return quantize(bmsData.avgCellVoltage, 1000.0f); }
+
+static void writeCurrent(JsonObject root) {
+    getSection(root, "measurement")["current"] = rounded(bmsData.current, 2);
+}
+static uint32_t signCurrent() { return quantize(bmsData.current, 100.0f); }
+
+static void writeTemp(JsonObject root) {
+    getSection(root, "measurement")["packTemperature"] = rounded(bmsData.packTemp, 1);
+}
+static uint32_t signTemp() { return quantize(bmsData.packTemp, 10.0f); }
+
+// ---------- Calculation ----------
+static void writeSOC(JsonObject root) {
+    JsonObject c = getSection(root, "calculation");
+    c["soc"] = rounded(bmsData.soc, 1);
+    c["socSigma"] = rounded(soc.getUncertainty(), 1);
+    c["socMode"] = soc.getModeName();
+}
+static uint32_t signSOC() {
+    uint32_t h = quantize(bmsData.soc, 10.0f);
+    h = hashMix(h, quantize(soc.getUncertainty(), 10.0f));
+    return hashMix(h, soc.getMode());
+}
+
+static void writeCellSOC(JsonObject root) {
+    JsonObject c = getSection(root, "calculation");
+    JsonArray cells = c.createNestedArray("cellSoc");
+    for (int i = 0; i < NUM_CELLS; i++) {
+        JsonObject cell = cells.createNestedObject();
+        cell["cell"] = i + 1;
+        cell["soc"] = rounded(cellSoc.getSOC(i), 1);
+        cell["sigma"] = rounded(cellSoc.getSigma(i), 1);
+        cell["capacityAh"] = rounded(cellSoc.getCapacityAh(i), 2);
+    }
+    c["packSocCells"] = rounded(cellSoc.getPackSOC(), 1);
+}
+static uint32_t signCellSOC() {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < NUM_CELLS; i++) {
+        h = hashMix(h, quantize(cellSoc.getSOC(i), 10.0f));
+        h = hashMix(h, quantize(cellSoc.getSigma(i), 10.0f));
+        h = hashMix(h, quantize(cellSoc.getCapacityAh(i), 100.0f));
+    }
+    return h;
+}
+
+static void writeCapacity(JsonObject root) {
+    JsonObject c = getSection(root, "calculation");
+    c["capacityAh"] = rounded(capacityEst.getCapacityAh(), 3);
+    c["capacitySigma"] = rounded(capacityEst.getSigmaAh(), 3);
+    c["capacityUpdates"] = capacityEst.getUpdates();
+}
+static uint32_t signCapacity() {
+    uint32_t h = quantize(capacityEst.getCapacityAh(), 1000.0f);
+    h = hashMix(h, quantize(capacityEst.getSigmaAh(), 1000.0f));
+    return hashMix(h, capacityEst.getUpdates());
+}
+
+static void writeResistance(JsonObject root) {
+    JsonObject c = getSection(root, "calculation");
+    JsonArray cells = c.createNestedArray("cellResistance");
+    for (int i = 0; i < NUM_CELLS; i++) {
+        JsonObject cell = cells.createNestedObject();
+        cell["cell"] = i + 1;
+        cell["r25_mOhm"] = rounded(resistance.getR25(i) * 1000.0f, 2);
+        cell["r_mOhm"] = rounded(resistance.getResistance(i, bmsData.packTemp) * 1000.0f, 2);
+        cell["sigma_mOhm"] = rounded(resistance.getSigma(i) * 1000.0f, 2);
+        cell["events"] = resistance.getEvents(i);
+        cell["ocv"] = rounded(resistance.compensate(i, bmsData.cellVoltages[i], bmsData.current,
+                                                    bmsData.packTemp), 3);
+    }
+}
+static uint32_t signResistance() {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < NUM_CELLS; i++) {
+        h = hashMix(h, quantize(resistance.getResistance(i, bmsData.packTemp), 100000.0f));
+        h = hashMix(h, quantize(resistance.getSigma(i), 100000.0f));
+        h = hashMix(h, quantize(resistance.compensate(i, bmsData.cellVoltages[i], bmsData.current,
+                                                      bmsData.packTemp), 1000.0f));
+    }
+    return h;
+}
+
+static void writePower(JsonObject root) {
+    JsonObject p = getSection(root, "power");
+    JsonArray horizons = p.createNestedArray("horizons");
+    JsonArray chargeA = p.createNestedArray("chargeA");
+    JsonArray dischargeA = p.createNestedArray("dischargeA");
+    JsonArray chargeW = p.createNestedArray("chargeW");
+    JsonArray dischargeW = p.createNestedArray("dischargeW");
+    for (uint8_t h = 0; h < SOP_HORIZONS; h++) {
+        const SOPLimit& l = power.getLimit(h);
+        horizons.add((int)SOP_HORIZON_S[h]);
+        chargeA.add(rounded(l.charge_A, 2));
+        dischargeA.add(rounded(l.discharge_A, 2));
+        chargeW.add(rounded(l.charge_W, 1));
+        dischargeW.add(rounded(l.discharge_W, 1));
+    }
+    p["avgCurrent"] = rounded(power.getAvgCurrent(), 2);
+    float tte = power.getTimeToEmpty();
+    float ttf = power.getTimeToFull();
+    if (isnan(tte)) p["timeToEmptyMin"] = nullptr; else p["timeToEmptyMin"] = (long)lroundf(tte);
+    if (isnan(ttf)) p["timeToFullMin"] = nullptr; else p["timeToFullMin"] = (long)lroundf(ttf);
+}
+static uint32_t signPower() {
+    uint32_t h = quantize(power.getAvgCurrent(), 100.0f);
+    for (uint8_t i = 0; i < SOP_HORIZONS; i++) {
+        const SOPLimit& l = power.getLimit(i);
+        h = hashMix(h, quantize(l.charge_A, 100.0f));
+        h = hashMix(h, quantize(l.discharge_A, 100.0f));
+    }
+    float tte = power.getTimeToEmpty();
+    float ttf = power.getTimeToFull();
+    h = hashMix(h, isnan(tte) ? 0xFFFFFFFFu : quantize(tte, 1.0f));
+    return hashMix(h, isnan(ttf) ? 0xFFFFFFFFu : quantize(ttf, 1.0f));
+}
+
+static void writeSOH(JsonObject root) {
+    JsonObject c = getSection(root, "calculation");
+    c["soh"] = rounded(bmsData.soh, 1);
+    c["sohPower"] = rounded(soh.getPowerSOH(), 1);
+    c["calendarLoss"] = rounded(soh.getCalendarLoss(), 2);
+    c["cycleLoss"] = rounded(soh.getCycleLoss(), 2);
+    float days = soh.getRemainingDays();
+    if (isnan(days)) c["remainingDays"] = nullptr; else c["remainingDays"] = (long)lroundf(days);
+}
+static uint32_t signSOH() {
+    uint32_t h = hashMix(quantize(bmsData.soh, 10.0f), quantize(soh.getPowerSOH(), 10.0f));
+    h = hashMix(h, quantize(soh.getCalendarLoss(), 100.0f));
+    h = hashMix(h, quantize(soh.getCycleLoss(), 100.0f));
+    float days = soh.getRemainingDays();
+    return hashMix(h, isnan(days) ? 0 : quantize(days, 1.0f));
+}
+
+static void writeRemainingCapacity(JsonObject root) {
+    getSection(root, "calculation")["remainingCapacity"] = rounded(bmsData.remainingCapacity, 3);
+}
+static uint32_t signRemainingCapacity() { return quantize(bmsData.remainingCapacity, 1000.0f); }
+
+static void writeTotalCycles(JsonObject root) {
+    JsonObject c = getSection(root, "calculation");
+    c["totalCycles"] = rounded(bmsData.totalCycles, 1);
+    c["damageCycles"] = rounded(soh.getDamageCycles(), 2);
+    JsonArray depths = c.createNestedArray("cycleDepths");
+    for (uint8_t b = 0; b < SOH_DEPTH_BINS; b++) {
+        depths.add(soh.getDepthCycles(b));
+    }
+}
+static uint32_t signTotalCycles() {
+    uint32_t h = hashMix(quantize(bmsData.totalCycles, 10.0f), quantize(soh.getDamageCycles(), 100.0f));
+    for (uint8_t b = 0; b < SOH_DEPTH_BINS; b++) {
+        h = hashMix(h, quantize(soh.getDepthCycles(b), 2.0f));
+    }
+    return h;
+}
+
+// ---------- Status ----------
+static void writeCharging(JsonObject root) {
+    JsonObject status = getSection(root, "status");
     if (bmsData.isCharging) {
         status["charging"] = "charging";
     } else if (bmsData.isDischarging) {
@@ -187,9 +524,15 @@ String getBMSJson() {
     } else {
         status["charging"] = "idle";
     }
-   
-    JsonObject balancing = status.createNestedObject("balancing");
+}
+static uint32_t signCharging() {
+    return (bmsData.isCharging ? 1 : 0) | (bmsData.isDischarging ? 2 : 0);
+}
+
+static void writeBalancing(JsonObject root) {
+    JsonObject balancing = getSection(root, "status").createNestedObject("balancing");
     balancing["active"] = bmsData.balancingActive;
+    balancing["target"] = bmsData.balancingByCharge ? "charge" : "voltage";
    
     JsonArray balancingCellsArray = balancing.createNestedArray("cells");
     if (bmsData.balancingActive) {
@@ -199,70 +542,277 @@ String getBMSJson() {
             }
         }
     }
-   
-    // ============ PROTECTION ============
-    JsonObject protectionObj = doc.createNestedObject("protection");
-    protectionObj["overVoltage"] = bmsData.overVoltageAlarm ? "alarm" : "normal";
-    protectionObj["underVoltage"] = bmsData.underVoltageAlarm ? "alarm" : "normal";
-    protectionObj["overCurrentCharge"] = bmsData.overCurrentChargeAlarm ? "alarm" : "normal";
-    protectionObj["overCurrentDischarge"] = bmsData.overCurrentDischargeAlarm ? "alarm" : "normal";
-    protectionObj["overTempCharge"] = bmsData.overTempChargeAlarm ? "alarm" : "normal";
-    protectionObj["overTempDischarge"] = bmsData.overTempDischargeAlarm ? "alarm" : "normal";
-   
-    // ============ ALERTS ============
-    JsonArray alerts = doc.createNestedArray("alerts");
+}
+static uint32_t signBalancing() {
+    uint32_t sig = bmsData.balancingActive ? 1 : 0;
+    if (bmsData.balancingByCharge) sig |= 0x100;
+    for (int i = 0; i < NUM_CELLS; i++) {
+        if (bmsData.balancingCells[i]) sig |= (2u << i);
+    }
+    return sig;
+}
+
+// ---------- Protection ----------
+static void writeProtection(JsonObject root) {
+    JsonObject protectionObj = getSection(root, "protection");
+    protectionObj["overVoltage"] = statusToString(bmsData.overVoltageAlarm);
+    protectionObj["underVoltage"] = statusToString(bmsData.underVoltageAlarm);
+    protectionObj["overCurrentCharge"] = statusToString(bmsData.overCurrentChargeAlarm);
+    protectionObj["overCurrentDischarge"] = statusToString(bmsData.overCurrentDischargeAlarm);
+    protectionObj["overTempCharge"] = statusToString(bmsData.overTempChargeAlarm);
+    protectionObj["overTempDischarge"] = statusToString(bmsData.overTempDischargeAlarm);
+}
+static uint32_t signProtection() {
+    return packBits(bmsData.overVoltageAlarm, bmsData.underVoltageAlarm,
+                    bmsData.overCurrentChargeAlarm, bmsData.overCurrentDischargeAlarm,
+                    bmsData.overTempChargeAlarm, bmsData.overTempDischargeAlarm,
+                    false, false);
+}
+
+// ---------- Alerts ----------
+static void addAlert(JsonArray alerts, const char* severity, const String& message) {
+    JsonObject alert = alerts.createNestedObject();
+    alert["severity"] = severity;
+    alert["message"] = message;
+}
+
+static void writeAlerts(JsonObject root) {
+    JsonArray alerts = root.createNestedArray("alerts");
    
     if (bmsData.overVoltageAlarm) {
-        JsonObject alert = alerts.createNestedObject();
-        alert["severity"] = "critical";
-        alert["message"] = "Ngắt sạc: Điện áp quá cao!";
+        addAlert(alerts, "critical", "Ngắt sạc: Điện áp quá cao!");
     }
    
     if (bmsData.underVoltageAlarm) {
-        JsonObject alert = alerts.createNestedObject();
-        alert["severity"] = "critical";
-        alert["message"] = "Ngắt xả: Điện áp quá thấp!";
+        addAlert(alerts, "critical", "Ngắt xả: Điện áp quá thấp!");
     }
    
     if (bmsData.overCurrentChargeAlarm) {
-        JsonObject alert = alerts.createNestedObject();
-        alert["severity"] = "critical";
-        alert["message"] = "Ngắt sạc: Quá dòng sạc!";
+        addAlert(alerts, "critical", "Ngắt sạc: Quá dòng sạc!");
     }
    
     if (bmsData.overCurrentDischargeAlarm) {
-        JsonObject alert = alerts.createNestedObject();
-        alert["severity"] = "critical";
-        alert["message"] = "Ngắt xả: Quá dòng xả!";
+        addAlert(alerts, "critical", "Ngắt xả: Quá dòng xả!");
     }
    
     if (bmsData.overVoltageWarning && !bmsData.overVoltageAlarm) {
-        JsonObject alert = alerts.createNestedObject();
-        alert["severity"] = "warning";
-        alert["message"] = "Điện áp cell đang cao";
+        addAlert(alerts, "warning", "Điện áp cell đang cao");
     }
    
     if (bmsData.underVoltageWarning && !bmsData.underVoltageAlarm) {
-        JsonObject alert = alerts.createNestedObject();
-        alert["severity"] = "warning";
-        alert["message"] = "Điện áp cell đang thấp";
+        addAlert(alerts, "warning", "Điện áp cell đang thấp");
     }
    
     if (bmsData.balancingActive) {
-        float maxV = bmsData.cellVoltages[0];
-        float minV = bmsData.cellVoltages[0];
-        for (int i = 1; i < NUM_CELLS; i++) {
-            if (bmsData.cellVoltages[i] > maxV) maxV = bmsData.cellVoltages[i];
-            if (bmsData.cellVoltages[i] < minV) minV = bmsData.cellVoltages[i];
+        addAlert(alerts, "info", String("Đang cân bằng Cell ") + String(bmsData.balancingCell) +
+                                 " (Δ" + String(getCellDelta(), 3) + "V)");
+    }
+}
+
+static uint32_t signAlerts() {
+    uint32_t h = 2166136261u;
+    h = hashMix(h, bmsData.overVoltageAlarm | (bmsData.underVoltageAlarm << 1) |
+                   (bmsData.overCurrentChargeAlarm << 2) | (bmsData.overCurrentDischargeAlarm << 3) |
+                   (bmsData.overVoltageWarning << 4) | (bmsData.underVoltageWarning << 5));
+    if (bmsData.balancingActive) {
+        h = hashMix(h, bmsData.balancingCell);
+        h = hashMix(h, quantize(getCellDelta(), 1000.0f));
+    }
+    return h;
+}
+
+// ---------- Energy ----------
+static void writeEnergy(JsonObject root) {
+    JsonObject e = getSection(root, "energy");
+    e["chargedWh"] = rounded(energy.getChargedWh(), 2);
+    e["dischargedWh"] = rounded(energy.getDischargedWh(), 2);
+    e["chargedAh"] = rounded(energy.getChargedAh(), 3);
+    e["dischargedAh"] = rounded(energy.getDischargedAh(), 3);
+
+    float eff = energy.getEfficiency();
+    float cycleEff = energy.getCycleEfficiency();
+    if (isnan(eff)) e["efficiency"] = nullptr;
+    else e["efficiency"] = rounded(eff, 1);
+    if (isnan(cycleEff)) e["cycleEfficiency"] = nullptr;
+    else e["cycleEfficiency"] = rounded(cycleEff, 1);
+}
+static uint32_t signEnergy() {
+    uint32_t h = 2166136261u;
+    h = hashMix(h, (uint32_t)(energy.getChargedWh() * 10.0));
+    h = hashMix(h, (uint32_t)(energy.getDischargedWh() * 10.0));
+    float eff = energy.getCycleEfficiency();
+    h = hashMix(h, isnan(eff) ? 0 : quantize(eff, 10.0f));
+    return h;
+}
+
+// ---------- Bảng trường ----------
+// Một bảng duy nhất điều khiển: JSON đầy đủ, delta (?since) và
+// chọn trường (?fields / các endpoint con)
+struct BMSFieldDesc {
+    const char* name;
+    const char* group;
+    void (*write)(JsonObject root);
+    uint32_t (*sign)();
+};
+
+static const BMSFieldDesc FIELD_TABLE[FIELD_COUNT] = {
+    { "cells",             "measurement", writeCells,             signCells },
+    { "packVoltage",       "measurement", writePackVoltage,       signPackVoltage },
+    { "avgCellVoltage",    "measurement", writeAvgCell,           signAvgCell },
+    { "current",           "measurement", writeCurrent,           signCurrent },
+    { "temperature",       "measurement", writeTemp,              signTemp },
+    { "soc",               "calculation", writeSOC,               signSOC },
+    { "soh",               "calculation", writeSOH,               signSOH },
+    { "remainingCapacity", "calculation", writeRemainingCapacity, signRemainingCapacity },
+    { "totalCycles",       "calculation", writeTotalCycles,       signTotalCycles },
+    { "charging",          "status",      writeCharging,          signCharging },
+    { "balancing",         "status",      writeBalancing,         signBalancing },
+    { "protection",        "protection",  writeProtection,        signProtection },
+    { "alerts",            "alerts",      writeAlerts,            signAlerts },
+    { "energy",            "energy",      writeEnergy,            signEnergy },
+    { "cellSoc",           "calculation", writeCellSOC,           signCellSOC },
+    { "capacity",          "calculation", writeCapacity,          signCapacity },
+    { "resistance",        "calculation", writeResistance,        signResistance },
+    { "power",             "power",       writePower,             signPower },
+};
+
+// "cells,current,soc" hoặc tên nhóm ("measurement") → bitmask.
+// Một tên không khớp trường/nhóm nào → 0 cả danh sách (không trả im lặng một phần)
+uint32_t parseFieldMask(const char* list, String* unknown) {
+    uint32_t mask = 0;
+    const char* p = list;
+
+    while (*p) {
+        const char* end = p;
+        while (*end && *end != ',') end++;
+        size_t n = end - p;
+
+        uint32_t matched = 0;
+        for (int i = 0; i < FIELD_COUNT; i++) {
+            const BMSFieldDesc& f = FIELD_TABLE[i];
+            if ((strlen(f.name) == n && strncmp(f.name, p, n) == 0) ||
+                (strlen(f.group) == n && strncmp(f.group, p, n) == 0)) {
+                matched |= FIELD_BIT(i);
+            }
+        }
+        // Dấu phẩy thừa ("cells,") bỏ qua
+        if (matched == 0 && n > 0) {
+            if (unknown != nullptr) *unknown = String(p).substring(0, n);
+            return 0;
         }
-       
-        JsonObject alert = alerts.createNestedObject();
-        alert["severity"] = "info";
-        alert["message"] = String("Đang cân bằng Cell ") + String(bmsData.balancingCell) +
-                          " (Δ" + String(maxV - minV, 3) + "V)";
+        mask |= matched;
+
+        p = *end ? end + 1 : end;
     }
-   
+
+    return mask;
+}
+
+// ==================== CHANGE TRACKING ====================
+uint32_t bmsSeq = 0;
+uint32_t bmsEpoch = 0;
+uint32_t bmsFieldVersion[FIELD_COUNT];
+static uint32_t fieldSignature[FIELD_COUNT];
+
+void commitBMSChanges() {
+    bool changed = false;
+
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        uint32_t sig = FIELD_TABLE[i].sign();
+        if (sig != fieldSignature[i] || bmsSeq == 0) {
+            if (!changed) {
+                bmsSeq++;
+                changed = true;
+            }
+            fieldSignature[i] = sig;
+            bmsFieldVersion[i] = bmsSeq;
+        }
+    }
+}
+
+// Keyframe khi client mới, client từ lần boot khác (epoch không khớp,
+// kể cả khi seq mới đã vượt since cũ), since lớn hơn seq hoặc khi seq
+// vượt qua ranh giới KEYFRAME_INTERVAL kể từ lần gửi trước
+static bool needsKeyframe(uint32_t since, uint32_t epoch) {
+    if (since == 0 || epoch != bmsEpoch || since > bmsSeq) return true;
+    return (since / KEYFRAME_INTERVAL) != (bmsSeq / KEYFRAME_INTERVAL);
+}
+
+// Document tràn thì trường cuối bị cắt im lặng → không gửi JSON thiếu trường.
+// Log mask để phân biệt /bms đủ trường với ?fields= / /bms/cells...
+static String serializeBMSJson(const DynamicJsonDocument& doc, uint32_t mask) {
+    if (doc.capacity() == 0 || doc.overflowed()) {
+        Serial.printf("BMS JSON overflow (fields 0x%05lX): %u/%u bytes\n", (unsigned long)mask,
+                      (unsigned)doc.memoryUsage(), (unsigned)BMS_JSON_CAPACITY);
+        return String();
+    }
+
     String output;
+    output.reserve(measureJson(doc));
     serializeJson(doc, output);
     return output;
 }
+
+String getBMSJson(uint32_t mask) {
+    DynamicJsonDocument doc(BMS_JSON_CAPACITY);
+    JsonObject root = doc.to<JsonObject>();
+
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        if (mask & FIELD_BIT(i)) {
+            FIELD_TABLE[i].write(root);
+        }
+    }
+
+    return serializeBMSJson(doc, mask);
+}
+
+String getBMSJsonSince(uint32_t since, uint32_t epoch, uint32_t mask) {
+    DynamicJsonDocument doc(BMS_JSON_CAPACITY);
+    JsonObject root = doc.to<JsonObject>();
+
+    bool keyframe = needsKeyframe(since, epoch);
+    root["seq"] = bmsSeq;
+    root["epoch"] = bmsEpoch;
+    root["keyframe"] = keyframe;
+
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        if ((mask & FIELD_BIT(i)) && (keyframe || bmsFieldVersion[i] > since)) {
+            FIELD_TABLE[i].write(root);
+        }
+    }
+
+    return serializeBMSJson(doc, mask);
+}
+
+// ==================== BINARY API ====================
+size_t getBMSFrame(uint8_t* buf) {
+    BMSFrame f;
+
+    f.timestamp = bmsData.lastUpdateTime;
+    for (int i = 0; i < NUM_CELLS; i++) {
+        f.cell_mV[i] = bmsFrameU16(bmsData.cellVoltages[i], 1000.0f);
+    }
+    f.pack_mV = bmsFrameU16(bmsData.packVoltage, 1000.0f);
+    f.current_mA = bmsFrameI16(bmsData.current, 1000.0f);
+    f.temp_dC = bmsFrameI16(bmsData.packTemp, 10.0f);
+    f.soc_pm = bmsFrameU16(bmsData.soc, 10.0f);
+    f.soh_pm = bmsFrameU16(bmsData.soh, 10.0f);
+    f.remaining_mAh = bmsFrameU16(bmsData.remainingCapacity, 1000.0f);
+    f.cycles_d = bmsFrameU16(bmsData.totalCycles, 10.0f);
+    f.remainingCycles = bmsFrameU16(bmsData.remainingCycles, 1.0f);
+
+    f.alarms = getAlarmBits();
+    f.warnings = packBits(bmsData.overVoltageWarning, bmsData.underVoltageWarning,
+                          bmsData.overCurrentChargeWarning, bmsData.overCurrentDischargeWarning,
+                          bmsData.overTempChargeWarning, bmsData.overTempDischargeWarning,
+                          bmsData.underTempChargeWarning, bmsData.underTempDischargeWarning);
+    f.flags = getStatusFlags();
+
+    f.balancingMask = 0;
+    for (int i = 0; i < NUM_CELLS; i++) {
+        if (bmsData.balancingCells[i]) f.balancingMask |= (1 << i);
+    }
+    f.balancingCell = bmsData.balancingCell;
+
+    return bmsFrameEncode(f, buf);
+}
@@ -1,6 +1,7 @@
 #include "bms_dwin.h"
 
 BMSDwin::BMSDwin() {
+    frameCount = 0;
 }
 
 void BMSDwin::begin() {
@@ -32,6 +33,7 @@ void BMSDwin::writeWord(uint16_t vp, int16_t value) {
     frame[7] = value & 0xFF;
     
     Serial2.write(frame, 8);
+    frameCount++;
 }
 
 void BMSDwin::writeFloat(uint16_t vp, float value, uint8_t decimal_places) {
@@ -80,6 +82,19 @@ void BMSDwin::sendTemperature(float temp) {
     writeFloat(VP_TEMP, temp, 2);
 }
 
+void BMSDwin::sendEnergy(float inKWh, float outKWh, float efficiency) {
+    writeFloat(VP_ENERGY_IN, inKWh, 2);
+    writeFloat(VP_ENERGY_OUT, outKWh, 2);
+    writeFloat(VP_EFFICIENCY, efficiency, 1);
+}
+
+void BMSDwin::sendPower(float chargeW, float dischargeW, float emptyMinutes, float fullMinutes) {
+    writeFloat(VP_SOP_CHARGE, chargeW, 1);
+    writeFloat(VP_SOP_DISCHARGE, dischargeW, 1);
+    writeWord(VP_TIME_EMPTY, isnan(emptyMinutes) ? -1 : (int16_t)fminf(emptyMinutes, 9999.0f));
+    writeWord(VP_TIME_FULL, isnan(fullMinutes) ? -1 : (int16_t)fminf(fullMinutes, 9999.0f));
+}
+
 void BMSDwin::updateBasicData(float cell1, float cell2, float cell3, float cell4,
                     float pack, float current, float temp) {
     sendVoltages(cell1, cell2, cell3, cell4, pack);
@@ -162,6 +177,10 @@ void BMSDwin::updateAllWarnings(bool chg_ov_warn, bool chg_ov_alarm,
     updateWarningDsgTemp(dsg_temp_warn, dsg_temp_alarm);
 }
 
+uint32_t BMSDwin::getFrameCount() const {
+    return frameCount;
+}
+
 void BMSDwin::resetDisplay() {
     Serial.println("Resetting DWIN Display...");
     
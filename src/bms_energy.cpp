@@ -0,0 +1,179 @@
+#include "bms_energy.h"
+
+// 1 Wh = 3.6e9 mW·ms, 1 Ah = 3.6e9 mA·ms
+static const double UNITS_PER_HOUR = 3600000000.0;
+
+// ========================= CONSTRUCTOR =========================
+BMSEnergy::BMSEnergy()
+    : chargeEnergy(0),
+      dischargeEnergy(0),
+      chargeCharge(0),
+      dischargeCharge(0),
+      lastPower_mW(0),
+      lastCurrent_mA(0),
+      lastSample(0),
+      primed(false),
+      markChargeEnergy(0),
+      markDischargeEnergy(0),
+      marked(false),
+      fullArmed(false),
+      cycleEfficiency(NAN),
+      journal(nullptr)
+{
+}
+
+void BMSEnergy::begin(BMSJournal& store) {
+    journal = &store;
+    if (!journal->isReady()) {
+        Serial.println("Energy: journal not ready, totals will not persist");
+        return;
+    }
+
+    // Ngưỡng ghi: 0.5 Wh / 0.05 Ah, tối đa 60 s
+    chargeEnergy = (uint64_t)(journal->define(JK_ENERGY_CHG_WH, 0.0, 0.5, 60000) * UNITS_PER_HOUR);
+    dischargeEnergy = (uint64_t)(journal->define(JK_ENERGY_DSG_WH, 0.0, 0.5, 60000) * UNITS_PER_HOUR);
+    chargeCharge = (uint64_t)(journal->define(JK_ENERGY_CHG_AH, 0.0, 0.05, 60000) * UNITS_PER_HOUR);
+    dischargeCharge = (uint64_t)(journal->define(JK_ENERGY_DSG_AH, 0.0, 0.05, 60000) * UNITS_PER_HOUR);
+
+    // Mốc lần đầy trước: -1 = chưa có
+    double markChg = journal->define(JK_ENERGY_MARK_CHG_WH, -1.0, 0.5, 60000);
+    double markDsg = journal->define(JK_ENERGY_MARK_DSG_WH, -1.0, 0.5, 60000);
+    if (markChg >= 0.0 && markDsg >= 0.0) {
+        markChargeEnergy = (uint64_t)(markChg * UNITS_PER_HOUR);
+        markDischargeEnergy = (uint64_t)(markDsg * UNITS_PER_HOUR);
+        marked = true;
+    }
+    double eff = journal->define(JK_ENERGY_CYCLE_EFF, -1.0, 0.05, 60000);
+    cycleEfficiency = eff >= 0.0 ? (float)eff : NAN;
+
+    Serial.printf("Energy initialized: in %.1fWh, out %.1fWh\n", getChargedWh(), getDischargedWh());
+}
+
+// ========================= TÍCH PHÂN =========================
+// Hình thang giữa 2 mẫu a → b trong dt ms. Trái dấu: tách tại điểm 0
+// (nội suy tuyến tính) để phần sạc và phần xả không bù trừ nhau.
+void BMSEnergy::integrate(int32_t a, int32_t b, uint32_t dt, uint64_t& pos, uint64_t& neg) {
+    if ((a >= 0) == (b >= 0)) {
+        int64_t area = ((int64_t)a + b) * dt / 2;
+        if (area >= 0) pos += (uint64_t)area;
+        else neg += (uint64_t)(-area);
+        return;
+    }
+
+    int64_t absA = a < 0 ? -(int64_t)a : a;
+    int64_t absB = b < 0 ? -(int64_t)b : b;
+    int64_t t0 = (int64_t)dt * absA / (absA + absB);
+    uint64_t areaA = (uint64_t)(absA * t0 / 2);
+    uint64_t areaB = (uint64_t)(absB * ((int64_t)dt - t0) / 2);
+
+    if (b < 0) {
+        pos += areaA;
+        neg += areaB;
+    } else {
+        neg += areaA;
+        pos += areaB;
+    }
+}
+
+// ========================= CẬP NHẬT =========================
+void BMSEnergy::update(float packVoltage, float current_A, float soc) {
+    unsigned long now = millis();
+    int32_t current_mA = (int32_t)lroundf(current_A * 1000.0f);
+    int32_t power_mW = (int32_t)lroundf(packVoltage * current_A * 1000.0f);
+    uint32_t dt = now - lastSample;
+
+    if (primed && dt <= ENERGY_MAX_GAP_MS) {
+        integrate(lastPower_mW, power_mW, dt, chargeEnergy, dischargeEnergy);
+        integrate(lastCurrent_mA, current_mA, dt, chargeCharge, dischargeCharge);
+    }
+
+    lastPower_mW = power_mW;
+    lastCurrent_mA = current_mA;
+    lastSample = now;
+    primed = true;
+
+    checkFull(soc);
+    saveState();
+}
+
+// Hiệu suất chu kỳ: năng lượng ra / vào giữa 2 lần đầy liên tiếp
+void BMSEnergy::checkFull(float soc) {
+    if (soc < ENERGY_REARM_SOC) {
+        fullArmed = true;
+        return;
+    }
+    if (!fullArmed || soc < ENERGY_FULL_SOC) return;
+    fullArmed = false;
+
+    if (marked) {
+        double in = (chargeEnergy - markChargeEnergy) / UNITS_PER_HOUR;
+        double out = (dischargeEnergy - markDischargeEnergy) / UNITS_PER_HOUR;
+        if (out >= ENERGY_MIN_CYCLE_WH && in > 0.0) {
+            cycleEfficiency = (float)(out / in * 100.0);
+            Serial.printf("Energy: cycle efficiency %.1f%% (in %.1fWh, out %.1fWh)\n",
+                          cycleEfficiency, in, out);
+        }
+    }
+
+    markChargeEnergy = chargeEnergy;
+    markDischargeEnergy = dischargeEnergy;
+    marked = true;
+}
+
+void BMSEnergy::saveState() {
+    if (journal == nullptr || !journal->isReady()) return;
+
+    journal->set(JK_ENERGY_CHG_WH, getChargedWh());
+    journal->set(JK_ENERGY_DSG_WH, getDischargedWh());
+    journal->set(JK_ENERGY_CHG_AH, getChargedAh());
+    journal->set(JK_ENERGY_DSG_AH, getDischargedAh());
+    if (marked) {
+        journal->set(JK_ENERGY_MARK_CHG_WH, markChargeEnergy / UNITS_PER_HOUR);
+        journal->set(JK_ENERGY_MARK_DSG_WH, markDischargeEnergy / UNITS_PER_HOUR);
+    }
+    if (!isnan(cycleEfficiency)) {
+        journal->set(JK_ENERGY_CYCLE_EFF, cycleEfficiency);
+    }
+}
+
+// ========================= GETTERS =========================
+double BMSEnergy::getChargedWh() const {
+    return chargeEnergy / UNITS_PER_HOUR;
+}
+
+double BMSEnergy::getDischargedWh() const {
+    return dischargeEnergy / UNITS_PER_HOUR;
+}
+
+double BMSEnergy::getChargedAh() const {
+    return chargeCharge / UNITS_PER_HOUR;
+}
+
+double BMSEnergy::getDischargedAh() const {
+    return dischargeCharge / UNITS_PER_HOUR;
+}
+
+float BMSEnergy::getEfficiency() const {
+    if (chargeEnergy == 0) return NAN;
+    return (float)((double)dischargeEnergy / chargeEnergy * 100.0);
+}
+
+float BMSEnergy::getCycleEfficiency() const {
+    return cycleEfficiency;
+}
+
+// ========================= DEBUG =========================
+void BMSEnergy::printStatus() {
+    Serial.println("\n╔═══ ENERGY STATUS ═══╗");
+    Serial.printf("Charged:    %10.2f Wh  %8.3f Ah\n", getChargedWh(), getChargedAh());
+    Serial.printf("Discharged: %10.2f Wh  %8.3f Ah\n", getDischargedWh(), getDischargedAh());
+    Serial.printf("Efficiency: lifetime %.1f%%, last cycle %.1f%%\n",
+                  getEfficiency(), getCycleEfficiency());
+    if (marked) {
+        Serial.printf("Since last full: in %.2fWh, out %.2fWh\n",
+                      (chargeEnergy - markChargeEnergy) / UNITS_PER_HOUR,
+                      (dischargeEnergy - markDischargeEnergy) / UNITS_PER_HOUR);
+    }
+    Serial.printf("Persisted: %s\n", (journal && journal->isReady()) ? "journal" : "no");
+    Serial.println("╚═════════════════════╝\n");
+}
@@ -0,0 +1,390 @@
+#include "bms_history.h"
+
+// ========================= BỘ NHỚ (SoA) =========================
+// 3 stat x 7 kênh x (600 + 720 + 1440) bucket x 2 byte ≈ 113 KB
+// + archive 32 x 512 B = 16 KB, cấp phát heap trong begin()
+static const uint16_t TIER0_SIZE = 600;
+static const uint16_t TIER1_SIZE = 720;
+static const uint16_t TIER2_SIZE = 1440;
+
+static const char* CHANNEL_NAMES[HIST_CHANNELS] = {
+    "cell1", "cell2", "cell3", "cell4", "current", "temp", "soc"
+};
+
+static const char* STAT_NAMES[HIST_STATS] = { "min", "max", "avg" };
+
+// ========================= CONSTRUCTOR =========================
+BMSHistory::BMSHistory() {
+    const uint16_t sizes[HISTORY_TIERS] = { TIER0_SIZE, TIER1_SIZE, TIER2_SIZE };
+    const uint32_t resolutions[HISTORY_TIERS] = { 1000, 10000, 60000 };
+    const uint8_t factors[HISTORY_TIERS] = { 1, 10, 6 };
+
+    for (uint8_t t = 0; t < HISTORY_TIERS; t++) {
+        tiers[t].data = nullptr;
+        tiers[t].capacity = sizes[t];
+        tiers[t].head = 0;
+        tiers[t].count = 0;
+        tiers[t].resolution_ms = resolutions[t];
+        tiers[t].factor = factors[t];
+        tiers[t].lastEnd = 0;
+        resetAccumulator(tiers[t].acc);
+    }
+    bucketStart = 0;
+    archiveData = nullptr;
+    archiveHead = 0;
+    archiveCount = 0;
+    allocated = 0;
+}
+
+// Ưu tiên: tier 1 s (dashboard), archive, tier 10 s, tier 1 phút (lớn nhất, bỏ trước)
+void BMSHistory::begin() {
+    bucketStart = millis();
+
+    tiers[0].data = (int16_t*)allocate(sizeof(int16_t) * HIST_STATS * HIST_CHANNELS * tiers[0].capacity,
+                                       "tier 1s");
+    archiveData = (uint8_t*)allocate((size_t)HISTORY_ARCHIVE_BLOCKS * HISTORY_ARCHIVE_BLOCK_SIZE,
+                                     "archive");
+    for (uint8_t t = 1; t < HISTORY_TIERS; t++) {
+        tiers[t].data = (int16_t*)allocate(sizeof(int16_t) * HIST_STATS * HIST_CHANNELS * tiers[t].capacity,
+                                           t == 1 ? "tier 10s" : "tier 1m");
+    }
+
+    archiveHead = 0;
+    archiveCount = 0;
+    if (archiveData != nullptr) {
+        archiveWriter.begin(archiveBlock(0), HISTORY_ARCHIVE_BLOCK_SIZE, HIST_CHANNELS);
+        archiveCount = 1;
+    }
+    Serial.printf("History initialized: %u bytes heap, %u bytes free\n",
+                  (unsigned)allocated, (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+
+// ========================= HÀM NỘI BỘ =========================
+void* BMSHistory::allocate(size_t bytes, const char* name) {
+    void* p = nullptr;
+    if (heap_caps_get_free_size(MALLOC_CAP_8BIT) >= bytes + HISTORY_HEAP_RESERVE) {
+        p = heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    }
+    if (p == nullptr) {
+        Serial.printf("History: no heap for %s (%u bytes), disabled\n", name, (unsigned)bytes);
+        return nullptr;
+    }
+    memset(p, 0, bytes);
+    allocated += bytes;
+    return p;
+}
+
+uint8_t* BMSHistory::archiveBlock(uint16_t index) const {
+    return &archiveData[(size_t)index * HISTORY_ARCHIVE_BLOCK_SIZE];
+}
+
+void BMSHistory::resetAccumulator(Accumulator& acc) {
+    for (uint8_t c = 0; c < HIST_CHANNELS; c++) {
+        acc.sum[c] = 0;
+        acc.min[c] = INT16_MAX;
+        acc.max[c] = INT16_MIN;
+    }
+    acc.count = 0;
+}
+
+void BMSHistory::accumulate(Accumulator& acc, const int16_t mn[], const int16_t mx[],
+                            const int16_t avg[]) {
+    for (uint8_t c = 0; c < HIST_CHANNELS; c++) {
+        acc.sum[c] += avg[c];
+        if (mn[c] < acc.min[c]) acc.min[c] = mn[c];
+        if (mx[c] > acc.max[c]) acc.max[c] = mx[c];
+    }
+    acc.count++;
+}
+
+int16_t* BMSHistory::slot(uint8_t tier, HistoryStat stat, uint8_t channel) {
+    Tier& t = tiers[tier];
+    return &t.data[((uint16_t)stat * HIST_CHANNELS + channel) * t.capacity];
+}
+
+void BMSHistory::closeBucket(uint8_t tier, unsigned long endTime) {
+    Tier& t = tiers[tier];
+    if (t.acc.count == 0) return;
+
+    int16_t avg[HIST_CHANNELS];
+    for (uint8_t c = 0; c < HIST_CHANNELS; c++) {
+        avg[c] = (int16_t)(t.acc.sum[c] / (int32_t)t.acc.count);
+    }
+
+    // Tier bị tắt vẫn gộp lên tier trên, chỉ không lưu bucket
+    if (t.data != nullptr) {
+        for (uint8_t c = 0; c < HIST_CHANNELS; c++) {
+            slot(tier, HIST_MIN, c)[t.head] = t.acc.min[c];
+            slot(tier, HIST_MAX, c)[t.head] = t.acc.max[c];
+            slot(tier, HIST_AVG, c)[t.head] = avg[c];
+        }
+        t.head = (t.head + 1) % t.capacity;
+        if (t.count < t.capacity) t.count++;
+    }
+    t.lastEnd = endTime;
+
+    if (tier == 0) archiveSample(endTime, avg);
+
+    // Gộp lên tier kế tiếp
+    if (tier + 1 < HISTORY_TIERS) {
+        Tier& up = tiers[tier + 1];
+        accumulate(up.acc, t.acc.min, t.acc.max, avg);
+        if (up.acc.count >= up.factor) {
+            closeBucket(tier + 1, endTime);
+        }
+    }
+
+    resetAccumulator(t.acc);
+}
+
+// Block đầy → ghi đè block cũ nhất trong vòng
+void BMSHistory::archiveSample(unsigned long time, const int16_t values[]) {
+    if (archiveCount == 0) return;
+    if (archiveWriter.append(time, values)) return;
+
+    archiveHead = (archiveHead + 1) % HISTORY_ARCHIVE_BLOCKS;
+    if (archiveCount < HISTORY_ARCHIVE_BLOCKS) archiveCount++;
+    archiveWriter.begin(archiveBlock(archiveHead), HISTORY_ARCHIVE_BLOCK_SIZE, HIST_CHANNELS);
+    archiveWriter.append(time, values);
+}
+
+static int16_t toInt16(float value, float scale) {
+    float v = value * scale;
+    if (v > 32767.0f) return 32767;
+    if (v < -32768.0f) return -32768;
+    return (int16_t)lroundf(v);
+}
+
+// ========================= CẬP NHẬT =========================
+void BMSHistory::addSample(const float cells[4], float current, float temp, float soc) {
+    unsigned long now = millis();
+
+    if (now - bucketStart >= tiers[0].resolution_ms) {
+        bucketStart += tiers[0].resolution_ms;
+        closeBucket(0, bucketStart);
+        if (now - bucketStart >= tiers[0].resolution_ms) {
+            bucketStart = now;   // loop bị trễ > 1 bucket
+        }
+    }
+
+    int16_t v[HIST_CHANNELS];
+    for (uint8_t c = 0; c < 4; c++) {
+        v[HIST_CELL1 + c] = toInt16(cells[c], 1000.0f);
+    }
+    v[HIST_CURRENT] = toInt16(current, 1000.0f);
+    v[HIST_TEMP] = toInt16(temp, 10.0f);
+    v[HIST_SOC] = toInt16(soc, 10.0f);
+
+    accumulate(tiers[0].acc, v, v, v);
+}
+
+// ========================= TRUY VẤN =========================
+uint16_t BMSHistory::getCount(uint8_t tier) const {
+    return (tier < HISTORY_TIERS) ? tiers[tier].count : 0;
+}
+
+uint32_t BMSHistory::getResolution(uint8_t tier) const {
+    return (tier < HISTORY_TIERS) ? tiers[tier].resolution_ms : 0;
+}
+
+int16_t BMSHistory::getValue(uint8_t tier, HistoryStat stat, uint8_t channel,
+                             uint16_t ageIndex) const {
+    const Tier& t = tiers[tier];
+    if (ageIndex >= t.count) return 0;
+    uint16_t idx = (t.head + t.capacity - 1 - ageIndex) % t.capacity;
+    return t.data[((uint16_t)stat * HIST_CHANNELS + channel) * t.capacity + idx];
+}
+
+int8_t BMSHistory::findTier(uint32_t resolution_ms) const {
+    for (uint8_t t = 0; t < HISTORY_TIERS; t++) {
+        if (tiers[t].resolution_ms == resolution_ms) {
+            return tiers[t].data != nullptr ? t : -1;
+        }
+    }
+    return -1;
+}
+
+uint16_t BMSHistory::getArchiveBlocks() const {
+    return archiveCount;
+}
+
+// ========================= XUẤT JSON =========================
+void BMSHistory::streamJson(WebServer& server, uint8_t tier, uint16_t points) {
+    const Tier& t = tiers[tier];
+    if (points == 0 || points > t.count) points = t.count;
+
+    char buf[512];
+    size_t len = 0;
+
+    auto flush = [&]() {
+        if (len > 0) {
+            server.sendContent(buf, len);
+            len = 0;
+        }
+    };
+    auto text = [&](const char* str) {
+        size_t n = strlen(str);
+        if (len + n > sizeof(buf)) flush();
+        memcpy(buf + len, str, n);
+        len += n;
+    };
+    auto number = [&](long value) {
+        if (len + 12 > sizeof(buf)) flush();
+        len += snprintf(buf + len, sizeof(buf) - len, "%ld", value);
+    };
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.send(200, "application/json", "");
+
+    text("{\"resolution\":");
+    number(t.resolution_ms);
+    text(",\"end\":");
+    number(t.lastEnd);
+    text(",\"count\":");
+    number(points);
+    text(",\"units\":{\"cell\":\"mV\",\"current\":\"mA\",\"temp\":\"0.1C\",\"soc\":\"0.1%\"}");
+    text(",\"channels\":{");
+
+    for (uint8_t c = 0; c < HIST_CHANNELS; c++) {
+        if (c) text(",");
+        text("\"");
+        text(CHANNEL_NAMES[c]);
+        text("\":{");
+
+        for (uint8_t s = 0; s < HIST_STATS; s++) {
+            if (s) text(",");
+            text("\"");
+            text(STAT_NAMES[s]);
+            text("\":[");
+
+            // Cũ nhất → mới nhất
+            for (uint16_t i = 0; i < points; i++) {
+                if (i) text(",");
+                number(getValue(tier, (HistoryStat)s, c, points - 1 - i));
+            }
+            text("]");
+        }
+        text("}");
+    }
+    text("}}");
+
+    flush();
+    server.sendContent("");
+}
+
+// Chỉ giải mã các block có lastTime trong khoảng yêu cầu (đọc header)
+void BMSHistory::streamArchive(WebServer& server, uint32_t range_s) {
+    char buf[512];
+    size_t len = 0;
+
+    auto flush = [&]() {
+        if (len > 0) {
+            server.sendContent(buf, len);
+            len = 0;
+        }
+    };
+    auto text = [&](const char* str) {
+        size_t n = strlen(str);
+        if (len + n > sizeof(buf)) flush();
+        memcpy(buf + len, str, n);
+        len += n;
+    };
+    auto number = [&](long value) {
+        if (len + 12 > sizeof(buf)) flush();
+        len += snprintf(buf + len, sizeof(buf) - len, "%ld", value);
+    };
+
+    BMSCodecBlockInfo newest;
+    uint32_t end = 0;
+    if (archiveCount > 0 &&
+        bmsCodecReadInfo(archiveBlock(archiveHead), HISTORY_ARCHIVE_BLOCK_SIZE, newest) &&
+        newest.count > 0) {
+        end = newest.lastTime;
+    }
+    // So sánh theo giây: range_s * 1000 tràn uint32 khi range > ~49.7 ngày
+    uint32_t from = (range_s > 0 && range_s < end / 1000) ? end - range_s * 1000 : 0;
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.send(200, "application/json", "");
+
+    text("{\"resolution\":");
+    number(tiers[0].resolution_ms);
+    text(",\"end\":");
+    number(end);
+    text(",\"units\":{\"cell\":\"mV\",\"current\":\"mA\",\"temp\":\"0.1C\",\"soc\":\"0.1%\"}");
+    text(",\"columns\":[\"t\"");
+    for (uint8_t c = 0; c < HIST_CHANNELS; c++) {
+        text(",\"");
+        text(CHANNEL_NAMES[c]);
+        text("\"");
+    }
+    text("],\"rows\":[");
+
+    bool first = true;
+    BMSCodecReader reader;
+    uint32_t time;
+    int16_t values[HIST_CHANNELS];
+
+    // Cũ nhất → mới nhất
+    for (uint16_t i = 0; i < archiveCount; i++) {
+        uint16_t index = (archiveHead + HISTORY_ARCHIVE_BLOCKS - archiveCount + 1 + i) %
+                         HISTORY_ARCHIVE_BLOCKS;
+        if (!reader.begin(archiveBlock(index), HISTORY_ARCHIVE_BLOCK_SIZE)) continue;
+        if (reader.getInfo().count == 0 || reader.getInfo().lastTime < from) continue;
+
+        while (reader.next(time, values)) {
+            if (time < from) continue;
+            text(first ? "[" : ",[");
+            first = false;
+            number(time);
+            for (uint8_t c = 0; c < HIST_CHANNELS; c++) {
+                text(",");
+                number(values[c]);
+            }
+            text("]");
+        }
+    }
+    text("]}");
+
+    flush();
+    server.sendContent("");
+}
+
+// ========================= DEBUG =========================
+void BMSHistory::printStatus() {
+    Serial.println("\n╔═══ HISTORY STATUS ═══╗");
+    for (uint8_t t = 0; t < HISTORY_TIERS; t++) {
+        if (tiers[t].data == nullptr) {
+            Serial.printf("Tier %d: %5lus disabled (no heap)\n",
+                          t, (unsigned long)(tiers[t].resolution_ms / 1000));
+            continue;
+        }
+        Serial.printf("Tier %d: %5lus x %4u/%u buckets\n",
+                      t, (unsigned long)(tiers[t].resolution_ms / 1000), tiers[t].count, tiers[t].capacity);
+    }
+
+    uint32_t samples = 0;
+    BMSCodecBlockInfo info;
+    for (uint16_t i = 0; i < archiveCount; i++) {
+        if (bmsCodecReadInfo(archiveBlock(i), HISTORY_ARCHIVE_BLOCK_SIZE, info)) {
+            samples += info.count;
+        }
+    }
+    size_t bytes = (size_t)(archiveCount > 0 ? archiveCount - 1 : 0) * HISTORY_ARCHIVE_BLOCK_SIZE +
+            archiveWriter.bytesUsed();
+    Serial.printf("Archive: %u/%u blocks, %lu samples, %.2f B/sample\n",
+                  archiveCount, HISTORY_ARCHIVE_BLOCKS, (unsigned long)samples,
+                  samples ? (float)bytes / samples : 0.0f);
+    Serial.printf("Heap: %u bytes history, %u bytes free\n",
+                  (unsigned)allocated, (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT));
+
+    if (tiers[0].count > 0) {
+        Serial.printf("Last 1s: %dmV..%dmV (cell1), %dmA avg\n",
+                      getValue(0, HIST_MIN, HIST_CELL1, 0),
+                      getValue(0, HIST_MAX, HIST_CELL1, 0),
+                      getValue(0, HIST_AVG, HIST_CURRENT, 0));
+    }
+    Serial.println("╚══════════════════════╝\n");
+}
@@ -0,0 +1,335 @@
+#include "bms_journal.h"
+#include "bms_frame.h"
+
+#define JOURNAL_MAGIC        0x4C4E524AUL   // "JRNL"
+#define JOURNAL_VERSION      1
+#define JOURNAL_SECTOR_SIZE  4096
+#define JOURNAL_HEADER_SIZE  16
+#define JOURNAL_RECORD_SIZE  12
+#define JOURNAL_SLOTS        ((JOURNAL_SECTOR_SIZE - JOURNAL_HEADER_SIZE) / JOURNAL_RECORD_SIZE)
+#define JOURNAL_MAX_SECTORS  64
+
+// ========================= RECORD =========================
+//  0  2  key
+//  2  2  CRC16-CCITT của key + value
+//  4  8  value (double, little-endian)
+static uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void encodeRecord(uint8_t* p, uint16_t key, double value) {
+    bmsPutU16(p, key);
+    memcpy(p + 4, &value, sizeof(value));
+    uint16_t crc = crc16(p, 2);
+    crc = crc16(p + 4, 8, crc);
+    bmsPutU16(p + 2, crc);
+}
+
+static bool isBlank(const uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+// ========================= CONSTRUCTOR =========================
+BMSJournal::BMSJournal() {
+    for (uint16_t k = 0; k < JOURNAL_KEYS; k++) {
+        entries[k].value = 0.0;
+        entries[k].committed = NAN;
+        entries[k].threshold = 0.0;
+        entries[k].maxAge_ms = 0;
+        entries[k].lastCommit = 0;
+        entries[k].defined = false;
+    }
+    lock = portMUX_INITIALIZER_UNLOCKED;
+    partition = nullptr;
+    sectorCount = 0;
+    activeSector = 0;
+    activeSeq = 0;
+    writeSlot = 0;
+    task = nullptr;
+    syncRequested = false;
+    replayedRecords = 0;
+    recordsWritten = 0;
+    sectorsErased = 0;
+    writeErrors = 0;
+    maxWriteUs = 0;
+    maxEraseUs = 0;
+}
+
+bool BMSJournal::begin() {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                         ESP_PARTITION_SUBTYPE_ANY, "journal");
+    if (partition == nullptr) {
+        Serial.println("Journal: partition 'journal' not found (check partitions.csv)");
+        return false;
+    }
+    sectorCount = partition->size / JOURNAL_SECTOR_SIZE;
+    if (sectorCount > JOURNAL_MAX_SECTORS) sectorCount = JOURNAL_MAX_SECTORS;
+    if (sectorCount < 2) {
+        Serial.println("Journal: partition too small (need >= 2 sectors)");
+        partition = nullptr;
+        return false;
+    }
+
+    // Sắp các sector hợp lệ theo seq tăng dần rồi replay lần lượt
+    uint16_t order[JOURNAL_MAX_SECTORS];
+    uint32_t seqs[JOURNAL_MAX_SECTORS];
+    uint16_t valid = 0;
+    for (uint16_t s = 0; s < sectorCount; s++) {
+        uint32_t seq;
+        if (!readSectorSeq(s, seq)) continue;
+        uint16_t i = valid++;
+        while (i > 0 && seqs[i - 1] > seq) {
+            seqs[i] = seqs[i - 1];
+            order[i] = order[i - 1];
+            i--;
+        }
+        seqs[i] = seq;
+        order[i] = s;
+    }
+
+    for (uint16_t i = 0; i < valid; i++) {
+        writeSlot = replaySector(order[i]);
+    }
+
+    if (valid == 0) {
+        if (!startSector(0, 1)) {
+            partition = nullptr;
+            return false;
+        }
+    } else {
+        activeSector = order[valid - 1];
+        activeSeq = seqs[valid - 1];
+    }
+
+    if (xTaskCreatePinnedToCore(commitTask, "bms_journal", 3072, this, 1, &task, 0) != pdPASS) {
+        Serial.println("Journal: failed to start commit task");
+        partition = nullptr;
+        return false;
+    }
+
+    Serial.printf("Journal initialized: %u sectors, active %u (seq %lu, %u/%u slots), %lu records replayed\n",
+                  sectorCount, activeSector, (unsigned long)activeSeq,
+                  writeSlot, (unsigned)JOURNAL_SLOTS, (unsigned long)replayedRecords);
+    return true;
+}
+
+bool BMSJournal::isReady() const {
+    return partition != nullptr;
+}
+
+// ========================= REPLAY =========================
+bool BMSJournal::readSectorSeq(uint16_t sector, uint32_t& seq) {
+    uint8_t header[JOURNAL_HEADER_SIZE];
+    if (esp_partition_read(partition, (size_t)sector * JOURNAL_SECTOR_SIZE,
+                           header, sizeof(header)) != ESP_OK) return false;
+    if (bmsGetU32(header) != JOURNAL_MAGIC || header[12] != JOURNAL_VERSION) return false;
+    seq = bmsGetU32(header + 4);
+    return (seq ^ bmsGetU32(header + 8)) == 0xFFFFFFFFUL;
+}
+
+// Áp mọi record hợp lệ của sector, trả về slot trống đầu tiên
+uint16_t BMSJournal::replaySector(uint16_t sector) {
+    size_t base = (size_t)sector * JOURNAL_SECTOR_SIZE + JOURNAL_HEADER_SIZE;
+    uint8_t rec[JOURNAL_RECORD_SIZE];
+    uint16_t end = 0;
+
+    for (uint16_t slot = 0; slot < JOURNAL_SLOTS; slot++) {
+        if (esp_partition_read(partition, base + (size_t)slot * JOURNAL_RECORD_SIZE,
+                               rec, sizeof(rec)) != ESP_OK) break;
+        if (isBlank(rec, sizeof(rec))) break;
+        end = slot + 1;   // record hỏng (mất điện khi ghi) vẫn chiếm slot
+
+        uint16_t key = bmsGetU16(rec);
+        uint16_t crc = crc16(rec, 2);
+        crc = crc16(rec + 4, 8, crc);
+        if (key >= JOURNAL_KEYS || crc != bmsGetU16(rec + 2)) continue;
+
+        double value;
+        memcpy(&value, rec + 4, sizeof(value));
+        entries[key].value = value;
+        entries[key].committed = value;
+        replayedRecords++;
+    }
+    return end;
+}
+
+// ========================= GHI FLASH (task nền) =========================
+bool BMSJournal::startSector(uint16_t sector, uint32_t seq) {
+    size_t offset = (size_t)sector * JOURNAL_SECTOR_SIZE;
+
+    uint32_t start = micros();
+    if (esp_partition_erase_range(partition, offset, JOURNAL_SECTOR_SIZE) != ESP_OK) {
+        writeErrors++;
+        return false;
+    }
+    uint32_t elapsed = micros() - start;
+    if (elapsed > maxEraseUs) maxEraseUs = elapsed;
+    sectorsErased++;
+
+    uint8_t header[JOURNAL_HEADER_SIZE];
+    memset(header, 0xFF, sizeof(header));
+    bmsPutU32(header, JOURNAL_MAGIC);
+    bmsPutU32(header + 4, seq);
+    bmsPutU32(header + 8, ~seq);
+    header[12] = JOURNAL_VERSION;
+    if (esp_partition_write(partition, offset, header, sizeof(header)) != ESP_OK) {
+        writeErrors++;
+        return false;
+    }
+
+    activeSector = sector;
+    activeSeq = seq;
+    writeSlot = 0;
+    return true;
+}
+
+bool BMSJournal::appendRecord(uint16_t key, double value) {
+    if (writeSlot >= JOURNAL_SLOTS) {
+        // Sector đầy: sang sector kế tiếp, snapshot toàn bộ giá trị đã ghi
+        // để các sector cũ hơn không còn cần thiết khi bị xoá vòng sau
+        if (!startSector((activeSector + 1) % sectorCount, activeSeq + 1)) return false;
+        for (uint16_t k = 0; k < JOURNAL_KEYS; k++) {
+            if (k == key || isnan(entries[k].committed)) continue;
+            if (!appendRecord(k, entries[k].committed)) return false;
+        }
+    }
+
+    uint8_t rec[JOURNAL_RECORD_SIZE];
+    encodeRecord(rec, key, value);
+    size_t offset = (size_t)activeSector * JOURNAL_SECTOR_SIZE + JOURNAL_HEADER_SIZE +
+                    (size_t)writeSlot * JOURNAL_RECORD_SIZE;
+
+    uint32_t start = micros();
+    esp_err_t err = esp_partition_write(partition, offset, rec, sizeof(rec));
+    uint32_t elapsed = micros() - start;
+    if (elapsed > maxWriteUs) maxWriteUs = elapsed;
+
+    writeSlot++;
+    if (err != ESP_OK) {
+        writeErrors++;
+        return false;
+    }
+    recordsWritten++;
+    return true;
+}
+
+void BMSJournal::commitPending(bool force) {
+    unsigned long now = millis();
+
+    for (uint16_t k = 0; k < JOURNAL_KEYS; k++) {
+        Entry& e = entries[k];
+        if (!e.defined) continue;
+
+        portENTER_CRITICAL(&lock);
+        double value = e.value;
+        portEXIT_CRITICAL(&lock);
+
+        if (value == e.committed) continue;
+
+        bool due = force || isnan(e.committed) ||
+                   fabs(value - e.committed) >= e.threshold ||
+                   now - e.lastCommit >= e.maxAge_ms;
+        if (!due) continue;
+
+        if (appendRecord(k, value)) {
+            e.committed = value;
+            e.lastCommit = now;
+        }
+    }
+}
+
+void BMSJournal::commitTask(void* arg) {
+    BMSJournal* self = static_cast<BMSJournal*>(arg);
+
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(JOURNAL_COMMIT_PERIOD));
+        bool force = self->syncRequested;
+        self->syncRequested = false;
+        self->commitPending(force);
+    }
+}
+
+// ========================= API =========================
+double BMSJournal::define(JournalKey key, double defaultValue, double threshold, uint32_t maxAge_ms) {
+    if (key >= JOURNAL_KEYS) return defaultValue;
+    Entry& e = entries[key];
+
+    portENTER_CRITICAL(&lock);
+    if (isnan(e.committed)) e.value = defaultValue;
+    e.threshold = threshold;
+    e.maxAge_ms = maxAge_ms;
+    e.lastCommit = millis();
+    e.defined = true;
+    double value = e.value;
+    portEXIT_CRITICAL(&lock);
+
+    return value;
+}
+
+bool BMSJournal::has(JournalKey key) const {
+    return key < JOURNAL_KEYS && !isnan(entries[key].committed);
+}
+
+double BMSJournal::get(JournalKey key) const {
+    if (key >= JOURNAL_KEYS) return 0.0;
+    portENTER_CRITICAL((portMUX_TYPE*)&lock);
+    double value = entries[key].value;
+    portEXIT_CRITICAL((portMUX_TYPE*)&lock);
+    return value;
+}
+
+void BMSJournal::set(JournalKey key, double value) {
+    if (key >= JOURNAL_KEYS) return;
+    portENTER_CRITICAL(&lock);
+    entries[key].value = value;
+    portEXIT_CRITICAL(&lock);
+}
+
+void BMSJournal::sync() {
+    syncRequested = true;
+}
+
+uint32_t BMSJournal::getRecordsWritten() const {
+    return recordsWritten;
+}
+
+uint32_t BMSJournal::getMaxWriteUs() const {
+    return maxWriteUs;
+}
+
+uint32_t BMSJournal::getMaxEraseUs() const {
+    return maxEraseUs;
+}
+
+// ========================= DEBUG =========================
+void BMSJournal::printStatus() {
+    Serial.println("\n╔═══ JOURNAL STATUS ═══╗");
+    if (partition == nullptr) {
+        Serial.println("Not ready (no 'journal' partition)");
+        Serial.println("╚══════════════════════╝\n");
+        return;
+    }
+
+    Serial.printf("Sector %u/%u, seq %lu, slot %u/%u\n",
+                  activeSector, sectorCount, (unsigned long)activeSeq,
+                  writeSlot, (unsigned)JOURNAL_SLOTS);
+    Serial.printf("Replayed: %lu, written: %lu, erased: %lu, errors: %lu\n",
+                  (unsigned long)replayedRecords, (unsigned long)recordsWritten,
+                  (unsigned long)sectorsErased, (unsigned long)writeErrors);
+    Serial.printf("Max write: %luus, max erase: %luus\n",
+                  (unsigned long)maxWriteUs, (unsigned long)maxEraseUs);
+    for (uint16_t k = 0; k < JOURNAL_KEYS; k++) {
+        if (!entries[k].defined) continue;
+        Serial.printf("  key %2u: %.4f (flash %.4f)\n", k, get((JournalKey)k), entries[k].committed);
+    }
+    Serial.println("╚══════════════════════╝\n");
+}
@@ -0,0 +1,429 @@
+#include "bms_logger.h"
+#include <ArduinoJson.h>
+
+// ========================= CONSTRUCTOR =========================
+BMSLogger::BMSLogger() {
+    partition = nullptr;
+    totalBlocks = 0;
+    segmentCount = 0;
+    pending[0] = pending[1] = false;
+    active = 0;
+    activeCount = 0;
+    activeStart = 0;
+    nextSeq = 0;
+    firstSeq = 0;
+    writtenSeq = 0;
+    queue = nullptr;
+    task = nullptr;
+    decimation = LOG_DEFAULT_DECIMATION;
+    decimationCounter = 0;
+    bootCount = 0;
+    service = nullptr;
+    droppedRecords = 0;
+    blocksWritten = 0;
+    writeErrors = 0;
+    lastWriteMs = 0;
+    maxWriteMs = 0;
+}
+
+bool BMSLogger::begin() {
+    prefs.begin("bms_log", false);
+    bootCount = prefs.getUShort("boot", 0) + 1;
+    prefs.putUShort("boot", bootCount);
+    decimation = prefs.getUShort("decim", LOG_DEFAULT_DECIMATION);
+    prefs.end();
+    if (decimation == 0) decimation = LOG_DEFAULT_DECIMATION;
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                         ESP_PARTITION_SUBTYPE_ANY, "bmslog");
+    if (partition == nullptr) {
+        Serial.println("Logger: partition 'bmslog' not found (check partitions.csv)");
+        return false;
+    }
+
+    segmentCount = partition->size / (BMS_LOG_BLOCK_SIZE * LOG_SEGMENT_BLOCKS);
+    totalBlocks = segmentCount * LOG_SEGMENT_BLOCKS;
+
+    scan();
+
+    queue = xQueueCreate(2, sizeof(WriteJob));
+    if (queue == nullptr ||
+        xTaskCreatePinnedToCore(writerTask, "bms_log", 4096, this, 1, &task, 0) != pdPASS) {
+        Serial.println("Logger: failed to start writer task");
+        partition = nullptr;
+        return false;
+    }
+
+    Serial.printf("Logger initialized: %u segments x %u KB, boot #%u, next block %lu\n",
+                  segmentCount, (unsigned)(LOG_SEGMENT_BLOCKS * BMS_LOG_BLOCK_SIZE / 1024),
+                  bootCount, (unsigned long)nextSeq);
+    return true;
+}
+
+// ========================= QUÉT KHI KHỞI ĐỘNG =========================
+// Chỉ đọc header 16 byte mỗi sector để tìm block mới nhất/cũ nhất
+void BMSLogger::scan() {
+    uint8_t header[BMS_LOG_HEADER_SIZE];
+    BMSLogBlockHeader h;
+    bool found = false;
+    uint32_t minSeq = 0, maxSeq = 0;
+
+    for (uint16_t i = 0; i < totalBlocks; i++) {
+        if (esp_partition_read(partition, (size_t)i * BMS_LOG_BLOCK_SIZE,
+                               header, sizeof(header)) != ESP_OK) continue;
+        if (!bmsLogReadHeader(header, h)) continue;
+        if (h.seq % totalBlocks != i) continue;   // header không khớp vị trí
+
+        if (!found || h.seq > maxSeq) maxSeq = h.seq;
+        if (!found || h.seq < minSeq) minSeq = h.seq;
+        found = true;
+    }
+
+    nextSeq = found ? maxSeq + 1 : 0;
+    firstSeq = found ? minSeq : 0;
+    writtenSeq = nextSeq;
+}
+
+// ========================= GHI RECORD =========================
+void BMSLogger::addSample(BMSLogRecord& record) {
+    if (partition == nullptr) return;
+    if (++decimationCounter < decimation) return;
+    decimationCounter = 0;
+
+    // Cả 2 buffer đều đang chờ ghi flash → bỏ record, không chặn loop()
+    if (pending[active]) {
+        droppedRecords++;
+        return;
+    }
+
+    uint8_t* block = buffers[active];
+    if (activeCount == 0) {
+        memset(block, 0xFF, BMS_LOG_BLOCK_SIZE);
+        activeStart = millis();
+    }
+
+    record.uptime_ms = millis();
+    record.boot = bootCount;
+    bmsLogEncodeRecord(record, block + BMS_LOG_HEADER_SIZE + activeCount * BMS_LOG_RECORD_SIZE);
+    activeCount++;
+
+    if (activeCount >= BMS_LOG_RECORDS_PER_BLOCK ||
+        millis() - activeStart >= LOG_FLUSH_INTERVAL) {
+        submit();
+    }
+}
+
+void BMSLogger::flush() {
+    if (partition == nullptr || pending[active]) return;
+    submit();
+}
+
+// Giao buffer hiện tại cho task nền, chuyển sang buffer còn lại
+void BMSLogger::submit() {
+    if (activeCount == 0) return;
+
+    WriteJob job = { active, activeCount, nextSeq };
+    pending[active] = true;
+    if (xQueueSend(queue, &job, 0) != pdTRUE) {
+        pending[active] = false;
+        droppedRecords += activeCount;
+        activeCount = 0;
+        return;
+    }
+
+    // Sector của block này đang giữ block cũ nhất
+    if (nextSeq + 1 > totalBlocks && nextSeq + 1 - totalBlocks > firstSeq) {
+        firstSeq = nextSeq + 1 - totalBlocks;
+    }
+    nextSeq++;
+    active ^= 1;
+    activeCount = 0;
+}
+
+// ========================= TASK NỀN =========================
+void BMSLogger::writeBlock(const WriteJob& job) {
+    uint8_t* block = buffers[job.buffer];
+    size_t offset = (size_t)(job.seq % totalBlocks) * BMS_LOG_BLOCK_SIZE;
+    unsigned long start = millis();
+
+    bmsLogSealBlock(block, job.seq, job.count);
+
+    if (esp_partition_erase_range(partition, offset, BMS_LOG_BLOCK_SIZE) != ESP_OK ||
+        esp_partition_write(partition, offset, block, BMS_LOG_BLOCK_SIZE) != ESP_OK) {
+        writeErrors++;
+        return;
+    }
+
+    blocksWritten++;
+    lastWriteMs = millis() - start;
+    if (lastWriteMs > maxWriteMs) maxWriteMs = lastWriteMs;
+}
+
+void BMSLogger::writerTask(void* arg) {
+    BMSLogger* self = static_cast<BMSLogger*>(arg);
+    WriteJob job;
+
+    for (;;) {
+        if (xQueueReceive(self->queue, &job, portMAX_DELAY) == pdTRUE) {
+            self->writeBlock(job);
+            self->writtenSeq = job.seq + 1;
+            self->pending[job.buffer] = false;
+        }
+    }
+}
+
+// ========================= CẤU HÌNH =========================
+bool BMSLogger::isReady() const {
+    return partition != nullptr;
+}
+
+uint16_t BMSLogger::getBootCount() const {
+    return bootCount;
+}
+
+uint16_t BMSLogger::getDecimation() const {
+    return decimation;
+}
+
+void BMSLogger::setDecimation(uint16_t value) {
+    if (value == 0) return;
+    decimation = value;
+    decimationCounter = 0;
+
+    prefs.begin("bms_log", false);
+    prefs.putUShort("decim", decimation);
+    prefs.end();
+}
+
+uint16_t BMSLogger::getSegmentCount() const {
+    return segmentCount;
+}
+
+uint32_t BMSLogger::getFirstSeq() const {
+    return firstSeq;
+}
+
+uint32_t BMSLogger::getWrittenSeq() const {
+    return writtenSeq;
+}
+
+void BMSLogger::setStreamService(LogStreamService fn) {
+    service = fn;
+}
+
+// ========================= TẢI VỀ =========================
+// "bytes=a-b" | "bytes=a-" | "bytes=-n" → [start, end]
+// 1 = hợp lệ, 0 = bỏ qua (gửi toàn bộ), -1 = ngoài phạm vi (416)
+static int parseRange(const String& value, size_t total, size_t& start, size_t& end) {
+    if (!value.startsWith("bytes=") || value.indexOf(',') >= 0) return 0;
+    const char* p = value.c_str() + 6;
+    char* dash;
+
+    if (*p == '-') {
+        unsigned long suffix = strtoul(p + 1, nullptr, 10);
+        if (suffix == 0 || total == 0) return -1;
+        start = suffix >= total ? 0 : total - suffix;
+        end = total - 1;
+        return 1;
+    }
+
+    start = strtoul(p, &dash, 10);
+    if (dash == p || *dash != '-') return 0;
+    if (start >= total) return -1;
+    end = dash[1] ? strtoul(dash + 1, nullptr, 10) : total - 1;
+    if (end >= total) end = total - 1;
+    return end >= start ? 1 : 0;
+}
+
+// bySeq: base là seq block đầu (block bị ghi đè/chưa ghi → false)
+//  khác: base là vị trí block trong partition
+bool BMSLogger::readStreamChunk(bool bySeq, uint32_t base, size_t offset,
+                                uint8_t* buf, size_t len) {
+    uint32_t block = base + offset / BMS_LOG_BLOCK_SIZE;
+    size_t inBlock = offset % BMS_LOG_BLOCK_SIZE;
+
+    if (bySeq) {
+        if (block < firstSeq || block >= writtenSeq) return false;
+        block %= totalBlocks;
+    }
+    return esp_partition_read(partition, (size_t)block * BMS_LOG_BLOCK_SIZE + inBlock,
+                              buf, len) == ESP_OK;
+}
+
+void BMSLogger::streamBlocks(WebServer& server, bool bySeq, uint32_t base, uint32_t blocks,
+                             const char* filename) {
+    size_t total = (size_t)blocks * BMS_LOG_BLOCK_SIZE;
+    size_t start = 0, end = total - 1;
+    int range = server.hasHeader("Range") ?
+                parseRange(server.header("Range"), total, start, end) : 0;
+    char value[64];
+
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.sendHeader("Accept-Ranges", "bytes");
+
+    if (range < 0) {
+        snprintf(value, sizeof(value), "bytes */%lu", (unsigned long)total);
+        server.sendHeader("Content-Range", value);
+        server.send(416, "text/plain", "range not satisfiable");
+        return;
+    }
+
+    size_t remaining = (total == 0) ? 0 : end - start + 1;
+    snprintf(value, sizeof(value), "attachment; filename=\"%s\"", filename);
+    server.sendHeader("Content-Disposition", value);
+    server.setContentLength(remaining);
+
+    if (range > 0) {
+        snprintf(value, sizeof(value), "bytes %lu-%lu/%lu",
+                 (unsigned long)start, (unsigned long)end, (unsigned long)total);
+        server.sendHeader("Content-Range", value);
+        server.send(206, "application/octet-stream", "");
+    } else {
+        server.send(200, "application/octet-stream", "");
+    }
+
+    // Chunk không vượt biên 1 KB → không vượt biên block; block hỏng gửi 0xFF (host bỏ qua)
+    uint8_t buf[LOG_STREAM_CHUNK];
+    size_t offset = start;
+    while (remaining > 0) {
+        size_t n = LOG_STREAM_CHUNK - (offset % LOG_STREAM_CHUNK);
+        if (n > remaining) n = remaining;
+
+        if (!readStreamChunk(bySeq, base, offset, buf, n)) {
+            memset(buf, 0xFF, n);
+        }
+        server.sendContent((const char*)buf, n);
+        offset += n;
+        remaining -= n;
+
+        if (!server.client().connected()) break;
+        if (service) service();
+    }
+}
+
+void BMSLogger::streamSegment(WebServer& server, uint16_t segment) {
+    char name[32];
+    snprintf(name, sizeof(name), "bmslog_seg%02u.bin", segment);
+    streamBlocks(server, false, (uint32_t)segment * LOG_SEGMENT_BLOCKS, LOG_SEGMENT_BLOCKS, name);
+}
+
+// Block đọc ra để chuyển CSV (loop task, không đệ quy)
+static uint8_t exportBlock[BMS_LOG_BLOCK_SIZE];
+
+void BMSLogger::streamExport(WebServer& server, uint32_t fromSeq, uint32_t toSeq, bool csv) {
+    if (fromSeq < firstSeq) fromSeq = firstSeq;
+    if (toSeq > writtenSeq) toSeq = writtenSeq;
+    if (toSeq < fromSeq) toSeq = fromSeq;
+
+    // Client tiếp tục tải (Range) với đúng from/to này
+    char value[16];
+    snprintf(value, sizeof(value), "%lu", (unsigned long)fromSeq);
+    server.sendHeader("X-Log-From", value);
+    snprintf(value, sizeof(value), "%lu", (unsigned long)toSeq);
+    server.sendHeader("X-Log-To", value);
+    server.sendHeader("Access-Control-Expose-Headers", "X-Log-From, X-Log-To, Content-Range");
+
+    if (!csv) {
+        char name[48];
+        snprintf(name, sizeof(name), "bmslog_%lu_%lu.bin",
+                 (unsigned long)fromSeq, (unsigned long)toSeq);
+        streamBlocks(server, true, fromSeq, toSeq - fromSeq, name);
+        return;
+    }
+
+    char buf[512];
+    size_t len = 0;
+
+    auto flush = [&]() {
+        if (len > 0) {
+            server.sendContent(buf, len);
+            len = 0;
+        }
+        if (service) service();
+    };
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.send(200, "text/csv", "");
+
+    len = snprintf(buf, sizeof(buf), "block,boot,uptime_ms,cell1_V,cell2_V,cell3_V,cell4_V,"
+                                     "current_A,temp_C,soc_pct,alarms,flags\n");
+
+    BMSLogBlockHeader h;
+    BMSLogRecord r;
+    for (uint32_t seq = fromSeq; seq < toSeq; seq++) {
+        if (seq < firstSeq) continue;   // bị ghi đè trong lúc tải
+        if (esp_partition_read(partition, (size_t)(seq % totalBlocks) * BMS_LOG_BLOCK_SIZE,
+                               exportBlock, BMS_LOG_BLOCK_SIZE) != ESP_OK) continue;
+        if (!bmsLogCheckBlock(exportBlock, h) || h.seq != seq) continue;
+
+        for (uint16_t i = 0; i < h.count; i++) {
+            bmsLogDecodeRecord(exportBlock + BMS_LOG_HEADER_SIZE + i * BMS_LOG_RECORD_SIZE, r);
+            if (len + 96 > sizeof(buf)) flush();
+            len += snprintf(buf + len, sizeof(buf) - len,
+                            "%lu,%u,%lu,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,0x%04X,0x%02X\n",
+                            (unsigned long)seq, r.boot, (unsigned long)r.uptime_ms,
+                            r.cell_mV[0] / 1000.0f, r.cell_mV[1] / 1000.0f,
+                            r.cell_mV[2] / 1000.0f, r.cell_mV[3] / 1000.0f,
+                            r.current_mA / 1000.0f, r.temp_dC / 10.0f, r.soc_pm / 10.0f,
+                            r.alarms, r.flags);
+        }
+        if (!server.client().connected()) break;
+    }
+
+    flush();
+    server.sendContent("");
+}
+
+void BMSLogger::sendInfo(WebServer& server) {
+    StaticJsonDocument<512> doc;
+
+    doc["ready"] = isReady();
+    doc["partitionSize"] = partition ? partition->size : 0;
+    doc["blockSize"] = BMS_LOG_BLOCK_SIZE;
+    doc["segmentSize"] = LOG_SEGMENT_BLOCKS * BMS_LOG_BLOCK_SIZE;
+    doc["segments"] = segmentCount;
+    doc["recordSize"] = BMS_LOG_RECORD_SIZE;
+    doc["recordsPerBlock"] = BMS_LOG_RECORDS_PER_BLOCK;
+    doc["firstSeq"] = firstSeq;
+    doc["nextSeq"] = nextSeq;
+    doc["writtenSeq"] = (uint32_t)writtenSeq;
+    doc["bufferedRecords"] = activeCount;
+    doc["decimation"] = decimation;
+    doc["bootCount"] = bootCount;
+    doc["droppedRecords"] = droppedRecords;
+    doc["blocksWritten"] = (uint32_t)blocksWritten;
+    doc["writeErrors"] = (uint32_t)writeErrors;
+    doc["lastWriteMs"] = (uint32_t)lastWriteMs;
+    doc["maxWriteMs"] = (uint32_t)maxWriteMs;
+
+    String output;
+    serializeJson(doc, output);
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.send(200, "application/json", output);
+}
+
+// ========================= DEBUG =========================
+void BMSLogger::printStatus() {
+    Serial.println("\n╔═══ LOGGER STATUS ═══╗");
+    if (partition == nullptr) {
+        Serial.println("Not ready (no 'bmslog' partition)");
+        Serial.println("╚═════════════════════╝\n");
+        return;
+    }
+
+    uint32_t stored = nextSeq - firstSeq;
+    Serial.printf("Partition: %u KB, %u segments, %u blocks\n",
+                  (unsigned)(partition->size / 1024), segmentCount, totalBlocks);
+    Serial.printf("Blocks: %lu..%lu (%lu stored), buffer %u/%u records\n",
+                  (unsigned long)firstSeq, (unsigned long)nextSeq,
+                  (unsigned long)stored, activeCount, (unsigned)BMS_LOG_RECORDS_PER_BLOCK);
+    Serial.printf("Decimation: %u (every %lu ms), boot #%u\n",
+                  decimation, (unsigned long)decimation * 100UL, bootCount);
+    Serial.printf("Written: %lu blocks, errors: %lu, dropped: %lu records\n",
+                  (unsigned long)blocksWritten, (unsigned long)writeErrors,
+                  (unsigned long)droppedRecords);
+    Serial.printf("Write time: last %lums, max %lums\n",
+                  (unsigned long)lastWriteMs, (unsigned long)maxWriteMs);
+    Serial.println("╚═════════════════════╝\n");
+}
@@ -0,0 +1,162 @@
+#include "bms_metrics.h"
+#include "bms_data.h"
+#include <stdarg.h>
+
+static const uint32_t BUCKET_BOUNDS_US[METRIC_BUCKETS] = {
+    1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+};
+
+// ========================= HISTOGRAM =========================
+void MetricHistogram::observe(uint32_t value_us) {
+    uint8_t i = 0;
+    while (i < METRIC_BUCKETS && value_us > BUCKET_BOUNDS_US[i]) {
+        i++;
+    }
+    counts[i]++;
+    sum_us += value_us;
+    count++;
+}
+
+// ========================= CONSTRUCTOR =========================
+BMSMetrics::BMSMetrics() {
+    memset(&loopPeriod, 0, sizeof(loopPeriod));
+    memset(&httpDuration, 0, sizeof(httpDuration));
+    httpRequests = 0;
+    lastLoopStart = 0;
+    loopMax_us = 0;
+}
+
+// ========================= GHI NHẬN =========================
+void BMSMetrics::markLoop() {
+    unsigned long now = micros();
+    if (lastLoopStart != 0) {
+        uint32_t period = now - lastLoopStart;
+        loopPeriod.observe(period);
+        if (period > loopMax_us) loopMax_us = period;
+    }
+    lastLoopStart = now;
+}
+
+void BMSMetrics::recordHttp(uint32_t duration_us) {
+    httpRequests++;
+    httpDuration.observe(duration_us);
+}
+
+uint32_t BMSMetrics::getHttpRequests() const {
+    return httpRequests;
+}
+
+// ========================= XUẤT PROMETHEUS =========================
+namespace {
+
+// Buffer trên stack, tự flush ra socket khi gần đầy
+class MetricWriter {
+private:
+    WebServer& server;
+    char buf[768];
+    size_t len;
+
+public:
+    explicit MetricWriter(WebServer& s) : server(s), len(0) {}
+
+    void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if (len > sizeof(buf) - 160) flush();
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf + len, sizeof(buf) - len, fmt, args);
+        va_end(args);
+        if (n > 0) {
+            len += n;
+            if (len >= sizeof(buf)) len = sizeof(buf) - 1;   // bị cắt
+        }
+    }
+
+    void header(const char* name, const char* type, const char* help) {
+        printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    }
+
+    void gauge(const char* name, const char* help, float value) {
+        header(name, "gauge", help);
+        printf("%s %.4f\n", name, value);
+    }
+
+    void histogram(const char* name, const char* help, const MetricHistogram& h) {
+        header(name, "histogram", help);
+        uint32_t cumulative = 0;
+        for (uint8_t i = 0; i < METRIC_BUCKETS; i++) {
+            cumulative += h.counts[i];
+            printf("%s_bucket{le=\"%g\"} %lu\n", name,
+                   BUCKET_BOUNDS_US[i] / 1e6, (unsigned long)cumulative);
+        }
+        cumulative += h.counts[METRIC_BUCKETS];
+        printf("%s_bucket{le=\"+Inf\"} %lu\n", name, (unsigned long)cumulative);
+        printf("%s_sum %.6f\n", name, h.sum_us / 1e6);
+        printf("%s_count %lu\n", name, (unsigned long)h.count);
+    }
+
+    void flush() {
+        if (len > 0) {
+            server.sendContent(buf, len);
+            len = 0;
+        }
+    }
+};
+
+}  // namespace
+
+void BMSMetrics::stream(WebServer& server) {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/plain; version=0.0.4", "");
+
+    MetricWriter w(server);
+
+    // ----- Gauges -----
+    w.header("bms_cell_voltage_volts", "gauge", "Cell voltage");
+    for (int i = 0; i < NUM_CELLS; i++) {
+        w.printf("bms_cell_voltage_volts{cell=\"%d\"} %.3f\n", i + 1, bmsData.cellVoltages[i]);
+    }
+    w.gauge("bms_pack_voltage_volts", "Pack voltage", bmsData.packVoltage);
+    w.gauge("bms_current_amperes", "Pack current (+ charge, - discharge)", bmsData.current);
+    w.gauge("bms_temperature_celsius", "Pack temperature", bmsData.packTemp);
+    w.gauge("bms_soc_percent", "State of charge", bmsData.soc);
+    w.gauge("bms_soc_uncertainty_percent", "EKF SOC standard deviation", soc.getUncertainty());
+    w.gauge("bms_soh_percent", "State of health", bmsData.soh);
+    w.gauge("bms_uptime_seconds", "Time since boot", millis() / 1000.0f);
+    w.gauge("bms_loop_period_max_seconds", "Longest main loop period since boot", loopMax_us / 1e6f);
+    w.gauge("bms_journal_write_max_seconds", "Longest journal record write", journal.getMaxWriteUs() / 1e6f);
+    w.gauge("bms_journal_erase_max_seconds", "Longest journal sector erase", journal.getMaxEraseUs() / 1e6f);
+
+    // ----- Counters -----
+    w.header("bms_protection_trips_total", "counter", "Protection trips by type");
+    for (int i = 0; i < PROT_COUNT; i++) {
+        ProtectionType type = (ProtectionType)i;
+        w.printf("bms_protection_trips_total{type=\"%s\"} %lu\n",
+                 BMSProtection::getTypeName(type), (unsigned long)protection.getTripCount(type));
+    }
+
+    w.header("bms_balancing_seconds_total", "counter", "Balancing resistor on-time per cell");
+    for (int i = 0; i < NUM_CELLS; i++) {
+        w.printf("bms_balancing_seconds_total{cell=\"%d\"} %.1f\n",
+                 i + 1, balancing.getBalancingSeconds(i + 1));
+    }
+
+    w.header("bms_charge_ampere_hours_total", "counter", "Charge throughput since boot");
+    w.printf("bms_charge_ampere_hours_total{direction=\"in\"} %.6f\n", soc.getChargeInAh());
+    w.printf("bms_charge_ampere_hours_total{direction=\"out\"} %.6f\n", soc.getChargeOutAh());
+
+    w.header("bms_http_requests_total", "counter", "HTTP requests handled");
+    w.printf("bms_http_requests_total %lu\n", (unsigned long)httpRequests);
+
+    w.header("bms_journal_records_total", "counter", "Records appended to the state journal");
+    w.printf("bms_journal_records_total %lu\n", (unsigned long)journal.getRecordsWritten());
+
+    w.header("bms_dwin_frames_total", "counter", "Frames written to the DWIN display");
+    w.printf("bms_dwin_frames_total %lu\n", (unsigned long)dwin.getFrameCount());
+
+    // ----- Histograms -----
+    w.histogram("bms_loop_period_seconds", "Main loop period", loopPeriod);
+    w.histogram("bms_http_request_duration_seconds", "HTTP handler time", httpDuration);
+
+    w.flush();
+    server.sendContent("");
+}
@@ -0,0 +1,133 @@
+#include "bms_power.h"
+#include "bms_ocv.h"
+
+// ========================= CONSTRUCTOR =========================
+BMSPower::BMSPower()
+    : cells(nullptr),
+      resistance(nullptr),
+      avgCurrent(0.0f),
+      tteMinutes(NAN),
+      ttfMinutes(NAN),
+      lastUpdate(0)
+{
+    for (uint8_t h = 0; h < SOP_HORIZONS; h++) {
+        limits[h] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        decay[h] = expf(-SOP_HORIZON_S[h] / SOP_TAU_S);
+    }
+}
+
+void BMSPower::attach(const SOCCells& cellSoc, const BMSResistance& ir) {
+    cells = &cellSoc;
+    resistance = &ir;
+}
+
+// ========================= HÀM NỘI BỘ =========================
+float BMSPower::tempDerate(float temp, float tMin, float tMax) {
+    if (isnan(temp)) return 1.0f;
+    if (temp <= tMin || temp >= tMax) return 0.0f;
+    return fminf(fminf((temp - tMin) / SOP_TEMP_RAMP, (tMax - temp) / SOP_TEMP_RAMP), 1.0f);
+}
+
+// ========================= CẬP NHẬT =========================
+void BMSPower::update(float current_A, float temperature, float rcVoltage, float packSOC,
+                      float packCapacity_Ah, bool chargeAllowed, bool dischargeAllowed) {
+    unsigned long now = millis();
+    float dt = lastUpdate ? (now - lastUpdate) / 1000.0f : 0.0f;
+    lastUpdate = now;
+
+    // ---------- TTE / TTF ----------
+    if (!isnan(current_A)) {
+        avgCurrent += fminf(dt / SOP_AVG_TAU_S, 1.0f) * (current_A - avgCurrent);
+    }
+    tteMinutes = NAN;
+    ttfMinutes = NAN;
+    if (avgCurrent <= -SOP_MIN_CURRENT) {
+        tteMinutes = packSOC / 100.0f * packCapacity_Ah / -avgCurrent * 60.0f;
+    } else if (avgCurrent >= SOP_MIN_CURRENT) {
+        ttfMinutes = (100.0f - packSOC) / 100.0f * packCapacity_Ah / avgCurrent * 60.0f;
+    }
+
+    if (cells == nullptr || resistance == nullptr) return;
+
+    // ---------- SOP ----------
+    float temp = isnan(temperature) ? 25.0f : temperature;
+    float v1 = isnan(rcVoltage) ? 0.0f : rcVoltage / SOC_CELLS;
+    float chargeCap = chargeAllowed ?
+        SOP_CHARGE_LIMIT_A * tempDerate(temperature, SOP_CHARGE_T_MIN, SOP_CHARGE_T_MAX) : 0.0f;
+    float dischargeCap = dischargeAllowed ?
+        SOP_DISCHARGE_LIMIT_A * tempDerate(temperature, SOP_DISCHARGE_T_MIN, SOP_DISCHARGE_T_MAX) : 0.0f;
+
+    // Phần không phụ thuộc horizon, tính 1 lần mỗi cell
+    float ocv[SOC_CELLS], slope[SOC_CELLS], r0[SOC_CELLS], r1[SOC_CELLS], cap[SOC_CELLS];
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        ocv[i] = bmsOcvCell(cells->getSOC(i), temp, &slope[i]);
+        r0[i] = resistance->getResistance(i, temp);
+        r1[i] = SOP_R1_OHM * r0[i] / resistance->getR25(i);
+        cap[i] = cells->getCapacityAh(i);
+    }
+
+    for (uint8_t h = 0; h < SOP_HORIZONS; h++) {
+        float a = decay[h];
+        float chargeA = chargeCap;
+        float dischargeA = dischargeCap;
+        float rEff[SOC_CELLS], vRest[SOC_CELLS];
+
+        for (uint8_t i = 0; i < SOC_CELLS; i++) {
+            rEff[i] = r0[i] + r1[i] * (1.0f - a) + slope[i] * SOP_HORIZON_S[h] / (36.0f * cap[i]);
+            vRest[i] = ocv[i] + v1 * a;
+            chargeA = fminf(chargeA, (SOP_CELL_V_MAX - vRest[i]) / rEff[i]);
+            dischargeA = fminf(dischargeA, (vRest[i] - SOP_CELL_V_MIN) / rEff[i]);
+        }
+        chargeA = fmaxf(chargeA, 0.0f);
+        dischargeA = fmaxf(dischargeA, 0.0f);
+
+        // Điện áp pack dự đoán tại dòng giới hạn
+        float vChg = 0.0f, vDsg = 0.0f;
+        for (uint8_t i = 0; i < SOC_CELLS; i++) {
+            vChg += vRest[i] + chargeA * rEff[i];
+            vDsg += vRest[i] - dischargeA * rEff[i];
+        }
+
+        limits[h].charge_A = chargeA;
+        limits[h].discharge_A = dischargeA;
+        limits[h].charge_W = chargeA * vChg;
+        limits[h].discharge_W = dischargeA * vDsg;
+    }
+}
+
+// ========================= GETTERS =========================
+const SOPLimit& BMSPower::getLimit(uint8_t horizon) const {
+    return limits[horizon < SOP_HORIZONS ? horizon : SOP_HORIZONS - 1];
+}
+
+float BMSPower::getAvgCurrent() const {
+    return avgCurrent;
+}
+
+float BMSPower::getTimeToEmpty() const {
+    return tteMinutes;
+}
+
+float BMSPower::getTimeToFull() const {
+    return ttfMinutes;
+}
+
+// ========================= DEBUG =========================
+void BMSPower::printStatus() {
+    Serial.println("\n╔═══ STATE OF POWER ═══╗");
+    Serial.println("Horizon   Charge          Discharge");
+    for (uint8_t h = 0; h < SOP_HORIZONS; h++) {
+        const SOPLimit& l = limits[h];
+        Serial.printf("%5.0fs  %5.2fA %5.1fW   %5.2fA %5.1fW\n", SOP_HORIZON_S[h],
+                      l.charge_A, l.charge_W, l.discharge_A, l.discharge_W);
+    }
+    Serial.printf("Avg current: %+.2fA\n", avgCurrent);
+    if (!isnan(tteMinutes)) {
+        Serial.printf("Time to empty: %.0f min\n", tteMinutes);
+    } else if (!isnan(ttfMinutes)) {
+        Serial.printf("Time to full: %.0f min\n", ttfMinutes);
+    } else {
+        Serial.println("Time to empty/full: idle");
+    }
+    Serial.println("╚══════════════════════╝\n");
+}
@@ -14,6 +14,11 @@ BMSProtection::BMSProtection() {
     dsg_uv_recover_timer = 0;
     dsg_oc_recover_timer = 0;
     dsg_temp_recover_timer = 0;
+    
+    for (int i = 0; i < PROT_COUNT; i++) {
+        tripCount[i] = 0;
+    }
+    tripQueueLen = 0;
 }
 
 void BMSProtection::begin() {
@@ -28,6 +33,17 @@ void BMSProtection::begin() {
     Serial.println("Protection initialized - MOSFETs enabled");
 }
 
+// Ghi nhận một lần trip: đếm cho /metrics, giữ nguyên nhân cho black-box
+void BMSProtection::recordTrip(ProtectionType type, float value) {
+    tripCount[type]++;
+    // Mỗi loại bảo vệ chốt fault nên không trip lại trước khi được lấy ra
+    if (tripQueueLen < PROT_COUNT) {
+        tripQueue[tripQueueLen] = type;
+        tripQueueValue[tripQueueLen] = value;
+        tripQueueLen++;
+    }
+}
+
 bool BMSProtection::checkChargeOV(float cell1, float cell2, float cell3, float cell4) {
     unsigned long now = millis();
     
@@ -40,6 +56,7 @@ bool BMSProtection::checkChargeOV(float cell1, float cell2, float cell3, float c
     if (!chg_ov_fault) {
         if (ov_trip) {
             chg_ov_fault = true;
+            recordTrip(PROT_CHG_OV, fmaxf(fmaxf(cell1, cell2), fmaxf(cell3, cell4)));
             Serial.println("CHG OV Protection triggered!");
         }
     } else {
@@ -69,6 +86,7 @@ bool BMSProtection::checkChargeOC(float current) {
     if (!chg_oc_fault) {
         if (oc_trip) {
             chg_oc_fault = true;
+            recordTrip(PROT_CHG_OC, current);
             Serial.printf("CHG OC Protection: %.2fA\n", current);
         }
     } else {
@@ -98,6 +116,7 @@ bool BMSProtection::checkChargeTemp(float temp) {
     if (!chg_temp_fault) {
         if (temp_trip) {
             chg_temp_fault = true;
+            recordTrip(PROT_CHG_TEMP, temp);
             Serial.printf("CHG TEMP Protection: %.1f°C\n", temp);
         }
     } else {
@@ -130,6 +149,7 @@ bool BMSProtection::checkDischargeUV(float cell1, float cell2, float cell3, floa
     if (!dsg_uv_fault) {
         if (uv_trip) {
             dsg_uv_fault = true;
+            recordTrip(PROT_DSG_UV, fminf(fminf(cell1, cell2), fminf(cell3, cell4)));
             Serial.println("DSG UV Protection triggered!");
         }
     } else {
@@ -159,6 +179,7 @@ bool BMSProtection::checkDischargeOC(float current) {
     if (!dsg_oc_fault) {
         if (oc_trip) {
             dsg_oc_fault = true;
+            recordTrip(PROT_DSG_OC, current);
             Serial.printf("DSG OC Protection: %.2fA\n", current);
         }
     } else {
@@ -188,6 +209,7 @@ bool BMSProtection::checkDischargeTemp(float temp) {
     if (!dsg_temp_fault) {
         if (temp_trip) {
             dsg_temp_fault = true;
+            recordTrip(PROT_DSG_TEMP, temp);
             Serial.printf("DSG TEMP Protection: %.1f°C\n", temp);
         }
     } else {
@@ -210,13 +232,17 @@ bool BMSProtection::checkDischargeTemp(float temp) {
 
 void BMSProtection::update(float cell1, float cell2, float cell3, float cell4, 
                            float current, float temp) {
-    bool chg_fault = checkChargeOV(cell1, cell2, cell3, cell4) ||
-                     checkChargeOC(current) ||
-                     checkChargeTemp(temp);
+    // Đánh giá mọi bảo vệ mỗi chu kỳ (không short-circuit) để trip đồng
+    // thời đều được ghi nhận và bộ đếm phục hồi của từng loại vẫn chạy
+    bool chg_ov = checkChargeOV(cell1, cell2, cell3, cell4);
+    bool chg_oc = checkChargeOC(current);
+    bool chg_temp = checkChargeTemp(temp);
+    bool chg_fault = chg_ov || chg_oc || chg_temp;
     
-    bool dsg_fault = checkDischargeUV(cell1, cell2, cell3, cell4) ||
-                     checkDischargeOC(current) ||
-                     checkDischargeTemp(temp);
+    bool dsg_uv = checkDischargeUV(cell1, cell2, cell3, cell4);
+    bool dsg_oc = checkDischargeOC(current);
+    bool dsg_temp = checkDischargeTemp(temp);
+    bool dsg_fault = dsg_uv || dsg_oc || dsg_temp;
     
     digitalWrite(PIN_CHG, chg_fault ? LOW : HIGH);
     digitalWrite(PIN_DSG, dsg_fault ? LOW : HIGH);
@@ -242,6 +268,34 @@ bool BMSProtection::getDischargeMosfetState() const {
     return digitalRead(PIN_DSG);
 }
 
+uint32_t BMSProtection::getTripCount(ProtectionType type) const {
+    return (type < PROT_COUNT) ? tripCount[type] : 0;
+}
+
+bool BMSProtection::takeTrip(ProtectionType& type, float& value) {
+    if (tripQueueLen == 0) return false;
+    type = tripQueue[0];
+    value = tripQueueValue[0];
+    tripQueueLen--;
+    for (uint8_t i = 0; i < tripQueueLen; i++) {
+        tripQueue[i] = tripQueue[i + 1];
+        tripQueueValue[i] = tripQueueValue[i + 1];
+    }
+    return true;
+}
+
+const char* BMSProtection::getTypeName(ProtectionType type) {
+    switch (type) {
+        case PROT_CHG_OV:   return "chg_ov";
+        case PROT_CHG_OC:   return "chg_oc";
+        case PROT_CHG_TEMP: return "chg_temp";
+        case PROT_DSG_UV:   return "dsg_uv";
+        case PROT_DSG_OC:   return "dsg_oc";
+        case PROT_DSG_TEMP: return "dsg_temp";
+        default:            return "unknown";
+    }
+}
+
 void BMSProtection::clearProtection() {
     Serial.println("Manually clearing all protections...");
     
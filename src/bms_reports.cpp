@@ -0,0 +1,302 @@
+#include "bms_reports.h"
+#include "bms_frame.h"
+#include <sys/time.h>
+
+#define REPORT_MAGIC  0x5244   // "DR"
+
+static const uint32_t REPORT_TRIP_SAVE_MS = 10000;   // trip → lưu ngay (tối đa 1 lần/10 s)
+
+// Giờ thực (giây) nếu đã được đặt, ngược lại 0
+static uint32_t epochNow() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec > 1600000000 ? (uint32_t)tv.tv_sec : 0;
+}
+
+// ========================= CONSTRUCTOR =========================
+BMSReports::BMSReports() {
+    memset(&current, 0, sizeof(current));
+    memset(lastTrips, 0, sizeof(lastTrips));
+    tripsPrimed = false;
+    lastChargedWh = 0.0;
+    lastDischargedWh = 0.0;
+    lastChargedAh = 0.0;
+    lastDischargedAh = 0.0;
+    energyPrimed = false;
+    lastUpdate = 0;
+    lastSave = 0;
+    bootCount = 0;
+}
+
+void BMSReports::begin(uint16_t boot) {
+    bootCount = boot;
+
+    prefs.begin("bms_rpt", true);
+    size_t len = prefs.getBytes("cur", &current, sizeof(current));
+    prefs.end();
+
+    // Tiếp tục ngày đang chạy trước khi khởi động lại
+    if (len != sizeof(current) || current.magic != REPORT_MAGIC) {
+        startDay(0);
+    }
+    current.bootLast = bootCount;
+
+    lastUpdate = millis();
+    lastSave = lastUpdate;
+
+    Serial.printf("Reports initialized: day %u (%.1fh), %u days stored\n",
+                  current.day, current.elapsed_ms / 3600000.0f, getStoredCount());
+}
+
+// ========================= HÀM NỘI BỘ =========================
+void BMSReports::startDay(uint16_t day) {
+    memset(&current, 0, sizeof(current));
+    current.magic = REPORT_MAGIC;
+    current.day = day;
+    current.bootFirst = bootCount;
+    current.bootLast = bootCount;
+    current.minCell_mV = 0xFFFF;
+    current.epochStart = epochNow();
+}
+
+void BMSReports::closeDay() {
+    char key[8];
+    snprintf(key, sizeof(key), "d%u", (unsigned)(current.day % REPORT_DAYS));
+
+    prefs.begin("bms_rpt", false);
+    prefs.putBytes(key, &current, sizeof(current));
+    prefs.end();
+
+    Serial.printf("Reports: day %u closed (+%.1fWh / -%.1fWh)\n",
+                  current.day, current.whCharged, current.whDischarged);
+
+    startDay(current.day + 1);
+    saveCurrent();
+}
+
+void BMSReports::saveCurrent() {
+    prefs.begin("bms_rpt", false);
+    prefs.putBytes("cur", &current, sizeof(current));
+    prefs.end();
+    lastSave = millis();
+}
+
+// ========================= CẬP NHẬT =========================
+void BMSReports::update(const BMSEnergy& energy, float current_A, const float cells[4], uint8_t flags,
+                        const uint32_t trips[PROT_COUNT]) {
+    unsigned long now = millis();
+    uint32_t dt = now - lastUpdate;
+    lastUpdate = now;
+    if (dt > REPORT_MAX_STEP_MS) dt = REPORT_MAX_STEP_MS;
+
+    // Năng lượng / điện lượng: phần tăng của tổng BMSEnergy (hình thang, tách
+    // tại điểm 0) thay vì tích phân lại → tổng các ngày khớp /energy.
+    // Lần đầu sau khởi động chỉ lấy mốc (tổng trọn đời nạp từ journal)
+    double chargedWh = energy.getChargedWh();
+    double dischargedWh = energy.getDischargedWh();
+    double chargedAh = energy.getChargedAh();
+    double dischargedAh = energy.getDischargedAh();
+    if (energyPrimed) {
+        current.whCharged += chargedWh - lastChargedWh;
+        current.whDischarged += dischargedWh - lastDischargedWh;
+        current.ahCharged += chargedAh - lastChargedAh;
+        current.ahDischarged += dischargedAh - lastDischargedAh;
+    }
+    lastChargedWh = chargedWh;
+    lastDischargedWh = dischargedWh;
+    lastChargedAh = chargedAh;
+    lastDischargedAh = dischargedAh;
+    energyPrimed = true;
+
+    if (current_A > 0.0f) {
+        current.peakChargeA = fmaxf(current.peakChargeA, current_A);
+    } else if (current_A < 0.0f) {
+        current.peakDischargeA = fmaxf(current.peakDischargeA, -current_A);
+    }
+
+    // Điện áp cell
+    for (uint8_t i = 0; i < 4; i++) {
+        long mV = lroundf(cells[i] * 1000.0f);
+        if (mV < 0) mV = 0;
+        if (mV > 0xFFFE) mV = 0xFFFE;
+        if (mV < current.minCell_mV) current.minCell_mV = (uint16_t)mV;
+        if (mV > current.maxCell_mV) current.maxCell_mV = (uint16_t)mV;
+    }
+
+    // Thời gian theo trạng thái
+    if (flags & BMS_FLAG_CHARGING)         current.charging_ms += dt;
+    else if (flags & BMS_FLAG_DISCHARGING) current.discharging_ms += dt;
+    else                                   current.idle_ms += dt;
+    if (flags & BMS_FLAG_BALANCING)        current.balancing_ms += dt;
+
+    // Trip: cộng phần tăng của bộ đếm tích luỹ từ lúc khởi động
+    bool tripped = false;
+    for (uint8_t t = 0; t < PROT_COUNT; t++) {
+        if (tripsPrimed && trips[t] > lastTrips[t]) {
+            uint32_t total = current.trips[t] + (trips[t] - lastTrips[t]);
+            current.trips[t] = total > 0xFFFF ? 0xFFFF : (uint16_t)total;
+            tripped = true;
+        }
+        lastTrips[t] = trips[t];
+    }
+    tripsPrimed = true;
+
+    current.elapsed_ms += dt;
+
+    if (current.elapsed_ms >= REPORT_DAY_MS) {
+        closeDay();
+    } else if (now - lastSave >= REPORT_SAVE_INTERVAL ||
+               (tripped && now - lastSave >= REPORT_TRIP_SAVE_MS)) {
+        saveCurrent();
+    }
+}
+
+// ========================= TRUY VẤN =========================
+uint8_t BMSReports::getStoredCount() const {
+    return current.day < REPORT_DAYS ? current.day : REPORT_DAYS;
+}
+
+bool BMSReports::getDay(uint8_t index, DailyReport& report) {
+    if (index >= getStoredCount()) return false;
+
+    uint16_t day = current.day - 1 - index;
+    char key[8];
+    snprintf(key, sizeof(key), "d%u", (unsigned)(day % REPORT_DAYS));
+
+    prefs.begin("bms_rpt", true);
+    size_t len = prefs.getBytes(key, &report, sizeof(report));
+    prefs.end();
+
+    return len == sizeof(report) && report.magic == REPORT_MAGIC && report.day == day;
+}
+
+const DailyReport& BMSReports::getCurrent() const {
+    return current;
+}
+
+// ========================= XUẤT JSON =========================
+void BMSReports::streamJson(WebServer& server) {
+    char buf[512];
+    size_t len = 0;
+
+    auto flush = [&]() {
+        if (len > 0) {
+            server.sendContent(buf, len);
+            len = 0;
+        }
+    };
+    auto text = [&](const char* str) {
+        size_t n = strlen(str);
+        if (len + n > sizeof(buf)) flush();
+        memcpy(buf + len, str, n);
+        len += n;
+    };
+    auto number = [&](long value) {
+        if (len + 12 > sizeof(buf)) flush();
+        len += snprintf(buf + len, sizeof(buf) - len, "%ld", value);
+    };
+    auto decimal = [&](double value, int digits) {
+        if (len + 16 > sizeof(buf)) flush();
+        len += snprintf(buf + len, sizeof(buf) - len, "%.*f", digits, value);
+    };
+    auto row = [&](const DailyReport& r, bool partial) {
+        text("[");
+        number(r.day);
+        text(",");
+        text(partial ? "true" : "false");
+        text(",");
+        number(r.bootFirst);
+        text(",");
+        number(r.bootLast);
+        text(",");
+        number(r.epochStart);
+        text(",");
+        decimal(r.elapsed_ms / 3600000.0, 2);
+        text(",");
+        decimal(r.whCharged, 2);
+        text(",");
+        decimal(r.whDischarged, 2);
+        text(",");
+        decimal(r.ahCharged, 3);
+        text(",");
+        decimal(r.ahDischarged, 3);
+        text(",");
+        decimal(r.peakChargeA, 2);
+        text(",");
+        decimal(r.peakDischargeA, 2);
+        text(",");
+        number(r.minCell_mV == 0xFFFF ? 0 : r.minCell_mV);
+        text(",");
+        number(r.maxCell_mV);
+        text(",");
+        number(r.charging_ms / 60000);
+        text(",");
+        number(r.discharging_ms / 60000);
+        text(",");
+        number(r.idle_ms / 60000);
+        text(",");
+        number(r.balancing_ms / 60000);
+        for (uint8_t t = 0; t < PROT_COUNT; t++) {
+            text(",");
+            number(r.trips[t]);
+        }
+        text("]");
+    };
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.send(200, "application/json", "");
+
+    text("{\"dayHours\":24,\"stored\":");
+    number(getStoredCount());
+    text(",\"columns\":[\"day\",\"partial\",\"bootFirst\",\"bootLast\",\"epochStart\",\"hours\","
+         "\"whCharged\",\"whDischarged\",\"ahCharged\",\"ahDischarged\","
+         "\"peakChargeA\",\"peakDischargeA\",\"minCell_mV\",\"maxCell_mV\","
+         "\"chargingMin\",\"dischargingMin\",\"idleMin\",\"balancingMin\"");
+    for (uint8_t t = 0; t < PROT_COUNT; t++) {
+        text(",\"trip_");
+        text(BMSProtection::getTypeName((ProtectionType)t));
+        text("\"");
+    }
+    text("],\"rows\":[");
+
+    // Cũ → mới, ngày đang chạy ở cuối
+    DailyReport r;
+    for (int i = getStoredCount() - 1; i >= 0; i--) {
+        if (!getDay(i, r)) continue;
+        row(r, false);
+        text(",");
+    }
+    row(current, true);
+    text("]}");
+
+    flush();
+    server.sendContent("");
+}
+
+// ========================= DEBUG =========================
+void BMSReports::printReports(uint8_t days) {
+    Serial.println("\n╔═══ DAILY REPORTS ═══╗");
+    Serial.println("Day   Hours  +Wh     -Wh     +Ah    -Ah    PkChg PkDsg MinCell MaxCell Chg/Dsg/Idle/Bal(min) Trips");
+
+    auto print = [](const DailyReport& r, const char* mark) {
+        uint32_t trips = 0;
+        for (uint8_t t = 0; t < PROT_COUNT; t++) trips += r.trips[t];
+        Serial.printf("%4u%s %5.1f %7.1f %7.1f %6.2f %6.2f %5.1f %5.1f %7u %7u %lu/%lu/%lu/%lu %lu\n",
+                      r.day, mark, r.elapsed_ms / 3600000.0f, r.whCharged, r.whDischarged,
+                      r.ahCharged, r.ahDischarged, r.peakChargeA, r.peakDischargeA,
+                      r.minCell_mV == 0xFFFF ? 0 : r.minCell_mV, r.maxCell_mV,
+                      (unsigned long)(r.charging_ms / 60000), (unsigned long)(r.discharging_ms / 60000),
+                      (unsigned long)(r.idle_ms / 60000), (unsigned long)(r.balancing_ms / 60000),
+                      (unsigned long)trips);
+    };
+
+    DailyReport r;
+    uint8_t count = getStoredCount() < days ? getStoredCount() : days;
+    for (int i = count - 1; i >= 0; i--) {
+        if (getDay(i, r)) print(r, " ");
+    }
+    print(current, "*");
+    Serial.println("* = current day");
+    Serial.println("╚═════════════════════╝\n");
+}
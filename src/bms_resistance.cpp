@@ -0,0 +1,204 @@
+#include "bms_resistance.h"
+
+#define IR_MAGIC  0x32535249   // "IRS2" (IRS1 có R lệch do đo khi bật/tắt xả cân bằng)
+
+// ========================= CONSTRUCTOR =========================
+BMSResistance::BMSResistance()
+    : prevCurrent(0.0f),
+      prevDelta(0.0f),
+      hasPrev(false),
+      rejected(0),
+      lastSave(0),
+      dirty(false)
+{
+    defaults();
+}
+
+void BMSResistance::begin() {
+    prefs.begin("bms_ir", true);
+    size_t len = prefs.getBytes("state", &state, sizeof(state));
+    prefs.end();
+
+    if (len != sizeof(state) || state.magic != IR_MAGIC) {
+        defaults();
+    }
+    lastSave = millis();
+
+    Serial.printf("Resistance: R25 %.1f/%.1f/%.1f/%.1f mΩ\n", state.r25[0] * 1000.0f,
+                  state.r25[1] * 1000.0f, state.r25[2] * 1000.0f, state.r25[3] * 1000.0f);
+}
+
+void BMSResistance::defaults() {
+    memset(&state, 0, sizeof(state));
+    state.magic = IR_MAGIC;
+    for (uint8_t i = 0; i < IR_CELLS; i++) {
+        state.r25[i] = IR_DEFAULT_OHM;
+        state.var[i] = (0.5f * IR_DEFAULT_OHM) * (0.5f * IR_DEFAULT_OHM);
+        for (uint8_t b = 0; b < IR_TEMP_BINS; b++) state.binR[i][b] = NAN;
+    }
+    rejected = 0;
+}
+
+void BMSResistance::reset() {
+    defaults();
+    save();
+}
+
+// ========================= HÀM NỘI BỘ =========================
+float BMSResistance::tempFactor(float temp_C) {
+    if (isnan(temp_C)) return 1.0f;
+    return expf(IR_TEMP_COEFF * (25.0f - constrain(temp_C, -20.0f, 60.0f)));
+}
+
+void BMSResistance::addMeasurement(uint8_t cell, float dV, float dI, float temp_C) {
+    float factor = tempFactor(temp_C);
+    float r = dV / dI;                               // Ω ở nhiệt độ hiện tại
+    float r25 = r / factor;
+
+    // Phương sai đo quy về 25 °C
+    float sigma = 1.41421356f * IR_VOLT_NOISE / fabsf(dI) / factor;
+    float rVar = sigma * sigma;
+
+    float p = state.var[cell] + IR_DRIFT * IR_DRIFT;
+    float e = r25 - state.r25[cell];
+    if (r < IR_MIN_OHM || r > IR_MAX_OHM || (state.loadEvents[cell] >= 10 && e * e > 16.0f * (p + rVar))) {
+        rejected++;
+        return;
+    }
+
+    float k = p / (p + rVar);
+    state.r25[cell] = constrain(state.r25[cell] + k * e, IR_MIN_OHM, IR_MAX_OHM);
+    state.var[cell] = (1.0f - k) * p;
+
+    state.loadEvents[cell]++;
+    if (state.baseline[cell] == 0.0f && state.loadEvents[cell] >= IR_BASELINE_EVENTS) {
+        state.baseline[cell] = state.r25[cell];
+        Serial.printf("Cell %u IR baseline: %.1f mΩ\n", cell + 1, state.baseline[cell] * 1000.0f);
+    }
+
+    if (!isnan(temp_C)) {
+        float pos = (temp_C - IR_TEMP_MIN) / IR_TEMP_STEP;
+        uint8_t bin = pos <= 0.0f ? 0 : pos >= IR_TEMP_BINS - 1 ? IR_TEMP_BINS - 1 : (uint8_t)pos;
+        float& binR = state.binR[cell][bin];
+        binR = isnan(binR) ? r : binR + IR_BIN_ALPHA * (r - binR);
+        if (state.binCount[cell][bin] < 0xFFFF) state.binCount[cell][bin]++;
+    }
+    dirty = true;
+}
+
+void BMSResistance::save() {
+    prefs.begin("bms_ir", false);
+    prefs.putBytes("state", &state, sizeof(state));
+    prefs.end();
+    lastSave = millis();
+    dirty = false;
+}
+
+// ========================= CẬP NHẬT =========================
+void BMSResistance::update(const float cells[IR_CELLS], float current_A, float temp_C,
+                           const bool bleeding[IR_CELLS]) {
+    if (isnan(current_A)) {
+        hasPrev = false;
+        return;
+    }
+
+    if (hasPrev) {
+        float dI = current_A - prevCurrent;
+        bool steadyBefore = fabsf(prevDelta) < IR_STABLE_A;
+
+        for (uint8_t i = 0; i < IR_CELLS; i++) {
+            if (isnan(cells[i]) || isnan(prevCells[i])) continue;
+            float dV = cells[i] - prevCells[i];
+
+            // Bước tải: dòng cell đổi đúng bằng dòng pack (xả cân bằng không đổi giữa 2 mẫu)
+            if (fabsf(dI) >= IR_MIN_STEP_A && steadyBefore && bleeding[i] == prevBleed[i]) {
+                addMeasurement(i, dV, dI, temp_C);
+            }
+        }
+        prevDelta = dI;
+    }
+
+    for (uint8_t i = 0; i < IR_CELLS; i++) {
+        prevCells[i] = cells[i];
+        prevBleed[i] = bleeding[i];
+    }
+    prevCurrent = current_A;
+    hasPrev = true;
+
+    if (dirty && millis() - lastSave >= IR_SAVE_INTERVAL) {
+        save();
+    }
+}
+
+// ========================= GETTERS =========================
+float BMSResistance::getR25(uint8_t cell) const {
+    return cell < IR_CELLS ? state.r25[cell] : NAN;
+}
+
+float BMSResistance::getResistance(uint8_t cell, float temp_C) const {
+    return cell < IR_CELLS ? state.r25[cell] * tempFactor(temp_C) : NAN;
+}
+
+float BMSResistance::getSigma(uint8_t cell) const {
+    return cell < IR_CELLS ? sqrtf(state.var[cell]) : NAN;
+}
+
+uint32_t BMSResistance::getEvents(uint8_t cell) const {
+    return cell < IR_CELLS ? state.loadEvents[cell] : 0;
+}
+
+float BMSResistance::getBaseline(uint8_t cell) const {
+    if (cell >= IR_CELLS || state.baseline[cell] == 0.0f) return NAN;
+    return state.baseline[cell];
+}
+
+float BMSResistance::getPowerSOH() const {
+    float soh = 100.0f;
+    for (uint8_t i = 0; i < IR_CELLS; i++) {
+        // Chưa chốt mốc: so với datasheet
+        float base = state.baseline[i] > 0.0f ? state.baseline[i] : IR_DEFAULT_OHM;
+        float cellSoh = 100.0f * (IR_EOL_FACTOR * base - state.r25[i]) / ((IR_EOL_FACTOR - 1.0f) * base);
+        soh = fminf(soh, cellSoh);
+    }
+    return constrain(soh, 0.0f, 100.0f);
+}
+
+float BMSResistance::getMaxR25() const {
+    float r = 0.0f;
+    for (uint8_t i = 0; i < IR_CELLS; i++) r = fmaxf(r, state.r25[i]);
+    return r;
+}
+
+float BMSResistance::compensate(uint8_t cell, float voltage, float current_A, float temp_C) const {
+    if (cell >= IR_CELLS) return voltage;
+    return voltage - getResistance(cell, temp_C) * current_A;
+}
+
+float BMSResistance::getTempBin(uint8_t cell, uint8_t bin) const {
+    return (cell < IR_CELLS && bin < IR_TEMP_BINS) ? state.binR[cell][bin] : NAN;
+}
+
+// ========================= DEBUG =========================
+void BMSResistance::printStatus() {
+    Serial.println("\n╔═══ CELL RESISTANCE ═══╗");
+    Serial.println("Cell  R25      ±σ     Base    Load");
+    for (uint8_t i = 0; i < IR_CELLS; i++) {
+        Serial.printf("%4u %5.1fmΩ %5.2fmΩ %5.1fmΩ %6lu\n", i + 1, state.r25[i] * 1000.0f,
+                      sqrtf(state.var[i]) * 1000.0f, state.baseline[i] * 1000.0f,
+                      (unsigned long)state.loadEvents[i]);
+    }
+    Serial.print("R vs T (mΩ):");
+    for (uint8_t b = 0; b < IR_TEMP_BINS; b++) {
+        Serial.printf(" %6.0f°C", IR_TEMP_MIN + b * IR_TEMP_STEP);
+    }
+    Serial.println();
+    for (uint8_t i = 0; i < IR_CELLS; i++) {
+        Serial.printf("  cell %u    ", i + 1);
+        for (uint8_t b = 0; b < IR_TEMP_BINS; b++) {
+            Serial.printf(" %8.1f", state.binR[i][b] * 1000.0f);
+        }
+        Serial.println();
+    }
+    Serial.printf("Power SOH: %.1f%% | rejected: %lu\n", getPowerSOH(), (unsigned long)rejected);
+    Serial.println("╚═══════════════════════╝\n");
+}
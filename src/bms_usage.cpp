@@ -0,0 +1,226 @@
+#include "bms_usage.h"
+
+#define USAGE_MAGIC  0x55534731   // "USG1"
+
+// Biên C-rate (+ sạc / - xả); bin i = [edge[i-1], edge[i])
+static const float USAGE_CRATE_EDGES[USAGE_CRATE_BINS - 1] = {
+    -2.0f, -1.0f, -0.5f, -0.2f, -0.05f, 0.05f, 0.2f, 0.5f, 1.0f, 2.0f
+};
+
+// ========================= CONSTRUCTOR =========================
+BMSUsage::BMSUsage(float nominalCapacity_Ah)
+    : capacity_Ah(nominalCapacity_Ah),
+      pendingMs(0),
+      lastUpdate(0),
+      lastSave(0),
+      dirty(false)
+{
+    memset(&hist, 0, sizeof(hist));
+    hist.magic = USAGE_MAGIC;
+}
+
+void BMSUsage::begin() {
+    prefs.begin("bms_usage", true);
+    size_t len = prefs.getBytes("hist", &hist, sizeof(hist));
+    prefs.end();
+
+    // Layout khác (đổi số bin) hoặc chưa có → bắt đầu lại
+    if (len != sizeof(hist) || hist.magic != USAGE_MAGIC) {
+        memset(&hist, 0, sizeof(hist));
+        hist.magic = USAGE_MAGIC;
+    }
+
+    lastUpdate = millis();
+    lastSave = lastUpdate;
+
+    Serial.printf("Usage initialized: %.1fh recorded\n", hist.total_s / 3600.0f);
+}
+
+// ========================= HÀM NỘI BỘ =========================
+uint8_t BMSUsage::linearBin(float value, float min, float step, uint8_t bins) {
+    if (isnan(value)) return 0;
+    // +1e-4: giá trị đúng bằng biên (3.30 V) không rơi xuống bin dưới do làm tròn float
+    float pos = (value - min) / step + 1e-4f;
+    if (pos <= 0.0f) return 0;
+    if (pos >= bins - 1) return bins - 1;
+    return (uint8_t)pos;
+}
+
+uint8_t BMSUsage::cRateBin(float cRate) {
+    // Số biên nhỏ hơn hoặc bằng giá trị = chỉ số bin (10 phép so sánh cố định)
+    uint8_t bin = 0;
+    for (uint8_t i = 0; i < USAGE_CRATE_BINS - 1; i++) {
+        bin += cRate >= USAGE_CRATE_EDGES[i];
+    }
+    return bin;
+}
+
+void BMSUsage::save() {
+    prefs.begin("bms_usage", false);
+    prefs.putBytes("hist", &hist, sizeof(hist));
+    prefs.end();
+    lastSave = millis();
+    dirty = false;
+}
+
+// ========================= CẬP NHẬT =========================
+void BMSUsage::update(const float cells[4], float current_A, float temp_C, float soc) {
+    unsigned long now = millis();
+    uint32_t dt = now - lastUpdate;
+    lastUpdate = now;
+    if (dt > USAGE_MAX_STEP_MS) dt = USAGE_MAX_STEP_MS;
+
+    pendingMs += dt;
+    if (pendingMs >= 1000) {
+        pendingMs -= 1000;
+
+        hist.total_s++;
+        hist.temp[linearBin(temp_C, USAGE_TEMP_MIN, USAGE_TEMP_STEP, USAGE_TEMP_BINS)]++;
+        hist.cRate[cRateBin(capacity_Ah > 0.0f ? current_A / capacity_Ah : 0.0f)]++;
+        hist.soc[linearBin(soc, 0.0f, USAGE_SOC_STEP, USAGE_SOC_BINS)]++;
+        for (uint8_t i = 0; i < 4; i++) {
+            hist.cell[i][linearBin(cells[i], USAGE_CELL_MIN, USAGE_CELL_STEP, USAGE_CELL_BINS)]++;
+        }
+        dirty = true;
+    }
+
+    if (dirty && now - lastSave >= USAGE_SAVE_INTERVAL) {
+        save();
+    }
+}
+
+// ========================= TRUY VẤN =========================
+const UsageHistograms& BMSUsage::getHistograms() const {
+    return hist;
+}
+
+void BMSUsage::reset() {
+    memset(&hist, 0, sizeof(hist));
+    hist.magic = USAGE_MAGIC;
+    pendingMs = 0;
+    save();
+}
+
+// ========================= XUẤT JSON =========================
+void BMSUsage::streamJson(WebServer& server) {
+    char buf[512];
+    size_t len = 0;
+
+    auto flush = [&]() {
+        if (len > 0) {
+            server.sendContent(buf, len);
+            len = 0;
+        }
+    };
+    auto text = [&](const char* str) {
+        size_t n = strlen(str);
+        if (len + n > sizeof(buf)) flush();
+        memcpy(buf + len, str, n);
+        len += n;
+    };
+    auto number = [&](unsigned long value) {
+        if (len + 12 > sizeof(buf)) flush();
+        len += snprintf(buf + len, sizeof(buf) - len, "%lu", value);
+    };
+    auto decimal = [&](double value, int digits) {
+        if (len + 16 > sizeof(buf)) flush();
+        len += snprintf(buf + len, sizeof(buf) - len, "%.*f", digits, value);
+    };
+    auto linearEdges = [&](float min, float step, uint8_t bins, int digits) {
+        text("\"edges\":[");
+        for (uint8_t i = 0; i <= bins; i++) {
+            if (i > 0) text(",");
+            decimal(min + step * i, digits);
+        }
+        text("]");
+    };
+    auto seconds = [&](const uint32_t* bins, uint8_t count) {
+        text("[");
+        for (uint8_t i = 0; i < count; i++) {
+            if (i > 0) text(",");
+            number(bins[i]);
+        }
+        text("]");
+    };
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.send(200, "application/json", "");
+
+    // Bin đầu/cuối nhận cả giá trị ngoài dải edges
+    text("{\"totalSeconds\":");
+    number(hist.total_s);
+
+    text(",\"temperature\":{\"unit\":\"C\",");
+    linearEdges(USAGE_TEMP_MIN, USAGE_TEMP_STEP, USAGE_TEMP_BINS, 0);
+    text(",\"seconds\":");
+    seconds(hist.temp, USAGE_TEMP_BINS);
+
+    text("},\"cRate\":{\"unit\":\"C\",\"capacityAh\":");
+    decimal(capacity_Ah, 2);
+    text(",\"edges\":[");
+    for (uint8_t i = 0; i < USAGE_CRATE_BINS - 1; i++) {
+        if (i > 0) text(",");
+        decimal(USAGE_CRATE_EDGES[i], 2);
+    }
+    text("],\"seconds\":");
+    seconds(hist.cRate, USAGE_CRATE_BINS);
+
+    text("},\"soc\":{\"unit\":\"%\",");
+    linearEdges(0.0f, USAGE_SOC_STEP, USAGE_SOC_BINS, 0);
+    text(",\"seconds\":");
+    seconds(hist.soc, USAGE_SOC_BINS);
+
+    text("},\"cellVoltage\":{\"unit\":\"V\",");
+    linearEdges(USAGE_CELL_MIN, USAGE_CELL_STEP, USAGE_CELL_BINS, 2);
+    text(",\"seconds\":[");
+    for (uint8_t c = 0; c < 4; c++) {
+        if (c > 0) text(",");
+        seconds(hist.cell[c], USAGE_CELL_BINS);
+    }
+    text("]}}");
+
+    flush();
+    server.sendContent("");
+}
+
+// ========================= DEBUG =========================
+void BMSUsage::printStatus() {
+    auto print = [](const char* label, float lo, float hi, uint32_t s, uint32_t total) {
+        if (s == 0) return;
+        Serial.printf("  %-6s %6.2f..%-6.2f %9.2fh %5.1f%%\n", label, lo, hi,
+                      s / 3600.0f, total ? s * 100.0f / total : 0.0f);
+    };
+
+    Serial.println("\n╔═══ USAGE HISTOGRAMS ═══╗");
+    Serial.printf("Recorded: %.1fh (%lu s)\n", hist.total_s / 3600.0f, (unsigned long)hist.total_s);
+
+    Serial.println("Temperature (C):");
+    for (uint8_t i = 0; i < USAGE_TEMP_BINS; i++) {
+        float lo = USAGE_TEMP_MIN + USAGE_TEMP_STEP * i;
+        print("temp", lo, lo + USAGE_TEMP_STEP, hist.temp[i], hist.total_s);
+    }
+
+    Serial.println("C-rate (+chg/-dsg):");
+    for (uint8_t i = 0; i < USAGE_CRATE_BINS; i++) {
+        float lo = i == 0 ? -INFINITY : USAGE_CRATE_EDGES[i - 1];
+        float hi = i == USAGE_CRATE_BINS - 1 ? INFINITY : USAGE_CRATE_EDGES[i];
+        print("rate", lo, hi, hist.cRate[i], hist.total_s);
+    }
+
+    Serial.println("SOC (%):");
+    for (uint8_t i = 0; i < USAGE_SOC_BINS; i++) {
+        print("soc", USAGE_SOC_STEP * i, USAGE_SOC_STEP * (i + 1), hist.soc[i], hist.total_s);
+    }
+
+    Serial.println("Cell voltage (V):");
+    for (uint8_t c = 0; c < 4; c++) {
+        char label[8];
+        snprintf(label, sizeof(label), "cell%u", c + 1);
+        for (uint8_t i = 0; i < USAGE_CELL_BINS; i++) {
+            float lo = USAGE_CELL_MIN + USAGE_CELL_STEP * i;
+            print(label, lo, lo + USAGE_CELL_STEP, hist.cell[c][i], hist.total_s);
+        }
+    }
+    Serial.println("╚════════════════════════╝\n");
+}
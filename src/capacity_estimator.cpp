@@ -0,0 +1,181 @@
+#include "capacity_estimator.h"
+
+// ========================= CONSTRUCTOR =========================
+CapacityEstimator::CapacityEstimator(float nominal_capacity_Ah)
+    : nominal_Ah(nominal_capacity_Ah),
+      capacity_Ah(nominal_capacity_Ah),
+      variance(0.0f),
+      updates(0),
+      rejected(0),
+      hasAnchor(false),
+      anchorSOC(0.0f),
+      anchorSigma(0.0f),
+      anchorNetAh(0.0),
+      anchorThroughputAh(0.0),
+      anchorTime(0),
+      lastPairAh(NAN),
+      lastPairSigma(NAN),
+      lastResult("none"),
+      journal(nullptr)
+{
+    float sigma = CAP_PRIOR_SIGMA * nominal_Ah;
+    variance = sigma * sigma;
+}
+
+void CapacityEstimator::begin(BMSJournal& store) {
+    journal = &store;
+    if (!journal->isReady()) return;
+
+    // Ngưỡng ghi 1 mAh / 1e-4 Ah²; chỉ đổi khi có cặp mốc mới
+    float cap = journal->define(JK_CAPACITY_AH, capacity_Ah, 0.001, 60000);
+    float var = journal->define(JK_CAPACITY_VAR, variance, 0.0001, 60000);
+    updates = (uint16_t)lround(journal->define(JK_CAPACITY_UPDATES, 0, 0.5, 60000));
+
+    if (cap >= nominal_Ah * 0.5f && cap <= nominal_Ah * 1.2f && var > 0.0f) {
+        capacity_Ah = cap;
+        variance = var;
+    }
+    Serial.printf("Capacity: %.3fAh ±%.3f (%u updates)\n", capacity_Ah, sqrtf(variance), updates);
+}
+
+// ========================= MỐC =========================
+bool CapacityEstimator::addAnchor(float soc_pct, float sigma_pct, double netAh, double throughputAh) {
+    unsigned long now = millis();
+
+    if (!hasAnchor) {
+        hasAnchor = true;
+        anchorSOC = soc_pct;
+        anchorSigma = sigma_pct;
+        anchorNetAh = netAh;
+        anchorThroughputAh = throughputAh;
+        anchorTime = now;
+        lastResult = "first anchor";
+        return false;
+    }
+
+    float y = (float)(netAh - anchorNetAh);
+    float x = (soc_pct - anchorSOC) / 100.0f;
+
+    // Cùng 1 điểm (vd 2 lần dự đoán OCV trong 1 đợt nghỉ): giữ mốc chắc hơn
+    if (fabsf(y) < CAP_SAME_POINT * nominal_Ah) {
+        if (sigma_pct < anchorSigma) {
+            anchorSOC = soc_pct;
+            anchorSigma = sigma_pct;
+            anchorNetAh = netAh;
+            anchorThroughputAh = throughputAh;
+            anchorTime = now;
+        }
+        lastResult = "same point";
+        return false;
+    }
+
+    // Độ bất định của cặp
+    float hours = (now - anchorTime) / 3600000.0f;
+    float throughput = (float)(throughputAh - anchorThroughputAh);
+    float sy = CAP_OFFSET_A * hours + CAP_GAIN_ERROR * throughput;
+    float sx = sqrtf(anchorSigma * anchorSigma + sigma_pct * sigma_pct) / 100.0f;
+    float r = sy * sy + capacity_Ah * capacity_Ah * sx * sx;
+
+    // Mốc mới luôn làm gốc cho cặp sau, kể cả khi cặp này bị loại
+    anchorSOC = soc_pct;
+    anchorSigma = sigma_pct;
+    anchorNetAh = netAh;
+    anchorThroughputAh = throughputAh;
+    anchorTime = now;
+
+    lastPairAh = fabsf(x) > 1e-3f ? y / x : NAN;
+    lastPairSigma = fabsf(x) > 1e-3f ? sqrtf(r) / fabsf(x) : INFINITY;
+
+    if (lastPairSigma > CAP_MAX_PAIR_SIGMA * nominal_Ah) {
+        rejected++;
+        lastResult = "rejected: weak pair";
+        return false;
+    }
+
+    float p = variance / CAP_FORGET;
+    float e = y - x * capacity_Ah;
+    float s = x * x * p + r;
+    if (e * e > 9.0f * s) {
+        rejected++;
+        lastResult = "rejected: outlier";
+        Serial.printf("Capacity pair rejected: %.2fAh vs %.2fAh (3σ %.2fAh)\n",
+                      lastPairAh, capacity_Ah, 3.0f * sqrtf(s) / fabsf(x));
+        return false;
+    }
+
+    float k = p * x / s;
+    capacity_Ah = constrain(capacity_Ah + k * e, nominal_Ah * 0.5f, nominal_Ah * 1.2f);
+    variance = fmaxf((1.0f - k * x) * p, 1e-6f);
+    updates++;
+    lastResult = "accepted";
+
+    Serial.printf("Capacity: %.3fAh ±%.3f (pair %.2fAh ±%.2f, ΔSOC %.0f%%)\n",
+                  capacity_Ah, sqrtf(variance), lastPairAh, lastPairSigma, x * 100.0f);
+
+    if (journal != nullptr && journal->isReady()) {
+        journal->set(JK_CAPACITY_AH, capacity_Ah);
+        journal->set(JK_CAPACITY_VAR, variance);
+        journal->set(JK_CAPACITY_UPDATES, updates);
+    }
+    return true;
+}
+
+void CapacityEstimator::clearAnchor() {
+    hasAnchor = false;
+}
+
+void CapacityEstimator::reset() {
+    capacity_Ah = nominal_Ah;
+    float sigma = CAP_PRIOR_SIGMA * nominal_Ah;
+    variance = sigma * sigma;
+    updates = 0;
+    rejected = 0;
+    hasAnchor = false;
+    lastResult = "reset";
+    if (journal != nullptr && journal->isReady()) {
+        journal->set(JK_CAPACITY_AH, capacity_Ah);
+        journal->set(JK_CAPACITY_VAR, variance);
+        journal->set(JK_CAPACITY_UPDATES, 0);
+        journal->sync();
+    }
+    Serial.println("Capacity estimate reset");
+}
+
+// ========================= GETTERS =========================
+float CapacityEstimator::getCapacityAh() const {
+    return capacity_Ah;
+}
+
+float CapacityEstimator::getSigmaAh() const {
+    return sqrtf(variance);
+}
+
+uint16_t CapacityEstimator::getUpdates() const {
+    return updates;
+}
+
+uint16_t CapacityEstimator::getRejected() const {
+    return rejected;
+}
+
+bool CapacityEstimator::isConverged() const {
+    return updates > 0 && sqrtf(variance) < CAP_CONVERGED_SIGMA * nominal_Ah;
+}
+
+// ========================= DEBUG =========================
+void CapacityEstimator::printStatus() {
+    Serial.println("\n╔═══ CAPACITY ═══╗");
+    Serial.printf("Estimate: %.3fAh ±%.3fAh (%.1f%% of %.1fAh)%s\n", capacity_Ah, sqrtf(variance),
+                  capacity_Ah / nominal_Ah * 100.0f, nominal_Ah, isConverged() ? " [in use]" : "");
+    Serial.printf("Updates: %u | rejected: %u | last: %s\n", updates, rejected, lastResult);
+    if (!isnan(lastPairAh)) {
+        Serial.printf("Last pair: %.2fAh ±%.2fAh\n", lastPairAh, lastPairSigma);
+    }
+    if (hasAnchor) {
+        Serial.printf("Anchor: %.1f%% ±%.1f%%, %lus ago\n", anchorSOC, anchorSigma,
+                      (millis() - anchorTime) / 1000);
+    } else {
+        Serial.println("Anchor: none");
+    }
+    Serial.println("╚════════════════╝\n");
+}
@@ -11,6 +11,7 @@
 #include "bms_dwin.h"
 #include "bms_data.h"      
 #include "bms_html.h"
+#include "bms_metrics.h"
 
 // ============ WiFi AP Configuration ============
 const char* AP_SSID = "ESP32_BMS";
@@ -27,7 +28,19 @@ BMSSensors sensors;
 BMSProtection protection;
 BMSBalancing balancing;
 BMSDwin dwin;
+BMSHistory history;
+BMSMetrics metrics;
+BMSLogger logger;
+BMSBlackBox blackbox;
+BMSReports reports;
+BMSEnergy energy;
+BMSUsage usage(6.0);
+BMSResistance resistance;
+BMSPower power;
+BMSJournal journal;
 SOCEstimator soc(6.0);
+SOCCells cellSoc(6.0);
+CapacityEstimator capacityEst(6.0);
 SOHEstimator soh(6.0);
 // BMSTestMode testMode;  // Optional
 
@@ -48,6 +61,31 @@ const unsigned long SOH_UPDATE_INTERVAL = 10000;   // 10s
 const unsigned long DEBUG_PRINT_INTERVAL = 5000;   // 5s
 const unsigned long DWIN_UPDATE_INTERVAL = 1000;   // 1s
 
+// ============================================
+// Đo, bảo vệ, SOC, SOH theo chu kỳ; cũng được logger gọi giữa các
+// chunk khi tải log dài để handler HTTP không chặn vòng điều khiển
+void runControlTasks() {
+    unsigned long now = millis();
+    
+    // =====  CẬP NHẬT TOÀN BỘ BMS (100ms) =====
+    if (now - lastBMSUpdate >= BMS_UPDATE_INTERVAL) {
+        lastBMSUpdate = now;
+        updateAllBMSData();
+    }
+    
+    // ===== CẬP NHẬT SOC (1s) =====
+    if (now - lastSOCUpdate >= SOC_UPDATE_INTERVAL) {
+        lastSOCUpdate = now;
+        updateSOC();  // Hàm trong bms_data.h
+    }
+    
+    // ===== CẬP NHẬT SOH (10s) =====
+    if (now - lastSOHUpdate >= SOH_UPDATE_INTERVAL) {
+        lastSOHUpdate = now;
+        updateSOH();  // Hàm trong bms_data.h
+    }
+}
+
 // ============================================
 // WIFI ACCESS POINT SETUP
 // ============================================
@@ -73,23 +111,207 @@ void setupWiFiAP() {
 // ============================================
 // WEB SERVER SETUP
 // ============================================
+// Bọc handler để đếm request và đo thời gian xử lý cho /metrics
+std::function<void()> timed(std::function<void()> handler) {
+    return [handler]() {
+        unsigned long start = micros();
+        handler();
+        metrics.recordHttp(micros() - start);
+    };
+}
+
+void sendBMSJson(uint32_t mask) {
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    String json;
+    if (server.hasArg("since")) {
+        uint32_t since = strtoul(server.arg("since").c_str(), nullptr, 10);
+        uint32_t epoch = server.hasArg("epoch") ? strtoul(server.arg("epoch").c_str(), nullptr, 10) : 0;
+        json = getBMSJsonSince(since, epoch, mask);
+    } else {
+        json = getBMSJson(mask);
+    }
+    if (json.length() == 0) {
+        server.send(500, "text/plain", "JSON overflow");
+        return;
+    }
+    server.send(200, "application/json", json);
+}
+
 void setupWebServer() {
-    server.on("/", HTTP_GET, []() {
+    server.on("/", HTTP_GET, timed([]() {
         server.send(200, "text/html", getHTMLPage());
-    });
+    }));
+    
+    // /bms?fields=cells,current,soc&since=<seq>&epoch=<epoch>
+    server.on("/bms", HTTP_GET, timed([]() {
+        uint32_t mask = FIELD_MASK_ALL;
+        if (server.hasArg("fields")) {
+            String unknown;
+            mask = parseFieldMask(server.arg("fields").c_str(), &unknown);
+            if (mask == 0) {
+                server.send(400, "text/plain",
+                            unknown.length() > 0 ? "Unknown field: " + unknown : String("No fields"));
+                return;
+            }
+        }
+        sendBMSJson(mask);
+    }));
+    
+    server.on("/bms/cells", HTTP_GET, timed([]() {
+        sendBMSJson(FIELD_MASK_CELLS);
+    }));
+    
+    server.on("/bms/state", HTTP_GET, timed([]() {
+        sendBMSJson(FIELD_MASK_STATE);
+    }));
+    
+    server.on("/bms/protection", HTTP_GET, timed([]() {
+        sendBMSJson(FIELD_MASK_PROTECTION);
+    }));
     
-    server.on("/bms", HTTP_GET, []() {
+    server.on("/bms.bin", HTTP_GET, timed([]() {
+        uint8_t frame[BMS_FRAME_SIZE];
+        size_t len = getBMSFrame(frame);
         server.sendHeader("Access-Control-Allow-Origin", "*");
-        server.send(200, "application/json", getBMSJson());
-    });
+        server.send_P(200, "application/octet-stream", (const char*)frame, len);
+    }));
+    
+    // /history?res=1s|10s|1m|raw&range=<giây>
+    server.on("/history", HTTP_GET, timed([]() {
+        String res = server.hasArg("res") ? server.arg("res") : String("1s");
+        uint32_t range = server.hasArg("range") ? strtoul(server.arg("range").c_str(), nullptr, 10) : 0;
+        if (res == "raw") {
+            if (history.getArchiveBlocks() == 0) {
+                server.send(503, "text/plain", "history archive disabled");
+                return;
+            }
+            history.streamArchive(server, range);
+            return;
+        }
+        
+        uint32_t resolution_ms = 1000;
+        if (res == "10s") resolution_ms = 10000;
+        else if (res == "1m") resolution_ms = 60000;
+        else if (res != "1s") {
+            server.send(400, "text/plain", "res must be 1s, 10s, 1m or raw");
+            return;
+        }
+        
+        int8_t tier = history.findTier(resolution_ms);
+        if (tier < 0) {
+            server.send(503, "text/plain", "history tier disabled");
+            return;
+        }
+        // uint64_t: range * 1000 tràn uint32 khi range > ~49.7 ngày
+        uint64_t points = range ? ((uint64_t)range * 1000 + resolution_ms - 1) / resolution_ms : 0;
+        if (points > 0xFFFF) points = 0;
+        history.streamJson(server, tier, points);
+    }));
+    
+    // /log?seg=<n> - tải raw một segment 64 KB của partition log
+    server.on("/log", HTTP_GET, timed([]() {
+        if (!logger.isReady()) {
+            server.send(503, "text/plain", "logger not ready");
+            return;
+        }
+        long seg = server.hasArg("seg") ? server.arg("seg").toInt() : -1;
+        if (seg < 0 || seg >= logger.getSegmentCount()) {
+            server.send(400, "text/plain", "seg out of range (see /log/info)");
+            return;
+        }
+        logger.streamSegment(server, (uint16_t)seg);
+    }));
+    
+    // /log/export?format=bin|csv&from=<seq>&to=<seq> - toàn bộ log theo thứ tự,
+    // bin hỗ trợ Range (tải tiếp với cùng from/to trả về ở X-Log-From/X-Log-To)
+    server.on("/log/export", HTTP_GET, timed([]() {
+        if (!logger.isReady()) {
+            server.send(503, "text/plain", "logger not ready");
+            return;
+        }
+        String format = server.hasArg("format") ? server.arg("format") : String("bin");
+        if (format != "bin" && format != "csv") {
+            server.send(400, "text/plain", "format must be bin or csv");
+            return;
+        }
+        uint32_t from = server.hasArg("from") ?
+                        strtoul(server.arg("from").c_str(), nullptr, 10) : logger.getFirstSeq();
+        uint32_t to = server.hasArg("to") ?
+                      strtoul(server.arg("to").c_str(), nullptr, 10) : logger.getWrittenSeq();
+        logger.streamExport(server, from, to, format == "csv");
+    }));
+    
+    server.on("/log/info", HTTP_GET, timed([]() {
+        logger.sendInfo(server);
+    }));
+    
+    // /blackbox - danh sách sự kiện; /blackbox?index=<n> - toàn bộ mẫu (0 = mới nhất)
+    server.on("/blackbox", HTTP_GET, timed([]() {
+        if (!server.hasArg("index")) {
+            blackbox.streamList(server);
+            return;
+        }
+        static BlackBoxRecord record;
+        long index = server.arg("index").toInt();
+        if (index < 0 || index >= BLACKBOX_SLOTS || !blackbox.getRecord(index, record)) {
+            server.send(404, "text/plain", "no such event");
+            return;
+        }
+        blackbox.streamRecord(server, record);
+    }));
+    
+    // /reports - tổng hợp theo ngày (32 ngày gần nhất + ngày đang chạy)
+    server.on("/reports", HTTP_GET, timed([]() {
+        reports.streamJson(server);
+    }));
+    
+    // /usage - histogram thời gian theo nhiệt độ / C-rate / SOC / điện áp cell
+    server.on("/usage", HTTP_GET, timed([]() {
+        usage.streamJson(server);
+    }));
+    
+    server.on("/metrics", HTTP_GET, timed([]() {
+        metrics.stream(server);
+    }));
     
-    server.onNotFound([]() {
+    server.onNotFound(timed([]() {
         server.send(404, "text/plain", "404: Not Found");
-    });
+    }));
+    
+    // Range cho /log, /log/export
+    const char* headerKeys[] = { "Range" };
+    server.collectHeaders(headerKeys, 1);
     
     Serial.println("Web server routes configured");
 }
 
+// ============================================
+// TELEMETRY BENCHMARK (JSON vs /bms.bin)
+// ============================================
+void benchTelemetry() {
+    const int RUNS = 50;
+    size_t jsonSize = 0;
+    size_t binSize = 0;
+    uint8_t frame[BMS_FRAME_SIZE];
+    
+    unsigned long t0 = micros();
+    for (int i = 0; i < RUNS; i++) {
+        jsonSize = getBMSJson().length();
+    }
+    unsigned long jsonUs = (micros() - t0) / RUNS;
+    
+    t0 = micros();
+    for (int i = 0; i < RUNS; i++) {
+        binSize = getBMSFrame(frame);
+    }
+    unsigned long binUs = (micros() - t0) / RUNS;
+    
+    Serial.println("\n╔═══ TELEMETRY BENCH ═══╗");
+    Serial.printf("JSON  : %4u bytes | %5lu us\n", (unsigned)jsonSize, jsonUs);
+    Serial.printf("Binary: %4u bytes | %5lu us\n", (unsigned)binSize, binUs);
+    Serial.println("╚═══════════════════════╝\n");
+}
+
 // ============================================
 // SERIAL COMMAND HANDLER
 // ============================================
@@ -106,6 +328,18 @@ void handleSerialCommand() {
         else if (cmd == "soc") {
             soc.printDebug(bmsData.packVoltage, bmsData.current, bmsData.packTemp);
         }
+        else if (cmd == "cells") {
+            cellSoc.printStatus();
+        }
+        else if (cmd == "capacity") {
+            capacityEst.printStatus();
+        }
+        else if (cmd == "ir") {
+            resistance.printStatus();
+        }
+        else if (cmd == "power") {
+            power.printStatus();
+        }
         else if (cmd == "sensors") {
             sensors.printDebug();
         }
@@ -118,6 +352,57 @@ void handleSerialCommand() {
         else if (cmd == "dwin") {
             dwin.printDebug();
         }
+        else if (cmd == "history") {
+            history.printStatus();
+        }
+        else if (cmd == "log") {
+            logger.printStatus();
+        }
+        else if (cmd == "log_flush") {
+            logger.flush();
+            Serial.println("Log buffer submitted");
+        }
+        else if (cmd.startsWith("log_decim ")) {
+            int value = cmd.substring(10).toInt();
+            if (value > 0 && value <= 600) {
+                logger.setDecimation(value);
+                Serial.printf("Log decimation = %d (every %dms)\n", value, value * 100);
+            } else {
+                Serial.println("Invalid decimation (1-600)");
+            }
+        }
+        else if (cmd == "journal") {
+            journal.printStatus();
+        }
+        else if (cmd == "blackbox") {
+            blackbox.printList();
+        }
+        else if (cmd.startsWith("blackbox ")) {
+            static BlackBoxRecord record;
+            int index = cmd.substring(9).toInt();
+            if (index >= 0 && index < BLACKBOX_SLOTS && blackbox.getRecord(index, record)) {
+                blackbox.printRecord(record);
+            } else {
+                Serial.println("No such event");
+            }
+        }
+        else if (cmd == "energy") {
+            energy.printStatus();
+        }
+        else if (cmd == "usage") {
+            usage.printStatus();
+        }
+        else if (cmd == "usage_clear") {
+            usage.reset();
+            Serial.println("Usage histograms cleared");
+        }
+        else if (cmd == "reports") {
+            reports.printReports(7);
+        }
+        else if (cmd == "blackbox_clear") {
+            blackbox.clear();
+            Serial.println("Black-box events cleared");
+        }
         else if (cmd == "data") {
             // Debug bmsData struct
             Serial.println("\n╔═══ BMS DATA STRUCT ═══╗");
@@ -149,11 +434,31 @@ void handleSerialCommand() {
                 Serial.println("Invalid capacity (0-10Ah)");
             }
         }
+        else if (cmd == "capacity_reset") {
+            capacityEst.reset();
+        }
+        else if (cmd == "ir_reset") {
+            resistance.reset();
+            Serial.println("Cell resistance reset to datasheet");
+        }
+        else if (cmd.startsWith("soc_mode ")) {
+            String name = cmd.substring(9);
+            if (name == "ekf" || name == "coulomb" || name == "cells") {
+                soc.setMode(name == "ekf" ? SOC_MODE_EKF :
+                            name == "cells" ? SOC_MODE_CELLS : SOC_MODE_COULOMB);
+                Serial.printf("SOC mode: %s\n", soc.getModeName());
+            } else {
+                Serial.println("Usage: soc_mode ekf|coulomb|cells");
+            }
+        }
         
         // ===== SYSTEM COMMANDS =====
         else if (cmd == "json") {
             Serial.println(getBMSJson());
         }
+        else if (cmd == "bench") {
+            benchTelemetry();
+        }
         else if (cmd == "wifi") {
             Serial.println("\n╔═══ WiFi AP INFO ═══╗");
             Serial.printf("│ Mode: Access Point\n");
@@ -172,18 +477,40 @@ void handleSerialCommand() {
             Serial.println("\n╔═══════════════════ COMMANDS ═══════════════════╗");
             Serial.println("│ MONITORING:                                    │");
             Serial.println("│  soc         - SOC debug info                  │");
+            Serial.println("│  cells       - Per-cell SOC & capacity         │");
+            Serial.println("│  capacity    - Online pack capacity estimate   │");
+            Serial.println("│  ir          - Cell DC resistance vs temp      │");
+            Serial.println("│  power       - Power limits, time to empty/full│");
             Serial.println("│  soh         - SOH debug info                  │");
             Serial.println("│  sensors     - Sensor readings                 │");
             Serial.println("│  protection  - Protection status               │");
             Serial.println("│  balance     - Balancing status                │");
             Serial.println("│  dwin        - DWIN display info               │");
+            Serial.println("│  history     - History buffer status           │");
+            Serial.println("│  log         - Flash logger status             │");
+            Serial.println("│  journal     - Persistent state journal        │");
+            Serial.println("│  blackbox    - Protection fault events         │");
+            Serial.println("│  blackbox N  - Dump event N as CSV             │");
+            Serial.println("│  reports     - Daily rollups (last 7 days)     │");
+            Serial.println("│  energy      - Lifetime energy & efficiency    │");
+            Serial.println("│  usage       - Dwell histograms (T/C/SOC/V)    │");
             Serial.println("│  data        - BMS Data struct                 │");
             Serial.println("│  json        - JSON API output                 │");
+            Serial.println("│  bench       - JSON vs binary frame size/time  │");
             Serial.println("│                                                │");
             Serial.println("│ CALIBRATION:                                   │");
             Serial.println("│  reset_soh   - Reset SOH to 100%               │");
             Serial.println("│  reset_cycles- Reset cycle counter             │");
             Serial.println("│  cal_soh X.X - Calibrate SOH (Ah)              │");
+            Serial.println("│  soc_mode M  - SOC source: ekf|coulomb|cells   │");
+            Serial.println("│  capacity_reset - Back to nominal capacity     │");
+            Serial.println("│  ir_reset    - Cell resistance to datasheet    │");
+            Serial.println("│                                                │");
+            Serial.println("│ LOGGER / BLACK-BOX:                            │");
+            Serial.println("│  log_flush   - Write partial block to flash    │");
+            Serial.println("│  log_decim N - Log every N x 100ms (1-600)     │");
+            Serial.println("│  blackbox_clear - Erase fault events           │");
+            Serial.println("│  usage_clear - Clear dwell histograms          │");
             Serial.println("│                                                │");
             Serial.println("│ SYSTEM:                                        │");             
             Serial.println("│  help        - Show this menu                  │");
@@ -228,6 +555,8 @@ void printBMSStatus() {
     Serial.printf("   SOH: %.1f%% (%.2fAh)\n", bmsData.soh, bmsData.remainingCapacity);
     Serial.printf("   Cycles: %.1f / %.0f remaining\n", 
                   bmsData.totalCycles, bmsData.remainingCycles);
+    Serial.printf("   Energy: +%.1fWh / -%.1fWh (eff %.1f%%)\n",
+                  energy.getChargedWh(), energy.getDischargedWh(), energy.getEfficiency());
     
     // Protection
     Serial.println("\n PROTECTION:");
@@ -272,7 +601,22 @@ void setup() {
     protection.begin();
     balancing.begin();
     dwin.begin();
-    soh.begin();
+    history.begin();
+    logger.begin();
+    logger.setStreamService(runControlTasks);
+    blackbox.begin(logger.getBootCount());
+    reports.begin(logger.getBootCount());
+    usage.begin();
+    resistance.begin();
+    journal.begin();
+    soh.begin(journal);
+    soc.begin(journal);
+    cellSoc.begin(journal);
+    soc.attachCells(cellSoc);
+    capacityEst.begin(journal);
+    soc.attachCapacity(capacityEst);
+    power.attach(cellSoc, resistance);
+    energy.begin(journal);
     sohInitialized = true;
     
     // Setup WiFi & Web
@@ -287,6 +631,7 @@ void setup() {
 
 void loop() {
     unsigned long now = millis();
+    metrics.markLoop();
     
     // Handle web requests
     server.handleClient();
@@ -294,23 +639,7 @@ void loop() {
     // Handle Serial commands
     handleSerialCommand();
     
-    // =====  CẬP NHẬT TOÀN BỘ BMS (100ms) =====
-    if (now - lastBMSUpdate >= BMS_UPDATE_INTERVAL) {
-        lastBMSUpdate = now;
-        updateAllBMSData();
-    }
-    
-    // ===== CẬP NHẬT SOC (1s) =====
-    if (now - lastSOCUpdate >= SOC_UPDATE_INTERVAL) {
-        lastSOCUpdate = now;
-        updateSOC();  // Hàm trong bms_data.h
-    }
-    
-    // ===== CẬP NHẬT SOH (10s) =====
-    if (now - lastSOHUpdate >= SOH_UPDATE_INTERVAL) {
-        lastSOHUpdate = now;
-        updateSOH();  // Hàm trong bms_data.h
-    }
+    runControlTasks();
     
     // =====  CẬP NHẬT DWIN (1s) =====
     if (now - lastDwinUpdate >= DWIN_UPDATE_INTERVAL) {
@@ -0,0 +1,139 @@
+#include "ocv_relax.h"
+#include <math.h>
+
+// ========================= CONSTRUCTOR =========================
+OCVRelaxation::OCVRelaxation() {
+    start();
+}
+
+float OCVRelaxation::tauAt(uint8_t k) {
+    return OCV_RELAX_TAU_MIN * powf(1.41421356f, k);
+}
+
+void OCVRelaxation::start() {
+    n = 0.0;
+    sumV = 0.0;
+    sumVV = 0.0;
+    for (uint8_t k = 0; k < OCV_RELAX_TAUS; k++) {
+        sumE[k] = 0.0;
+        sumEE[k] = 0.0;
+        sumEV[k] = 0.0;
+    }
+    blockHead = 0;
+    blockCount = 0;
+    blockSum = 0.0;
+    blockTimeSum = 0.0;
+    blockSamples = 0;
+    nextSample_s = OCV_RELAX_SKIP_S;
+    lastSample_s = 0.0f;
+    lastVoltage = NAN;
+}
+
+// ========================= LẤY MẪU =========================
+void OCVRelaxation::addSample(float t_s, float voltage) {
+    if (t_s < nextSample_s || isnan(voltage)) return;
+    nextSample_s = t_s + OCV_RELAX_SAMPLE_S;
+
+    double v = voltage;
+    n += 1.0;
+    sumV += v;
+    sumVV += v * v;
+    for (uint8_t k = 0; k < OCV_RELAX_TAUS; k++) {
+        double e = exp(-t_s / tauAt(k));
+        sumE[k] += e;
+        sumEE[k] += e * e;
+        sumEV[k] += e * v;
+    }
+    lastSample_s = t_s;
+    lastVoltage = voltage;
+
+    blockSum += v;
+    blockTimeSum += t_s;
+    if (++blockSamples >= OCV_RELAX_BLOCK_SAMPLES) {
+        blockMean[blockHead] = (float)(blockSum / blockSamples);
+        blockTime[blockHead] = (float)(blockTimeSum / blockSamples);
+        blockHead = (blockHead + 1) % OCV_RELAX_BLOCKS;
+        if (blockCount < OCV_RELAX_BLOCKS) blockCount++;
+        blockSum = 0.0;
+        blockTimeSum = 0.0;
+        blockSamples = 0;
+    }
+}
+
+// Độ dốc giữa khối cũ nhất và mới nhất còn giữ (V/s)
+bool OCVRelaxation::endSlope(float& slope) const {
+    if (blockCount < 2) return false;
+    uint8_t newest = (blockHead + OCV_RELAX_BLOCKS - 1) % OCV_RELAX_BLOCKS;
+    uint8_t oldest = (blockHead + OCV_RELAX_BLOCKS - blockCount) % OCV_RELAX_BLOCKS;
+    slope = (blockMean[newest] - blockMean[oldest]) / (blockTime[newest] - blockTime[oldest]);
+    return true;
+}
+
+uint16_t OCVRelaxation::getSamples() const {
+    return (uint16_t)n;
+}
+
+// ========================= FIT =========================
+bool OCVRelaxation::fit(OCVRelaxFit& out) const {
+    out.valid = false;
+    out.samples = (uint16_t)n;
+    if (n < OCV_RELAX_MIN_SAMPLES) return false;
+
+    double b0[OCV_RELAX_TAUS], b1[OCV_RELAX_TAUS], sse[OCV_RELAX_TAUS], var0[OCV_RELAX_TAUS];
+    int best = -1;
+    double meanV = sumV / n;
+    double syy = sumVV - sumV * meanV;
+
+    for (uint8_t k = 0; k < OCV_RELAX_TAUS; k++) {
+        double det = n * sumEE[k] - sumE[k] * sumE[k];
+        sse[k] = INFINITY;
+        if (det <= 1e-9 * n * n) continue;     // e gần như hằng: τ quá dài so với dữ liệu
+
+        double sxy = sumEV[k] - sumE[k] * meanV;
+        double sxx = det / n;
+        b1[k] = sxy / sxx;
+        b0[k] = meanV - b1[k] * sumE[k] / n;
+        sse[k] = fmax(syy - b1[k] * sxy, 0.0);
+
+        double s2 = fmax(sse[k] / (n - 2.0), (double)OCV_RELAX_NOISE_V * OCV_RELAX_NOISE_V);
+        var0[k] = s2 * sumEE[k] / det;
+
+        if (best < 0 || sse[k] < sse[best]) best = k;
+    }
+    if (best < 0) return false;
+
+    // Các τ gần tốt như nhau → phân tán V∞ là sai số mô hình
+    double floor = n * OCV_RELAX_NOISE_V * OCV_RELAX_NOISE_V;
+    double band = OCV_RELAX_SSE_BAND * sse[best] + floor;
+    double lo = b0[best], hi = b0[best];
+    for (uint8_t k = 0; k < OCV_RELAX_TAUS; k++) {
+        if (sse[k] <= band) {
+            lo = fmin(lo, b0[k]);
+            hi = fmax(hi, b0[k]);
+        }
+    }
+    double spread = 0.5 * (hi - lo);
+
+    float tau = tauAt(best);
+    float remaining = (float)(b0[best] - lastVoltage);
+
+    // Thành phần chậm hơn cửa sổ dữ liệu không tách được khỏi V∞ → bù theo độ dốc còn lại
+    float slope;
+    if (!endSlope(slope)) slope = b1[best] / tau * expf(-lastSample_s / tau);
+    double hidden = slope * OCV_RELAX_HIDDEN_TAU_S;
+
+    out.ocv_V = (float)b0[best];
+    out.sigma_V = (float)sqrt(var0[best] + spread * spread + hidden * hidden);
+    out.tau_s = tau;
+    out.remaining_V = remaining;
+    out.rms_V = (float)sqrt(sse[best] / n);
+    out.slope_mVps = slope * 1000.0f;
+
+    // τ chạm biên trên: đường hồi còn dài hơn mọi τ thử → không ngoại suy
+    bool edge = best == OCV_RELAX_TAUS - 1 || sse[OCV_RELAX_TAUS - 1] <= band;
+    // Chưa quan sát đủ OCV_RELAX_MIN_TAUS lần τ → phần ngoại suy chiếm ưu thế
+    bool early = lastSample_s < OCV_RELAX_MIN_TAUS * tau;
+    // Ngoại lệ chỉ khi đường đo được cũng đã phẳng: remaining lấy từ chính fit ở biên
+    out.valid = (!edge && !early) || fabsf(remaining) + fabs(hidden) < OCV_RELAX_EDGE_V;
+    return out.valid;
+}
@@ -0,0 +1,127 @@
+#include "rainflow.h"
+#include <math.h>
+#include <string.h>
+
+// ========================= CONSTRUCTOR =========================
+RainflowCounter::RainflowCounter(float hysteresis)
+    : depth(0),
+      hysteresis(hysteresis),
+      direction(0),
+      candidate(0.0f),
+      tempSum(0.0f),
+      tempCount(0)
+{
+}
+
+void RainflowCounter::clear() {
+    depth = 0;
+    direction = 0;
+    tempSum = 0.0f;
+    tempCount = 0;
+}
+
+// ========================= HÀM NỘI BỘ =========================
+uint8_t RainflowCounter::push(float value, RainflowCycle out[RAINFLOW_MAX_OUT]) {
+    uint8_t n = 0;
+
+    // Tràn: điểm cũ nhất không bao giờ đóng được chu kỳ nữa → nửa chu kỳ.
+    // Chừa 1 chỗ cho đỉnh/đáy đang chờ để residue lưu qua reset luôn đủ điểm
+    if (depth == RAINFLOW_STACK - 1) {
+        const RainflowPoint& a = stack[0];
+        const RainflowPoint& b = stack[1];
+        out[n++] = { fabsf(b.value - a.value), 0.5f * (a.value + b.value), b.temp, 0.5f };
+        memmove(&stack[0], &stack[1], (depth - 1) * sizeof(RainflowPoint));
+        depth--;
+    }
+
+    stack[depth].value = value;
+    stack[depth].temp = tempCount > 0 ? tempSum / tempCount : 25.0f;
+    depth++;
+    tempSum = 0.0f;
+    tempCount = 0;
+
+    // Thuật toán 4 điểm
+    while (depth >= 4) {
+        const RainflowPoint& a = stack[depth - 4];
+        const RainflowPoint& b = stack[depth - 3];
+        const RainflowPoint& c = stack[depth - 2];
+        const RainflowPoint& d = stack[depth - 1];
+        float x = fabsf(c.value - b.value);
+        if (fabsf(b.value - a.value) < x || fabsf(d.value - c.value) < x) break;
+
+        out[n++] = { x, 0.5f * (b.value + c.value), 0.5f * (c.temp + d.temp), 1.0f };
+        stack[depth - 3] = d;
+        depth -= 2;
+    }
+    return n;
+}
+
+// ========================= CẬP NHẬT =========================
+uint8_t RainflowCounter::addSample(float value, float temp, RainflowCycle out[RAINFLOW_MAX_OUT]) {
+    if (isnan(value)) return 0;
+    if (!isnan(temp)) {
+        tempSum += temp;
+        tempCount++;
+    }
+
+    // Điểm đầu tiên là gốc của residue
+    if (depth == 0) {
+        push(value, out);
+        direction = 0;
+        return 0;
+    }
+
+    if (direction == 0) {
+        float delta = value - stack[depth - 1].value;
+        if (fabsf(delta) >= hysteresis) {
+            direction = delta > 0.0f ? 1 : -1;
+            candidate = value;
+        }
+        return 0;
+    }
+
+    // Tiếp tục cùng chiều → dời đỉnh/đáy chờ xác nhận
+    if ((direction > 0 && value > candidate) || (direction < 0 && value < candidate)) {
+        candidate = value;
+        return 0;
+    }
+    if (fabsf(value - candidate) < hysteresis) return 0;
+
+    uint8_t n = push(candidate, out);
+    direction = -direction;
+    candidate = value;
+    return n;
+}
+
+// ========================= RESIDUE =========================
+uint8_t RainflowCounter::getResidueCount() const {
+    // Đỉnh/đáy đang chờ được lưu như 1 điểm residue (push() luôn chừa chỗ)
+    return depth + (direction != 0 ? 1 : 0);
+}
+
+RainflowPoint RainflowCounter::getResidue(uint8_t index) const {
+    if (index < depth) return stack[index];
+    RainflowPoint p = { candidate, tempCount > 0 ? tempSum / tempCount : 25.0f };
+    return p;
+}
+
+void RainflowCounter::restore(const RainflowPoint* points, uint8_t count) {
+    clear();
+    if (count > RAINFLOW_STACK) {
+        points += count - RAINFLOW_STACK;
+        count = RAINFLOW_STACK;
+    }
+    if (count == 0) return;
+
+    memcpy(stack, points, count * sizeof(RainflowPoint));
+    depth = count;
+    if (count >= 2) {
+        // Điểm cuối chưa chắc là đỉnh/đáy thật: trả về trạng thái chờ xác nhận
+        const RainflowPoint& last = stack[count - 1];
+        candidate = last.value;
+        direction = last.value >= stack[count - 2].value ? 1 : -1;
+        tempSum = last.temp;
+        tempCount = 1;
+        depth = count - 1;
+    }
+}
@@ -0,0 +1,171 @@
+#include "soc_cells.h"
+#include "bms_ocv.h"
+
+static const JournalKey CAPACITY_KEYS[SOC_CELLS] = {
+    JK_CELL_CAP_1, JK_CELL_CAP_2, JK_CELL_CAP_3, JK_CELL_CAP_4
+};
+
+// ========================= CONSTRUCTOR =========================
+SOCCells::SOCCells(float capacity_Ah)
+    : nominal_mAh(capacity_Ah * 1000.0f),
+      lastUpdate(0),
+      restStart(0),
+      resting(false),
+      anchoredThisRest(false),
+      initialized(false),
+      capacityUpdates(0),
+      journal(nullptr)
+{
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        soc[i] = 50.0f;
+        var[i] = 100.0f;
+        capacity_mAh[i] = nominal_mAh;
+        throughput_mAh[i] = 0.0f;
+        anchorSoc[i] = NAN;
+        r0[i] = CELL_R0_OHM;
+    }
+}
+
+void SOCCells::begin(BMSJournal& store) {
+    journal = &store;
+    if (!journal->isReady()) return;
+
+    // Ngưỡng ghi 10 mAh; chỉ đổi khi có mốc mới nên maxAge ít ý nghĩa
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        float cap = journal->define(CAPACITY_KEYS[i], nominal_mAh, 10.0, 60000);
+        if (cap >= nominal_mAh * 0.5f && cap <= nominal_mAh * 1.2f) {
+            capacity_mAh[i] = cap;
+        }
+    }
+}
+
+void SOCCells::initialize(float packSOC) {
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        soc[i] = packSOC;
+        var[i] = 100.0f;
+    }
+    lastUpdate = millis();
+    initialized = true;
+}
+
+// ========================= CẬP NHẬT =========================
+void SOCCells::update(const float cells[SOC_CELLS], float current_A, float temperature,
+                      const bool bleeding[SOC_CELLS]) {
+    if (!initialized) return;
+
+    unsigned long now = millis();
+    float dt = (now - lastUpdate) / 1000.0f;
+    lastUpdate = now;
+    if (dt <= 0.0f) return;
+    if (dt > 2.0f) dt = 2.0f;
+    if (isnan(temperature)) temperature = 25.0f;
+
+    float charge[SOC_CELLS];
+    socCellsStep(soc, var, capacity_mAh, r0, cells, current_A, temperature, bleeding, dt, charge);
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        throughput_mAh[i] += charge[i];
+    }
+
+    // Mốc OCV cho dung lượng: 1 lần mỗi đợt nghỉ đủ lâu
+    if (fabsf(current_A) < CELL_REST_CURRENT) {
+        if (!resting) {
+            resting = true;
+            restStart = now;
+            anchoredThisRest = false;
+        }
+        if (!anchoredThisRest && now - restStart >= CELL_REST_MS) {
+            anchor(cells, temperature);
+            anchoredThisRest = true;
+        }
+    } else {
+        resting = false;
+    }
+}
+
+void SOCCells::anchor(const float cells[SOC_CELLS], float temperature) {
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        float ocvSoc = bmsOcvCellToSOC(cells[i], temperature);
+
+        if (!isnan(anchorSoc[i])) {
+            float swing = fabsf(ocvSoc - anchorSoc[i]);
+            if (swing >= CELL_CAP_MIN_SWING) {
+                float estimate = fabsf(throughput_mAh[i]) / (swing / 100.0f);
+                if (estimate >= nominal_mAh * 0.5f && estimate <= nominal_mAh * 1.2f) {
+                    capacity_mAh[i] += CELL_CAP_GAIN * (estimate - capacity_mAh[i]);
+                    capacityUpdates++;
+                    Serial.printf("Cell %u capacity: %.2fAh (estimate %.2fAh, swing %.0f%%)\n",
+                                  i + 1, capacity_mAh[i] / 1000.0f, estimate / 1000.0f, swing);
+                    if (journal != nullptr && journal->isReady()) {
+                        journal->set(CAPACITY_KEYS[i], capacity_mAh[i]);
+                    }
+                }
+            }
+        }
+
+        anchorSoc[i] = ocvSoc;
+        throughput_mAh[i] = 0.0f;
+    }
+}
+
+void SOCCells::setResistance(uint8_t cell, float ohm) {
+    if (cell >= SOC_CELLS || !(ohm > 0.0f)) return;
+    r0[cell] = ohm;
+}
+
+// ========================= GETTERS =========================
+bool SOCCells::isInitialized() const {
+    return initialized;
+}
+
+float SOCCells::getSOC(uint8_t cell) const {
+    return cell < SOC_CELLS ? soc[cell] : NAN;
+}
+
+float SOCCells::getSigma(uint8_t cell) const {
+    return cell < SOC_CELLS ? sqrtf(var[cell]) : NAN;
+}
+
+float SOCCells::getCapacityAh(uint8_t cell) const {
+    return cell < SOC_CELLS ? capacity_mAh[cell] / 1000.0f : NAN;
+}
+
+float SOCCells::getPackSOC() const {
+    // Xả: dừng khi cell ít điện nhất cạn; sạc: dừng khi cell gần đầy nhất đầy
+    float dischargeable = INFINITY;
+    float chargeable = INFINITY;
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        dischargeable = fminf(dischargeable, soc[i] * capacity_mAh[i]);
+        chargeable = fminf(chargeable, (100.0f - soc[i]) * capacity_mAh[i]);
+    }
+    float total = dischargeable + chargeable;
+    return total > 0.0f ? dischargeable / total * 100.0f : 0.0f;
+}
+
+bool SOCCells::isConfident() const {
+    if (!initialized) return false;
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        if (var[i] >= CELL_CONFIDENT_SIGMA * CELL_CONFIDENT_SIGMA) return false;
+    }
+    return true;
+}
+
+void SOCCells::getBalanceExcess(float excess_mAh[SOC_CELLS]) const {
+    socCellsBalanceExcess(soc, var, capacity_mAh, excess_mAh);
+}
+
+// ========================= DEBUG =========================
+void SOCCells::printStatus() {
+    float excess[SOC_CELLS];
+    getBalanceExcess(excess);
+
+    Serial.println("\n╔═══ CELL SOC ═══╗");
+    Serial.println("Cell  SOC     ±σ     Capacity  Excess");
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        Serial.printf("%4u %6.1f%% %5.1f%% %7.2fAh %6.0fmAh\n", i + 1, soc[i], sqrtf(var[i]),
+                      capacity_mAh[i] / 1000.0f, excess[i]);
+    }
+    Serial.printf("Pack SOC (weakest/strongest): %.1f%%\n", getPackSOC());
+    Serial.printf("Confident: %s | capacity updates: %u | %s\n", isConfident() ? "yes" : "no",
+                  capacityUpdates, resting ? "resting" : "active");
+    Serial.println("╚════════════════╝\n");
+}
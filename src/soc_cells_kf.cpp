@@ -0,0 +1,60 @@
+#include "soc_cells_kf.h"
+#include "bms_ocv.h"
+#include <math.h>
+
+// ========================= LỌC =========================
+void socCellsStep(float soc[SOC_CELLS], float var[SOC_CELLS],
+                  const float capacity_mAh[SOC_CELLS], const float r0[SOC_CELLS],
+                  const float cells[SOC_CELLS], float current_A, float temperature,
+                  const bool bleeding[SOC_CELLS], float dt_s, float charge_mAh[SOC_CELLS]) {
+    if (isnan(temperature)) temperature = 25.0f;
+
+    // Phần chung cho mọi cell, tính 1 lần ngoài vòng lặp
+    float drift = CELL_SOC_DRIFT * CELL_SOC_DRIFT * dt_s / 3600.0f;
+    float noise = CELL_VOLT_NOISE + CELL_LOAD_NOISE * fabsf(current_A);
+    float r = noise * noise * fmaxf(CELL_VOLT_CORR_S / dt_s, 1.0f);
+    float mAhPerA = dt_s / 3.6f;
+
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        float cellCurrent = current_A - (bleeding[i] ? cells[i] / CELL_BLEED_OHM : 0.0f);
+        float charge = cellCurrent * mAhPerA;
+        charge_mAh[i] = charge;
+
+        // Predict
+        float s = soc[i] + charge / capacity_mAh[i] * 100.0f;
+        float p = var[i] + drift;
+
+        // Update
+        float h;
+        float e = cells[i] - (bmsOcvCell(s, temperature, &h) + r0[i] * cellCurrent);
+        float k = p * h / (h * h * p + r);
+        s += k * e;
+        p -= k * h * p;
+
+        soc[i] = fminf(fmaxf(s, 0.0f), 100.0f);
+        var[i] = fminf(fmaxf(p, 0.01f), 2500.0f);
+    }
+}
+
+// ========================= CÂN BẰNG =========================
+void socCellsBalanceExcess(const float soc[SOC_CELLS], const float var[SOC_CELLS],
+                           const float capacity_mAh[SOC_CELLS], float excess_mAh[SOC_CELLS]) {
+    // Khoảng còn sạc được của từng cell; cell có khoảng nhỏ hơn phải xả bớt
+    float room[SOC_CELLS];
+    uint8_t ref = 0;
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        room[i] = (100.0f - soc[i]) / 100.0f * capacity_mAh[i];
+        if (room[i] > room[ref]) ref = i;
+    }
+
+    // σ (mAh) của khoảng trống cell tham chiếu, dùng chung cho mọi hiệu
+    float refVar = var[ref] * capacity_mAh[ref] * capacity_mAh[ref];
+    for (uint8_t i = 0; i < SOC_CELLS; i++) {
+        if (i == ref) {
+            excess_mAh[i] = 0.0f;
+            continue;
+        }
+        float sigma = sqrtf(var[i] * capacity_mAh[i] * capacity_mAh[i] + refVar) / 100.0f;
+        excess_mAh[i] = fmaxf(room[ref] - room[i] - CELL_EXCESS_SIGMAS * sigma, 0.0f);
+    }
+}
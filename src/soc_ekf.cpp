@@ -0,0 +1,128 @@
+#include "soc_ekf.h"
+#include "bms_ocv.h"
+#include <math.h>
+
+static const float EKF_SERIES_CELLS = 4.0f;  // pack 4S, OCV cell × 4
+
+static const float EKF_P00_MIN = 1e-8f;      // giữ P xác định dương
+static const float EKF_P00_MAX = 0.25f;      // σ tối đa 50 %
+
+// ========================= CONSTRUCTOR =========================
+SOCEkf::SOCEkf(float capacity_Ah)
+    : x0(0.5f),
+      x1(0.0f),
+      p00(0.04f),
+      p01(0.0f),
+      p11(1e-4f),
+      lastInnovation(0.0f)
+{
+    params.capacity_Ah = capacity_Ah;
+    params.r0_ohm = 0.060f;       // ~15 mΩ/cell
+    params.r1_ohm = 0.040f;
+    params.tau_s = 60.0f;
+    // Chỉnh trên tools/soc_ekf_sim.cpp để 2σ phủ ~95 % sai số thật. Offset
+    // 30 mA (0.5 %/h) + sai dung lượng 3 % ở 0.5C (1.5 %/h) là trôi tuyến tính,
+    // random walk 3.5 %/√h phủ được trong vài giờ; sai số OCV ±15 mV đổi chậm
+    // theo SOC (~5 phút ở 0.5C) → tương quan 300 s
+    params.socDrift_pct = 3.5f;
+    params.rcNoise_V = 0.002f;
+    params.voltageNoise_V = 0.07f;
+    params.voltageCorr_s = 300.0f;
+}
+
+void SOCEkf::setParams(const SOCEkfParams& p) {
+    params = p;
+}
+
+const SOCEkfParams& SOCEkf::getParams() const {
+    return params;
+}
+
+void SOCEkf::reset(float soc_pct, float sigma_pct) {
+    x0 = fminf(fmaxf(soc_pct / 100.0f, 0.0f), 1.0f);
+    x1 = 0.0f;
+    float sigma = sigma_pct / 100.0f;
+    p00 = fminf(fmaxf(sigma * sigma, EKF_P00_MIN), EKF_P00_MAX);
+    p01 = 0.0f;
+    p11 = 1e-4f;
+    lastInnovation = 0.0f;
+}
+
+// ========================= MÔ HÌNH =========================
+float SOCEkf::ocv(float soc, float temperature, float* slope) {
+    if (isnan(temperature)) temperature = 25.0f;
+    float cellSlope;
+    float v = bmsOcvCell(soc * 100.0f, temperature, &cellSlope) * EKF_SERIES_CELLS;
+    if (slope) *slope = cellSlope * 100.0f * EKF_SERIES_CELLS;
+    return v;
+}
+
+// ========================= LỌC =========================
+void SOCEkf::step(float packVoltage, float current_A, float temperature, float dt_s) {
+    if (dt_s <= 0.0f || isnan(packVoltage) || isnan(current_A)) return;
+
+    // Lạnh → điện trở tăng (~2 %/°C dưới 25 °C, tối đa x3)
+    float rScale = 1.0f;
+    if (!isnan(temperature) && temperature < 25.0f) {
+        rScale = fminf(1.0f + 0.02f * (25.0f - temperature), 3.0f);
+    }
+    float r0 = params.r0_ohm * rScale;
+    float r1 = params.r1_ohm * rScale;
+
+    // ---- Predict ----
+    float a = expf(-dt_s / params.tau_s);
+    float socGain = dt_s / (3600.0f * params.capacity_Ah);
+
+    x0 += current_A * socGain;
+    x1 = a * x1 + r1 * (1.0f - a) * current_A;
+
+    float drift = params.socDrift_pct / 100.0f;
+    p00 += drift * drift * dt_s / 3600.0f;
+    p01 *= a;
+    p11 = a * a * p11 + params.rcNoise_V * params.rcNoise_V * dt_s;
+
+    // ---- Update ----
+    float h0;
+    float predicted = ocv(x0, temperature, &h0) + x1 + r0 * current_A;
+    float e = packVoltage - predicted;
+
+    // PH' = [h0·p00 + p01, h0·p01 + p11]
+    float ph0 = h0 * p00 + p01;
+    float ph1 = h0 * p01 + p11;
+    // R tăng theo số mẫu trong khoảng tương quan: sai số OCV không trung bình hoá được
+    float r = params.voltageNoise_V * params.voltageNoise_V * fmaxf(params.voltageCorr_s / dt_s, 1.0f);
+    float s = h0 * ph0 + ph1 + r;
+    float k0 = ph0 / s;
+    float k1 = ph1 / s;
+
+    x0 += k0 * e;
+    x1 += k1 * e;
+
+    // P = (I - KH)·P
+    p00 -= k0 * ph0;
+    p01 -= k0 * ph1;
+    p11 -= k1 * ph1;
+
+    x0 = fminf(fmaxf(x0, 0.0f), 1.0f);
+    p00 = fminf(fmaxf(p00, EKF_P00_MIN), EKF_P00_MAX);
+    if (p11 < 1e-8f) p11 = 1e-8f;
+
+    lastInnovation = e;
+}
+
+// ========================= GETTERS =========================
+float SOCEkf::getSOC() const {
+    return x0 * 100.0f;
+}
+
+float SOCEkf::getUncertainty() const {
+    return sqrtf(p00) * 100.0f;
+}
+
+float SOCEkf::getRCVoltage() const {
+    return x1;
+}
+
+float SOCEkf::getInnovation() const {
+    return lastInnovation;
+}
@@ -1,67 +1,107 @@
 #include "soc_estimator.h"
+#include "bms_log_format.h"
+#include <sys/time.h>
+
+// ========================= TRẠNG THÁI GIỮ QUA RESET =========================
+// RTC slow memory giữ qua reset mềm/panic/watchdog; gettimeofday() chạy
+// tiếp qua các reset này nhờ RTC timer → biết được thời gian gián đoạn.
+// Mất nguồn: CRC sai → dùng bản trong journal (không biết thời gian tắt).
+#define SOC_RETAINED_MAGIC  0x32534F53UL   // "SOS2" (thêm ekfSoc)
+#define SOC_FLAG_CHARGED_FULL  0x01
+
+struct SOCRetained {
+    uint32_t magic;
+    float coulomb_mAh;
+    float soc;
+    float ekfSoc;
+    uint8_t flags;
+    uint8_t reserved[3];
+    int64_t time_s;
+    uint32_t crc;
+};
+
+RTC_NOINIT_ATTR static SOCRetained retained;
+
+static int64_t nowSeconds() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec;
+}
+
+static uint32_t retainedCrc() {
+    return bmsCrc32((const uint8_t*)&retained, offsetof(SOCRetained, crc));
+}
 
 SOCEstimator::SOCEstimator(float capacity_ah) 
     : CAPACITY_AH(capacity_ah),
-      CAPACITY_MAH(capacity_ah * 1000.0f),
+      capacity_mAh(capacity_ah * 1000.0f),
       soc(50.0f),
       coulombCounter_mAh(capacity_ah * 500.0f),
       lastUpdateTime(0),
       initialized(false),
+      temperature(25.0f),
       idleStartTime(0),
       isIdle(false),
-      chargedFullThisCycle(false)
+      chargedFullThisCycle(false),
+      chargeIn_mAh(0.0),
+      chargeOut_mAh(0.0),
+      journal(nullptr),
+      startSource("ocv"),
+      ekf(capacity_ah),
+      mode(SOC_MODE_COULOMB),
+      lastModelTime(0),
+      restoredEkfSOC(NAN),
+      cells(nullptr),
+      capacityEst(nullptr),
+      relaxFit(),
+      relaxSOC(NAN),
+      relaxSigma(NAN),
+      lastRelaxFit(0),
+      relaxWeight(0.0f),
+      plateauRef(0.0f),
+      plateauStart(0),
+      taperStart(0),
+      kneeStart(0),
+      fullAnchored(false),
+      emptyAnchored(false),
+      fullAnchors(0),
+      emptyAnchors(0)
 {
 }
 
-float SOCEstimator::ocvToSOC(float voltage) {
-    if (voltage <= OCV_TABLE[0][1]) return 0.0f;
-    if (voltage >= OCV_TABLE[10][1]) return 100.0f;
-    
-    for (int i = 0; i < 10; i++) {
-        float v1 = OCV_TABLE[i][1];
-        float v2 = OCV_TABLE[i+1][1];
-        
-        if (voltage >= v1 && voltage <= v2) {
-            float soc1 = OCV_TABLE[i][0];
-            float soc2 = OCV_TABLE[i+1][0];
-            
-            return soc1 + (voltage - v1) * (soc2 - soc1) / (v2 - v1);
-        }
+void SOCEstimator::begin(BMSJournal& store) {
+    journal = &store;
+    if (journal->isReady()) {
+        long saved = lround(journal->define(JK_SOC_MODE, SOC_MODE_COULOMB, 0.5, 60000));
+        mode = (saved >= SOC_MODE_COULOMB && saved <= SOC_MODE_CELLS) ? (SOCMode)saved
+                                                                      : SOC_MODE_COULOMB;
     }
-    
-    return 50.0f;
 }
 
-float SOCEstimator::getTempCoeff(float temp) {
-    if (temp <= TEMP_COMP_TABLE[0][0]) return TEMP_COMP_TABLE[0][1];
-    if (temp >= TEMP_COMP_TABLE[4][0]) return TEMP_COMP_TABLE[4][1];
-    
-    for (int i = 0; i < 4; i++) {
-        float t1 = TEMP_COMP_TABLE[i][0];
-        float t2 = TEMP_COMP_TABLE[i+1][0];
-        
-        if (temp >= t1 && temp <= t2) {
-            float a1 = TEMP_COMP_TABLE[i][1];
-            float a2 = TEMP_COMP_TABLE[i+1][1];
-            
-            return a1 + (temp - t1) * (a2 - a1) / (t2 - t1);
-        }
-    }
-    
-    return 1.0f;
+// Mặt OCV theo SOC × nhiệt độ (bms_ocv.h), điện áp pack chia đều cho từng cell
+float SOCEstimator::ocvToSOC(float voltage) const {
+    return bmsOcvCellToSOC(voltage / SOC_CELLS, temperature);
 }
 
-void SOCEstimator::autoRecalibrate(float voltage, float current) {
+void SOCEstimator::autoRecalibrate(float voltage, float current, float minCellOcv) {
     if (abs(current) < I_IDLE_THRESHOLD) {
         if (!isIdle) {
             isIdle = true;
             idleStartTime = millis();
+            relax.start();
+            relaxWeight = 0.0f;
+            relaxSOC = NAN;
+            relaxSigma = NAN;
         }
     } else {
         isIdle = false;
     }
     
     unsigned long idleDuration = isIdle ? (millis() - idleStartTime) : 0;
+    if (isIdle) {
+        relax.addSample(idleDuration / 1000.0f, voltage);
+        relaxationSync(idleDuration);
+    }
     
     if (voltage >= 14.5 && current > 0) {
         chargedFullThisCycle = true;
@@ -70,6 +110,9 @@ void SOCEstimator::autoRecalibrate(float voltage, float current) {
         chargedFullThisCycle = false;
     }
 
+    anchorFull(voltage, current);
+    anchorEmpty(minCellOcv, current);
+
     if (voltage >= V_RECALIB_FULL &&
         abs(current) < I_IDLE_THRESHOLD &&
         idleDuration >= 1800000 &&
@@ -78,14 +121,20 @@ void SOCEstimator::autoRecalibrate(float voltage, float current) {
         if (abs(soc - 100.0f) > 2.0f) {
             Serial.println("Recal: FULL");
         }
+        reportAnchor(100.0f, ANCHOR_SIGMA_FULL);
         soc = 100.0f;
-        coulombCounter_mAh = CAPACITY_MAH;
+        coulombCounter_mAh = capacity_mAh;
+        ekf.reset(100.0f, 1.0f);
     }
 
     if (isIdle && idleDuration > 7200000) {
         float ocvSOC = ocvToSOC(voltage);
         float socError = abs(ocvSOC - soc);
         
+        float slope;
+        bmsOcvCell(ocvSOC, temperature, &slope);
+        reportAnchor(ocvSOC, OCV_REST_SIGMA_V / (slope * SOC_CELLS));
+        
         if (socError > 5.0f) {
             float socNew = soc * ALPHA + ocvSOC * (1.0f - ALPHA);
             Serial.printf(
@@ -93,25 +142,261 @@ void SOCEstimator::autoRecalibrate(float voltage, float current) {
                 soc, ocvSOC, socNew
             );
             soc = socNew;
-            coulombCounter_mAh = (soc / 100.0f) * CAPACITY_MAH;
+            coulombCounter_mAh = (soc / 100.0f) * capacity_mAh;
             idleStartTime = millis();
         }
     }
 }
 
-void SOCEstimator::initializeFromVoltage(float packVoltage) {
+// Cuối pha CV: điện áp đứng trong dải ±V_PLATEAU_BAND ít nhất PLATEAU_MIN_MS và
+// dòng sạc đã giảm dưới C/20 liên tục TAPER_DEBOUNCE_MS → SOC = 100 % ngay lúc
+// sạc xong, không chờ 30 phút nghỉ ở điện áp cao
+void SOCEstimator::anchorFull(float voltage, float current) {
+    unsigned long now = millis();
+
+    if (current <= -I_IDLE_THRESHOLD) {
+        fullAnchored = false;
+        taperStart = 0;
+        return;
+    }
+
+    if (abs(voltage - plateauRef) > V_PLATEAU_BAND) {
+        plateauRef = voltage;
+        plateauStart = now;
+    }
+
+    bool taper = voltage >= V_CV_MIN &&
+                 current > 0.0f &&
+                 current < TAIL_C_RATE * CAPACITY_AH &&
+                 now - plateauStart >= PLATEAU_MIN_MS;
+    if (!taper) {
+        taperStart = 0;
+        return;
+    }
+    if (taperStart == 0) taperStart = now;
+    if (fullAnchored || now - taperStart < TAPER_DEBOUNCE_MS) return;
+
+    Serial.printf("Recal: FULL (taper %.2fA @ %.2fV) %.1f%% → 100%%\n", current, voltage, soc);
+    reportAnchor(100.0f, ANCHOR_SIGMA_FULL);
+    soc = 100.0f;
+    coulombCounter_mAh = capacity_mAh;
+    ekf.reset(100.0f, 1.0f);
+    chargedFullThisCycle = true;
+    fullAnchored = true;
+    fullAnchors++;
+}
+
+// Đầu gối phía cạn: OCV dốc (~50 mV/%) nên SOC theo điện áp cell thấp nhất đã bù
+// sụt áp R·I (điện trở đo online, BMSResistance) sai số nhỏ; neo 1 lần mỗi lần xả,
+// cell yếu nhất quyết định pack cạn
+void SOCEstimator::anchorEmpty(float minCellOcv, float current) {
+    unsigned long now = millis();
+
+    if (current >= I_IDLE_THRESHOLD) {
+        emptyAnchored = false;
+        kneeStart = 0;
+        return;
+    }
+    if (isnan(minCellOcv) || current > -I_IDLE_THRESHOLD) {
+        kneeStart = 0;
+        return;
+    }
+
+    if (minCellOcv > KNEE_CELL_V) {
+        kneeStart = 0;
+        return;
+    }
+    if (kneeStart == 0) kneeStart = now;
+    if (emptyAnchored || now - kneeStart < KNEE_DEBOUNCE_MS) return;
+
+    float kneeSOC = bmsOcvCellToSOC(minCellOcv, temperature);
+    Serial.printf("Recal: EMPTY knee (cell OCV~%.3fV) %.1f%% → %.1f%%\n",
+                  minCellOcv, soc, kneeSOC);
+    reportAnchor(kneeSOC, ANCHOR_SIGMA_KNEE);
+    soc = kneeSOC;
+    coulombCounter_mAh = (soc / 100.0f) * capacity_mAh;
+    ekf.reset(soc, 2.0f);
+    emptyAnchored = true;
+    emptyAnchors++;
+}
+
+// Ngoại suy OCV từ đường hồi áp, mức kéo = độ tin cậy w = 1 - σ/RELAX_MAX_SIGMA
+// (σ SOC = σ V∞ / độ dốc OCV tại điểm dự đoán). Fit sau tốt hơn chỉ kéo thêm
+// phần w tăng lên → tổng mức kéo trong 1 đợt nghỉ = w lớn nhất, không cộng dồn.
+void SOCEstimator::relaxationSync(unsigned long idleDuration) {
+    if (idleDuration < RELAX_MIN_REST_MS) return;
+    if (millis() - lastRelaxFit < RELAX_FIT_INTERVAL_MS) return;
+    lastRelaxFit = millis();
+
+    if (!relax.fit(relaxFit)) return;
+
+    relaxSOC = ocvToSOC(relaxFit.ocv_V);
+    float slope;
+    bmsOcvCell(relaxSOC, temperature, &slope);
+    relaxSigma = relaxFit.sigma_V / (slope * SOC_CELLS);
+    if (relaxSigma < RELAX_MAX_SIGMA) reportAnchor(relaxSOC, relaxSigma);
+
+    float weight = 1.0f - relaxSigma / RELAX_MAX_SIGMA;
+    if (weight <= relaxWeight) return;
+
+    float socError = abs(relaxSOC - soc);
+    if (socError <= 2.0f * relaxSigma) return;
+    if (relaxWeight == 0.0f && socError <= 5.0f) return;
+
+    float gain = (weight - relaxWeight) / (1.0f - relaxWeight);
+    float socNew = soc + gain * (relaxSOC - soc);
+    Serial.printf("OCV Sync (relax %lus): SOC=%.1f%% | V∞ %.3fV=%.1f%% ±%.1f%% → %.1f%%\n",
+                  idleDuration / 1000, soc, relaxFit.ocv_V, relaxSOC, relaxSigma, socNew);
+    soc = socNew;
+    coulombCounter_mAh = (soc / 100.0f) * capacity_mAh;
+    relaxWeight = weight;
+}
+
+// Mốc tin cậy → CapacityEstimator (ΔAh theo bộ đếm sạc/xả không bị hiệu chỉnh)
+void SOCEstimator::reportAnchor(float anchorSOC, float sigma) {
+    if (capacityEst == nullptr) return;
+    bool updated = capacityEst->addAnchor(anchorSOC, sigma, (chargeIn_mAh - chargeOut_mAh) / 1000.0,
+                                          (chargeIn_mAh + chargeOut_mAh) / 1000.0);
+    if (updated && capacityEst->isConverged()) {
+        applyCapacity(capacityEst->getCapacityAh());
+    }
+}
+
+// Đổi dung lượng giữ nguyên SOC hiện tại
+void SOCEstimator::applyCapacity(float capacity_Ah) {
+    capacity_mAh = capacity_Ah * 1000.0f;
+    coulombCounter_mAh = (soc / 100.0f) * capacity_mAh;
+
+    SOCEkfParams params = ekf.getParams();
+    params.capacity_Ah = capacity_Ah;
+    ekf.setParams(params);
+}
+
+// ========================= WARM RESTART =========================
+bool SOCEstimator::restoreState(float packVoltage, float current_A) {
+    float savedSOC, savedCoulomb, savedEkf;
+    uint8_t flags;
+    int64_t elapsed = -1;   // -1 = không biết (mất nguồn)
+
+    if (retained.magic == SOC_RETAINED_MAGIC && retained.crc == retainedCrc()) {
+        savedSOC = retained.soc;
+        savedCoulomb = retained.coulomb_mAh;
+        savedEkf = retained.ekfSoc;
+        flags = retained.flags;
+        elapsed = nowSeconds() - retained.time_s;
+        if (elapsed < 0) elapsed = -1;
+        startSource = "rtc";
+    } else if (journal != nullptr && journal->isReady() && journal->has(JK_SOC_COULOMB)) {
+        savedSOC = journal->get(JK_SOC_VALUE);
+        savedCoulomb = journal->get(JK_SOC_COULOMB);
+        savedEkf = journal->has(JK_SOC_EKF) ? journal->get(JK_SOC_EKF) : NAN;
+        flags = (uint8_t)journal->get(JK_SOC_FLAGS);
+        startSource = "journal";
+    } else {
+        return false;
+    }
+
+    if (savedSOC < 0.0f || savedSOC > 100.0f ||
+        savedCoulomb < 0.0f || savedCoulomb > capacity_mAh * 1.05f) {
+        Serial.printf("Warm start rejected (%s): invalid state\n", startSource);
+        return false;
+    }
+    if (elapsed > (int64_t)WARM_STALE_S) {
+        Serial.printf("Warm start rejected (%s): stale, %lds\n", startSource, (long)elapsed);
+        return false;
+    }
+
+    // Tự xả trong thời gian gián đoạn (nếu biết)
+    if (elapsed > 0) {
+        float loss = SELF_DISCHARGE_PER_DAY * (elapsed / 86400.0f);
+        savedSOC = constrain(savedSOC - loss, 0.0f, 100.0f);
+        savedCoulomb = constrain(savedCoulomb - loss / 100.0f * capacity_mAh, 0.0f, capacity_mAh);
+        if (!isnan(savedEkf)) savedEkf -= loss;
+    }
+
+    // Đối chiếu OCV: dung sai theo mức tin cậy của điện áp lúc khởi động
+    float ocvSOC = ocvToSOC(packVoltage);
+    float tolerance;
+    if (abs(current_A) >= I_IDLE_THRESHOLD) {
+        tolerance = WARM_TOL_LOAD;
+    } else if (elapsed < 0 || elapsed < (int64_t)WARM_RELAX_S) {
+        tolerance = WARM_TOL_UNRELAXED;
+    } else {
+        tolerance = WARM_TOL_REST;
+    }
+
+    if (abs(savedSOC - ocvSOC) > tolerance) {
+        Serial.printf("Warm start rejected (%s): SOC %.1f%% vs OCV %.1f%% (tol %.0f%%)\n",
+                      startSource, savedSOC, ocvSOC, tolerance);
+        return false;
+    }
+
+    soc = savedSOC;
+    coulombCounter_mAh = savedCoulomb;
+    if (!isnan(savedEkf) && savedEkf >= 0.0f && savedEkf <= 100.0f) {
+        restoredEkfSOC = savedEkf;
+    }
+    chargedFullThisCycle = (flags & SOC_FLAG_CHARGED_FULL) != 0;
+
+    Serial.printf("Warm start (%s, %lds): %.1f%% | OCV %.1f%%\n",
+                  startSource, (long)elapsed, soc, ocvSOC);
+    return true;
+}
+
+// Lưu trạng thái: RTC memory mỗi lần gọi, journal theo ngưỡng (task nền)
+void SOCEstimator::saveState(bool immediate) {
+    uint8_t flags = chargedFullThisCycle ? SOC_FLAG_CHARGED_FULL : 0;
+
+    retained.magic = SOC_RETAINED_MAGIC;
+    retained.coulomb_mAh = coulombCounter_mAh;
+    retained.soc = soc;
+    retained.ekfSoc = ekf.getSOC();
+    retained.flags = flags;
+    memset(retained.reserved, 0, sizeof(retained.reserved));
+    retained.time_s = nowSeconds();
+    retained.crc = retainedCrc();
+
+    if (journal == nullptr || !journal->isReady()) return;
+    journal->set(JK_SOC_COULOMB, coulombCounter_mAh);
+    journal->set(JK_SOC_VALUE, soc);
+    journal->set(JK_SOC_FLAGS, flags);
+    journal->set(JK_SOC_EKF, ekf.getSOC());
+    if (immediate) journal->sync();
+}
+
+void SOCEstimator::initializeFromVoltage(float packVoltage, float current_A) {
     if (initialized) return;
     
-    soc = ocvToSOC(packVoltage);
-    coulombCounter_mAh = (soc / 100.0f) * CAPACITY_MAH;
+    if (!restoreState(packVoltage, current_A)) {
+        soc = ocvToSOC(packVoltage);
+        coulombCounter_mAh = (soc / 100.0f) * capacity_mAh;
+        startSource = "ocv";
+        Serial.printf("Init: %.3fV → %.1f%% (%.1fAh)\n", 
+                      packVoltage, soc, CAPACITY_AH);
+    }
     lastUpdateTime = millis();
+    lastModelTime = lastUpdateTime;
     initialized = true;
     
-    Serial.printf("Init: %.3fV → %.1f%% (%.1fAh)\n", 
-                  packVoltage, soc, CAPACITY_AH);
+    // EKF: độ bất định ban đầu theo nguồn khởi động
+    if (!isnan(restoredEkfSOC)) {
+        ekf.reset(restoredEkfSOC, startSource[0] == 'r' ? 3.0f : 5.0f);
+    } else {
+        ekf.reset(soc, startSource[0] == 'o' ? 15.0f : 5.0f);
+    }
+    
+    // Khai báo khoá sau khi có trạng thái thật, tránh ghi giá trị mặc định
+    if (journal != nullptr && journal->isReady()) {
+        // Ngưỡng ghi: 0.1% dung lượng, 0.1% SOC, mọi thay đổi cờ; tối đa 60s
+        journal->define(JK_SOC_COULOMB, coulombCounter_mAh, capacity_mAh * 0.001f, 60000);
+        journal->define(JK_SOC_VALUE, soc, 0.1, 60000);
+        journal->define(JK_SOC_FLAGS, 0, 0.5, 60000);
+        journal->define(JK_SOC_EKF, ekf.getSOC(), 0.1, 60000);
+    }
+    saveState(true);
 }
 
-void SOCEstimator::update(float current_A, float temperature) {
+void SOCEstimator::update(float current_A, float temp) {
     if (!initialized) {
         Serial.println("SOC not initialized! Call initializeFromVoltage() first");
         return;
@@ -122,12 +407,19 @@ void SOCEstimator::update(float current_A, float temperature) {
     lastUpdateTime = now;
 
     if (dt_sec > 2.0f) dt_sec = 2.0f;
+    if (!isnan(temp)) temperature = temp;
 
     float charge_mAh = current_A * 1000.0f * (dt_sec / 3600.0f);
     coulombCounter_mAh += charge_mAh;
+    
+    if (charge_mAh > 0) {
+        chargeIn_mAh += charge_mAh;
+    } else {
+        chargeOut_mAh -= charge_mAh;
+    }
 
-    float tempCoeff = getTempCoeff(temperature);
-    float effectiveCapacity_mAh = CAPACITY_MAH * tempCoeff;
+    float tempCoeff = bmsCapacityTempCoeff(temperature);
+    float effectiveCapacity_mAh = capacity_mAh * tempCoeff;
 
     soc = (coulombCounter_mAh / effectiveCapacity_mAh) * 100.0f;
 
@@ -138,32 +430,136 @@ void SOCEstimator::update(float current_A, float temperature) {
         soc = 0.0f;
         coulombCounter_mAh = 0.0f;
     }
+    
+    saveState(false);
+}
+
+void SOCEstimator::updateModel(float packVoltage, float current_A, float temp) {
+    if (!initialized) return;
+
+    unsigned long now = millis();
+    float dt_sec = (now - lastModelTime) / 1000.0f;
+    lastModelTime = now;
+    if (dt_sec > 2.0f) dt_sec = 2.0f;
+
+    ekf.step(packVoltage, current_A, temp, dt_sec);
 }
 
-void SOCEstimator::recalibrate(float packVoltage, float current_A) {
-    autoRecalibrate(packVoltage, current_A);
+void SOCEstimator::recalibrate(float packVoltage, float current_A, float minCellOcv) {
+    autoRecalibrate(packVoltage, current_A, minCellOcv);
 }
 
 void SOCEstimator::reset(float newSOC) {
     soc = constrain(newSOC, 0.0f, 100.0f);
-    coulombCounter_mAh = (soc / 100.0f) * CAPACITY_MAH;
+    coulombCounter_mAh = (soc / 100.0f) * capacity_mAh;
+    ekf.reset(soc, 2.0f);
+    if (capacityEst != nullptr) capacityEst->clearAnchor();
+    if (initialized) saveState(true);
 }
 
 float SOCEstimator::getSOC() const {
+    switch (mode) {
+        case SOC_MODE_EKF:
+            return ekf.getSOC();
+        case SOC_MODE_CELLS:
+            return (cells != nullptr && cells->isInitialized()) ? cells->getPackSOC() : soc;
+        default:
+            return soc;
+    }
+}
+
+float SOCEstimator::getCoulombSOC() const {
     return soc;
 }
 
-void SOCEstimator::printDebug(float packVoltage, float current_A, float temperature) {
-    float ocvSOC = ocvToSOC(packVoltage);
-    float tempCoeff = getTempCoeff(temperature);
+float SOCEstimator::getEkfSOC() const {
+    return ekf.getSOC();
+}
+
+float SOCEstimator::getRCVoltage() const {
+    return ekf.getRCVoltage();
+}
+
+float SOCEstimator::getUncertainty() const {
+    return ekf.getUncertainty();
+}
+
+float SOCEstimator::getRelaxSOC() const {
+    return relaxSOC;
+}
+
+float SOCEstimator::getRelaxSigma() const {
+    return relaxSigma;
+}
+
+void SOCEstimator::attachCells(const SOCCells& cellEstimator) {
+    cells = &cellEstimator;
+}
+
+// Gọi trước initializeFromVoltage() để coulomb counter khôi phục theo dung lượng đã học
+void SOCEstimator::attachCapacity(CapacityEstimator& estimator) {
+    capacityEst = &estimator;
+    if (capacityEst->isConverged()) {
+        applyCapacity(capacityEst->getCapacityAh());
+    }
+}
+
+float SOCEstimator::getCapacityAh() const {
+    return capacity_mAh / 1000.0f;
+}
+
+void SOCEstimator::setMode(SOCMode newMode) {
+    mode = newMode;
+    if (journal != nullptr && journal->isReady()) {
+        journal->set(JK_SOC_MODE, mode);
+        journal->sync();
+    }
+}
+
+SOCMode SOCEstimator::getMode() const {
+    return mode;
+}
+
+const char* SOCEstimator::getModeName() const {
+    switch (mode) {
+        case SOC_MODE_EKF:   return "ekf";
+        case SOC_MODE_CELLS: return "cells";
+        default:             return "coulomb";
+    }
+}
+
+const char* SOCEstimator::getStartSource() const {
+    return startSource;
+}
+
+double SOCEstimator::getChargeInAh() const {
+    return chargeIn_mAh / 1000.0;
+}
+
+double SOCEstimator::getChargeOutAh() const {
+    return chargeOut_mAh / 1000.0;
+}
+
+void SOCEstimator::printDebug(float packVoltage, float current_A, float temp) {
+    float ocvSOC = bmsOcvCellToSOC(packVoltage / SOC_CELLS, temp);
+    float tempCoeff = bmsCapacityTempCoeff(temp);
     
     Serial.println("\n SOC DEBUG ");
     Serial.printf("SOC: %.1f%% | OCV: %.1f%% (Δ%.1f%%)\n", 
                   soc, ocvSOC, abs(soc - ocvSOC));
     Serial.printf("%.1f/%.0f mAh | 🌡 %.1f°C (α%.2f)\n", 
-                  coulombCounter_mAh, CAPACITY_MAH, temperature, tempCoeff);
-    Serial.printf(" %s |  %+.2fA\n",
-                  isIdle ? "IDLE" : "ACTIVE", current_A);
+                  coulombCounter_mAh, capacity_mAh, temp, tempCoeff);
+    Serial.printf(" %s |  %+.2fA | start: %s\n",
+                  isIdle ? "IDLE" : "ACTIVE", current_A, startSource);
+    Serial.printf("EKF: %.1f%% ±%.1f%% | V1 %+.3fV | innov %+.3fV | mode: %s\n",
+                  ekf.getSOC(), ekf.getUncertainty(), ekf.getRCVoltage(), ekf.getInnovation(),
+                  getModeName());
+    Serial.printf("Anchors: full %u (taper) | empty %u (knee)\n", fullAnchors, emptyAnchors);
+    if (isIdle) {
+        Serial.printf("Relax: %u mẫu | V∞ %.3fV ±%.0fmV (τ %.0fs, dốc %+.3fmV/s) → %.1f%% ±%.1f%%%s\n",
+                      relax.getSamples(), relaxFit.ocv_V, relaxFit.sigma_V * 1000.0f, relaxFit.tau_s,
+                      relaxFit.slope_mVps, relaxSOC, relaxSigma, relaxWeight > 0.0f ? " (đã dùng)" : "");
+    }
     
     if (abs(soc - ocvSOC) > 10.0f) {
         Serial.println("Large error - Check calibration");
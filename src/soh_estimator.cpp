@@ -1,23 +1,49 @@
 #include "soh_estimator.h"
 
+#define RAINFLOW_MAGIC  0x31464652   // "RFF1"
+
+// Hệ số tăng tốc Arrhenius so với 25 °C
+static float arrhenius(float eaOverR, float temperature) {
+    float kelvin = constrain(temperature, -20.0f, 60.0f) + 273.15f;
+    return expf(eaOverR * (1.0f / 298.15f - 1.0f / kelvin));
+}
+
 SOHEstimator::SOHEstimator(float nominal_capacity_ah) 
     : NOMINAL_CAPACITY_AH(nominal_capacity_ah),
       EOL_CAPACITY_PERCENT(80.0f),
       RATED_CYCLES(2000.0f),
       soh(100.0f),
       totalCycles(0.0f),
+      damageCycles(0.0f),
       equivalentFullCycles(0.0f),
       currentCapacity_Ah(nominal_capacity_ah),
+      sohCycle(100.0f),
+      measuredCapacity_Ah(NAN),
+      measuredSigma_Ah(NAN),
+      sohPower(100.0f),
+      calendarLoss(0.0),
+      calendarK2(CALENDAR_K25 * CALENDAR_K25),
+      cycleRate(CYCLE_RATE_PRIOR * CYCLE_AGING_LINEAR),
+      remainingDays(NAN),
+      lastAgingUpdate(0),
       lastSOC(50.0f),
       cycleDepthAccum(0.0f),
       chargingCycle(false),
       dischargingCycle(false),
+      rainflow(RAINFLOW_HYSTERESIS),
+      rainflowDirty(false),
+      lastRainflowSave(0),
+      journal(nullptr),
       lastSaveTime(0)
 {
+    memset(depthHalfCycles, 0, sizeof(depthHalfCycles));
 }
 
-void SOHEstimator::begin() {
+void SOHEstimator::begin(BMSJournal& store) {
+    journal = &store;
     loadFromFlash();
+    loadRainflow();
+    lastAgingUpdate = millis();
 }
 
 float SOHEstimator::calculateSOHFromCycles(float cycles) {
@@ -29,7 +55,7 @@ float SOHEstimator::calculateSOHFromCycles(float cycles) {
     return sohCycle;
 }
 
-void SOHEstimator::detectCycle(float currentSOC) {
+void SOHEstimator::detectCycle(float currentSOC, float temperature) {
     float deltaSOC = currentSOC - lastSOC;
     
     if (deltaSOC > 0) {
@@ -56,61 +82,246 @@ void SOHEstimator::detectCycle(float currentSOC) {
         Serial.printf("+%.2f cycles | Total: %.1f\n", newCycles, totalCycles);
     }
     
+    // Rainflow: 10 chu kỳ 10 % không còn tính bằng 1 chu kỳ 100 %
+    RainflowCycle cycles[RAINFLOW_MAX_OUT];
+    uint8_t n = rainflow.addSample(currentSOC, temperature, cycles);
+    for (uint8_t i = 0; i < n; i++) {
+        countCycle(cycles[i]);
+    }
+    if (n > 0 || deltaSOC != 0.0f) rainflowDirty = true;
+    
     lastSOC = currentSOC;
 }
 
+float SOHEstimator::cycleDamage(float depth, float temperature) const {
+    float damage = powf(constrain(depth, 0.0f, 100.0f) / 100.0f, CYCLE_DOD_EXPONENT);
+    if (temperature > 25.0f) {
+        damage *= arrhenius(CYCLE_EA_OVER_R, temperature);
+    }
+    return damage;
+}
+
+// Lão hoá lịch + trung bình điều kiện cho dự báo; gọi mỗi lần cập nhật SOH.
+// Chỉ tính thời gian có nguồn (không biết thời gian tắt máy khi mất nguồn).
+void SOHEstimator::updateAging(float currentSOC, float temperature, float cycleLossDelta) {
+    unsigned long now = millis();
+    float dtDays = (now - lastAgingUpdate) / 86400000.0f;
+    lastAgingUpdate = now;
+    if (dtDays <= 0.0f) return;
+    if (isnan(temperature)) temperature = 25.0f;
+    
+    float k = CALENDAR_K25 * arrhenius(CALENDAR_EA_OVER_R, temperature) *
+              (0.5f + constrain(currentSOC, 0.0f, 100.0f) / 100.0f);
+    // double: L² ~ 25 còn k²·dt ~ 1e-6 mỗi 10 s
+    calendarLoss = sqrt(calendarLoss * calendarLoss + (double)k * k * dtDays);
+    
+    float alpha = fminf(dtDays / LIFE_AVG_DAYS, 1.0f);
+    calendarK2 += alpha * (k * k - calendarK2);
+    cycleRate += alpha * (cycleLossDelta / dtDays - cycleRate);
+}
+
+// Số ngày đến khi SOH = EOL nếu giữ điều kiện trung bình (k̄ = √k², a = %/ngày):
+//   L(t) = k̄·√(t0 + t), t0 = (L/k̄)²;  k̄·(u - √t0) + a·(u² - t0) = SOH - EOL, u = √(t0 + t)
+//   → a·u² + k̄·u - (a·t0 + k̄·√t0 + SOH - EOL) = 0
+float SOHEstimator::projectRemainingDays() const {
+    double margin = soh - EOL_CAPACITY_PERCENT;
+    if (margin <= 0.0) return 0.0f;
+    
+    double k = sqrt(fmax(calendarK2, 0.0f));
+    double a = fmax(cycleRate, 0.0f);
+    double t0 = k > 1e-9 ? (calendarLoss / k) * (calendarLoss / k) : 0.0;
+    double c = a * t0 + k * sqrt(t0) + margin;
+    
+    double u;
+    if (a < 1e-9) {
+        if (k < 1e-9) return 36500.0f;
+        u = c / k;
+    } else {
+        u = (-k + sqrt(k * k + 4.0 * a * c)) / (2.0 * a);
+    }
+    return (float)fmin(u * u - t0, 36500.0);
+}
+
+void SOHEstimator::countCycle(const RainflowCycle& cycle) {
+    uint8_t bin = SOH_DEPTH_BINS - 1;
+    while (bin > 0 && cycle.range < SOH_DEPTH_EDGES[bin]) bin--;
+    depthHalfCycles[bin] += cycle.count >= 1.0f ? 2 : 1;
+    
+    float damage = cycle.count * cycleDamage(cycle.range, cycle.temp);
+    damageCycles += damage;
+    if (cycle.range >= 20.0f) {
+        Serial.printf("Rainflow: %.0f%% cycle @%.0f°C → +%.3f | damage: %.2f\n",
+                      cycle.range, cycle.temp, damage, damageCycles);
+    }
+}
+
+void SOHEstimator::saveRainflow() {
+    RainflowStore store;
+    memset(&store, 0, sizeof(store));
+    store.magic = RAINFLOW_MAGIC;
+    memcpy(store.halfCycles, depthHalfCycles, sizeof(store.halfCycles));
+    store.residueCount = rainflow.getResidueCount();
+    for (uint8_t i = 0; i < store.residueCount; i++) {
+        RainflowPoint p = rainflow.getResidue(i);
+        store.residueSOC[i] = (uint8_t)lroundf(constrain(p.value, 0.0f, 100.0f) * 2.0f);
+        store.residueTemp[i] = (int8_t)lroundf(constrain(p.temp, -40.0f, 100.0f));
+    }
+    
+    prefs.begin(NAMESPACE, false);
+    prefs.putBytes("rainflow", &store, sizeof(store));
+    prefs.end();
+    rainflowDirty = false;
+    lastRainflowSave = millis();
+}
+
+void SOHEstimator::loadRainflow() {
+    RainflowStore store;
+    prefs.begin(NAMESPACE, true);
+    size_t len = prefs.getBytes("rainflow", &store, sizeof(store));
+    prefs.end();
+    lastRainflowSave = millis();
+    
+    if (len != sizeof(store) || store.magic != RAINFLOW_MAGIC) return;
+    
+    memcpy(depthHalfCycles, store.halfCycles, sizeof(depthHalfCycles));
+    RainflowPoint points[RAINFLOW_STACK];
+    uint8_t count = store.residueCount < RAINFLOW_STACK ? store.residueCount : RAINFLOW_STACK;
+    for (uint8_t i = 0; i < count; i++) {
+        points[i].value = store.residueSOC[i] * 0.5f;
+        points[i].temp = store.residueTemp[i];
+    }
+    rainflow.restore(points, count);
+    Serial.printf("Rainflow: %u residue points restored\n", count);
+}
+
+void SOHEstimator::clearRainflow() {
+    rainflow.clear();
+    memset(depthHalfCycles, 0, sizeof(depthHalfCycles));
+    saveRainflow();
+}
+
+// Đẩy trạng thái sang journal (chỉ ghi RAM, task nền quyết định khi nào
+// ghi flash). immediate: reset/hiệu chỉnh - ghi ở lần chạy kế tiếp của task
+void SOHEstimator::saveState(bool immediate) {
+    // Không có journal (chưa begin() / không có partition) → NVS
+    if (journal == nullptr || !journal->isReady()) {
+        if (immediate) saveToFlash();
+        return;
+    }
+    journal->set(JK_SOH, soh);
+    journal->set(JK_SOH_TOTAL_CYCLES, totalCycles);
+    journal->set(JK_SOH_EQ_CYCLES, equivalentFullCycles);
+    journal->set(JK_SOH_CAPACITY, currentCapacity_Ah);
+    journal->set(JK_SOH_CYCLE_ACCUM, cycleDepthAccum);
+    journal->set(JK_SOH_DAMAGE, damageCycles);
+    journal->set(JK_SOH_CALENDAR_LOSS, calendarLoss);
+    journal->set(JK_SOH_CALENDAR_K2, calendarK2);
+    journal->set(JK_SOH_CYCLE_RATE, cycleRate);
+    if (immediate) journal->sync();
+}
+
 void SOHEstimator::saveToFlash() {
     prefs.begin(NAMESPACE, false);
     prefs.putFloat("soh", soh);
     prefs.putFloat("cycles", totalCycles);
     prefs.putFloat("eqCycles", equivalentFullCycles);
     prefs.putFloat("capacity", currentCapacity_Ah);
+    prefs.putFloat("damage", damageCycles);
+    prefs.putFloat("calLoss", (float)calendarLoss);
+    prefs.putFloat("calK2", calendarK2);
+    prefs.putFloat("cycRate", cycleRate);
     prefs.end();
 }
 
 void SOHEstimator::loadFromFlash() {
+    // NVS: nguồn duy nhất trước khi có journal, và giá trị mặc định
+    // cho lần khởi động đầu tiên với journal trống
     prefs.begin(NAMESPACE, true);
     soh = prefs.getFloat("soh", 100.0f);
     totalCycles = prefs.getFloat("cycles", 0.0f);
     equivalentFullCycles = prefs.getFloat("eqCycles", 0.0f);
     currentCapacity_Ah = prefs.getFloat("capacity", NOMINAL_CAPACITY_AH);
+    // Chưa có rainflow: bắt đầu từ số chu kỳ cũ (mỗi chu kỳ tính như 100 %)
+    damageCycles = prefs.getFloat("damage", totalCycles);
+    calendarLoss = prefs.getFloat("calLoss", 0.0f);
+    calendarK2 = prefs.getFloat("calK2", calendarK2);
+    cycleRate = prefs.getFloat("cycRate", cycleRate);
     prefs.end();
     
-    Serial.printf("SOH loaded: %.1f%% | %.1f cycles\n", soh, totalCycles);
+    if (journal != nullptr && journal->isReady()) {
+        bool migrated = !journal->has(JK_SOH);
+        // Ngưỡng ghi: 0.01% SOH, 0.01 chu kỳ, 1mAh, 1% SOC tích luỹ; tối đa 60s
+        soh = journal->define(JK_SOH, soh, 0.01, 60000);
+        totalCycles = journal->define(JK_SOH_TOTAL_CYCLES, totalCycles, 0.01, 60000);
+        equivalentFullCycles = journal->define(JK_SOH_EQ_CYCLES, equivalentFullCycles, 0.01, 60000);
+        currentCapacity_Ah = journal->define(JK_SOH_CAPACITY, currentCapacity_Ah, 0.001, 60000);
+        cycleDepthAccum = journal->define(JK_SOH_CYCLE_ACCUM, 0.0, 1.0, 60000);
+        damageCycles = journal->define(JK_SOH_DAMAGE, totalCycles, 0.01, 60000);
+        // Lão hoá lịch trôi rất chậm: ghi khi lệch 0.001 % hoặc mỗi 10 phút
+        calendarLoss = journal->define(JK_SOH_CALENDAR_LOSS, calendarLoss, 0.001, 600000);
+        calendarK2 = journal->define(JK_SOH_CALENDAR_K2, calendarK2, 0.0001, 600000);
+        cycleRate = journal->define(JK_SOH_CYCLE_RATE, cycleRate, 0.0001, 600000);
+        if (migrated) Serial.println("SOH: journal empty, seeded from NVS");
+    }
+    
+    Serial.printf("SOH loaded: %.1f%% | %.1f cycles | damage %.1f | calendar -%.2f%%\n",
+                  soh, totalCycles, damageCycles, calendarLoss);
 }
 
 void SOHEstimator::update(float currentSOC, float temperature) {
     unsigned long now = millis();
     
-    detectCycle(currentSOC);
+    float damageBefore = damageCycles;
+    detectCycle(currentSOC, temperature);
+    updateAging(currentSOC, temperature, (damageCycles - damageBefore) * CYCLE_AGING_LINEAR);
     
-    soh = calculateSOHFromCycles(totalCycles);
+    sohCycle = constrain(calculateSOHFromCycles(damageCycles) - (float)calendarLoss, 0.0f, 100.0f);
+    soh = sohCycle;
+    
+    if (!isnan(measuredCapacity_Ah)) {
+        float sohMeasured = measuredCapacity_Ah / NOMINAL_CAPACITY_AH * 100.0f;
+        float sigmaMeasured = measuredSigma_Ah / NOMINAL_CAPACITY_AH * 100.0f;
+        float wModel = 1.0f / (CYCLE_MODEL_SIGMA * CYCLE_MODEL_SIGMA);
+        float wMeasured = 1.0f / fmaxf(sigmaMeasured * sigmaMeasured, 0.01f);
+        soh = (sohCycle * wModel + sohMeasured * wMeasured) / (wModel + wMeasured);
+    }
     
     if (soh < 0.0f) soh = 0.0f;
     if (soh > 100.0f) soh = 100.0f;
     
     currentCapacity_Ah = NOMINAL_CAPACITY_AH * (soh / 100.0f);
+    remainingDays = projectRemainingDays();
     
-    if (now - lastSaveTime >= SAVE_INTERVAL) {
+    if (journal != nullptr && journal->isReady()) {
+        saveState(false);
+    } else if (now - lastSaveTime >= SAVE_INTERVAL) {
         saveToFlash();
         lastSaveTime = now;
     }
+    if (rainflowDirty && now - lastRainflowSave >= RAINFLOW_SAVE_INTERVAL) {
+        saveRainflow();
+    }
 }
 
 void SOHEstimator::resetCycles() {
     totalCycles = 0.0f;
+    damageCycles = 0.0f;
     equivalentFullCycles = 0.0f;
     cycleDepthAccum = 0.0f;
-    saveToFlash();
+    clearRainflow();
+    saveState(true);
     Serial.println("Cycles reset");
 }
 
 void SOHEstimator::resetSOH() {
     soh = 100.0f;
     totalCycles = 0.0f;
+    damageCycles = 0.0f;
+    calendarLoss = 0.0;
     equivalentFullCycles = 0.0f;
     currentCapacity_Ah = NOMINAL_CAPACITY_AH;
-    saveToFlash();
+    clearRainflow();
+    saveState(true);
     Serial.println("SOH reset to 100%");
 }
 
@@ -120,19 +331,56 @@ void SOHEstimator::calibrateFromCapacity(float measured_capacity_Ah) {
     
     float estimatedCycles = (100.0f - soh) / CYCLE_AGING_LINEAR;
     totalCycles = estimatedCycles;
+    // Phần không giải thích được bằng lão hoá lịch quy cho chu kỳ
+    damageCycles = fmaxf(100.0f - soh - (float)calendarLoss, 0.0f) / CYCLE_AGING_LINEAR;
     
-    saveToFlash();
+    saveState(true);
     Serial.printf("SOH calibrated: %.1f%% (%.2fAh)\n", soh, currentCapacity_Ah);
 }
 
+void SOHEstimator::setMeasuredCapacity(float capacity_Ah, float sigma_Ah) {
+    if (isnan(capacity_Ah) || !(sigma_Ah > 0.0f)) return;
+    measuredCapacity_Ah = capacity_Ah;
+    measuredSigma_Ah = sigma_Ah;
+}
+
+void SOHEstimator::setPowerFade(float soh_power) {
+    if (isnan(soh_power)) return;
+    sohPower = constrain(soh_power, 0.0f, 100.0f);
+}
+
 float SOHEstimator::getSOH() const { 
     return soh; 
 }
 
+float SOHEstimator::getPowerSOH() const {
+    return sohPower;
+}
+
 float SOHEstimator::getTotalCycles() const { 
     return totalCycles; 
 }
 
+float SOHEstimator::getDamageCycles() const {
+    return damageCycles;
+}
+
+float SOHEstimator::getDepthCycles(uint8_t bin) const {
+    return bin < SOH_DEPTH_BINS ? depthHalfCycles[bin] * 0.5f : 0.0f;
+}
+
+float SOHEstimator::getRemainingDays() const {
+    return remainingDays;
+}
+
+float SOHEstimator::getCalendarLoss() const {
+    return (float)calendarLoss;
+}
+
+float SOHEstimator::getCycleLoss() const {
+    return damageCycles * CYCLE_AGING_LINEAR;
+}
+
 float SOHEstimator::getEquivalentCycles() const { 
     return equivalentFullCycles; 
 }
@@ -142,24 +390,42 @@ float SOHEstimator::getCurrentCapacity() const {
 }
 
 float SOHEstimator::getRemainingCycles() const { 
-    float cyclesUsed = totalCycles;
+    float cyclesUsed = damageCycles;
     float cyclesRemaining = RATED_CYCLES - cyclesUsed;
     return (cyclesRemaining > 0) ? cyclesRemaining : 0.0f;
 }
 
 void SOHEstimator::printDebug() {
-    Serial.println("SOH DEBUG (LINEAR MODEL)");
-    Serial.printf("SOH: %.1f%%\n", soh);
+    Serial.println("SOH DEBUG (CYCLE + CALENDAR AGING + MEASURED CAPACITY)");
+    Serial.printf("SOH: %.1f%% | power: %.1f%%\n", soh, sohPower);
     Serial.printf("Capacity: %.2f/%.1f Ah\n", currentCapacity_Ah, NOMINAL_CAPACITY_AH);
     Serial.printf("Cycles: %.1f / %.0f (%.1f%% used)\n", 
                   totalCycles, RATED_CYCLES, (totalCycles/RATED_CYCLES)*100.0f);
     Serial.printf("Equiv Cycles: %.2f\n", equivalentFullCycles);
+    Serial.printf("Damage: %.2f full cycles @25°C\n", damageCycles);
     Serial.printf("Est. Remaining: %.0f cycles\n", getRemainingCycles());
     
     Serial.println("────────────────────────────────");
-    Serial.printf("Formula: SOH = 100 - (%.1f × 0.01)\n", totalCycles);
-    Serial.printf("           SOH = 100 - %.2f = %.1f%%\n", 
-                  totalCycles * 0.01f, 100.0f - totalCycles * 0.01f);
+    Serial.print("Depth:  ");
+    for (uint8_t b = 0; b < SOH_DEPTH_BINS; b++) {
+        Serial.printf(" %5.0f%%", SOH_DEPTH_EDGES[b]);
+    }
+    Serial.print("\nCycles: ");
+    for (uint8_t b = 0; b < SOH_DEPTH_BINS; b++) {
+        Serial.printf(" %6.1f", getDepthCycles(b));
+    }
+    Serial.printf("\nResidue: %u points\n", rainflow.getResidueCount());
+    Serial.printf("Formula: SOH = 100 - (%.1f × 0.01) - calendar %.2f\n", damageCycles, calendarLoss);
+    Serial.printf("           SOH = 100 - %.2f - %.2f = %.1f%%\n", 
+                  damageCycles * 0.01f, calendarLoss, sohCycle);
+    Serial.printf("Aging rate (avg %.0f d): calendar k=%.3f%%/√d, cycle %.4f%%/d\n",
+                  LIFE_AVG_DAYS, sqrtf(calendarK2), cycleRate);
+    Serial.printf("Est. Remaining: %.0f days to %.0f%%\n", remainingDays, EOL_CAPACITY_PERCENT);
+    if (!isnan(measuredCapacity_Ah)) {
+        Serial.printf("Measured: %.3f ±%.3f Ah → %.1f%% (blend with cycle model ±%.0f%%)\n",
+                      measuredCapacity_Ah, measuredSigma_Ah,
+                      measuredCapacity_Ah / NOMINAL_CAPACITY_AH * 100.0f, CYCLE_MODEL_SIGMA);
+    }
     
     if (soh < 80.0f) {
         Serial.println("Battery approaching EOL!");
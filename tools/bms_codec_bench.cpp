@@ -0,0 +1,175 @@
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS CODEC BENCHMARK (chạy trên máy host)
+ *  Đo tỉ lệ nén và thời gian encode/decode mỗi mẫu của
+ *  bms_codec.h trên dữ liệu log thật (CSV từ bms_log_decode)
+ *  hoặc dữ liệu giả lập, kiểm tra giải mã khớp từng mẫu.
+ *
+ *  Build:  g++ -std=c++11 -O2 -I../include bms_codec_bench.cpp -o bms_codec_bench
+ *  Dùng:   ./bms_codec_bench log.csv
+ *          ./bms_codec_bench --synthetic 86400
+ * ═══════════════════════════════════════════════════════════
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include "bms_codec.h"
+
+static const uint8_t CHANNELS = 7;   // cell1..4 (mV), dòng (mA), nhiệt độ (0.1 °C), SOC (0.1 %)
+
+struct Sample {
+    uint32_t time_ms;
+    int16_t v[CHANNELS];
+};
+
+static int16_t quantize(double value, double scale) {
+    return (int16_t)lround(value * scale);
+}
+
+// ==================== NGUỒN DỮ LIỆU ====================
+// CSV: block,boot,uptime_ms,cell1_V..cell4_V,current_A,temp_C,soc_pct,alarms,flags
+static bool loadCsv(const char* path, std::vector<Sample>& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    char line[256];
+    if (!fgets(line, sizeof(line), f)) {
+        fclose(f);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long block, boot, uptime;
+        double c[4], current, temp, soc;
+        if (sscanf(line, "%lu,%lu,%lu,%lf,%lf,%lf,%lf,%lf,%lf,%lf",
+                   &block, &boot, &uptime, &c[0], &c[1], &c[2], &c[3],
+                   &current, &temp, &soc) != 10) continue;
+
+        Sample s;
+        s.time_ms = (uint32_t)uptime;
+        for (int i = 0; i < 4; i++) s.v[i] = quantize(c[i], 1000.0);
+        s.v[4] = quantize(current, 1000.0);
+        s.v[5] = quantize(temp, 10.0);
+        s.v[6] = quantize(soc, 10.0);
+        out.push_back(s);
+    }
+    fclose(f);
+    return true;
+}
+
+// Chu kỳ xả/nghỉ/sạc 1 Hz với nhiễu ADC cỡ vài LSB
+static void synthesize(size_t count, std::vector<Sample>& out) {
+    srand(1);
+    double soc = 80.0, temp = 25.0;
+    uint32_t t = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t phase = (i / 3600) % 4;
+        double current = phase == 0 ? -20.0 : phase == 2 ? 15.0 : 0.0;
+        if (current != 0.0) current += (rand() % 41 - 20) / 100.0;
+
+        soc += current / 100.0 / 36.0;
+        if (soc < 5.0) soc = 5.0;
+        if (soc > 100.0) soc = 100.0;
+        temp += (current != 0.0 ? 0.0005 : -0.0005);
+
+        Sample s;
+        s.time_ms = t;
+        for (int c = 0; c < 4; c++) {
+            double v = 3.20 + soc * 0.0015 + current * 0.002 + c * 0.003;
+            s.v[c] = quantize(v, 1000.0) + (int16_t)(rand() % 3 - 1);
+        }
+        s.v[4] = quantize(current, 1000.0);
+        s.v[5] = quantize(temp, 10.0);
+        s.v[6] = quantize(soc, 10.0);
+        out.push_back(s);
+
+        t += 1000 + (rand() % 10 == 0 ? rand() % 5 : 0);   // jitter của loop
+    }
+}
+
+// ==================== ĐO ====================
+static void bench(const std::vector<Sample>& samples, size_t blockSize, uint8_t xorMask,
+                  const char* label) {
+    std::vector<uint8_t> storage;
+    std::vector<size_t> blockUsed;
+    BMSCodecWriter writer;
+
+    auto t0 = std::chrono::steady_clock::now();
+    size_t blocks = 0;
+    storage.resize(blockSize);
+    writer.begin(&storage[0], blockSize, CHANNELS, xorMask);
+    for (size_t i = 0; i < samples.size(); i++) {
+        if (!writer.append(samples[i].time_ms, samples[i].v)) {
+            blockUsed.push_back(writer.bytesUsed());
+            blocks++;
+            storage.resize((blocks + 1) * blockSize);
+            writer.begin(&storage[blocks * blockSize], blockSize, CHANNELS, xorMask);
+            writer.append(samples[i].time_ms, samples[i].v);
+        }
+    }
+    blockUsed.push_back(writer.bytesUsed());
+    blocks++;
+    auto t1 = std::chrono::steady_clock::now();
+
+    size_t decoded = 0, mismatches = 0;
+    BMSCodecReader reader;
+    Sample s;
+    for (size_t b = 0; b < blocks; b++) {
+        reader.begin(&storage[b * blockSize], blockSize);
+        while (reader.next(s.time_ms, s.v)) {
+            const Sample& ref = samples[decoded++];
+            if (s.time_ms != ref.time_ms || memcmp(s.v, ref.v, sizeof(s.v)) != 0) mismatches++;
+        }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    size_t used = 0;
+    for (size_t b = 0; b < blockUsed.size(); b++) used += blockUsed[b];
+    double raw = (double)samples.size() * (4 + 2 * CHANNELS);
+    double n = (double)samples.size();
+    double encNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+    double decNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / n;
+
+    printf("%-6s %5u B  %6lu blocks  %6.2f B/sample  ratio %5.1fx (%4.1fx incl. slack)"
+           "  enc %6.1f ns  dec %6.1f ns  %s\n",
+           label, (unsigned)blockSize, (unsigned long)blocks, used / n, raw / used,
+           raw / ((double)blocks * blockSize), encNs, decNs,
+           (mismatches == 0 && decoded == samples.size()) ? "OK" : "MISMATCH");
+}
+
+int main(int argc, char** argv) {
+    std::vector<Sample> samples;
+
+    if (argc == 3 && strcmp(argv[1], "--synthetic") == 0) {
+        synthesize(strtoul(argv[2], nullptr, 10), samples);
+    } else if (argc == 2) {
+        if (!loadCsv(argv[1], samples)) return 1;
+    } else {
+        fprintf(stderr, "usage: %s <log.csv> | --synthetic <samples>\n", argv[0]);
+        return 1;
+    }
+
+    if (samples.empty()) {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+
+    printf("%lu samples x %u channels, raw %lu bytes\n",
+           (unsigned long)samples.size(), CHANNELS,
+           (unsigned long)(samples.size() * (4 + 2 * CHANNELS)));
+
+    const size_t sizes[] = { 512, 4096 };
+    for (size_t i = 0; i < 2; i++) {
+        bench(samples, sizes[i], 0x00, "delta");
+        bench(samples, sizes[i], 0x7F, "xor");
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  BMS LOG DECODER (chạy trên máy host)
+ *  Đọc các segment tải từ /log?seg=N (hoặc dump cả partition),
+ *  kiểm tra CRC từng block, sắp xếp theo block seq và in CSV.
+ *
+ *  Build:  g++ -std=c++11 -O2 -I../include bms_log_decode.cpp -o bms_log_decode
+ *  Dùng:   ./bms_log_decode bmslog_seg*.bin > log.csv
+ * ═══════════════════════════════════════════════════════════
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "bms_log_format.h"
+
+struct Block {
+    uint32_t seq;
+    uint16_t count;
+    std::vector<uint8_t> data;
+};
+
+static bool seqLess(const Block& a, const Block& b) {
+    return a.seq < b.seq;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <segment.bin>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Block> blocks;
+    unsigned long badBlocks = 0;
+
+    for (int a = 1; a < argc; a++) {
+        FILE* f = fopen(argv[a], "rb");
+        if (!f) {
+            perror(argv[a]);
+            return 1;
+        }
+
+        std::vector<uint8_t> buf(BMS_LOG_BLOCK_SIZE);
+        while (fread(buf.data(), 1, buf.size(), f) == buf.size()) {
+            BMSLogBlockHeader h;
+            if (bmsGetU32(buf.data()) == 0xFFFFFFFFUL) continue;   // sector trống
+            if (!bmsLogCheckBlock(buf.data(), h)) {
+                badBlocks++;
+                continue;
+            }
+            Block b;
+            b.seq = h.seq;
+            b.count = h.count;
+            b.data = buf;
+            blocks.push_back(b);
+        }
+        fclose(f);
+    }
+
+    std::sort(blocks.begin(), blocks.end(), seqLess);
+
+    printf("block,boot,uptime_ms,cell1_V,cell2_V,cell3_V,cell4_V,"
+           "current_A,temp_C,soc_pct,alarms,flags\n");
+
+    unsigned long records = 0;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (i > 0 && blocks[i].seq == blocks[i - 1].seq) continue;   // trùng segment
+
+        for (uint16_t r = 0; r < blocks[i].count; r++) {
+            BMSLogRecord rec;
+            bmsLogDecodeRecord(blocks[i].data.data() + BMS_LOG_HEADER_SIZE +
+                               r * BMS_LOG_RECORD_SIZE, rec);
+            printf("%lu,%u,%lu,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,0x%04X,0x%02X\n",
+                   (unsigned long)blocks[i].seq, rec.boot, (unsigned long)rec.uptime_ms,
+                   rec.cell_mV[0] / 1000.0, rec.cell_mV[1] / 1000.0,
+                   rec.cell_mV[2] / 1000.0, rec.cell_mV[3] / 1000.0,
+                   rec.current_mA / 1000.0, rec.temp_dC / 10.0, rec.soc_pm / 10.0,
+                   rec.alarms, rec.flags);
+            records++;
+        }
+    }
+
+    fprintf(stderr, "%lu blocks, %lu records, %lu bad blocks\n",
+            (unsigned long)blocks.size(), records, badBlocks);
+    return 0;
+}
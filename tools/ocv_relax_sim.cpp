@@ -0,0 +1,194 @@
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  OCV RELAX SIMULATION (chạy trên máy host)
+ *  Kiểm tra OCVRelaxation::fit() trên đường hồi áp giả lập:
+ *    V(t) = V∞ + A1·exp(-t/τ1) + A2·exp(-t/τ2) + nhiễu
+ *  trên điện áp pack 4S như SOCEstimator (nhiễu 2 mV, lượng tử
+ *  ADC 4 mV), lấy mẫu mỗi 100 ms, fit từ phút 10 mỗi phút. Mỗi
+ *  nhóm chạy nhiều đường ngẫu nhiên.
+ *
+ *  In ra: tỉ lệ fit hợp lệ; với fit hợp lệ: 2σ cover (|V∞ fit −
+ *  V∞ thật| ≤ 2·sigma_V, σ khớp thực tế → ≥ ~95 %) và sai số
+ *  p95; sai số trung vị của fit hợp lệ / bị loại và σ trung vị
+ *  của fit hợp lệ (sai số lớn phải đi kèm σ lớn); σ trung vị ở
+ *  phút 20/40/60 (inf = đa số bị loại). Cuối cùng vài kiểm tra
+ *  cố định (fit sớm, τ chạm biên, hàm mũ sạch), lỗi → exit 1.
+ *
+ *  Build:  g++ -std=c++17 -O2 -I../include ocv_relax_sim.cpp ../src/ocv_relax.cpp -o ocv_relax_sim
+ *  Dùng:   ./ocv_relax_sim
+ * ═══════════════════════════════════════════════════════════
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "ocv_relax.h"
+
+static const float DT = 0.1f;                 // chu kỳ đo firmware
+static const float FIT_START_S = 600.0f;      // SOCEstimator: fit từ phút 10
+static const float FIT_EVERY_S = 60.0f;
+static const int RUNS = 200;
+
+// ==================== ĐƯỜNG HỒI ÁP ====================
+struct Relax {
+    double vInf;
+    double a1, tau1;
+    double a2, tau2;
+
+    double at(double t) const {
+        return vInf + a1 * exp(-t / tau1) + a2 * exp(-t / tau2);
+    }
+};
+
+struct Group {
+    const char* name;
+    double tau2Min, tau2Max;      // τ chậm (s)
+    double a2Max;                 // |A2| tối đa (V)
+    float duration_s;             // thời gian nghỉ
+};
+
+// τ nhanh 10–40 s, |A1| 20–120 mV (pack); sau xả A < 0, sau sạc A > 0
+static const Group GROUPS[] = {
+    { "typical",   200.0,  800.0, 0.120f, 7200.0f },
+    { "slow",      800.0, 1900.0, 0.120f, 7200.0f },
+    { "very_slow", 3000.0, 8000.0, 0.080f, 7200.0f },
+};
+
+static const float MARKS_S[] = { 1200.0f, 2400.0f, 3600.0f };   // in σ trung vị ở 20/40/60 phút
+static const int MARKS = sizeof(MARKS_S) / sizeof(MARKS_S[0]);
+
+struct Stats {
+    long fits = 0, valid = 0, covered = 0;
+    std::vector<float> errValid, errRejected, sigmaValid;
+    std::vector<float> sigmaAt[MARKS];      // σ của fit hợp lệ tại mốc (∞ nếu bị loại)
+};
+
+static float percentile(std::vector<float>& v, float p) {
+    if (v.empty()) return NAN;
+    size_t k = (size_t)(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static double quantize(double v) {
+    return round(v / 0.004) * 0.004;
+}
+
+// Chạy 1 đường hồi, fit ở các thời điểm như firmware, cộng vào thống kê
+static void runRelax(const Relax& r, float duration_s, std::mt19937& rng, Stats& st) {
+    std::normal_distribution<double> noise(0.0, 0.002);
+    OCVRelaxation relax;
+    relax.start();
+    const long fitEvery = lroundf(FIT_EVERY_S / DT);
+    const long steps = lroundf(duration_s / DT);
+
+    // Đếm bước nguyên: cộng dồn float lệch khỏi mốc fit sau vài nghìn bước
+    for (long i = 0; i <= steps; i++) {
+        float t = i * DT;
+        relax.addSample(t, (float)quantize(r.at(t) + noise(rng)));
+        if (t < FIT_START_S || i % fitEvery != 0) continue;
+
+        OCVRelaxFit fit;
+        relax.fit(fit);
+        double err = fabs(fit.ocv_V - r.vInf);
+        bool inside = err <= 2.0 * fit.sigma_V;
+        st.fits++;
+        if (fit.valid) {
+            st.valid++;
+            if (inside) st.covered++;
+            st.errValid.push_back(err);
+            st.sigmaValid.push_back(fit.sigma_V);
+        } else {
+            st.errRejected.push_back(err);
+        }
+        for (int m = 0; m < MARKS; m++) {
+            if (i == lroundf(MARKS_S[m] / DT)) st.sigmaAt[m].push_back(fit.valid ? fit.sigma_V : INFINITY);
+        }
+    }
+}
+
+static void runGroup(const Group& g) {
+    std::mt19937 rng(2024);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    Stats st;
+
+    for (int i = 0; i < RUNS; i++) {
+        double sign = (i & 1) ? 1.0 : -1.0;
+        Relax r;
+        r.vInf = 13.1 + 0.2 * uni(rng);
+        r.a1 = sign * (0.020 + 0.100 * uni(rng));
+        r.tau1 = 10.0 + 30.0 * uni(rng);
+        r.a2 = sign * (0.020 + (g.a2Max - 0.020) * uni(rng));
+        r.tau2 = g.tau2Min * pow(g.tau2Max / g.tau2Min, uni(rng));
+        runRelax(r, g.duration_s, rng, st);
+    }
+
+    printf("%-10s τ2 %4.0f–%4.0fs | valid %3.0f%% | 2σ cover %5.1f%%  p95 err %4.1f mV"
+           " | median err valid %4.1f (σ %4.1f) / rejected %4.1f mV | σ 20/40/60 min %5.1f %5.1f %5.1f mV\n",
+           g.name, g.tau2Min, g.tau2Max, st.valid * 100.0 / st.fits,
+           st.valid ? st.covered * 100.0 / st.valid : 0.0,
+           percentile(st.errValid, 0.95f) * 1000.0f,
+           percentile(st.errValid, 0.5f) * 1000.0f, percentile(st.sigmaValid, 0.5f) * 1000.0f,
+           percentile(st.errRejected, 0.5f) * 1000.0f,
+           percentile(st.sigmaAt[0], 0.5f) * 1000.0f, percentile(st.sigmaAt[1], 0.5f) * 1000.0f,
+           percentile(st.sigmaAt[2], 0.5f) * 1000.0f);
+}
+
+// ==================== KIỂM TRA CỐ ĐỊNH ====================
+static int failures = 0;
+
+static OCVRelaxFit fitAt(const Relax& r, float t_end) {
+    OCVRelaxation relax;
+    relax.start();
+    for (long i = 0; i <= lroundf(t_end / DT); i++) {
+        relax.addSample(i * DT, (float)r.at(i * DT));
+    }
+    OCVRelaxFit fit = {};
+    relax.fit(fit);
+    return fit;
+}
+
+static void check(const char* name, bool ok, const OCVRelaxFit& fit, const Relax& r) {
+    printf("%s %-44s valid %d  V∞ %.4f (thật %.4f)  σ %5.1f mV  τ %4.0fs  còn hồi %5.1f mV\n",
+           ok ? "PASS" : "FAIL", name, fit.valid, fit.ocv_V, r.vInf, fit.sigma_V * 1000.0f,
+           fit.tau_s, fit.remaining_V * 1000.0f);
+    if (!ok) failures++;
+}
+
+static void runChecks() {
+    // Hàm mũ sạch τ = 300 s, sau 1 giờ: hợp lệ, sai số < 1 mV
+    Relax clean = { 13.200, 0.0, 1.0, -0.150, 300.0 };
+    OCVRelaxFit f = fitAt(clean, 3600.0f);
+    check("1 hàm mũ τ=300s, fit ở 60 phút", f.valid && fabs(f.ocv_V - clean.vInf) < 0.001, f, clean);
+
+    // Quá ít mẫu (1 phút sau phần bỏ qua): fit() trả false
+    f = fitAt(clean, 90.0f);
+    check("< OCV_RELAX_MIN_SAMPLES mẫu", !f.valid, f, clean);
+
+    // τ = 600 s, mới 4 phút: chưa đủ 2τ và còn hồi nhiều → loại
+    Relax early = { 13.200, -0.040, 20.0, -0.120, 600.0 };
+    f = fitAt(early, 240.0f);
+    check("τ2=600s, fit ở 4 phút (chưa đủ 2τ)", !f.valid, f, early);
+
+    // τ = 5000 s > τ lớn nhất của dãy: chạm biên → loại
+    Relax edge = { 13.200, -0.040, 20.0, -0.120, 5000.0 };
+    f = fitAt(edge, 1800.0f);
+    check("τ2=5000s, fit ở 30 phút (τ chạm biên)", !f.valid, f, edge);
+
+    // Chạm biên nhưng phần còn hồi < OCV_RELAX_EDGE_V → vẫn chấp nhận
+    Relax flat = { 13.200, -0.040, 20.0, -0.0015, 5000.0 };
+    f = fitAt(flat, 1800.0f);
+    check("τ2=5000s nhưng |A2| 1.5 mV (còn hồi < 2 mV)",
+          f.valid && fabs(f.ocv_V - flat.vInf) <= 2.0 * f.sigma_V, f, flat);
+}
+
+int main() {
+    for (const Group& g : GROUPS) {
+        runGroup(g);
+    }
+    printf("\n");
+    runChecks();
+    return failures ? 1 : 0;
+}
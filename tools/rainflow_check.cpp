@@ -0,0 +1,218 @@
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  RAINFLOW CHECK (chạy trên máy host)
+ *  Kiểm tra RainflowCounter (rainflow.h):
+ *    1. Chuỗi ví dụ ASTM E1049-85 §5.4.4: -2 1 -3 5 -1 3 -4 4 -2
+ *       → đúng 1 chu kỳ đầy biên độ 4 (−1 → 3); residue còn lại
+ *       đếm nửa chu kỳ khớp bảng ASTM (3, 4, 8, 9, 8, 6). Chạy cả
+ *       với điểm đảo chiều trực tiếp lẫn tín hiệu lấy mẫu dày có
+ *       nhiễu nhỏ hơn hysteresis.
+ *    2. Tràn ngăn xếp: biên độ tăng dần không đóng chu kỳ nào →
+ *       điểm cũ nhất thành nửa chu kỳ, residue giữ RAINFLOW_STACK
+ *       điểm (kể cả đỉnh/đáy đang chờ).
+ *    3. restore(): lưu residue giữa chừng rồi nạp vào bộ đếm mới,
+ *       chu kỳ đếm tiếp phải trùng với chạy liền một mạch, kể cả
+ *       khi residue đầy / đang tràn.
+ *  Lỗi → exit code 1.
+ *
+ *  Build:  g++ -std=c++17 -O2 -I../include rainflow_check.cpp ../src/rainflow.cpp -o rainflow_check
+ *  Dùng:   ./rainflow_check
+ * ═══════════════════════════════════════════════════════════
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "rainflow.h"
+
+static const float HYSTERESIS = 0.5f;
+
+static int failures = 0;
+
+static void check(const char* name, bool ok) {
+    printf("%s %s\n", ok ? "PASS" : "FAIL", name);
+    if (!ok) failures++;
+}
+
+// Chạy chuỗi mẫu, gom mọi chu kỳ đã đóng (kể cả nửa chu kỳ do tràn)
+static void feed(RainflowCounter& rf, const std::vector<float>& samples,
+                 std::vector<RainflowCycle>& cycles) {
+    RainflowCycle out[RAINFLOW_MAX_OUT];
+    for (float v : samples) {
+        uint8_t n = rf.addSample(v, 25.0f, out);
+        cycles.insert(cycles.end(), out, out + n);
+    }
+}
+
+static std::vector<RainflowPoint> residue(const RainflowCounter& rf) {
+    std::vector<RainflowPoint> points;
+    for (uint8_t i = 0; i < rf.getResidueCount(); i++) {
+        points.push_back(rf.getResidue(i));
+    }
+    return points;
+}
+
+// Nửa chu kỳ của residue theo ASTM: mỗi đoạn giữa 2 điểm liền kề
+static std::vector<float> residueRanges(const std::vector<RainflowPoint>& points) {
+    std::vector<float> ranges;
+    for (size_t i = 1; i < points.size(); i++) {
+        ranges.push_back(fabsf(points[i].value - points[i - 1].value));
+    }
+    return ranges;
+}
+
+// Nội suy dày giữa các điểm đảo chiều + nhiễu nhỏ hơn hysteresis
+static std::vector<float> densify(const std::vector<float>& points, std::mt19937& rng) {
+    std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+    std::vector<float> samples;
+    for (size_t i = 1; i < points.size(); i++) {
+        for (int k = 0; k < 20; k++) {
+            float v = points[i - 1] + (points[i] - points[i - 1]) * k / 20.0f;
+            // Đỉnh/đáy giữ nguyên, nhiễu không vượt ra ngoài đoạn (nếu không đỉnh dời đi)
+            float lo = fminf(points[i - 1], points[i]), hi = fmaxf(points[i - 1], points[i]);
+            samples.push_back(k == 0 ? v : fminf(fmaxf(v + noise(rng), lo), hi));
+        }
+    }
+    samples.push_back(points.back());
+    return samples;
+}
+
+// ==================== 1. ASTM E1049 ====================
+static void checkAstm(const char* label, const std::vector<float>& samples) {
+    static const float ASTM_HALF[] = { 3.0f, 4.0f, 8.0f, 9.0f, 8.0f, 6.0f };
+
+    RainflowCounter rf(HYSTERESIS);
+    std::vector<RainflowCycle> cycles;
+    feed(rf, samples, cycles);
+
+    bool full = cycles.size() == 1 && cycles[0].count == 1.0f &&
+                fabsf(cycles[0].range - 4.0f) < 1e-4f && fabsf(cycles[0].mean - 1.0f) < 1e-4f;
+    char name[96];
+    snprintf(name, sizeof(name), "ASTM %s: 1 chu kỳ đầy biên độ 4, trung bình 1", label);
+    check(name, full);
+
+    std::vector<float> ranges = residueRanges(residue(rf));
+    bool half = ranges.size() == sizeof(ASTM_HALF) / sizeof(ASTM_HALF[0]);
+    for (size_t i = 0; half && i < ranges.size(); i++) {
+        half = fabsf(ranges[i] - ASTM_HALF[i]) < 1e-4f;
+    }
+    snprintf(name, sizeof(name), "ASTM %s: residue → nửa chu kỳ 3 4 8 9 8 6", label);
+    check(name, half);
+}
+
+// ==================== 2. TRÀN ====================
+static void checkOverflow() {
+    // 0, 1, -2, 3, -4 ...: mỗi đoạn dài hơn đoạn trước → không chu kỳ nào đóng
+    const int points = RAINFLOW_STACK + 8;
+    std::vector<float> samples;
+    for (int i = 0; i < points; i++) {
+        samples.push_back((i & 1) ? (float)i : -(float)i);
+    }
+    samples.push_back(0.0f);    // xác nhận điểm cuối
+
+    RainflowCounter rf(HYSTERESIS);
+    std::vector<RainflowCycle> cycles;
+    feed(rf, samples, cycles);
+
+    // Residue giữ RAINFLOW_STACK - 1 điểm đã xác nhận + 1 đỉnh chờ
+    bool ok = cycles.size() == (size_t)(points - (RAINFLOW_STACK - 1));
+    for (size_t i = 0; ok && i < cycles.size(); i++) {
+        // Nửa chu kỳ thứ i là đoạn i → i+1: biên độ 2i + 1
+        ok = cycles[i].count == 0.5f && fabsf(cycles[i].range - (2.0f * i + 1.0f)) < 1e-4f;
+    }
+    check("tràn: điểm cũ nhất thành nửa chu kỳ, biên độ 1 3 5 ...", ok);
+    check("tràn: residue giữ RAINFLOW_STACK điểm (+ đỉnh chờ)",
+          rf.getResidueCount() == RAINFLOW_STACK);
+}
+
+// ==================== 3. RESTORE ====================
+static bool sameCycles(const std::vector<RainflowCycle>& a, const std::vector<RainflowCycle>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (fabsf(a[i].range - b[i].range) > 1e-4f || fabsf(a[i].mean - b[i].mean) > 1e-4f ||
+            a[i].count != b[i].count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Cắt chuỗi ở nhiều điểm: lưu residue, nạp vào bộ đếm mới, chạy tiếp; đếm số lần
+// tổng chu kỳ khác với chạy liền một mạch
+static int restoreMismatches(const std::vector<float>& samples, float hysteresis,
+                             size_t first, size_t every, int& splits) {
+    RainflowCounter whole(hysteresis);
+    std::vector<RainflowCycle> reference;
+    feed(whole, samples, reference);
+
+    int mismatches = 0;
+    splits = 0;
+    for (size_t split = first; split < samples.size(); split += every) {
+        splits++;
+        RainflowCounter before(hysteresis);
+        std::vector<RainflowCycle> cycles;
+        feed(before, std::vector<float>(samples.begin(), samples.begin() + split), cycles);
+
+        std::vector<RainflowPoint> saved = residue(before);
+        RainflowCounter after(hysteresis);
+        after.restore(saved.data(), (uint8_t)saved.size());
+        feed(after, std::vector<float>(samples.begin() + split, samples.end()), cycles);
+
+        if (!sameCycles(cycles, reference)) mismatches++;
+    }
+    return mismatches;
+}
+
+static void checkRestore() {
+    // SOC giả lập: dao động ngẫu nhiên 0–100 %, 5000 mẫu
+    std::mt19937 rng(7);
+    std::normal_distribution<float> step(0.0f, 1.5f);
+    std::vector<float> samples;
+    float soc = 50.0f;
+    for (int i = 0; i < 5000; i++) {
+        soc = fminf(fmaxf(soc + step(rng), 0.0f), 100.0f);
+        samples.push_back(soc);
+    }
+
+    char name[96];
+    int splits = 0;
+    int mismatches = restoreMismatches(samples, 2.0f, 100, 397, splits);
+    snprintf(name, sizeof(name), "restore: SOC ngẫu nhiên, %d điểm cắt, chu kỳ trùng chạy liền", splits);
+    check(name, mismatches == 0);
+
+    // Biên độ tăng dần rồi giảm dần: residue đầy ngăn xếp, tràn, rồi đóng lại các chu kỳ
+    samples.clear();
+    for (int i = 0; i < RAINFLOW_STACK + 8; i++) {
+        samples.push_back((i & 1) ? (float)i : -(float)i);
+    }
+    for (int i = RAINFLOW_STACK + 8; i > 0; i--) {
+        samples.push_back((i & 1) ? (float)i : -(float)i);
+    }
+    mismatches = restoreMismatches(samples, HYSTERESIS, 1, 1, splits);
+    snprintf(name, sizeof(name), "restore: residue đầy / tràn, cắt ở mọi mẫu (%d), chu kỳ trùng", splits);
+    check(name, mismatches == 0);
+
+    // Nạp nhiều hơn RAINFLOW_STACK điểm: chỉ giữ các điểm mới nhất
+    std::vector<RainflowPoint> many;
+    for (int i = 0; i < RAINFLOW_STACK + 5; i++) {
+        many.push_back({ (i & 1) ? (float)i : -(float)i, 25.0f });
+    }
+    RainflowCounter rf(HYSTERESIS);
+    rf.restore(many.data(), (uint8_t)many.size());
+    std::vector<RainflowPoint> kept = residue(rf);
+    check("restore: > RAINFLOW_STACK điểm → giữ điểm mới nhất",
+          kept.size() == RAINFLOW_STACK && kept.back().value == many.back().value &&
+          kept.front().value == many[5].value);
+}
+
+int main() {
+    std::vector<float> astm = { -2, 1, -3, 5, -1, 3, -4, 4, -2 };
+    std::mt19937 rng(1);
+
+    checkAstm("điểm đảo chiều", astm);
+    checkAstm("lấy mẫu dày + nhiễu", densify(astm, rng));
+    checkOverflow();
+    checkRestore();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,306 @@
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  SOC CELLS SIMULATION (chạy trên máy host)
+ *  Kiểm tra bộ lọc SOC từng cell (soc_cells_kf.h) và điện lượng
+ *  thừa dùng cho cân bằng. Pack "thật" 4S: mỗi cell dung lượng,
+ *  SOC ban đầu, sai số OCV (±8 mV, lệch pha) và nhánh RC riêng;
+ *  cảm biến dòng offset 30 mA + nhiễu, điện áp cell nhiễu 3 mV.
+ *  Bộ lọc bắt đầu mọi cell từ SOC pack sai 10 % (như initialize).
+ *  Mô hình cân bằng giống BMSBalancing: chỉ khi nghỉ, 1 cell có
+ *  excess lớn nhất, bật ≥ 30 mAh, tắt ≤ 10 mAh, 5 s bật / 5 s tắt;
+ *  chưa đủ tin cậy → theo chênh áp (Δ ≥ 100 mV, Vmax ≥ 3.50 V, tắt
+ *  ≤ 30 mAh). Cell "thật" có knee đầu trên của LFP (OCV vọt lên
+ *  gần 100 %) để quy tắc chênh áp có tác dụng cuối sạc.
+ *
+ *  In ra: RMS / 2σ cover của SOC từng cell; số mAh đã xả (phần
+ *  theo chênh áp), số mAh bị xả nhầm (cell không thừa thật) và
+ *  chênh lệch thật đầu/cuối, cho cả quy tắc cũ (excess thô, cổng
+ *  σ < 3 %, thay hẳn chênh áp) và hiện tại (excess đã trừ 2σ, cổng
+ *  CELL_CONFIDENT_SIGMA, không cell nào thừa đủ → chênh áp).
+ *
+ *  Build:  g++ -std=c++17 -O2 -I../include soc_cells_sim.cpp ../src/soc_cells_kf.cpp -o soc_cells_sim
+ *  Dùng:   ./soc_cells_sim            (tất cả case)
+ *          ./soc_cells_sim partial    (cc | cc_imb | pulse | partial | partial_imb | top_imb)
+ * ═══════════════════════════════════════════════════════════
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include "soc_cells_kf.h"
+#include "bms_ocv.h"
+
+static const float CAPACITY_MAH = 6000.0f;
+static const float DT = 0.1f;                 // chu kỳ đo firmware
+
+static const float BAL_IDLE_CURRENT = 0.1f;   // bms_balancing.h
+static const float BAL_DELTA_START = 0.1f;
+static const float BAL_DELTA_STOP = 0.03f;
+static const float BAL_MIN_CELL_V = 3.50f;
+static const float BAL_EXCESS_START = 30.0f;
+static const float BAL_EXCESS_STOP = 10.0f;
+static const float BAL_CHARGE_MIN_CELL_V = 3.20f;
+static const float BAL_PERIOD_S = 5.0f;
+static const float OLD_CONFIDENT_SIGMA = 3.0f;
+
+// ==================== PACK "THẬT" ====================
+struct Cell {
+    double soc;                                   // %
+    double capacity;                              // mAh
+    double v1 = 0.0;
+    double r0 = 0.017, r1 = 0.012, tau = 45.0;    // lệch so với CELL_R0_OHM
+    double phase;                                 // pha sai số OCV
+
+    // Bảng OCV dừng ở 3.40 V; cell thật vọt lên ~3.55 V sát 100 % (knee đầu trên)
+    double ocv() const {
+        return bmsOcvCell((float)soc, 25.0f, nullptr) + 0.008 * sin(soc * 0.17 + phase) +
+               0.15 * exp((soc - 100.0) / 1.5);
+    }
+
+    double step(double current, double dt) {
+        double a = exp(-dt / tau);
+        soc += current * dt / 3.6 / capacity * 100.0;
+        soc = fmin(fmax(soc, 0.0), 100.0);
+        v1 = a * v1 + r1 * (1.0 - a) * current;
+        return ocv() + v1 + r0 * current;
+    }
+};
+
+// Điện lượng thừa thật (mAh) so với cell còn trống nhất
+static void trueExcess(const Cell cells[SOC_CELLS], double excess[SOC_CELLS]) {
+    double maxRoom = 0.0;
+    for (int i = 0; i < SOC_CELLS; i++) {
+        maxRoom = fmax(maxRoom, (100.0 - cells[i].soc) / 100.0 * cells[i].capacity);
+    }
+    for (int i = 0; i < SOC_CELLS; i++) {
+        excess[i] = maxRoom - (100.0 - cells[i].soc) / 100.0 * cells[i].capacity;
+    }
+}
+
+// ==================== PROFILE DÒNG ====================
+// Trả về dòng (A) tại thời điểm t, hoặc NAN khi hết profile
+typedef double (*Profile)(double t);
+
+static double profileCC(double t) {
+    // Xả 3 A đến ~25 %, nghỉ 1 giờ, sạc 1 A đến ~90 %, nghỉ 2 giờ
+    if (t < 5000.0) return -3.0;
+    if (t < 8600.0) return 0.0;
+    if (t < 8600.0 + 14000.0) return 1.0;
+    if (t < 8600.0 + 14000.0 + 7200.0) return 0.0;
+    return NAN;
+}
+
+static double profilePulse(double t) {
+    // Xung 4 A 30 s / nghỉ 30 s đến ~10 %, nghỉ 1 giờ, sạc 1 A đến ~80 %, nghỉ 2 giờ
+    if (t < 9000.0) return fmod(t, 60.0) < 30.0 ? -4.0 : 0.0;
+    if (t < 12600.0) return 0.0;
+    if (t < 12600.0 + 15000.0) return 1.0;
+    if (t < 12600.0 + 15000.0 + 7200.0) return 0.0;
+    return NAN;
+}
+
+static double profileTop(double t) {
+    // Sạc 1 A đến khi cell cao nhất sát đầy (chưa chạm 100 %), rồi nghỉ 3 giờ
+    if (t < 6800.0) return 1.0;
+    if (t < 6800.0 + 10800.0) return 0.0;
+    return NAN;
+}
+
+static double profilePartial(double t) {
+    // Chu kỳ nông trong vùng phẳng có nghỉ: xả 2 A 40 phút, nghỉ 20 phút,
+    // sạc 1 A 80 phút, nghỉ 20 phút
+    if (t >= 6.0 * 9600.0) return NAN;
+    double p = fmod(t, 9600.0);
+    if (p < 2400.0) return -2.0;
+    if (p < 3600.0) return 0.0;
+    if (p < 8400.0) return 1.0;
+    return 0.0;
+}
+
+struct Case {
+    const char* name;
+    Profile profile;
+    double startSoc;
+    double socOffset[SOC_CELLS];      // lệch SOC thật từng cell (%)
+    double capacityScale[SOC_CELLS];
+};
+
+static const Case CASES[] = {
+    { "cc",          profileCC,      95.0, { 0.0, 0.0, 5.0, 0.0 }, { 0.98, 1.00, 0.97, 0.99 } },
+    { "cc_imb",      profileCC,      88.0, { 0.0, 0.0, 12.0, 0.0 }, { 0.98, 1.00, 0.97, 0.99 } },
+    { "pulse",       profilePulse,   95.0, { 0.0, 0.0, 0.0, 0.0 }, { 1.00, 1.00, 1.00, 1.00 } },
+    { "partial",     profilePartial, 60.0, { 0.0, 0.0, 0.0, 0.0 }, { 1.00, 1.00, 1.00, 1.00 } },
+    { "partial_imb", profilePartial, 60.0, { 0.0, 0.0, 5.0, 0.0 }, { 0.98, 1.00, 0.97, 0.99 } },
+    { "top_imb",     profileTop,     60.0, { 0.0, 0.0, 8.0, 0.0 }, { 1.00, 1.00, 1.00, 1.00 } },
+};
+
+// ==================== CÂN BẰNG ====================
+struct Balancer {
+    bool oldRule = false;             // true: điện lượng thay hẳn chênh áp khi valid
+    bool active = false;
+    bool byCharge = false;            // quy tắc của lượt đang chạy
+    int cell = -1;
+    double wrong_mAh = 0.0;           // xả cell không thừa thật
+    double bled_mAh = 0.0;
+    double bledVoltage_mAh = 0.0;     // phần xả theo chênh áp
+    double bledFallback_mAh = 0.0;    // ... trong đó lúc valid (dự phòng)
+    bool startedValid = false;
+
+    // Trả về cell được xả trong bước này (-1 = không)
+    int step(double t, bool idle, bool valid, const float excess[SOC_CELLS],
+             const float volts[SOC_CELLS]) {
+        int idx = 0, vIdx = 0;
+        float vmin = volts[0];
+        for (int i = 1; i < SOC_CELLS; i++) {
+            if (excess[i] > excess[idx]) idx = i;
+            if (volts[i] > volts[vIdx]) vIdx = i;
+            vmin = fminf(vmin, volts[i]);
+        }
+        float delta = volts[vIdx] - vmin;
+
+        bool charge = active ? byCharge
+                             : valid && (oldRule || excess[idx] >= BAL_EXCESS_START);
+        bool start, stop;
+        if (charge) {
+            start = idle && vmin >= BAL_CHARGE_MIN_CELL_V && excess[idx] >= BAL_EXCESS_START;
+            stop = !valid || !idle || vmin < BAL_CHARGE_MIN_CELL_V || excess[idx] <= BAL_EXCESS_STOP;
+        } else {
+            start = idle && volts[vIdx] >= BAL_MIN_CELL_V && delta >= BAL_DELTA_START;
+            stop = !idle || delta <= BAL_DELTA_STOP;
+        }
+
+        if (!active) {
+            if (start) {
+                active = true;
+                byCharge = charge;
+                startedValid = valid;
+            }
+        } else if (stop) {
+            active = false;
+        }
+        if (!active) return -1;
+        // Đầu mỗi pha ON chọn lại cell như firmware
+        if (fmod(t, 2.0 * BAL_PERIOD_S) < BAL_PERIOD_S) {
+            if (cell < 0) cell = byCharge ? idx : vIdx;
+            return cell;
+        }
+        cell = -1;
+        return -1;
+    }
+};
+
+// ==================== CHẠY ====================
+static void runBalance(const Case& c, bool oldRule) {
+    std::mt19937 rng(12345);
+    std::normal_distribution<double> currentNoise(0.0, 0.02);
+    std::normal_distribution<double> voltageNoise(0.0, 0.003);
+    const double currentOffset = 0.03;
+
+    Cell cells[SOC_CELLS];
+    for (int i = 0; i < SOC_CELLS; i++) {
+        cells[i].soc = c.startSoc + c.socOffset[i];
+        cells[i].capacity = CAPACITY_MAH * c.capacityScale[i];
+        cells[i].phase = i * 1.7;
+    }
+
+    float soc[SOC_CELLS], var[SOC_CELLS], capacity[SOC_CELLS], r0[SOC_CELLS], charge[SOC_CELLS];
+    for (int i = 0; i < SOC_CELLS; i++) {
+        soc[i] = (float)(c.startSoc - 10.0);
+        var[i] = 100.0f;
+        capacity[i] = CAPACITY_MAH;
+        r0[i] = CELL_R0_OHM;
+    }
+
+    double startExcess[SOC_CELLS], excessTrue[SOC_CELLS];
+    trueExcess(cells, startExcess);
+
+    Balancer bal;
+    bal.oldRule = oldRule;
+    bool bleeding[SOC_CELLS] = { false, false, false, false };
+    double sumSq = 0.0, sigmaSum = 0.0;
+    long samples = 0, inside = 0;
+
+    for (double t = 0.0;; t += DT) {
+        double current = c.profile(t);
+        if (std::isnan(current)) break;
+
+        float measured[SOC_CELLS];
+        for (int i = 0; i < SOC_CELLS; i++) {
+            double bleed = bleeding[i] ? cells[i].ocv() / CELL_BLEED_OHM : 0.0;
+            measured[i] = (float)(cells[i].step(current - bleed, DT) + voltageNoise(rng));
+            if (bleeding[i]) {
+                bal.bled_mAh += bleed * DT / 3.6;
+                if (!bal.byCharge) bal.bledVoltage_mAh += bleed * DT / 3.6;
+                if (!bal.byCharge && bal.startedValid) bal.bledFallback_mAh += bleed * DT / 3.6;
+                trueExcess(cells, excessTrue);
+                if (excessTrue[i] < BAL_EXCESS_STOP) bal.wrong_mAh += bleed * DT / 3.6;
+            }
+        }
+        double sensed = current + currentOffset + currentNoise(rng);
+
+        socCellsStep(soc, var, capacity, r0, measured, (float)sensed, 25.0f, bleeding, DT, charge);
+
+        for (int i = 0; i < SOC_CELLS; i++) {
+            double err = soc[i] - cells[i].soc;
+            sumSq += err * err;
+            sigmaSum += sqrt(var[i]);
+            if (fabs(err) <= 2.0 * sqrt(var[i])) inside++;
+            samples++;
+        }
+
+        // Excess: thô + cổng σ < 3 % (cũ) hoặc đã trừ 2σ + cổng σ < 5 % (hiện tại)
+        float excess[SOC_CELLS];
+        bool valid = true;
+        if (oldRule) {
+            float room[SOC_CELLS], maxRoom = 0.0f;
+            for (int i = 0; i < SOC_CELLS; i++) {
+                room[i] = (100.0f - soc[i]) / 100.0f * capacity[i];
+                maxRoom = fmaxf(maxRoom, room[i]);
+                if (var[i] >= OLD_CONFIDENT_SIGMA * OLD_CONFIDENT_SIGMA) valid = false;
+            }
+            for (int i = 0; i < SOC_CELLS; i++) excess[i] = maxRoom - room[i];
+        } else {
+            for (int i = 0; i < SOC_CELLS; i++) {
+                if (var[i] >= CELL_CONFIDENT_SIGMA * CELL_CONFIDENT_SIGMA) valid = false;
+            }
+            socCellsBalanceExcess(soc, var, capacity, excess);
+        }
+
+        bool idle = fabs(sensed) < BAL_IDLE_CURRENT;
+        int on = bal.step(t, idle, valid, excess, measured);
+        for (int i = 0; i < SOC_CELLS; i++) bleeding[i] = (i == on);
+    }
+
+    double endExcess[SOC_CELLS];
+    trueExcess(cells, endExcess);
+    double startMax = 0.0, endMax = 0.0;
+    for (int i = 0; i < SOC_CELLS; i++) {
+        startMax = fmax(startMax, startExcess[i]);
+        endMax = fmax(endMax, endExcess[i]);
+    }
+
+    if (oldRule) {
+        printf("%-12s old: excess thô, σ < 3 %%, thay chênh áp | bled %4.0f mAh (voltage %4.0f, valid %4.0f), wrong %4.0f mAh"
+               " | imbalance %4.0f → %4.0f mAh\n",
+               c.name, bal.bled_mAh, bal.bledVoltage_mAh, bal.bledFallback_mAh, bal.wrong_mAh, startMax, endMax);
+    } else {
+        printf("%-12s %6.0fs  rms %5.2f%%  σ %5.2f%%  2σ cover %3.0f%%\n",
+               c.name, samples / SOC_CELLS * DT, sqrt(sumSq / samples), sigmaSum / samples,
+               inside * 100.0 / samples);
+        printf("%-12s new: excess - 2σ, σ < 5 %%, dự phòng áp | bled %4.0f mAh (voltage %4.0f, valid %4.0f), wrong %4.0f mAh"
+               " | imbalance %4.0f → %4.0f mAh\n",
+               c.name, bal.bled_mAh, bal.bledVoltage_mAh, bal.bledFallback_mAh, bal.wrong_mAh, startMax, endMax);
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* only = argc > 1 ? argv[1] : nullptr;
+
+    for (const Case& c : CASES) {
+        if (only && strcmp(only, c.name) != 0) continue;
+        runBalance(c, false);
+        runBalance(c, true);
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * ═══════════════════════════════════════════════════════════
+ *  SOC EKF SIMULATION (chạy trên máy host)
+ *  Kiểm tra SOCEkf trên các profile dòng giả lập: pack "thật"
+ *  là mô hình 1RC với thông số lệch so với bộ lọc, OCV lệch
+ *  ±15 mV, cảm biến dòng có offset + nhiễu, điện áp có nhiễu.
+ *  So sánh với coulomb counting cùng điều kiện, cả hai bắt đầu
+ *  sai 30 % SOC. "2σ cover" = tỉ lệ mẫu có |sai số| ≤ 2σ báo cáo
+ *  (σ khớp thực tế → ~95 %), tính trên cả lần chạy và sau hội tụ.
+ *
+ *  Build:  g++ -std=c++17 -O2 -I../include soc_ekf_sim.cpp ../src/soc_ekf.cpp -o soc_ekf_sim
+ *  Dùng:   ./soc_ekf_sim            (tất cả profile)
+ *          ./soc_ekf_sim pulse      (cc | pulse | random | partial)
+ *          ./soc_ekf_sim pulse --csv > trace.csv
+ * ═══════════════════════════════════════════════════════════
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include "soc_ekf.h"
+
+static const float CAPACITY_AH = 6.0f;
+static const float DT = 0.1f;                 // chu kỳ đo firmware
+
+// ==================== PACK "THẬT" ====================
+struct Plant {
+    double soc = 0.8;
+    double v1 = 0.0;
+    double r0 = 0.070, r1 = 0.050, tau = 45.0;   // lệch so với mặc định của bộ lọc
+    double capacity = CAPACITY_AH * 0.97;        // dung lượng thật hơi thấp hơn danh định
+
+    double ocv() const {
+        float v = SOCEkf::ocv((float)soc, 25.0f, nullptr);
+        return v + 0.015 * sin(soc * 17.0);       // sai số mô hình OCV
+    }
+
+    double step(double current, double dt) {
+        double a = exp(-dt / tau);
+        soc += current * dt / (3600.0 * capacity);
+        if (soc < 0.0) soc = 0.0;
+        if (soc > 1.0) soc = 1.0;
+        v1 = a * v1 + r1 * (1.0 - a) * current;
+        return ocv() + v1 + r0 * current;
+    }
+};
+
+// ==================== PROFILE DÒNG ====================
+// Trả về dòng (A) tại thời điểm t, hoặc NAN khi hết profile
+typedef double (*Profile)(double t, std::mt19937& rng);
+
+static double profileCC(double t, std::mt19937&) {
+    // Xả 3 A (0.5C) đến ~5 %, nghỉ 30 phút, sạc 1 A
+    if (t < 5400.0) return -3.0;
+    if (t < 7200.0) return 0.0;
+    if (t < 7200.0 + 18000.0) return 1.0;
+    return NAN;
+}
+
+static double profilePulse(double t, std::mt19937&) {
+    // Xung 4 A 30 s / nghỉ 30 s đến cạn, rồi sạc
+    if (t < 10800.0) return fmod(t, 60.0) < 30.0 ? -4.0 : 0.0;
+    if (t < 10800.0 + 16000.0) return 1.0;
+    return NAN;
+}
+
+static double profileRandom(double t, std::mt19937& rng) {
+    // Tải thay đổi ngẫu nhiên mỗi 20 s, trung bình xả ~1.5 A, sạc xen kẽ
+    static double level = 0.0;
+    static long lastSlot = -1;
+    long slot = (long)(t / 20.0);
+    if (slot != lastSlot) {
+        lastSlot = slot;
+        std::uniform_real_distribution<double> u(-4.0, 1.2);
+        level = u(rng);
+    }
+    return t < 14400.0 ? level : NAN;
+}
+
+static double profilePartial(double t, std::mt19937&) {
+    // Chu kỳ nông trong vùng phẳng: xả 2 A 40 phút / sạc 1 A 80 phút
+    if (t >= 6.0 * 7200.0) return NAN;
+    return fmod(t, 7200.0) < 2400.0 ? -2.0 : 1.0;
+}
+
+struct Case {
+    const char* name;
+    Profile profile;
+    double startSoc;
+};
+
+static const Case CASES[] = {
+    { "cc",      profileCC,      0.95 },
+    { "pulse",   profilePulse,   0.95 },
+    { "random",  profileRandom,  0.80 },
+    { "partial", profilePartial, 0.60 },
+};
+
+// ==================== CHẠY ====================
+static void run(const Case& c, bool csv) {
+    std::mt19937 rng(12345);
+    std::normal_distribution<double> currentNoise(0.0, 0.02);
+    std::normal_distribution<double> voltageNoise(0.0, 0.01);
+    const double currentOffset = 0.03;        // offset cảm biến dòng (A)
+
+    Plant plant;
+    plant.soc = c.startSoc;
+
+    float initSoc = (float)(c.startSoc * 100.0 - 30.0);
+    SOCEkf ekf(CAPACITY_AH);
+    ekf.reset(initSoc, 20.0f);
+    double coulomb = initSoc / 100.0;
+
+    double sumEkf = 0.0, sumCc = 0.0, maxEkf = 0.0;
+    long samples = 0, inside = 0, insideAll = 0, counted = 0;
+    double convergeAt = -1.0;
+    double stepNs = 0.0;
+
+    if (csv) printf("t_s,current_A,voltage_V,soc_true,soc_ekf,sigma,soc_cc\n");
+
+    for (double t = 0.0;; t += DT) {
+        double current = c.profile(t, rng);
+        if (std::isnan(current)) break;
+
+        double voltage = plant.step(current, DT) + voltageNoise(rng);
+        double measured = current + currentOffset + currentNoise(rng);
+
+        auto t0 = std::chrono::steady_clock::now();
+        ekf.step((float)voltage, (float)measured, 25.0f, DT);
+        stepNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        coulomb += measured * DT / (3600.0 * CAPACITY_AH);
+        coulomb = fmin(fmax(coulomb, 0.0), 1.0);
+
+        double truth = plant.soc * 100.0;
+        double errEkf = ekf.getSOC() - truth;
+        double errCc = coulomb * 100.0 - truth;
+
+        if (convergeAt < 0.0 && fabs(errEkf) < 5.0) convergeAt = t;
+        if (convergeAt >= 0.0) {
+            sumEkf += errEkf * errEkf;
+            sumCc += errCc * errCc;
+            maxEkf = fmax(maxEkf, fabs(errEkf));
+            if (fabs(errEkf) <= 2.0 * ekf.getUncertainty()) inside++;
+            counted++;
+        }
+        if (fabs(errEkf) <= 2.0 * ekf.getUncertainty()) insideAll++;
+        samples++;
+
+        if (csv && samples % 10 == 0) {
+            printf("%.1f,%.3f,%.3f,%.2f,%.2f,%.2f,%.2f\n", t, measured, voltage, truth,
+                   ekf.getSOC(), ekf.getUncertainty(), coulomb * 100.0);
+        }
+    }
+
+    if (csv) return;
+
+    double finalTruth = plant.soc * 100.0;
+    printf("%-8s %7.0fs  converge %6.0fs  EKF rms %5.2f%% max %5.2f%% final %+6.2f%% (σ %.2f%%, 2σ cover %3.0f%% all / %3.0f%% converged)"
+           "  |  CC rms %5.2f%% final %+6.2f%%  |  %.0f ns/step\n",
+           c.name, samples * DT, convergeAt,
+           counted ? sqrt(sumEkf / counted) : NAN, maxEkf, ekf.getSOC() - finalTruth,
+           ekf.getUncertainty(), insideAll * 100.0 / samples, counted ? inside * 100.0 / counted : 0.0,
+           counted ? sqrt(sumCc / counted) : NAN, coulomb * 100.0 - finalTruth, stepNs / samples);
+}
+
+int main(int argc, char** argv) {
+    const char* only = argc > 1 && argv[1][0] != '-' ? argv[1] : nullptr;
+    bool csv = argc > 2 && strcmp(argv[2], "--csv") == 0;
+
+    for (const Case& c : CASES) {
+        if (only && strcmp(only, c.name) != 0) continue;
+        run(c, csv);
+    }
+    return 0;
+}